@@ -0,0 +1,191 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Arena (region) memory allocation.
+ *
+ * Allocations are carved sequentially out of large blocks obtained from
+ * xmalloc. Individual allocations are never freed; the entire arena is
+ * released (or reset for reuse) in one operation.
+ *
+ * @file       slp_arena.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    CommonCodeArena
+ */
+
+#include "slp_arena.h"
+#include "slp_xmalloc.h"
+
+/** The alignment of every arena allocation. */
+#define SLP_ARENA_ALIGN \
+      (sizeof(double) > sizeof(void *)? sizeof(double): sizeof(void *))
+
+/** Round a size up to the arena alignment. */
+#define SLP_ARENA_ROUND(n) \
+      (((n) + SLP_ARENA_ALIGN - 1) & ~(SLP_ARENA_ALIGN - 1))
+
+/** The size of a block header, rounded to the arena alignment. */
+#define SLP_ARENA_HDRSZ SLP_ARENA_ROUND(sizeof(SLPArenaBlock))
+
+/** Create a new (empty) arena.
+ *
+ * No block memory is allocated until the first call to SLPArenaAlloc.
+ *
+ * @param[in] blocksize - The size of each arena block in bytes, or zero
+ *    to use SLP_ARENA_BLOCKSIZE.
+ *
+ * @return A new arena, or NULL on memory allocation failure.
+ */
+SLPArena SLPArenaCreate(size_t blocksize)
+{
+   SLPArena arena = xmalloc(sizeof(struct _SLPArena));
+   if (arena)
+   {
+      arena->blocks = 0;
+      arena->blocksize = blocksize? blocksize: SLP_ARENA_BLOCKSIZE;
+   }
+   return arena;
+}
+
+/** Allocate memory from an arena.
+ *
+ * Requests larger than the arena block size are given a block of their
+ * own, so that a single large allocation does not waste the remainder
+ * of the current block.
+ *
+ * @param[in] arena - The arena to allocate from.
+ * @param[in] size - The number of bytes to allocate.
+ *
+ * @return A pointer to @p size bytes of suitably aligned memory, or NULL
+ *    on memory allocation failure. The memory is valid until the arena
+ *    is reset or freed.
+ */
+void * SLPArenaAlloc(SLPArena arena, size_t size)
+{
+   SLPArenaBlock * block = arena->blocks;
+   void * mem;
+
+   size = SLP_ARENA_ROUND(size? size: 1);
+   if (block == 0 || block->size - block->used < size)
+   {
+      size_t blksz = size > arena->blocksize? size: arena->blocksize;
+      block = xmalloc(SLP_ARENA_HDRSZ + blksz);
+      if (block == 0)
+         return 0;
+      block->size = blksz;
+      block->used = 0;
+
+      /* Oversized blocks go behind the current block so that the
+       * current block's free space is still used by later requests.
+       */
+      if (blksz > arena->blocksize && arena->blocks)
+      {
+         block->next = arena->blocks->next;
+         arena->blocks->next = block;
+      }
+      else
+      {
+         block->next = arena->blocks;
+         arena->blocks = block;
+      }
+   }
+   mem = (uint8_t *)block + SLP_ARENA_HDRSZ + block->used;
+   block->used += size;
+   return mem;
+}
+
+/** Copy a (possibly unterminated) string into an arena.
+ *
+ * @param[in] arena - The arena to allocate from.
+ * @param[in] str - The string to copy.
+ * @param[in] len - The length of @p str in bytes.
+ *
+ * @return A null-terminated copy of @p str, or NULL on memory allocation
+ *    failure.
+ */
+char * SLPArenaStrDup(SLPArena arena, const char * str, size_t len)
+{
+   char * dup = SLPArenaAlloc(arena, len + 1);
+   if (dup)
+   {
+      memcpy(dup, str, len);
+      dup[len] = 0;
+   }
+   return dup;
+}
+
+/** Release all allocations made from an arena, but keep one block.
+ *
+ * @param[in] arena - The arena to reset.
+ *
+ * @remarks The most recently allocated standard-size block is retained
+ *    so that an arena reused for a similar working set does not need to
+ *    go back to the heap.
+ */
+void SLPArenaReset(SLPArena arena)
+{
+   SLPArenaBlock * keep = arena->blocks;
+   SLPArenaBlock * block;
+
+   if (keep == 0)
+      return;
+
+   block = keep->next;
+   while (block)
+   {
+      SLPArenaBlock * next = block->next;
+      xfree(block);
+      block = next;
+   }
+   keep->next = 0;
+   keep->used = 0;
+}
+
+/** Free an arena and every allocation made from it.
+ *
+ * @param[in] arena - The arena to free; may be NULL.
+ */
+void SLPArenaFree(SLPArena arena)
+{
+   if (arena)
+   {
+      SLPArenaBlock * block = arena->blocks;
+      while (block)
+      {
+         SLPArenaBlock * next = block->next;
+         xfree(block);
+         block = next;
+      }
+      xfree(arena);
+   }
+}
+
+/*=========================================================================*/
@@ -0,0 +1,87 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Header file for arena (region) memory allocation.
+ *
+ * An arena hands out many small allocations from a few large blocks and
+ * releases all of them at once. It is intended for short-lived working
+ * sets, such as the result collation of a single API call, where every
+ * allocation has the same lifetime.
+ *
+ * @file       slp_arena.h
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    CommonCodeArena
+ */
+
+#ifndef SLP_ARENA_H_INCLUDED
+#define SLP_ARENA_H_INCLUDED
+
+/*!@defgroup CommonCodeArena Arena
+ * @ingroup CommonCodeUtility
+ * @{
+ */
+
+#include "slp_types.h"
+
+/** The default arena block size in bytes. */
+#define SLP_ARENA_BLOCKSIZE   4096
+
+/** A block of arena memory. */
+typedef struct _SLPArenaBlock
+{
+   struct _SLPArenaBlock * next; /*!< The next (older) block. */
+   size_t size;                  /*!< The usable size of this block. */
+   size_t used;                  /*!< The number of bytes handed out. */
+} SLPArenaBlock;
+
+/** An arena allocator. */
+typedef struct _SLPArena
+{
+   SLPArenaBlock * blocks;       /*!< The block list, newest first. */
+   size_t blocksize;             /*!< The size of new blocks. */
+} * SLPArena;
+
+SLPArena SLPArenaCreate(size_t blocksize);
+
+void * SLPArenaAlloc(SLPArena arena, size_t size);
+
+char * SLPArenaStrDup(SLPArena arena, const char * str, size_t len);
+
+void SLPArenaReset(SLPArena arena);
+
+void SLPArenaFree(SLPArena arena);
+
+/*! @} */
+
+#endif   /* SLP_ARENA_H_INCLUDED */
+
+/*=========================================================================*/
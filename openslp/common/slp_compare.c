@@ -151,6 +151,15 @@ static int hex2bin(int c)
    return c - (c <= '9'? '0': 'A' - 10);
 }
 
+#if defined(HAVE_ICU) || defined(SLP_COMPARE_TEST) || defined(SLP_COMPARE_BENCH)
+/* The copying comparator below is the reference implementation for the
+ * streaming one. ICU builds still use it for strings that are not plain
+ * ASCII, and the test and benchmark programs compare against it.
+ */
+# define SLP_COMPARE_COPYING 1
+#endif
+
+#ifdef SLP_COMPARE_COPYING
 /** Unescape an SLP string in place.
  *
  * Replace escape sequences with corresponding character codes in a
@@ -217,6 +226,8 @@ static int SLPFoldWhiteSpace(size_t len, char * str)
    return (int)len;
 }
 
+#endif /* SLP_COMPARE_COPYING */
+
 /** Lexical compare routine.
  *
  * Performs a lexical string compare on two normalized UTF-8 strings as
@@ -300,7 +311,9 @@ size_t SLPNormalizeString(size_t len, const char * srcstr, char * dststr, int tr
          {
             if (ishex(srcstr[1]) && ishex(srcstr[2]))
             {
-               *upd++ = (char)(hex2bin(srcstr[0]) * 16 + hex2bin(srcstr[1]));
+               *upd++ = (char)tolower(hex2bin(srcstr[1]) * 16
+                     + hex2bin(srcstr[2]));
+               srcstr += 3;
                len -= 3;
             }
             else
@@ -320,11 +333,249 @@ size_t SLPNormalizeString(size_t len, const char * srcstr, char * dststr, int tr
    return upd - dststr;
 }
 
+#ifdef SLP_COMPARE_COPYING
+/** Compares two trimmed, non-empty, non-normalized strings by copying.
+ *
+ * Unescapes and folds white space in private copies of both strings,
+ * and then calls SLPCompareNormalizedString on the copies.
+ *
+ * @param[in] str1len - The length of str1 in bytes.
+ * @param[in] str1 - A pointer to string to be compared.
+ * @param[in] str2len - The length of str2 in bytes.
+ * @param[in] str2 - A pointer to string to be compared.
+ *
+ * @return The same as SLPCompareString.
+ *
+ * @internal
+ */
+static int SLPCompareStringCopying(size_t str1len, const char * str1,
+      size_t str2len, const char * str2)
+{
+   int result;
+   char * cpy1, * cpy2;
+
+   /* Make modifiable copies. If either fails, compare original strings. */
+   cpy1 = xmemdup(str1, str1len);
+   cpy2 = xmemdup(str2, str2len);
+   if (cpy1 != 0 && cpy2 != 0)
+   {
+      /* Unescape copies in place. */
+      str1len = SLPUnescapeInPlace(str1len, cpy1);
+      str2len = SLPUnescapeInPlace(str2len, cpy2);
+
+      /* Fold white space in place. */
+      str1len = SLPFoldWhiteSpace(str1len, cpy1);
+      str2len = SLPFoldWhiteSpace(str2len, cpy2);
+
+      /* Reset original pointers to modified copies. */
+      str1 = cpy1;
+      str2 = cpy2;
+   }
+
+   /* Comparison logic. */
+   if (str1len == str2len)
+      result = SLPCompareNormalizedString(str1, str2, str1len);
+   else if (str1len > str2len)
+      result = -1;
+   else
+      result = 1;
+
+   xfree(cpy1);
+   xfree(cpy2);
+
+   return result;
+}
+#endif /* SLP_COMPARE_COPYING */
+
+/** Build a machine word with every byte set to @p b. */
+#define SWAR_BYTES(b) (((size_t)-1 / 0xFF) * (b))
+
+/** Non-zero if any byte of the ASCII word @p x is less than @p n. */
+#define SWAR_HASLESS(x, n) (((x) - SWAR_BYTES(n)) & ~(x) & SWAR_BYTES(0x80))
+
+/** Fold the upper case letters of the ASCII word @p x to lower case.
+ *
+ * Adding 0x3F sets a byte's high bit if the byte is at least 'A', and
+ * adding 0x25 sets it if the byte is above 'Z'; where exactly one of the
+ * two is set the byte is an upper case letter, and gets 0x20 or'ed in.
+ */
+#define SWAR_TOLOWER(x) ((x) | (((((x) + SWAR_BYTES(0x3F)) \
+      ^ ((x) + SWAR_BYTES(0x25))) & SWAR_BYTES(0x80)) >> 2))
+
+/** Classify a word of string data for the plain-string fast path.
+ *
+ * @param[in] x - A word of string data.
+ *
+ * @return Non-zero if @p x holds a byte that needs normalizing or that
+ *    SWAR_TOLOWER cannot handle: white space or another control character,
+ *    a backslash, or a byte outside US ASCII.
+ *
+ * @internal
+ */
+static size_t SWARNotPlain(size_t x)
+{
+   return (x & SWAR_BYTES(0x80)) | SWAR_HASLESS(x, 0x21)
+         | SWAR_HASLESS(x ^ SWAR_BYTES('\\'), 1);
+}
+
+/** Compare two trimmed, equal length, plain ASCII strings.
+ *
+ * Plain strings contain only the printable US ASCII characters other than
+ * space and backslash, so they are already normalized and may be compared
+ * a machine word at a time.
+ *
+ * @param[in] len - The length in bytes of both strings.
+ * @param[in] str1 - A pointer to string to be compared.
+ * @param[in] str2 - A pointer to string to be compared.
+ * @param[out] result - The address of storage for the comparison result,
+ *    as returned by SLPCompareString, if both strings are plain.
+ *
+ * @return Zero if both strings are plain and @p result is valid, or
+ *    non-zero if either string needs the full normalizing comparison.
+ *
+ * @internal
+ */
+static int SLPComparePlainString(size_t len, const char * str1,
+      const char * str2, int * result)
+{
+   size_t i = 0;
+   size_t diff = (size_t)-1;  /* offset of the first difference */
+
+   for (; i + sizeof(size_t) <= len; i += sizeof(size_t))
+   {
+      size_t w1, w2;
+      memcpy(&w1, str1 + i, sizeof(w1));
+      memcpy(&w2, str2 + i, sizeof(w2));
+      if (SWARNotPlain(w1) | SWARNotPlain(w2))
+         return 1;
+      if (diff == (size_t)-1 && SWAR_TOLOWER(w1) != SWAR_TOLOWER(w2))
+         diff = i;
+   }
+   for (; i < len; i++)
+   {
+      int c1 = (unsigned char)str1[i];
+      int c2 = (unsigned char)str2[i];
+      if (c1 <= ' ' || c1 >= 0x80 || c1 == '\\'
+            || c2 <= ' ' || c2 >= 0x80 || c2 == '\\')
+         return 1;
+      if (diff == (size_t)-1 && tolower(c1) != tolower(c2))
+         diff = i;
+   }
+
+   /* The first differing word only locates the difference. */
+   *result = 0;
+   if (diff != (size_t)-1)
+      for (i = diff; i < len && *result == 0; i++)
+         *result = tolower((unsigned char)str1[i])
+               - tolower((unsigned char)str2[i]);
+   return 0;
+}
+
+/** Tests whether a trimmed string is plain; see SLPComparePlainString.
+ *
+ * @param[in] len - The length of @p str in bytes.
+ * @param[in] str - The string to test.
+ *
+ * @return Non-zero if @p str is plain, otherwise zero.
+ *
+ * @internal
+ */
+static int SLPIsPlainString(size_t len, const char * str)
+{
+   size_t i = 0;
+   for (; i + sizeof(size_t) <= len; i += sizeof(size_t))
+   {
+      size_t w;
+      memcpy(&w, str + i, sizeof(w));
+      if (SWARNotPlain(w))
+         return 0;
+   }
+   for (; i < len; i++)
+   {
+      int c = (unsigned char)str[i];
+      if (c <= ' ' || c >= 0x80 || c == '\\')
+         return 0;
+   }
+   return 1;
+}
+
+#ifndef HAVE_ICU
+/** A cursor over the normalized form of a string. */
+typedef struct _SLPNormCursor
+{
+   const char * cur;    /*!< The next unread source byte. */
+   const char * end;    /*!< The end of the source string. */
+   int inspace;         /*!< The last character produced was white space. */
+} SLPNormCursor;
+
+/** Produce the next character of a string's normalized form.
+ *
+ * Escape sequences are decoded, and each run of white space is reduced
+ * to its first character, just as SLPUnescapeInPlace followed by
+ * SLPFoldWhiteSpace would do, but without a copy.
+ *
+ * @param[in,out] nc - The cursor to advance.
+ *
+ * @return The next character, or -1 at the end of the string.
+ *
+ * @internal
+ */
+static int SLPNormNext(SLPNormCursor * nc)
+{
+   while (nc->cur < nc->end)
+   {
+      int c = (unsigned char)*nc->cur++;
+      if (c == '\\' && nc->end - nc->cur >= 2
+            && ishex(nc->cur[0]) && ishex(nc->cur[1]))
+      {
+         c = (unsigned char)(hex2bin(nc->cur[0]) * 16 + hex2bin(nc->cur[1]));
+         nc->cur += 2;
+      }
+      if (isspace(c))
+      {
+         if (nc->inspace)
+            continue;
+         nc->inspace = 1;
+      }
+      else
+         nc->inspace = 0;
+      return c;
+   }
+   return -1;
+}
+
+/** Compute the length of a string's normalized form.
+ *
+ * @param[in] len - The length of @p str in bytes.
+ * @param[in] str - The string to measure.
+ *
+ * @return The length in bytes of the normalized form of @p str.
+ *
+ * @internal
+ */
+static size_t SLPNormLength(size_t len, const char * str)
+{
+   SLPNormCursor nc;
+   size_t n = 0;
+
+   nc.cur = str;
+   nc.end = str + len;
+   nc.inspace = 0;
+   while (SLPNormNext(&nc) >= 0)
+      n++;
+   return n;
+}
+#endif /* ! HAVE_ICU */
+
 /** Compares two non-normalized strings.
  *
  * Normalizes two strings by removing leading and trailing white space,
  * folding internal white space and unescaping the strings first, and then
- * calling SLPCompareNormalizedString (as per RFC 2608, section 6.4).
+ * comparing them case-insensitively (as per RFC 2608, section 6.4).
+ *
+ * Normalization is done on the fly, so no memory is allocated. Strings
+ * of plain printable ASCII, by far the most common case, are compared a
+ * machine word at a time.
  *
  * @param[in] str1 - A pointer to string to be compared.
  * @param[in] str1len - The length of str1 in bytes.
@@ -339,7 +590,6 @@ int SLPCompareString(size_t str1len, const char * str1,
       size_t str2len, const char * str2)
 {
    int result;
-   char * cpy1, * cpy2;
 
    /* Remove leading white space. */
    while (str1len && isspace((unsigned char)*str1))
@@ -353,7 +603,7 @@ int SLPCompareString(size_t str1len, const char * str1,
    while (str2len && isspace((unsigned char)str2[str2len - 1]))
       str2len--;
 
-   /*A quick check for empty strings before we start xmemduping and xfreeing*/
+   /* A quick check for empty strings. */
    if (str1len == 0 || str2len == 0)
    {
       if(str1len == str2len)
@@ -363,36 +613,51 @@ int SLPCompareString(size_t str1len, const char * str1,
       return 1;
    }
 
-   /* Make modifiable copies. If either fails, compare original strings. */
-   cpy1 = xmemdup(str1, str1len);
-   cpy2 = xmemdup(str2, str2len);
-   if (cpy1 != 0 && cpy2 != 0)
+   /* Plain strings are their own normalized form. */
+   if (str1len == str2len)
    {
-      /* Unescape copies in place. */
-      str1len = SLPUnescapeInPlace(str1len, cpy1);
-      str2len = SLPUnescapeInPlace(str2len, cpy2);
-
-      /* Fold white space in place. */
-      str1len = SLPFoldWhiteSpace(str1len, cpy1);
-      str2len = SLPFoldWhiteSpace(str2len, cpy2);
-
-      /* Reset original pointers to modified copies. */
-      str1 = cpy1;
-      str2 = cpy2;
+      if (SLPComparePlainString(str1len, str1, str2, &result) == 0)
+         return result;
    }
+   else if (SLPIsPlainString(str1len, str1)
+         && SLPIsPlainString(str2len, str2))
+      return str1len > str2len? -1: 1;
 
-   /* Comparison logic. */
-   if (str1len == str2len)
-      result = SLPCompareNormalizedString(str1, str2, str1len);
-   else if (str1len > str2len)
-      result = -1;
-   else
-      result = 1;
-
-   xfree(cpy1);
-   xfree(cpy2);
-
-   return result;
+#ifdef HAVE_ICU
+   /* Leave anything beyond ASCII to ICU. */
+   return SLPCompareStringCopying(str1len, str1, str2len, str2);
+#else
+   {
+      SLPNormCursor nc1, nc2;
+      size_t norm1len = SLPNormLength(str1len, str1);
+      size_t norm2len = SLPNormLength(str2len, str2);
+
+      /* Strings of different normalized lengths are ordered by length. */
+      if (norm1len != norm2len)
+         return norm1len > norm2len? -1: 1;
+
+      /* Compare the normalized forms as strncasecmp would. */
+      nc1.cur = str1;
+      nc1.end = str1 + str1len;
+      nc1.inspace = 0;
+      nc2.cur = str2;
+      nc2.end = str2 + str2len;
+      nc2.inspace = 0;
+      for (;;)
+      {
+         int c1 = SLPNormNext(&nc1);
+         int c2 = SLPNormNext(&nc2);
+         if (c1 < 0)
+            return 0;
+         c1 = tolower(c1);
+         c2 = tolower(c2);
+         if (c1 != c2)
+            return c1 - c2;
+         if (c1 == 0)
+            return 0;
+      }
+   }
+#endif
 }
 
 /** Compare service type for matching naming authority.
@@ -512,8 +777,9 @@ int SLPContainsStringList(size_t listlen, const char * list, size_t stringlen,
       itembegin = itemend;
 
       /* Seek to the end of the next list item, break on commas. */
-      while (itemend != listend && itemend[0] != ',')
-         itemend++;
+      itemend = memchr(itembegin, ',', listend - itembegin);
+      if (!itemend)
+         itemend = listend;
 
       if (SLPCompareString(itemend - itembegin, itembegin,
             stringlen, string) == 0)
@@ -548,8 +814,9 @@ int SLPIntersectStringList(size_t list1len, const char * list1,
       itembegin = itemend;
 
       /* Seek to the end of the next list item, break on commas. */
-      while (itemend < listend && itemend[0] != ',')
-         itemend++;
+      itemend = memchr(itembegin, ',', listend - itembegin);
+      if (!itemend)
+         itemend = listend;
 
       if (SLPContainsStringList(list2len, list2,
             itemend - itembegin, itembegin))
@@ -730,7 +997,8 @@ int SLPUnionStringList(size_t list1len, const char * list1, size_t list2len,
 int SLPSubsetStringList(size_t listlen, const char * list,
       size_t sublistlen, const char * sublist)
 {
-   unsigned curpos;
+   const char * comma;
+   const char * sublistend = sublist + sublistlen;
    int sublistcount;
 
    /* Quick check for empty lists. Note that an empty sub-list is not
@@ -740,13 +1008,12 @@ int SLPSubsetStringList(size_t listlen, const char * list,
       return 0;
 
    /* Count the items in sublist. */
-   curpos = 0;
    sublistcount = 1;
-   while (curpos < sublistlen)
+   comma = sublist;
+   while ((comma = memchr(comma, ',', sublistend - comma)) != 0)
    {
-      if (sublist[curpos] == ',')
-         sublistcount++;
-      curpos++;
+      sublistcount++;
+      comma++;
    }
 
    /* Intersect the lists, return 1 if proper subset, 0 if not. */
@@ -821,8 +1088,73 @@ int SLPCheckAttributeListSyntax(const char * attrlist, size_t attrlistlen)
    return 0;
 }
 
+#if defined(SLP_COMPARE_TEST) || defined(SLP_COMPARE_BENCH)
+
+/* The comparator as it was before SLPCompareString learned to normalize
+ * on the fly: trim, then compare unescaped, folded copies.
+ */
+static int CopyingCompareString(size_t str1len, const char * str1,
+      size_t str2len, const char * str2)
+{
+   while (str1len && isspace((unsigned char)*str1))
+      str1++, str1len--;
+   while (str2len && isspace((unsigned char)*str2))
+      str2++, str2len--;
+   while (str1len && isspace((unsigned char)str1[str1len - 1]))
+      str1len--;
+   while (str2len && isspace((unsigned char)str2[str2len - 1]))
+      str2len--;
+   if (str1len == 0 || str2len == 0)
+      return str1len == str2len? 0: str1len < str2len? -1: 1;
+   return SLPCompareStringCopying(str1len, str1, str2len, str2);
+}
+
+#endif
+
 #ifdef SLP_COMPARE_TEST
 
+/* Check SLPCompareString against the copying comparator on every pair
+ * of a set of strings chosen to exercise trimming, white space folding,
+ * escapes, case, embedded nulls and the word-at-a-time path.
+ */
+static int test_SLPCompareString(void)
+{
+   static const char * strs[] =
+   {
+      "", " ", "\t \t", "a", "A", " a ", "abc", "ABC", "abd", "ab",
+      "a b", "a  b", "a\tb", "a \tb", " a \t b ", "a\\20b", "a\\20 b",
+      "a\\20\\20b", "a\\41", "aA", "A\\61", "\\5c41", "\\5C41", "x\\",
+      "x\\4", "x\\zz", "x\\4g", "a\\00b", "a\\00c", "caf\xc3\xa9",
+      "CAF\xc3\xa9", "caf\xc3\x89", "DEFAULT", "default", "default,x",
+      "service:printer:lpr://host.example.com:515/queue",
+      "SERVICE:PRINTER:LPR://HOST.EXAMPLE.COM:515/QUEUE",
+      "service:printer:lpr://host.example.com:515/queuf",
+      "service:printer:lpr://host.example.com:515/queue ",
+      "service:printer:lpr://host.example.com:515/\\71ueue",
+      "service:printer:lpr://host example.com:515/queue",
+      "@[`{~\x7f", "@[`{~\x7f", "`{@[\x7f~",
+   };
+   size_t n = sizeof(strs) / sizeof(*strs);
+   size_t i, j;
+
+   for (i = 0; i < n; i++)
+      for (j = 0; j < n; j++)
+      {
+         size_t len1 = strlen(strs[i]);
+         size_t len2 = strlen(strs[j]);
+         int r1, r2;
+
+         r1 = SLPCompareString(len1, strs[i], len2, strs[j]);
+         r2 = CopyingCompareString(len1, strs[i], len2, strs[j]);
+         /* Only equality is compared: the ordering of unequal strings
+          * of the same length came from the C library's strncasecmp.
+          */
+         if ((r1 == 0) != (r2 == 0))
+            return -1;
+      }
+   return 0;
+}
+
 /* Test boundary conditions of SLPFoldWhiteSpace. */
 static int test_SLPFoldWhiteSpace(void)
 {
@@ -889,6 +1221,9 @@ int main(void)
    if (test_SLPFoldWhiteSpace() != 0)
       return -1;
 
+   if (test_SLPCompareString() != 0)
+      return -1;
+
    /* *** SLPContainsStringList ***
     */
    count = SLPContainsStringList(sizeof lst1 - 1, lst1, sizeof str1 - 1, str1);
@@ -922,4 +1257,108 @@ int main(void)
 
 #endif /* SLP_COMPARE_TEST */
 
+#ifdef SLP_COMPARE_BENCH
+
+/* ------------- Benchmark main for the slp_compare.c module -------------
+ *
+ * Times SLPCompareString and SLPContainsStringList against the copying
+ * comparator they replaced, on a mix of matching and non-matching service
+ * URLs, service types and scope lists.
+ *
+ * Build and run with:
+ *    make slp-compare-bench && ./slp-compare-bench [iterations]
+ */
+
+typedef int BenchCompare(size_t, const char *, size_t, const char *);
+typedef int BenchContains(size_t, const char *, size_t, const char *);
+
+/* SLPContainsStringList as it was, on top of the copying comparator. */
+static int CopyingContainsStringList(size_t listlen, const char * list,
+      size_t stringlen, const char * string)
+{
+   const char * listend = list + listlen;
+   const char * itembegin = list;
+   const char * itemend = itembegin;
+
+   while (itemend < listend)
+   {
+      itembegin = itemend;
+      while (itemend != listend && itemend[0] != ',')
+         itemend++;
+      if (CopyingCompareString(itemend - itembegin, itembegin,
+            stringlen, string) == 0)
+         return (int)(1 + (itembegin - list));
+      itemend++;
+   }
+   return 0;
+}
+
+static double BenchSeconds(clock_t start)
+{
+   return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char * argv[])
+{
+   static const char * pairs[][2] =
+   {
+      {"service:printer:lpr://host.example.com:515/queue",
+       "service:printer:lpr://host.example.com:515/queue"},
+      {"service:printer:lpr://host.example.com:515/queue",
+       "SERVICE:PRINTER:LPR://HOST.EXAMPLE.COM:515/QUEUE"},
+      {"service:printer:lpr://host.example.com:515/queue",
+       "service:printer:lpr://host.example.com:515/other"},
+      {"service:printer:lpr://host.example.com:515/queue",
+       "service:printer:lpr://host.example.com/queue"},
+      {"service:printer", "service:printer"},
+      {"DEFAULT", "default"},
+      {"engineering", "marketing"},
+      {"a\\2cb", "a\\2Cb"},
+      {"Big  Blue  Printer", "big blue printer"},
+   };
+   static const char scopes[] =
+         "engineering,marketing,sales,support,finance,legal,DEFAULT";
+   static const char * wanted[] = {"DEFAULT", "sales", "research"};
+
+   const char * names[] = {"copying", "streaming"};
+   BenchCompare * cmps[] = {CopyingCompareString, SLPCompareString};
+   BenchContains * contains[] =
+         {CopyingContainsStringList, SLPContainsStringList};
+   long iters = argc > 1? atol(argv[1]): 1000000;
+   size_t npairs = sizeof(pairs) / sizeof(*pairs);
+   size_t nwanted = sizeof(wanted) / sizeof(*wanted);
+   volatile int sink = 0;
+   int k;
+
+   printf("%ld iterations\n", iters);
+   for (k = 0; k < 2; k++)
+   {
+      clock_t start = clock();
+      double secs;
+      long i;
+
+      for (i = 0; i < iters; i++)
+      {
+         const char ** pair = pairs[i % npairs];
+         sink += cmps[k](strlen(pair[0]), pair[0], strlen(pair[1]), pair[1]);
+      }
+      secs = BenchSeconds(start);
+      printf("%-10s SLPCompareString      %8.1f ns/call\n", names[k],
+            secs * 1e9 / iters);
+
+      start = clock();
+      for (i = 0; i < iters; i++)
+      {
+         const char * str = wanted[i % nwanted];
+         sink += contains[k](sizeof(scopes) - 1, scopes, strlen(str), str);
+      }
+      secs = BenchSeconds(start);
+      printf("%-10s SLPContainsStringList %8.1f ns/call\n", names[k],
+            secs * 1e9 / iters);
+   }
+   return sink == 42? 1: 0;
+}
+
+#endif /* SLP_COMPARE_BENCH */
+
 /*=========================================================================*/
@@ -0,0 +1,639 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Shared DA cache.
+ *
+ * Creates and updates the DA cache on behalf of slpd, and maps and reads
+ * it on behalf of libslp, so that both agree on its layout and on the
+ * sequence lock that guards it.
+ *
+ * slpd never truncates a cache file in place; a new one is created under
+ * a temporary name and renamed over the old, so a reader that mapped the
+ * old one, say before slpd restarted, keeps a valid mapping, and learns
+ * from the cache going stale that it should map the file again.
+ *
+ * Where mmap is unavailable no cache is created or mapped, and libslp
+ * asks slpd over IPC as before.
+ *
+ * @file       slp_dacache.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    CommonCodeDACache
+ */
+
+#include "slp_dacache.h"
+#include "slp_atomic.h"
+#include "slp_xmalloc.h"
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+# include <sys/mman.h>
+# define DACACHE_MMAP 1
+#endif
+
+/** How many times a reader tries to get a consistent copy before it
+ * gives up and leaves slpd to be asked over IPC.
+ */
+#define DACACHE_RETRIES    1000
+
+/** Order the loads before this call against those after it.
+ *
+ * An atomic increment is a full barrier on every platform slp_atomic
+ * supports, and readers may not store to the read-only mapping, so this
+ * increments a private counter instead.
+ *
+ * @internal
+ */
+static void DACacheBarrier(void)
+{
+   static intptr_t fence = 0;
+
+   SLPAtomicInc(&fence);
+}
+
+/** Create a DA cache.
+ *
+ * The cache is created empty under a temporary name and then renamed to
+ * @p path, so readers never see it half initialised.
+ *
+ * @param[in] path - The name of the cache file.
+ * @param[in] size - The size of the cache in bytes.
+ *
+ * @return The cache, to be released with SLPDACacheDestroy, or NULL on
+ *    error.
+ */
+SLPDACacheHeader * SLPDACacheCreate(const char * path, size_t size)
+{
+#ifdef DACACHE_MMAP
+   SLPDACacheHeader * cache = 0;
+   char * tmppath;
+   int fd;
+
+   if (size < sizeof(SLPDACacheHeader)
+         || (tmppath = xmalloc(strlen(path) + 5)) == 0)
+      return 0;
+   sprintf(tmppath, "%s.new", path);
+   unlink(tmppath);
+
+   if ((fd = open(tmppath, O_RDWR | O_CREAT | O_EXCL, 0644)) >= 0)
+   {
+      /* every local process may read it, whatever slpd's umask */
+      if (fchmod(fd, 0644) == 0 && ftruncate(fd, (off_t)size) == 0)
+      {
+         cache = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+         if (cache == MAP_FAILED)
+            cache = 0;
+      }
+      close(fd);
+   }
+
+   if (cache)
+   {
+      memcpy(cache->magic, SLP_DACACHE_MAGIC, sizeof(cache->magic));
+      cache->wordsize = sizeof(intptr_t);
+      cache->size = (uint32_t)size;
+      cache->updated = (uint32_t)time(0);
+      if (rename(tmppath, path) != 0)
+      {
+         munmap(cache, size);
+         cache = 0;
+      }
+   }
+   if (cache == 0)
+      unlink(tmppath);
+   xfree(tmppath);
+   return cache;
+#else
+   (void)path;
+   (void)size;
+   return 0;
+#endif
+}
+
+/** Abandon and release a DA cache.
+ *
+ * Readers that still have the cache mapped see it as stale from now on.
+ *
+ * @param[in] cache - The cache returned by SLPDACacheCreate.
+ * @param[in] path - The name of the cache file, to be removed; or NULL
+ *    if the file has already been replaced.
+ */
+void SLPDACacheDestroy(SLPDACacheHeader * cache, const char * path)
+{
+#ifdef DACACHE_MMAP
+   SLPAtomicInc(&cache->sequence);
+   cache->updated = 0;
+   SLPAtomicInc(&cache->sequence);
+   munmap(cache, cache->size);
+   if (path)
+      unlink(path);
+#else
+   (void)cache;
+   (void)path;
+#endif
+}
+
+/** Format a DA cache entry.
+ *
+ * @param[out] p - The buffer to format into; at least
+ *    SLP_DACACHE_ENTRYLEN(@p msglen) bytes.
+ * @param[in] addr - The DA's address.
+ * @param[in] msg - The DA's DAAdvert message.
+ * @param[in] msglen - The length of @p msg in bytes.
+ *
+ * @return The length of the entry, or zero if @p addr is neither an
+ *    IPv4 nor an IPv6 address.
+ */
+size_t SLPDACachePutEntry(uint8_t * p, const struct sockaddr_storage * addr,
+      const uint8_t * msg, size_t msglen)
+{
+   SLPDACacheEntry entry;
+   size_t len = SLP_DACACHE_ENTRYLEN(msglen);
+
+   memset(&entry, 0, sizeof(entry));
+   entry.family = addr->ss_family;
+   if (addr->ss_family == AF_INET)
+   {
+      const struct sockaddr_in * v4 = (const struct sockaddr_in *)addr;
+      entry.port = v4->sin_port;
+      memcpy(entry.addr, &v4->sin_addr, sizeof(v4->sin_addr));
+   }
+   else if (addr->ss_family == AF_INET6)
+   {
+      const struct sockaddr_in6 * v6 = (const struct sockaddr_in6 *)addr;
+      entry.port = v6->sin6_port;
+      entry.scope = v6->sin6_scope_id;
+      memcpy(entry.addr, &v6->sin6_addr, sizeof(v6->sin6_addr));
+   }
+   else
+      return 0;
+   entry.length = (uint32_t)msglen;
+
+   memcpy(p, &entry, sizeof(entry));
+   memcpy(p + sizeof(entry), msg, msglen);
+   memset(p + sizeof(entry) + msglen, 0, len - sizeof(entry) - msglen);
+   return len;
+}
+
+/** Replace the entries of a DA cache.
+ *
+ * @param[in] cache - The cache returned by SLPDACacheCreate.
+ * @param[in] entries - The entries, formatted by SLPDACachePutEntry.
+ * @param[in] length - The length of @p entries in bytes; no more than
+ *    the size of the cache less its header.
+ * @param[in] count - The number of entries.
+ * @param[in] flags - SLP_DACACHE_xxx flags.
+ *
+ * @remarks Also marks the cache as refreshed, so it is called with the
+ *    current entries at least every SLP_DACACHE_STALE seconds.
+ */
+void SLPDACachePublish(SLPDACacheHeader * cache, const uint8_t * entries,
+      size_t length, uint32_t count, uint32_t flags)
+{
+   SLPAtomicInc(&cache->sequence);
+   memcpy(cache + 1, entries, length);
+   cache->length = (uint32_t)length;
+   cache->count = count;
+   cache->flags = flags;
+   cache->updated = (uint32_t)time(0);
+   SLPAtomicInc(&cache->sequence);
+}
+
+/** Map a DA cache for reading.
+ *
+ * @param[in] path - The name of the cache file.
+ *
+ * @return The cache, to be released with SLPDACacheUnmap, or NULL if
+ *    there is no such file, or it is not a DA cache this process can
+ *    read.
+ */
+SLPDACacheHeader * SLPDACacheMap(const char * path)
+{
+#ifdef DACACHE_MMAP
+   SLPDACacheHeader * cache = 0;
+   struct stat st;
+   int fd;
+
+   if ((fd = open(path, O_RDONLY)) < 0)
+      return 0;
+   if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(*cache))
+   {
+      cache = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (cache == MAP_FAILED)
+         cache = 0;
+      else if (memcmp(cache->magic, SLP_DACACHE_MAGIC, sizeof(cache->magic))
+            || cache->wordsize != sizeof(intptr_t)
+            || cache->size != (uint32_t)st.st_size)
+      {
+         munmap(cache, (size_t)st.st_size);
+         cache = 0;
+      }
+   }
+   close(fd);
+   return cache;
+#else
+   (void)path;
+   return 0;
+#endif
+}
+
+/** Release a DA cache mapped by SLPDACacheMap.
+ *
+ * @param[in] cache - The cache.
+ */
+void SLPDACacheUnmap(SLPDACacheHeader * cache)
+{
+#ifdef DACACHE_MMAP
+   munmap(cache, cache->size);
+#else
+   (void)cache;
+#endif
+}
+
+/** Copy the entries out of a DA cache.
+ *
+ * @param[in] cache - The cache returned by SLPDACacheMap.
+ * @param[out] entries - The entries, to be released with xfree; NULL
+ *    if there are none.
+ * @param[out] length - The length of @p entries in bytes.
+ * @param[out] count - The number of entries.
+ *
+ * @return Zero on success; or non-zero if the cache is stale or
+ *    incomplete, or slpd kept changing it, in which case the caller
+ *    should map it again or ask slpd instead.
+ */
+int SLPDACacheRead(const SLPDACacheHeader * cache, uint8_t ** entries,
+      size_t * length, uint32_t * count)
+{
+   const volatile SLPDACacheHeader * vcache = cache;
+   size_t room = cache->size - sizeof(*cache);
+   uint8_t * copy = 0;
+   size_t copysize = 0;
+   int tries;
+
+   for (tries = 0; tries < DACACHE_RETRIES; tries++)
+   {
+      intptr_t sequence = vcache->sequence;
+      uint32_t updated;
+      uint32_t flags;
+      size_t len;
+
+      if (sequence & 1)
+         continue;
+      DACacheBarrier();
+
+      updated = vcache->updated;
+      flags = vcache->flags;
+      *count = vcache->count;
+      len = vcache->length;
+      if (len > 0 && len <= room)
+      {
+         if (len > copysize)
+         {
+            xfree(copy);
+            if ((copy = xmalloc(len)) == 0)
+               return -1;
+            copysize = len;
+         }
+         memcpy(copy, cache + 1, len);
+      }
+
+      DACacheBarrier();
+      if (vcache->sequence != sequence)
+         continue;
+
+      if (len > room || updated == 0
+            || (uint32_t)time(0) - updated > SLP_DACACHE_STALE
+            || (flags & SLP_DACACHE_INCOMPLETE))
+         break;
+
+      if (len == 0)
+      {
+         xfree(copy);
+         copy = 0;
+      }
+      *entries = copy;
+      *length = len;
+      return 0;
+   }
+   xfree(copy);
+   return -1;
+}
+
+/** Parse a DA cache entry.
+ *
+ * @param[in] p - The entry to parse.
+ * @param[in] end - The end of the entries.
+ * @param[out] addr - The DA's address.
+ * @param[out] msg - The DA's DAAdvert message, followed by a zero byte.
+ * @param[out] msglen - The length of @p msg in bytes.
+ *
+ * @return The next entry, or NULL if @p p is at @p end or does not hold
+ *    a valid entry.
+ */
+const uint8_t * SLPDACacheGetEntry(const uint8_t * p, const uint8_t * end,
+      struct sockaddr_storage * addr, const uint8_t ** msg, size_t * msglen)
+{
+   SLPDACacheEntry entry;
+
+   if ((size_t)(end - p) < sizeof(entry))
+      return 0;
+   memcpy(&entry, p, sizeof(entry));
+   if (entry.length == 0 || entry.length >= (size_t)(end - p)
+         || SLP_DACACHE_ENTRYLEN(entry.length) > (size_t)(end - p))
+      return 0;
+
+   memset(addr, 0, sizeof(*addr));
+   if (entry.family == AF_INET)
+   {
+      struct sockaddr_in * v4 = (struct sockaddr_in *)addr;
+      addr->ss_family = AF_INET;
+#ifdef HAVE_SOCKADDR_STORAGE_SS_LEN
+      addr->ss_len = sizeof(struct sockaddr_in);
+#endif
+      v4->sin_port = entry.port;
+      memcpy(&v4->sin_addr, entry.addr, sizeof(v4->sin_addr));
+   }
+   else if (entry.family == AF_INET6)
+   {
+      struct sockaddr_in6 * v6 = (struct sockaddr_in6 *)addr;
+      addr->ss_family = AF_INET6;
+#ifdef HAVE_SOCKADDR_STORAGE_SS_LEN
+      addr->ss_len = sizeof(struct sockaddr_in6);
+#endif
+      v6->sin6_port = entry.port;
+      v6->sin6_scope_id = entry.scope;
+      memcpy(&v6->sin6_addr, entry.addr, sizeof(v6->sin6_addr));
+   }
+   else
+      return 0;
+
+   *msg = p + sizeof(entry);
+   *msglen = entry.length;
+   return p + SLP_DACACHE_ENTRYLEN(entry.length);
+}
+
+/* ---------------- Test main for the slp_dacache.c module -----------------
+ *
+ * Compile with:
+ *    gcc -g -Wall -I .. -O0 -D SLP_DACACHE_TEST -D DEBUG -D HAVE_CONFIG_H \
+ *       -o slp-dacache-test slp_dacache.c slp_atomic.c slp_linkedlist.c \
+ *       slp_xmalloc.c
+ */
+#ifdef SLP_DACACHE_TEST
+
+# define FAIL (printf("FAIL: %s at line %d.\n", __FILE__, __LINE__), (-1))
+# define PASS (printf("PASS: Success!\n"), (0))
+
+/* Stands in for a DAAdvert; its content does not matter to the cache. */
+static const uint8_t G_TestMsg[] = "service:directory-agent://10.0.0.1";
+
+/* Fill in an IPv4 or IPv6 address ending in n. */
+static void TestAddr(struct sockaddr_storage * addr, int family, int n)
+{
+   memset(addr, 0, sizeof(*addr));
+   addr->ss_family = family;
+   if (family == AF_INET)
+   {
+      struct sockaddr_in * v4 = (struct sockaddr_in *)addr;
+      v4->sin_port = htons(427);
+      v4->sin_addr.s_addr = htonl(0x0a000000 + n);
+   }
+   else
+   {
+      struct sockaddr_in6 * v6 = (struct sockaddr_in6 *)addr;
+      v6->sin6_port = htons(427);
+      v6->sin6_scope_id = 2;
+      v6->sin6_addr.s6_addr[0] = 0xfe;
+      v6->sin6_addr.s6_addr[1] = 0x80;
+      v6->sin6_addr.s6_addr[15] = (uint8_t)n;
+   }
+}
+
+/* Check that a parsed address is the one TestAddr made. */
+static int TestSameAddr(const struct sockaddr_storage * got, int family,
+      int n)
+{
+   struct sockaddr_storage want;
+
+   TestAddr(&want, family, n);
+   if (family == AF_INET)
+      return got->ss_family == AF_INET
+            && memcmp(&((const struct sockaddr_in *)got)->sin_addr,
+               &((struct sockaddr_in *)&want)->sin_addr, 4) == 0
+            && ((const struct sockaddr_in *)got)->sin_port == htons(427);
+   return got->ss_family == AF_INET6
+         && memcmp(&((const struct sockaddr_in6 *)got)->sin6_addr,
+            &((struct sockaddr_in6 *)&want)->sin6_addr, 16) == 0
+         && ((const struct sockaddr_in6 *)got)->sin6_port == htons(427)
+         && ((const struct sockaddr_in6 *)got)->sin6_scope_id == 2;
+}
+
+/* Format an entry for each message length from 1 to sizeof(G_TestMsg) - 1,
+ * alternating IPv4 and IPv6; returns the length of all of them.
+ */
+static size_t TestEntries(uint8_t * buf, uint32_t * count)
+{
+   struct sockaddr_storage addr;
+   size_t len = 0;
+   size_t msglen;
+
+   *count = 0;
+   for (msglen = 1; msglen < sizeof(G_TestMsg); msglen++)
+   {
+      TestAddr(&addr, msglen & 1? AF_INET: AF_INET6, (int)msglen);
+      len += SLPDACachePutEntry(buf + len, &addr, G_TestMsg, msglen);
+      (*count)++;
+   }
+   return len;
+}
+
+/* Make a cache in ordinary memory, as slpd's mapping would start out. */
+static SLPDACacheHeader * TestCache(void)
+{
+   SLPDACacheHeader * cache = xcalloc(1, SLP_DACACHE_SIZE);
+
+   if (cache)
+   {
+      memcpy(cache->magic, SLP_DACACHE_MAGIC, sizeof(cache->magic));
+      cache->wordsize = sizeof(intptr_t);
+      cache->size = SLP_DACACHE_SIZE;
+      cache->updated = (uint32_t)time(0);
+   }
+   return cache;
+}
+
+int main(void)
+{
+   static uint8_t buf[SLP_DACACHE_SIZE];
+   struct sockaddr_storage addr;
+   SLPDACacheHeader * cache;
+   const uint8_t * p;
+   const uint8_t * msg;
+   uint8_t * entries;
+   size_t msglen;
+   size_t length;
+   size_t len;
+   size_t cut;
+   uint32_t count;
+   uint32_t n;
+
+   /* Entries read back as they were written, and are padded to a
+    * multiple of four bytes with a zero after each message.
+    */
+   len = TestEntries(buf, &count);
+   for (p = buf, n = 1; p != buf + len; n++)
+   {
+      const uint8_t * next = SLPDACacheGetEntry(p, buf + len, &addr, &msg,
+            &msglen);
+
+      if (next == 0 || (size_t)(next - p) != SLP_DACACHE_ENTRYLEN(n)
+            || (next - buf) % 4 != 0)
+         return FAIL;
+      if (!TestSameAddr(&addr, n & 1? AF_INET: AF_INET6, (int)n)
+            || msglen != n || memcmp(msg, G_TestMsg, n) != 0
+            || msg[msglen] != 0)
+         return FAIL;
+      p = next;
+   }
+   if (n - 1 != count)
+      return FAIL;
+   if (SLPDACacheGetEntry(p, p, &addr, &msg, &msglen) != 0)
+      return FAIL;
+
+   /* Other address families are refused on the way in and the way out. */
+   memset(&addr, 0, sizeof(addr));
+   addr.ss_family = AF_UNIX;
+   if (SLPDACachePutEntry(buf, &addr, G_TestMsg, 4) != 0)
+      return FAIL;
+   ((SLPDACacheEntry *)buf)->family = AF_UNIX;
+   if (SLPDACacheGetEntry(buf, buf + len, &addr, &msg, &msglen) != 0)
+      return FAIL;
+
+   /* An entry cut short anywhere is refused. */
+   TestAddr(&addr, AF_INET6, 1);
+   len = SLPDACachePutEntry(buf, &addr, G_TestMsg, sizeof(G_TestMsg) - 1);
+   for (cut = 0; cut < len; cut++)
+      if (SLPDACacheGetEntry(buf, buf + cut, &addr, &msg, &msglen) != 0)
+         return FAIL;
+   if (SLPDACacheGetEntry(buf, buf + len, &addr, &msg, &msglen)
+         != buf + len)
+      return FAIL;
+
+   /* So is one whose message is empty, or longer than what follows. */
+   ((SLPDACacheEntry *)buf)->length = 0;
+   if (SLPDACacheGetEntry(buf, buf + len, &addr, &msg, &msglen) != 0)
+      return FAIL;
+   ((SLPDACacheEntry *)buf)->length = (uint32_t)(len - sizeof(SLPDACacheEntry));
+   if (SLPDACacheGetEntry(buf, buf + len, &addr, &msg, &msglen) != 0)
+      return FAIL;
+   ((SLPDACacheEntry *)buf)->length = 0xffffffff;
+   if (SLPDACacheGetEntry(buf, buf + len, &addr, &msg, &msglen) != 0)
+      return FAIL;
+
+   /* A fresh, complete cache reads back what was published. */
+   if ((cache = TestCache()) == 0)
+      return FAIL;
+   len = TestEntries(buf, &count);
+   SLPDACachePublish(cache, buf, len, count, 0);
+   if (cache->sequence & 1)
+      return FAIL;
+   if (SLPDACacheRead(cache, &entries, &length, &n) != 0)
+      return FAIL;
+   if (length != len || n != count || memcmp(entries, buf, len) != 0)
+      return FAIL;
+   xfree(entries);
+
+   /* An empty one reads back no entries. */
+   SLPDACachePublish(cache, buf, 0, 0, 0);
+   if (SLPDACacheRead(cache, &entries, &length, &n) != 0
+         || entries != 0 || length != 0 || n != 0)
+      return FAIL;
+
+   /* An incomplete one is refused, so the reader asks slpd. */
+   SLPDACachePublish(cache, buf, len, count, SLP_DACACHE_INCOMPLETE);
+   if (SLPDACacheRead(cache, &entries, &length, &n) == 0)
+      return FAIL;
+
+   /* As are a stale one, an abandoned one, one claiming more entries
+    * than fit, and one slpd never finishes updating.
+    */
+   SLPDACachePublish(cache, buf, len, count, 0);
+   cache->updated = (uint32_t)time(0) - SLP_DACACHE_STALE - 1;
+   if (SLPDACacheRead(cache, &entries, &length, &n) == 0)
+      return FAIL;
+   cache->updated = 0;
+   if (SLPDACacheRead(cache, &entries, &length, &n) == 0)
+      return FAIL;
+   cache->updated = (uint32_t)time(0);
+   cache->length = SLP_DACACHE_SIZE;
+   if (SLPDACacheRead(cache, &entries, &length, &n) == 0)
+      return FAIL;
+   cache->length = (uint32_t)len;
+   cache->sequence++;
+   if (SLPDACacheRead(cache, &entries, &length, &n) == 0)
+      return FAIL;
+   cache->sequence++;
+   if (SLPDACacheRead(cache, &entries, &length, &n) != 0)
+      return FAIL;
+   xfree(entries);
+   xfree(cache);
+
+#ifdef DACACHE_MMAP
+   {
+      SLPDACacheHeader * reader;
+      char path[64];
+
+      /* A published file maps and reads back, until slpd abandons it. */
+      sprintf(path, "slp-dacache-test.%d", (int)getpid());
+      if ((cache = SLPDACacheCreate(path, SLP_DACACHE_SIZE)) == 0)
+         return FAIL;
+      SLPDACachePublish(cache, buf, len, count, 0);
+      if ((reader = SLPDACacheMap(path)) == 0)
+         return FAIL;
+      if (SLPDACacheRead(reader, &entries, &length, &n) != 0
+            || length != len || memcmp(entries, buf, len) != 0)
+         return FAIL;
+      xfree(entries);
+      SLPDACacheDestroy(cache, path);
+      if (SLPDACacheRead(reader, &entries, &length, &n) == 0)
+         return FAIL;
+      SLPDACacheUnmap(reader);
+      if (SLPDACacheMap(path) != 0)
+         return FAIL;
+   }
+#endif
+
+   return PASS;
+}
+
+#endif /* SLP_DACACHE_TEST */
+
+/*=========================================================================*/
@@ -0,0 +1,126 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Header file for the shared DA cache.
+ *
+ * slpd publishes the DAs it knows in a file that local processes map
+ * read-only, so that libslp can learn them without asking slpd over IPC
+ * or discovering them itself. The file is only ever read and written
+ * by processes on the same host, so it is in native byte order.
+ *
+ * @file       slp_dacache.h
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    CommonCodeDACache
+ */
+
+#ifndef SLP_DACACHE_H_INCLUDED
+#define SLP_DACACHE_H_INCLUDED
+
+/*!@defgroup CommonCodeDACache Shared DA Cache
+ * @ingroup CommonCodeUtility
+ * @{
+ */
+
+#include "slp_types.h"
+#include "slp_socket.h"
+
+/** The magic string that starts a DA cache. */
+#define SLP_DACACHE_MAGIC     "SLPDAC01"
+
+/** The size slpd gives a DA cache; room for a few hundred DAAdverts. */
+#define SLP_DACACHE_SIZE      (64 * 1024)
+
+/** A cache slpd has not refreshed for this many seconds is ignored,
+ * as slpd is presumed to have stopped without removing it.
+ */
+#define SLP_DACACHE_STALE     60
+
+/** Cache flag: not every known DA fitted, so readers must ask slpd. */
+#define SLP_DACACHE_INCOMPLETE   0x01
+
+/** The header at the start of a DA cache.
+ *
+ * @e sequence is a sequence lock: slpd makes it odd before it changes
+ * anything after it, and even again when it is done. A reader copies
+ * what it needs and then checks that @e sequence was even and did not
+ * change meanwhile.
+ */
+typedef struct _SLPDACacheHeader
+{
+   char magic[8];          /*!< SLP_DACACHE_MAGIC. */
+   uint32_t wordsize;      /*!< The size of @e sequence in slpd. */
+   uint32_t size;          /*!< The size of the whole cache in bytes. */
+   intptr_t sequence;      /*!< Odd while slpd is updating the cache. */
+   uint32_t updated;       /*!< When slpd last refreshed the cache, in
+                            *   seconds since the epoch; 0 once slpd has
+                            *   abandoned it. */
+   uint32_t flags;         /*!< SLP_DACACHE_xxx flags. */
+   uint32_t count;         /*!< The number of entries. */
+   uint32_t length;        /*!< The length of the entries in bytes. */
+} SLPDACacheHeader;
+
+/** An entry of a DA cache: a known DA's address and DAAdvert.
+ *
+ * The message follows the entry header, and is followed by at least one
+ * zero byte and padded to a multiple of four bytes.
+ */
+typedef struct _SLPDACacheEntry
+{
+   uint16_t family;        /*!< AF_INET or AF_INET6. */
+   uint16_t port;          /*!< The DA's port, in network byte order. */
+   uint32_t scope;         /*!< The IPv6 scope ID, or zero. */
+   uint32_t length;        /*!< The length of the message in bytes. */
+   uint8_t addr[16];       /*!< The DA's IPv4 or IPv6 address. */
+} SLPDACacheEntry;
+
+/** The length of an entry holding a message of @p msglen bytes. */
+#define SLP_DACACHE_ENTRYLEN(msglen) \
+      ((sizeof(SLPDACacheEntry) + (msglen) + 4) & ~(size_t)3)
+
+SLPDACacheHeader * SLPDACacheCreate(const char * path, size_t size);
+void SLPDACacheDestroy(SLPDACacheHeader * cache, const char * path);
+size_t SLPDACachePutEntry(uint8_t * p, const struct sockaddr_storage * addr,
+      const uint8_t * msg, size_t msglen);
+void SLPDACachePublish(SLPDACacheHeader * cache, const uint8_t * entries,
+      size_t length, uint32_t count, uint32_t flags);
+SLPDACacheHeader * SLPDACacheMap(const char * path);
+void SLPDACacheUnmap(SLPDACacheHeader * cache);
+int SLPDACacheRead(const SLPDACacheHeader * cache, uint8_t ** entries,
+      size_t * length, uint32_t * count);
+const uint8_t * SLPDACacheGetEntry(const uint8_t * p, const uint8_t * end,
+      struct sockaddr_storage * addr, const uint8_t ** msg, size_t * msglen);
+
+/*! @} */
+
+#endif   /* SLP_DACACHE_H_INCLUDED */
+
+/*=========================================================================*/
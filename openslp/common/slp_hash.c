@@ -0,0 +1,309 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Hash tables.
+ *
+ * Open addressing with linear probing over a power-of-two slot array.
+ * The table doubles when it becomes three-quarters full. Since all
+ * memory is drawn from an arena, entries can not be removed; the table
+ * is meant for accumulate-then-discard working sets.
+ *
+ * @file       slp_hash.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    CommonCodeHash
+ */
+
+#include "slp_hash.h"
+
+/** The initial number of slots in a hash table. */
+#define SLP_HASH_INITSIZE  32
+
+/** Hash a byte string.
+ *
+ * Uses the 32-bit FNV-1a algorithm, which is fast on short keys and
+ * distributes well enough for open addressing with linear probing.
+ *
+ * @param[in] key - The bytes to hash.
+ * @param[in] keylen - The length of @p key in bytes.
+ *
+ * @return The hash value of @p key.
+ */
+uint32_t SLPHash(const void * key, size_t keylen)
+{
+   const uint8_t * p = key;
+   uint32_t hash = 2166136261U;
+   while (keylen--)
+   {
+      hash ^= *p++;
+      hash *= 16777619U;
+   }
+   return hash;
+}
+
+/** Initialize an empty hash table.
+ *
+ * @param[out] table - The table to initialize.
+ * @param[in] arena - The arena from which table memory is allocated.
+ */
+void SLPHashTableInit(SLPHashTable * table, SLPArena arena)
+{
+   memset(table, 0, sizeof(*table));
+   table->arena = arena;
+}
+
+/** Locate the slot for a key.
+ *
+ * @param[in] slots - The slot array to search.
+ * @param[in] size - The number of entries in @p slots (power of 2).
+ * @param[in] hash - The hash value of @p key.
+ * @param[in] key - The key to locate.
+ * @param[in] keylen - The length of @p key in bytes.
+ *
+ * @return The slot holding @p key, or the empty slot where it belongs.
+ *
+ * @internal
+ */
+static SLPHashEntry ** SLPHashTableProbe(SLPHashEntry ** slots,
+      size_t size, uint32_t hash, const void * key, size_t keylen)
+{
+   size_t mask = size - 1;
+   size_t i = hash & mask;
+   while (slots[i])
+   {
+      SLPHashEntry * entry = slots[i];
+      if (entry->hash == hash && entry->keylen == keylen
+            && memcmp(entry->key, key, keylen) == 0)
+         break;
+      i = (i + 1) & mask;
+   }
+   return &slots[i];
+}
+
+/** Double the number of slots in a hash table.
+ *
+ * @param[in,out] table - The table to grow.
+ *
+ * @return Zero on success, or non-zero on memory allocation failure.
+ *
+ * @internal
+ */
+static int SLPHashTableGrow(SLPHashTable * table)
+{
+   size_t size = table->size? table->size * 2: SLP_HASH_INITSIZE;
+   SLPHashEntry ** slots;
+   SLPHashEntry * entry;
+
+   slots = SLPArenaAlloc(table->arena, size * sizeof(*slots));
+   if (slots == 0)
+      return -1;
+   memset(slots, 0, size * sizeof(*slots));
+
+   for (entry = table->head; entry; entry = entry->next)
+      *SLPHashTableProbe(slots, size, entry->hash, entry->key,
+            entry->keylen) = entry;
+
+   table->slots = slots;
+   table->size = size;
+   return 0;
+}
+
+/** Find an entry in a hash table.
+ *
+ * @param[in] table - The table to search.
+ * @param[in] key - The key to locate.
+ * @param[in] keylen - The length of @p key in bytes.
+ *
+ * @return The entry for @p key, or NULL if @p key is not in @p table.
+ */
+SLPHashEntry * SLPHashTableFind(SLPHashTable * table, const void * key,
+      size_t keylen)
+{
+   if (table->count == 0)
+      return 0;
+   return *SLPHashTableProbe(table->slots, table->size,
+         SLPHash(key, keylen), key, keylen);
+}
+
+/** Find or insert an entry in a hash table.
+ *
+ * If @p key is not yet in @p table, a copy of it is added to the arena
+ * and a new entry with a NULL value is linked to the end of the table's
+ * insertion order.
+ *
+ * @param[in,out] table - The table to update.
+ * @param[in] key - The key to locate or insert.
+ * @param[in] keylen - The length of @p key in bytes.
+ * @param[out] inserted - Set true if a new entry was created; may be
+ *    NULL.
+ *
+ * @return The entry for @p key, or NULL on memory allocation failure.
+ */
+SLPHashEntry * SLPHashTableInsert(SLPHashTable * table, const void * key,
+      size_t keylen, bool * inserted)
+{
+   uint32_t hash = SLPHash(key, keylen);
+   SLPHashEntry ** slot;
+   SLPHashEntry * entry;
+
+   if (inserted)
+      *inserted = false;
+
+   if (table->size != 0)
+   {
+      slot = SLPHashTableProbe(table->slots, table->size, hash, key, keylen);
+      if (*slot)
+         return *slot;
+   }
+
+   /* Keep the load factor at or below 3/4; only a new entry needs room,
+    * and it belongs in a different slot once the table has grown.
+    */
+   if ((table->count + 1) * 4 > table->size * 3)
+   {
+      if (SLPHashTableGrow(table) != 0)
+         return 0;
+      slot = SLPHashTableProbe(table->slots, table->size, hash, key, keylen);
+   }
+
+   entry = SLPArenaAlloc(table->arena, sizeof(*entry));
+   if (entry == 0 || (entry->key = SLPArenaStrDup(table->arena,
+         key, keylen)) == 0)
+      return 0;
+   entry->next = 0;
+   entry->hash = hash;
+   entry->keylen = keylen;
+   entry->value = 0;
+
+   if (table->tail)
+      table->tail->next = entry;
+   else
+      table->head = entry;
+   table->tail = entry;
+   table->count++;
+   *slot = entry;
+
+   if (inserted)
+      *inserted = true;
+   return entry;
+}
+
+/* ----------------- Test main for the slp_hash.c module -----------------
+ *
+ * Compile with:
+ *    gcc -g -Wall -I .. -o0 -D SLP_HASH_TEST -D DEBUG -D HAVE_CONFIG_H \
+ *       -o slp-hash-test slp_hash.c slp_arena.c slp_linkedlist.c \
+ *       slp_xmalloc.c
+ */
+#ifdef SLP_HASH_TEST
+
+# define FAIL (printf("FAIL: %s at line %d.\n", __FILE__, __LINE__), (-1))
+# define PASS (printf("PASS: Success!\n"), (0))
+
+int main(void)
+{
+   char key[32];
+   bool inserted;
+   int i, n;
+   SLPHashEntry * entry;
+   SLPHashTable table;
+   SLPArena arena = SLPArenaCreate(128);
+   if (arena == 0)
+      return FAIL;
+
+   SLPHashTableInit(&table, arena);
+   if (SLPHashTableFind(&table, "x", 1) != 0)
+      return FAIL;
+
+   /* Insert enough keys to force several table expansions and a few
+    * oversized arena blocks. 
+    */
+   for (i = 0; i < 1000; i++)
+   {
+      n = sprintf(key, "service:test%d", i);
+      entry = SLPHashTableInsert(&table, key, n, &inserted);
+      if (entry == 0 || !inserted || strcmp(entry->key, key) != 0)
+         return FAIL;
+      entry->value = (void *)(intptr_t)i;
+   }
+   if (table.count != 1000)
+      return FAIL;
+
+   /* Duplicates must be found, not inserted. */
+   for (i = 0; i < 1000; i++)
+   {
+      n = sprintf(key, "service:test%d", i);
+      entry = SLPHashTableInsert(&table, key, n, &inserted);
+      if (entry == 0 || inserted || (intptr_t)entry->value != i)
+         return FAIL;
+      if (SLPHashTableFind(&table, key, n) != entry)
+         return FAIL;
+   }
+   if (table.count != 1000 || SLPHashTableFind(&table, "service:test", 12))
+      return FAIL;
+
+   /* Insertion order is preserved. */
+   for (i = 0, entry = table.head; entry; entry = entry->next, i++)
+      if ((intptr_t)entry->value != i)
+         return FAIL;
+   if (i != 1000)
+      return FAIL;
+
+   /* A reset arena can be reused for a new table. */
+   SLPArenaReset(arena);
+   SLPHashTableInit(&table, arena);
+   if (SLPHashTableInsert(&table, "a", 1, &inserted) == 0 || !inserted)
+      return FAIL;
+
+   /* Finding a key in a full table does not grow it; adding one does. */
+   for (i = 1; (size_t)(i + 1) * 4 <= table.size * 3; i++)
+   {
+      n = sprintf(key, "service:test%d", i);
+      if (SLPHashTableInsert(&table, key, n, &inserted) == 0 || !inserted)
+         return FAIL;
+   }
+   n = (int)table.size;
+   entry = SLPHashTableInsert(&table, "a", 1, &inserted);
+   if (entry != table.head || inserted || table.size != (size_t)n)
+      return FAIL;
+   entry = SLPHashTableInsert(&table, "b", 1, &inserted);
+   if (entry == 0 || !inserted || table.size != (size_t)n * 2
+         || SLPHashTableFind(&table, "b", 1) != entry
+         || SLPHashTableFind(&table, "a", 1) != table.head)
+      return FAIL;
+
+   SLPArenaFree(arena);
+   return PASS;
+}
+
+#endif
+
+/*=========================================================================*/
@@ -0,0 +1,91 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Header file for hash tables.
+ *
+ * A simple open-addressed hash table keyed by byte strings. All table
+ * memory (slots, entries and key copies) comes from an SLPArena, so a
+ * table is released by freeing its arena. Entries are also chained in
+ * insertion order so that callers can enumerate them deterministically.
+ *
+ * @file       slp_hash.h
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    CommonCodeHash
+ */
+
+#ifndef SLP_HASH_H_INCLUDED
+#define SLP_HASH_H_INCLUDED
+
+/*!@defgroup CommonCodeHash Hash Table
+ * @ingroup CommonCodeUtility
+ * @{
+ */
+
+#include "slp_types.h"
+#include "slp_arena.h"
+
+/** A hash table entry. */
+typedef struct _SLPHashEntry
+{
+   struct _SLPHashEntry * next;  /*!< The next entry in insertion order. */
+   uint32_t hash;                /*!< The hash value of @e key. */
+   size_t keylen;                /*!< The length of @e key in bytes. */
+   const char * key;             /*!< The (null-terminated) key copy. */
+   void * value;                 /*!< Caller data associated with @e key. */
+} SLPHashEntry;
+
+/** A hash table. */
+typedef struct _SLPHashTable
+{
+   SLPArena arena;               /*!< The arena backing this table. */
+   SLPHashEntry ** slots;        /*!< The open-addressed slot array. */
+   size_t size;                  /*!< The number of slots (power of 2). */
+   size_t count;                 /*!< The number of entries. */
+   SLPHashEntry * head;          /*!< The first entry inserted. */
+   SLPHashEntry * tail;          /*!< The last entry inserted. */
+} SLPHashTable;
+
+uint32_t SLPHash(const void * key, size_t keylen);
+
+void SLPHashTableInit(SLPHashTable * table, SLPArena arena);
+
+SLPHashEntry * SLPHashTableFind(SLPHashTable * table, const void * key,
+      size_t keylen);
+
+SLPHashEntry * SLPHashTableInsert(SLPHashTable * table, const void * key,
+      size_t keylen, bool * inserted);
+
+/*! @} */
+
+#endif   /* SLP_HASH_H_INCLUDED */
+
+/*=========================================================================*/
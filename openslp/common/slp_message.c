@@ -158,68 +158,41 @@ void slp_PutUINT32(uint8_t ** cpp, size_t val)
  */
 void SLPMessageFreeInternals(SLPMessage * mp)
 {
-   int i;
+   /* The v2 parser carves URL entry and authentication block arrays from
+    * blocks chained through their first word; the v1 parser allocates none.
+    */
+   while (mp->arrays)
+   {
+      void * next = *(void **)mp->arrays;
+      xfree(mp->arrays);
+      mp->arrays = next;
+   }
 
    switch (mp->header.functionid)
    {
       case SLP_FUNCT_SRVRPLY:
-         if (mp->body.srvrply.urlarray)
-         {
-            for (i = 0; i < mp->body.srvrply.urlcount; i++)
-               if (mp->body.srvrply.urlarray[i].autharray)
-               {
-                  xfree(mp->body.srvrply.urlarray[i].autharray);
-                  mp->body.srvrply.urlarray[i].autharray = 0;
-               }
-
-            xfree(mp->body.srvrply.urlarray);
-            mp->body.srvrply.urlarray = 0;
-         }
+         mp->body.srvrply.urlarray = 0;
          break;
 
       case SLP_FUNCT_SRVREG:
-         if (mp->body.srvreg.urlentry.autharray)
-         {
-            xfree(mp->body.srvreg.urlentry.autharray);
-            mp->body.srvreg.urlentry.autharray = 0;
-         }
-         if (mp->body.srvreg.autharray)
-         {
-            xfree(mp->body.srvreg.autharray);
-            mp->body.srvreg.autharray = 0;
-         }
+         mp->body.srvreg.urlentry.autharray = 0;
+         mp->body.srvreg.autharray = 0;
          break;
 
       case SLP_FUNCT_SRVDEREG:
-         if (mp->body.srvdereg.urlentry.autharray)
-         {
-            xfree(mp->body.srvdereg.urlentry.autharray);
-            mp->body.srvdereg.urlentry.autharray = 0;
-         }
+         mp->body.srvdereg.urlentry.autharray = 0;
          break;
 
       case SLP_FUNCT_ATTRRPLY:
-         if (mp->body.attrrply.autharray)
-         {
-            xfree(mp->body.attrrply.autharray);
-            mp->body.attrrply.autharray = 0;
-         }
+         mp->body.attrrply.autharray = 0;
          break;
 
       case SLP_FUNCT_DAADVERT:
-         if (mp->body.daadvert.autharray)
-         {
-            xfree(mp->body.daadvert.autharray);
-            mp->body.daadvert.autharray = 0;
-         }
+         mp->body.daadvert.autharray = 0;
          break;
 
       case SLP_FUNCT_SAADVERT:
-         if (mp->body.saadvert.autharray)
-         {
-            xfree(mp->body.saadvert.autharray);
-            mp->body.saadvert.autharray = 0;
-         }
+         mp->body.saadvert.autharray = 0;
          break;
 
       case SLP_FUNCT_ATTRRQST:
@@ -343,4 +316,49 @@ int SLPMessageParseBuffer(void * peeraddr,
    return SLP_ERROR_VER_NOT_SUPPORTED;
 }
 
+/** Parse the body of a message whose header is already parsed.
+ *
+ * Callers that parse the header first to decide what to do with a
+ * message use this to avoid parsing the header a second time.
+ *
+ * @param[in] peeraddr - Remote address binding to store in @p message.
+ * @param[in] localaddr - Local address binding to store in @p message.
+ * @param[in] buffer - The buffer to be parsed, with its current position
+ *    just past the message header.
+ * @param[in] header - The header parsed from @p buffer by
+ *    SLPMessageParseHeader.
+ * @param[in] mp - A pointer to a message into which @p buffer should
+ *    be parsed.
+ *
+ * @return Zero on success, SLP_ERROR_PARSE_ERROR, or
+ *    SLP_ERROR_INTERNAL_ERROR if out of memory.
+ *
+ * @remarks On success, pointers in the SLPMessage reference memory in
+ *    the parsed SLPBuffer. If SLPBufferFree is called then the pointers
+ *    in @p message will be invalidated.
+ */
+int SLPMessageParseBody(void * peeraddr,
+      const void * localaddr, SLPBuffer buffer,
+      const SLPHeader * header, SLPMessage * mp)
+{
+   /* Copy in the local and remote address info */
+   if (peeraddr != 0)
+      memcpy(&mp->peer, peeraddr, sizeof(mp->peer));
+   if (localaddr != 0)
+      memcpy(&mp->localaddr, localaddr, sizeof(mp->localaddr));
+
+   SLPMessageFreeInternals(mp);
+
+   switch (header->version)
+   {
+#if defined(ENABLE_SLPv1)
+      case 1:
+         buffer->curpos = buffer->start;
+         return SLPv1MessageParseBuffer(buffer, mp);
+#endif
+      case 2: return SLPv2MessageParseBody(buffer, header, mp);
+   }
+   return SLP_ERROR_VER_NOT_SUPPORTED;
+}
+
 /*=========================================================================*/
@@ -126,6 +126,7 @@
 #define SLP_REG_SOURCE_REMOTE    1  /* from a remote host    */
 #define SLP_REG_SOURCE_LOCAL     2  /* from localhost or IPC */
 #define SLP_REG_SOURCE_STATIC    3  /* from the slp.reg file */
+#define SLP_REG_SOURCE_PEER_DA   4  /* synced from a peer DA */
 
 /** SLP Extension IDs */
 
@@ -157,7 +158,7 @@
 
 #define AS_UINT32(p) (uint32_t)              \
       (                                      \
-         (((const uint8_t *)(p))[0] << 24) | \
+         ((uint32_t)((const uint8_t *)(p))[0] << 24) | \
          (((const uint8_t *)(p))[1] << 16) | \
          (((const uint8_t *)(p))[2] <<  8) | \
          (((const uint8_t *)(p))[3]      )   \
@@ -397,6 +398,7 @@ typedef struct _SLPMessage
       SLPSrvTypeRply srvtyperply;
       SLPSAAdvert    saadvert;
    } body; 
+   void * arrays;    /*!< URL entry and auth block arrays of the body */
 } SLPMessage;
 
 void SLPMessageFreeInternals(SLPMessage * mp);
@@ -408,6 +410,8 @@ void SLPMessageFree(SLPMessage * mp);
 int SLPMessageParseHeader(SLPBuffer buffer, SLPHeader * header);
 int SLPMessageParseBuffer(void * peeraddr, const void * localaddr, 
       SLPBuffer buffer, SLPMessage * mp);
+int SLPMessageParseBody(void * peeraddr, const void * localaddr, 
+      SLPBuffer buffer, const SLPHeader * header, SLPMessage * mp);
 
 /*! @} */
 
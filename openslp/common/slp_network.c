@@ -115,6 +115,81 @@ sockfd_t SLPNetworkConnectStream(void * peeraddr,
    return result;
 }
 
+/** Connect a sequenced-packet socket to a local AF_UNIX path.
+ *
+ * Each send on the returned socket is delivered as one record, so an SLP
+ * message is never split or coalesced with its neighbours in transit.
+ *
+ * The connection is made without blocking. Where the platform reports it
+ * as in progress, it is given up to @p timeout to complete; where the
+ * listener's backlog is full and the platform refuses it outright, it
+ * fails at once, so the caller can fall back to another transport.
+ *
+ * @param[in] path - The file system path of the listening socket.
+ * @param[in] timeout - The maximum time to spend connecting.
+ *
+ * @return A connected (blocking) socket, or SLP_INVALID_SOCKET if @p path
+ *    is empty, nothing is listening on it, it did not accept the
+ *    connection in time, or the platform has no such sockets.
+ */
+sockfd_t SLPNetworkConnectLocal(const char * path, struct timeval * timeout)
+{
+   sockfd_t result = SLP_INVALID_SOCKET;
+#ifdef SLP_HAVE_LOCAL_SOCKET
+   struct sockaddr_un addr;
+   int fdflags;
+
+   if (!path || !*path || strlen(path) >= sizeof(addr.sun_path))
+      return SLP_INVALID_SOCKET;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, path);
+
+   result = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+   if (result == SLP_INVALID_SOCKET)
+      return SLP_INVALID_SOCKET;
+
+   fdflags = fcntl(result, F_GETFL, 0);
+   if (fdflags == -1 || fcntl(result, F_SETFL, fdflags | O_NONBLOCK) == -1)
+   {
+      closesocket(result);
+      return SLP_INVALID_SOCKET;
+   }
+
+   if (connect(result, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+   {
+      int err = errno;
+
+      if (err == EINPROGRESS)
+      {
+         fd_set writefds;
+         socklen_t errlen = sizeof(err);
+         struct timeval wait = *timeout;
+
+         FD_ZERO(&writefds);
+         FD_SET(result, &writefds);
+         if (select((int)result + 1, 0, &writefds, 0, &wait) <= 0
+               || getsockopt(result, SOL_SOCKET, SO_ERROR, &err,
+                  &errlen) != 0)
+            err = ETIMEDOUT;
+      }
+      if (err != 0)
+      {
+         closesocket(result);
+         return SLP_INVALID_SOCKET;
+      }
+   }
+
+   /* The callers expect blocking sockets, as from the other transports. */
+   fcntl(result, F_SETFL, fdflags);
+#else
+   (void)path;
+   (void)timeout;
+#endif
+   return result;
+}
+
 /** Creates a datagram socket
  *
  * @param[in] family -- the family (IPv4, IPv6 to create the socket in)
@@ -161,12 +161,21 @@ static int SetDefaultValues(void)
       {"net.slp.OpenSLPVersion", SLP_VERSION, 0},
       {"net.slp.unicastMaximumWait", "5000", 0},
       {"net.slp.unicastTimeouts", "500,750,1000,1500,2000,3000", 0},
+      {"net.slp.DAHedgeMinimumWait", "0", 0},
       {"net.slp.DADiscoveryMaximumWait", "5000", 0},
       {"net.slp.activeDADetection", "true", 0},
       {"net.slp.checkSourceAddr", "true", 0},
       {"net.slp.broadcastAddr", "255.255.255.255", 0},
       {"net.slp.port", "427", 0},
       {"net.slp.useDHCP", "true", 0},
+      {"net.slp.streamQueueLength", "32", 0},
+      {"net.slp.connectionPoolSize", "8", 0},
+      {"net.slp.connectionPoolIdleTimeout", "60", 0},
+      {"net.slp.localSocketPath", "/var/run/slpd.sock", 0},
+      {"net.slp.lazyAttributes", "false", 0},
+      {"net.slp.DASyncInterval", "0", 0},
+      {"net.slp.snapshotFile", "", 0},
+      {"net.slp.DACacheFile", "", 0},
 
    /* Additional properties that are specific to IPv6 */
       {"net.slp.useIPv6", "false", 0},
@@ -0,0 +1,611 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Registration files.
+ *
+ * Reads the text registration file format, and writes and describes the
+ * compiled format, so that slpd and slptool agree on both.
+ *
+ * @file       slp_regfile.c
+ * @author     Matthew Peterson, John Calcote (jcalcote@novell.com)
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    CommonCodeRegFile
+ */
+
+#include "slp_regfile.h"
+#include "slp_message.h"
+#include "slp_hash.h"
+#include "slp_xmalloc.h"
+
+/** Trim leading and trailing whitespace from a string.
+ *
+ * @param[in,out] str - The address of the string to be trimmed.
+ *
+ * @return A pointer to the first non-whitespace character in @p str.
+ *
+ * @internal
+ */
+static char * TrimWhitespace(char * str)
+{
+   char * end;
+
+   end = str+strlen(str)-1;
+   while (*str && *str <= 0x20)
+      str++;
+
+   while (end >= str)
+   {
+      if (*end > 0x20)
+         break;
+      *end = 0;
+      end--;
+   }
+   return str;
+}
+
+/** Read a line from a file into a buffer.
+ *
+ * @param[in] fd - The file to read from.
+ * @param[out] line - The address of storage for the read line.
+ * @param[in] linesize - The size of the buffer pointed to by @p line.
+ *
+ * @return A pointer to @p line for convenience.
+ *
+ * @internal
+ */
+static char * RegFileReadLine(FILE * fd, char * line, int linesize)
+{
+   while (1)
+   {
+      if (fgets(line,linesize,fd) == 0)
+         return 0;
+
+      while(*line && *line <= 0x20 && *line != 0x0d && *line != 0x0a)
+         line++;
+
+      if (*line == 0x0d || *line == 0x0a)
+         break;
+
+      if (*line != 0 && *line != '#' && *line != ';')
+         break;
+   }
+   return line;
+}
+
+/** Read a registration from a text registration file.
+ *
+ * A really big and nasty function that reads service registrations from
+ * from a file. Don't look at this too hard or you'll be sick. This is by
+ * far the most horrible code in OpenSLP. Please volunteer to rewrite it!
+ *
+ * @param[in] fd - The file to read from.
+ * @param[out] entry - The registration read; release it with
+ *    SLPRegFileFreeEntry whatever the result.
+ * @param[out] line - Storage for the lines read; holds the offending
+ *    line on error.
+ * @param[in] linesize - The size of the buffer pointed to by @p line.
+ *
+ * @return Zero on success. A value greater than zero (an SLP_ERROR_xxx
+ *    code) on error. A value less than zero on EOF.
+ */
+int SLPRegFileReadEntry(FILE * fd, SLPRegFileEntry * entry,
+      char * line, size_t linesize)
+{
+   char * slider1;
+   char * slider2;
+   char * srvtype;
+
+   memset(entry, 0, sizeof(*entry));
+
+   /* read the next non-white non-comment line from the stream */
+   do
+   {
+      slider1 = RegFileReadLine(fd, line, (int)linesize);
+      if (slider1 == 0)
+         return -1;
+
+   } while (*slider1 == 0x0d ||  *slider1 == 0x0a);
+
+   /* Parse the url-props */
+   slider2 = strchr(slider1, ',');
+   if (slider2 == 0)
+      return SLP_ERROR_INVALID_REGISTRATION;
+
+   /* srvurl */
+   *slider2 = 0; /* squash comma to null terminate srvurl */
+   entry->url = xstrdup(TrimWhitespace(slider1));
+   if (entry->url == 0)
+      return SLP_ERROR_INTERNAL_ERROR;
+   entry->urllen = strlen(entry->url);
+
+   /* derive srvtype from srvurl */
+   srvtype = strstr(slider1, "://");
+   if (srvtype == 0)
+      return SLP_ERROR_INVALID_REGISTRATION;
+   *srvtype = 0;
+   entry->srvtype = xstrdup(TrimWhitespace(slider1));
+   if (entry->srvtype == 0)
+      return SLP_ERROR_INTERNAL_ERROR;
+   entry->srvtypelen = strlen(entry->srvtype);
+   slider1 = slider2 + 1;
+
+   /*lang*/
+   slider2 = strchr(slider1, ',');
+   if (slider2 == 0)
+      return SLP_ERROR_INVALID_REGISTRATION;
+   *slider2 = 0; /* squash comma to null terminate lang */
+   entry->langtag = xstrdup(TrimWhitespace(slider1));
+   if (entry->langtag == 0)
+      return SLP_ERROR_INVALID_REGISTRATION;
+   entry->langtaglen = strlen(entry->langtag);
+   slider1 = slider2 + 1;
+
+   /* ltime */
+   slider2 = strchr(slider1,',');
+   if (slider2)
+      *slider2 = 0; /* squash comma to null terminate ltime */
+   entry->lifetime = atoi(slider1);
+   if (entry->lifetime < 1 || entry->lifetime > SLP_LIFETIME_MAXIMUM)
+      return SLP_ERROR_INVALID_REGISTRATION;
+
+   /* read all the attributes including the scopelist */
+   *line=0;
+   while (1)
+   {
+      slider1 = RegFileReadLine(fd, line, (int)linesize);
+      if (slider1 == 0 || *slider1 == 0x0d || *slider1 == 0x0a)
+         break;
+
+      /* Check to see if it is the scopes line */
+      /* FIXME We can collapse the scope stuff into the value getting and
+         just make it a special case (do strcmp on the tag as opposed to the
+         line) of attribute getting. */
+      if (strncasecmp(slider1,"scopes", 6) == 0)
+      {
+         /* found scopes line */
+         slider2 = strchr(slider1,'=');
+         if (slider2)
+         {
+            slider2++;
+            if (*slider2)
+            {
+               /* just in case some idiot puts multiple scopes lines */
+               if (entry->scopelist)
+                  return SLP_ERROR_SCOPE_NOT_SUPPORTED;
+
+               /* make sure there are no spaces in the scope list
+      NOTE: There's nothing in the spec that indicates that
+      scopes can't contain spaces. Commenting out for now. --jmc
+               if (strchr(slider2, ' '))
+                  return SLP_ERROR_SCOPE_NOT_SUPPORTED; */
+
+               entry->scopelist = xstrdup(TrimWhitespace(slider2));
+               if (entry->scopelist == 0)
+                  return SLP_ERROR_INTERNAL_ERROR;
+               entry->scopelistlen = strlen(entry->scopelist);
+            }
+         }
+      }
+      else
+      {
+         /* line contains an attribute (slow but it works)*/
+         /* TODO Fix this so we do not have to realloc memory each time! */
+         char * attrlist;
+
+         TrimWhitespace(slider1);
+
+         if (entry->attrlist == 0)
+         {
+            entry->attrlistlen += strlen(slider1) + 2;
+            attrlist = xmalloc(entry->attrlistlen + 1);
+            if (attrlist == 0)
+               return SLP_ERROR_INTERNAL_ERROR;
+            *attrlist = 0;
+         }
+         else
+         {
+            entry->attrlistlen += strlen(slider1) + 3;
+            attrlist = xrealloc(entry->attrlist, entry->attrlistlen + 1);
+            if (attrlist == 0)
+               return SLP_ERROR_INTERNAL_ERROR;
+            strcat(attrlist, ",");
+         }
+         entry->attrlist = attrlist;
+
+         /* we need special case for keywords (why do we need these)
+            they seem like a waste of code.  Why not just use booleans */
+         if (strchr(slider1, '='))
+         {
+            /* normal attribute (with '=') */
+            strcat(attrlist, "(");
+            strcat(attrlist, slider1);
+            strcat(attrlist, ")");
+         }
+         else
+         {
+            /* keyword (no '=') */
+            entry->attrlistlen -= 2; /* subtract 2 bytes for no '(' or ')' */
+            strcat(attrlist, slider1);
+         }
+      }
+   }
+   return 0;
+}
+
+/** Release the memory held by a registration file entry.
+ *
+ * @param[in] entry - The entry to be released.
+ */
+void SLPRegFileFreeEntry(SLPRegFileEntry * entry)
+{
+   xfree(entry->url);
+   xfree(entry->srvtype);
+   xfree(entry->langtag);
+   xfree(entry->scopelist);
+   xfree(entry->attrlist);
+   memset(entry, 0, sizeof(*entry));
+}
+
+/** Get the size of the SrvReg message for a registration.
+ *
+ * @param[in] entry - The registration.
+ * @param[in] urlauthlen - The length of the URL authentication block,
+ *    or zero for none.
+ * @param[in] attrauthlen - The length of the attribute authentication
+ *    block, or zero for none.
+ *
+ * @return The size of the message in bytes.
+ */
+size_t SLPRegFileSrvRegSize(const SLPRegFileEntry * entry,
+      size_t urlauthlen, size_t attrauthlen)
+{
+   size_t size;
+
+   size = 14 + entry->langtaglen;      /* 14 bytes for header    */
+   size += entry->urllen + 6;          /*  1 byte for reserved   */
+                                       /*  2 bytes for lifetime  */
+                                       /*  2 bytes for urllen    */
+                                       /*  1 byte for authcount  */
+   size += entry->srvtypelen + 2;      /*  2 bytes for len field */
+   size += entry->scopelistlen + 2;    /*  2 bytes for len field */
+   size += entry->attrlistlen + 2;     /*  2 bytes for len field */
+   size += 1;                          /*  1 byte for authcount  */
+   return size + urlauthlen + attrauthlen;
+}
+
+/** Build the SrvReg message for a registration.
+ *
+ * @param[out] p - Storage for the message, of the size returned by
+ *    SLPRegFileSrvRegSize.
+ * @param[in] entry - The registration.
+ * @param[in] urlauth - The URL authentication block, or NULL for none.
+ * @param[in] urlauthlen - The length of @p urlauth.
+ * @param[in] attrauth - The attribute authentication block, or NULL
+ *    for none.
+ * @param[in] attrauthlen - The length of @p attrauth.
+ */
+void SLPRegFilePutSrvReg(uint8_t * p, const SLPRegFileEntry * entry,
+      const uint8_t * urlauth, size_t urlauthlen,
+      const uint8_t * attrauth, size_t attrauthlen)
+{
+   size_t size = SLPRegFileSrvRegSize(entry, urlauthlen, attrauthlen);
+
+   /* version */
+   *p++ = 2;
+
+   /* function id */
+   *p++ = SLP_FUNCT_SRVREG;
+
+   /* length */
+   PutUINT24(&p, size);
+
+   /* flags */
+   PutUINT16(&p, 0);
+
+   /* ext offset */
+   PutUINT24(&p, 0);
+
+   /* xid */
+   PutUINT16(&p, 0);
+
+   /* lang tag len */
+   PutUINT16(&p, entry->langtaglen);
+
+   /* lang tag */
+   memcpy(p, entry->langtag, entry->langtaglen);
+   p += entry->langtaglen;
+
+   /* url-entry reserved */
+   *p++ = 0;
+
+   /* url-entry lifetime */
+   PutUINT16(&p, entry->lifetime);
+
+   /* url-entry urllen */
+   PutUINT16(&p, entry->urllen);
+
+   /* url-entry url */
+   memcpy(p, entry->url, entry->urllen);
+   p += entry->urllen;
+
+   /* url-entry authblock */
+   *p++ = urlauth? 1: 0;
+   if (urlauth)
+   {
+      memcpy(p, urlauth, urlauthlen);
+      p += urlauthlen;
+   }
+
+   /* service type */
+   PutUINT16(&p, entry->srvtypelen);
+   memcpy(p, entry->srvtype, entry->srvtypelen);
+   p += entry->srvtypelen;
+
+   /* scope list */
+   PutUINT16(&p, entry->scopelistlen);
+   memcpy(p, entry->scopelist, entry->scopelistlen);
+   p += entry->scopelistlen;
+
+   /* attr list */
+   PutUINT16(&p, entry->attrlistlen);
+   memcpy(p, entry->attrlist, entry->attrlistlen);
+   p += entry->attrlistlen;
+
+   /* attribute auth block */
+   *p++ = attrauth? 1: 0;
+   if (attrauth)
+      memcpy(p, attrauth, attrauthlen);
+}
+
+/** Write the header of a compiled registration file.
+ *
+ * @param[in] fd - The file to write to, positioned at its start.
+ * @param[in] count - The number of entries in the file.
+ * @param[in] hash - The hash accumulated over the entries by
+ *    SLPRegFileWriteEntry.
+ *
+ * @return Zero on success, or non-zero on error.
+ */
+int SLPRegFileWriteHeader(FILE * fd, uint32_t count, uint32_t hash)
+{
+   uint8_t hdr[SLP_REGFILE_HDRLEN];
+
+   memcpy(hdr, SLP_REGFILE_MAGIC, 8);
+   TO_UINT32(hdr + 8, count);
+   TO_UINT32(hdr + 12, hash);
+   return fwrite(hdr, 1, sizeof(hdr), fd) != sizeof(hdr);
+}
+
+/** Write an entry of a compiled registration file.
+ *
+ * The message is followed by at least one zero byte, and padded to a
+ * multiple of four bytes, so that it can be parsed where it lies.
+ *
+ * @param[in] fd - The file to write to.
+ * @param[in] entry - The registration to write.
+ * @param[in,out] hash - The hash over the entries written so far;
+ *    start with zero.
+ *
+ * @return Zero on success, or non-zero on error.
+ */
+int SLPRegFileWriteEntry(FILE * fd, const SLPRegFileEntry * entry,
+      uint32_t * hash)
+{
+   size_t msglen = SLPRegFileSrvRegSize(entry, 0, 0);
+   size_t len = (SLP_REGFILE_ENTRYHDRLEN + msglen + 4) & ~(size_t)3;
+   uint8_t * rec;
+   int result;
+
+   if ((rec = xmalloc(len)) == 0)
+      return -1;
+   memset(rec, 0, len);
+   TO_UINT32(rec, len);
+   rec[4] = entry->scopelist? 0: SLP_REGFILE_DEFAULT_SCOPES;
+   SLPRegFilePutSrvReg(rec + SLP_REGFILE_ENTRYHDRLEN, entry, 0, 0, 0, 0);
+
+   *hash = *hash * 16777619 ^ SLPHash(rec, len);
+   result = fwrite(rec, 1, len, fd) != len;
+   xfree(rec);
+   return result;
+}
+
+/* ---------------- Test main for the slp_regfile.c module -----------------
+ *
+ * Compile with:
+ *    gcc -g -Wall -I .. -O0 -D SLP_REGFILE_TEST -D DEBUG -D HAVE_CONFIG_H \
+ *       -o slp-regfile-test slp_regfile.c slp_v2message.c slp_message.c \
+ *       slp_buffer.c slp_compare.c slp_hash.c slp_arena.c slp_linkedlist.c \
+ *       slp_xmalloc.c
+ */
+#ifdef SLP_REGFILE_TEST
+
+# include "slp_buffer.h"
+# include "slp_v2message.h"
+
+# define FAIL (printf("FAIL: %s at line %d.\n", __FILE__, __LINE__), (-1))
+# define PASS (printf("PASS: Success!\n"), (0))
+
+/* A registration file with a bad entry between good ones. */
+static const char G_TestRegFile[] =
+      "# comment\n"
+      "service:test.x://host1:1,en,65535\n"
+      "scopes=A,B\n"
+      "color=red\n"
+      "keyword\n"
+      "\n"
+      "service:test.y://host2,en,100\n"
+      "size=3\n"
+      "\n"
+      "bad line without a comma\n"
+      "\n"
+      "service:test.z://host3,de,10\n";
+
+/* What the good entries should compile to. */
+static const struct
+{
+   const char * url;
+   const char * srvtype;
+   const char * langtag;
+   int lifetime;
+   const char * scopelist;
+   const char * attrlist;
+} G_TestEntries[] =
+{
+   {"service:test.x://host1:1", "service:test.x", "en", 65535, "A,B",
+         "(color=red),keyword"},
+   {"service:test.y://host2", "service:test.y", "en", 100, 0, "(size=3)"},
+   {"service:test.z://host3", "service:test.z", "de", 10, 0, 0},
+};
+
+/* Check that a string field of a parsed message is the expected one. */
+static int TestSame(const char * got, size_t gotlen, const char * want)
+{
+   if (want == 0)
+      return gotlen == 0;
+   return gotlen == strlen(want) && memcmp(got, want, gotlen) == 0;
+}
+
+int main(int argc, char * argv[])
+{
+   SLPRegFileEntry entry;
+   SLPBuffer buffer;
+   SLPMessage * msg;
+   char line[4096];
+   uint8_t * data;
+   uint8_t * rec;
+   uint32_t count = 0;
+   uint32_t hash = 0;
+   size_t reclen;
+   size_t msglen;
+   size_t pos;
+   long len;
+   unsigned i;
+   int bad = 0;
+   int result;
+   FILE * in;
+   FILE * out;
+
+   (void)argc;
+   (void)argv;
+
+   /* Compile the text file as slptool does, skipping the bad entry. */
+   if ((in = tmpfile()) == 0 || (out = tmpfile()) == 0)
+      return FAIL;
+   if (fputs(G_TestRegFile, in) == EOF || fseek(in, 0, SEEK_SET) != 0)
+      return FAIL;
+   if (SLPRegFileWriteHeader(out, 0, 0) != 0)
+      return FAIL;
+   while ((result = SLPRegFileReadEntry(in, &entry, line, sizeof(line))) >= 0)
+   {
+      if (result == 0)
+      {
+         if (SLPRegFileWriteEntry(out, &entry, &hash) != 0)
+            return FAIL;
+         count++;
+      }
+      else if (result == SLP_ERROR_INVALID_REGISTRATION)
+         bad++;
+      else
+         return FAIL;
+      SLPRegFileFreeEntry(&entry);
+   }
+   SLPRegFileFreeEntry(&entry);
+   fclose(in);
+   if (bad != 1 || count != sizeof(G_TestEntries) / sizeof(*G_TestEntries))
+      return FAIL;
+   if (fseek(out, 0, SEEK_SET) != 0
+         || SLPRegFileWriteHeader(out, count, hash) != 0)
+      return FAIL;
+
+   /* Load the image back. */
+   if (fseek(out, 0, SEEK_END) != 0 || (len = ftell(out)) < SLP_REGFILE_HDRLEN
+         || fseek(out, 0, SEEK_SET) != 0)
+      return FAIL;
+   if ((data = xmalloc((size_t)len)) == 0
+         || fread(data, 1, (size_t)len, out) != (size_t)len)
+      return FAIL;
+   fclose(out);
+   if (memcmp(data, SLP_REGFILE_MAGIC, 8) != 0 || AS_UINT32(data + 8) != count)
+      return FAIL;
+
+   /* Walk the entries, rebuilding the hash and parsing each message. */
+   hash = 0;
+   pos = SLP_REGFILE_HDRLEN;
+   for (i = 0; i < count; i++)
+   {
+      if ((size_t)len - pos < SLP_REGFILE_ENTRYHDRLEN + 14)
+         return FAIL;
+      rec = data + pos;
+      reclen = AS_UINT32(rec);
+      msglen = AS_UINT24(rec + SLP_REGFILE_ENTRYHDRLEN + 2);
+      if (reclen > (size_t)len - pos || (reclen & 3) != 0
+            || SLP_REGFILE_ENTRYHDRLEN + msglen >= reclen
+            || rec[SLP_REGFILE_ENTRYHDRLEN + msglen] != 0)
+         return FAIL;
+      if (!(rec[4] & SLP_REGFILE_DEFAULT_SCOPES)
+            != (G_TestEntries[i].scopelist != 0))
+         return FAIL;
+      hash = hash * 16777619 ^ SLPHash(rec, reclen);
+      pos += reclen;
+
+      if ((buffer = SLPBufferAlloc(msglen)) == 0
+            || (msg = SLPMessageAlloc()) == 0)
+         return FAIL;
+      memcpy(buffer->start, rec + SLP_REGFILE_ENTRYHDRLEN, msglen);
+      if (SLPv2MessageParseBuffer(buffer, msg) != 0
+            || msg->header.functionid != SLP_FUNCT_SRVREG)
+         return FAIL;
+      if (!TestSame(msg->header.langtag, msg->header.langtaglen,
+               G_TestEntries[i].langtag)
+            || !TestSame(msg->body.srvreg.urlentry.url,
+               msg->body.srvreg.urlentry.urllen, G_TestEntries[i].url)
+            || msg->body.srvreg.urlentry.lifetime != G_TestEntries[i].lifetime
+            || !TestSame(msg->body.srvreg.srvtype,
+               msg->body.srvreg.srvtypelen, G_TestEntries[i].srvtype)
+            || !TestSame(msg->body.srvreg.scopelist,
+               msg->body.srvreg.scopelistlen, G_TestEntries[i].scopelist)
+            || !TestSame(msg->body.srvreg.attrlist,
+               msg->body.srvreg.attrlistlen, G_TestEntries[i].attrlist))
+         return FAIL;
+      SLPMessageFree(msg);
+      SLPBufferFree(buffer);
+   }
+   if (pos != (size_t)len || hash != AS_UINT32(data + 12))
+      return FAIL;
+   xfree(data);
+
+   return PASS;
+}
+
+#endif /* SLP_REGFILE_TEST */
+
+/*=========================================================================*/
@@ -0,0 +1,106 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Header file for registration files.
+ *
+ * Static registrations are kept in a text file (slp.reg) that can be
+ * compiled into a binary image. The image holds each registration as a
+ * ready-made SrvReg message, so slpd can map the file and use the
+ * messages in place instead of parsing and rebuilding each entry.
+ *
+ * @file       slp_regfile.h
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    CommonCodeRegFile
+ */
+
+#ifndef SLP_REGFILE_H_INCLUDED
+#define SLP_REGFILE_H_INCLUDED
+
+/*!@defgroup CommonCodeRegFile Registration Files
+ * @ingroup CommonCodeUtility
+ * @{
+ */
+
+#include "slp_types.h"
+
+/** The magic string that starts a compiled registration file. */
+#define SLP_REGFILE_MAGIC        "SLPREGC1"
+
+/** The length of a compiled registration file header: the magic, the
+ * number of entries and a hash over all entries.
+ */
+#define SLP_REGFILE_HDRLEN       16
+
+/** The length of an entry header: the entry length, including this
+ * header and the padding after the message, and the entry flags.
+ */
+#define SLP_REGFILE_ENTRYHDRLEN  8
+
+/** Entry flag: the entry named no scopes, so it belongs to the scopes
+ * the registering agent is configured with, and its message carries an
+ * empty scope list.
+ */
+#define SLP_REGFILE_DEFAULT_SCOPES  0x01
+
+/** A registration read from a text registration file. */
+typedef struct _SLPRegFileEntry
+{
+   char * url;             /*!< The service URL. */
+   size_t urllen;          /*!< The length of @e url. */
+   char * srvtype;         /*!< The service type. */
+   size_t srvtypelen;      /*!< The length of @e srvtype. */
+   char * langtag;         /*!< The language tag. */
+   size_t langtaglen;      /*!< The length of @e langtag. */
+   int lifetime;           /*!< The registration lifetime. */
+   char * scopelist;       /*!< The scope list, or NULL if none given. */
+   size_t scopelistlen;    /*!< The length of @e scopelist. */
+   char * attrlist;        /*!< The attribute list, or NULL if empty. */
+   size_t attrlistlen;     /*!< The length of @e attrlist. */
+} SLPRegFileEntry;
+
+int SLPRegFileReadEntry(FILE * fd, SLPRegFileEntry * entry,
+      char * line, size_t linesize);
+void SLPRegFileFreeEntry(SLPRegFileEntry * entry);
+size_t SLPRegFileSrvRegSize(const SLPRegFileEntry * entry,
+      size_t urlauthlen, size_t attrauthlen);
+void SLPRegFilePutSrvReg(uint8_t * p, const SLPRegFileEntry * entry,
+      const uint8_t * urlauth, size_t urlauthlen,
+      const uint8_t * attrauth, size_t attrauthlen);
+int SLPRegFileWriteHeader(FILE * fd, uint32_t count, uint32_t hash);
+int SLPRegFileWriteEntry(FILE * fd, const SLPRegFileEntry * entry,
+      uint32_t * hash);
+
+/*! @} */
+
+#endif   /* SLP_REGFILE_H_INCLUDED */
+
+/*=========================================================================*/
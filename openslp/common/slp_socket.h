@@ -106,6 +106,17 @@ const char * inet_ntop(int af, const void * src, char * dst, size_t size);
 #if defined(LINUX) || defined (DARWIN)
 # include <ifaddrs.h>
 #endif
+#if HAVE_SYS_UN_H
+# include <sys/un.h>
+#endif
+
+/** Defined where libslp can reach slpd over an AF_UNIX SOCK_SEQPACKET
+ * socket. Platforms that define the constants but refuse the socket type
+ * at runtime simply fall back to loopback TCP.
+ */
+#if HAVE_SYS_UN_H && defined(AF_UNIX) && defined(SOCK_SEQPACKET)
+# define SLP_HAVE_LOCAL_SOCKET 1
+#endif
 
 /** Portability definitions
  * @todo Move to slp_types.h
@@ -192,4 +192,84 @@ void SLPMutexDestroy(SLPMutexHandle mh)
    free(mh);
 }
 
+/** Create a new condition variable.
+ *
+ * @return The new condition variable's handle, or zero on failure.
+ */
+SLPCondHandle SLPCondCreate(void)
+{
+#ifdef _WIN32
+   CONDITION_VARIABLE * cond = (CONDITION_VARIABLE *)xmalloc(sizeof(*cond));
+   if (cond != 0)
+      InitializeConditionVariable(cond);
+#else
+   pthread_cond_t * cond = (pthread_cond_t *)xmalloc(sizeof(*cond));
+   if (cond != 0 && pthread_cond_init(cond, 0) != 0)
+   {
+      xfree(cond);
+      cond = 0;
+   }
+#endif
+   return (SLPCondHandle)cond;
+}
+
+/** Wait for a condition variable to be signaled.
+ *
+ * Atomically releases @p mh and waits for @p ch to be signaled, then
+ * reacquires @p mh before returning. As with any condition variable, 
+ * the caller must re-check its predicate on return, since wake-ups may
+ * be spurious.
+ *
+ * @param[in] ch - The condition variable to wait on.
+ * @param[in] mh - The mutex protecting the caller's predicate; it must 
+ *    be held exactly once by the calling thread.
+ */
+void SLPCondWait(SLPCondHandle ch, SLPMutexHandle mh)
+{
+#ifdef _WIN32
+   SleepConditionVariableCS((CONDITION_VARIABLE *)ch, 
+         (CRITICAL_SECTION *)mh, INFINITE);
+#else
+   (void)pthread_cond_wait((pthread_cond_t *)ch, (pthread_mutex_t *)mh);
+#endif
+}
+
+/** Wake one thread waiting on a condition variable.
+ *
+ * @param[in] ch - The condition variable to be signaled.
+ */
+void SLPCondSignal(SLPCondHandle ch)
+{
+#ifdef _WIN32
+   WakeConditionVariable((CONDITION_VARIABLE *)ch);
+#else
+   (void)pthread_cond_signal((pthread_cond_t *)ch);
+#endif
+}
+
+/** Wake all threads waiting on a condition variable.
+ *
+ * @param[in] ch - The condition variable to be signaled.
+ */
+void SLPCondBroadcast(SLPCondHandle ch)
+{
+#ifdef _WIN32
+   WakeAllConditionVariable((CONDITION_VARIABLE *)ch);
+#else
+   (void)pthread_cond_broadcast((pthread_cond_t *)ch);
+#endif
+}
+
+/** Destroy a condition variable.
+ * 
+ * @param[in] ch - The condition variable to be destroyed.
+ */
+void SLPCondDestroy(SLPCondHandle ch)
+{
+#ifndef _WIN32
+   (void)pthread_cond_destroy((pthread_cond_t *)ch);
+#endif
+   xfree(ch);
+}
+
 /*=========================================================================*/
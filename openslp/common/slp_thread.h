@@ -80,6 +80,24 @@ void SLPMutexRelease(SLPMutexHandle mh);
 void SLPMutexDestroy(SLPMutexHandle mh);
 /*@}*/
 
+/** @name Condition Primitives. 
+ * 
+ * Condition variables are always used together with an SLP mutex, which
+ * must be held (exactly once) by the caller of SLPCondWait. They're based
+ * on pthreads for POSIX platforms and Win32 CONDITION_VARIABLES on 
+ * Windows platforms.
+ */
+/*@{*/
+/** A cross-platform condition variable handle abstraction. */
+typedef void * SLPCondHandle;
+
+SLPCondHandle SLPCondCreate(void);
+void SLPCondWait(SLPCondHandle ch, SLPMutexHandle mh);
+void SLPCondSignal(SLPCondHandle ch);
+void SLPCondBroadcast(SLPCondHandle ch);
+void SLPCondDestroy(SLPCondHandle ch);
+/*@}*/
+
 /*! @} */
 
 #endif   /* SLP_THREAD_H_INCLUDED */
@@ -39,20 +39,274 @@
  */
 
 #include "slp_message.h"
+#include "slp_v2message.h"
 #include "slp_xmalloc.h"
 
-/** Parse an authentication block.
+/* SLPv2 message bodies are parsed in a single pass by walking a
+ * per-function layout table (RFC 2608, section 8). Every length and count
+ * is checked against the end of the buffer before anything it describes
+ * is touched. Most messages need no memory beyond the SLPMessage itself;
+ * URL entry and authentication block arrays are carved from a block held
+ * in SLPMessage::arrays, which usually takes one allocation per message.
+ */
+
+/** The kinds of field that make up an SLPv2 message body.
  *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] authblock - The authentication block object into which 
- *    @p buffer should be parsed.
+ * @internal
+ */
+enum
+{
+   V2F_END,          /*!< End of the layout */
+   V2F_ERRORCODE,    /*!< 16-bit error code (int) - non-zero ends the body */
+   V2F_UINT32,       /*!< 32-bit value (uint32_t) */
+   V2F_STRING,       /*!< 16-bit length (size_t) and string (const char *) */
+   V2F_NAMINGAUTH,   /*!< As V2F_STRING, but 0xffff ("all") has no string */
+   V2F_URLENTRY,     /*!< A single URL entry (SLPUrlEntry) */
+   V2F_URLENTRIES,   /*!< 16-bit count (int) and URL entries (SLPUrlEntry *) */
+   V2F_AUTHBLOCKS    /*!< 8-bit count (int) and auth blocks (SLPAuthBlock *) */
+};
+
+/** One field of an SLPv2 message body layout.
+ *
+ * @internal
+ */
+typedef struct V2Field
+{
+   uint8_t kind;        /*!< One of the V2F_ constants */
+   uint16_t off;        /*!< Body offset of the value, length or count */
+   uint16_t ptroff;     /*!< Body offset of the string or array pointer */
+} V2Field;
+
+/** The layout of an SLPv2 message body.
+ *
+ * @internal
+ */
+typedef struct V2Layout
+{
+   size_t size;         /*!< The size of the body structure */
+   size_t minlen;       /*!< The smallest valid body, in bytes */
+   V2Field fields[8];   /*!< The fields in wire order, ending in V2F_END */
+} V2Layout;
+
+#define V2_FIELD(kind, type, member, ptrmember) \
+      {kind, (uint16_t)offsetof(type, member), (uint16_t)offsetof(type, ptrmember)}
+#define V2_VALUE(kind, type, member) V2_FIELD(kind, type, member, member)
+#define V2_END {V2F_END, 0, 0}
+
+/** SLPv2 message body layouts, indexed by function id.
+ *
+ * @internal
+ */
+static const V2Layout v2Layouts[SLP_FUNCT_SAADVERT + 1] =
+{
+   {0, 0, {V2_END}},
+   {  /* SLP_FUNCT_SRVRQST */
+      sizeof(SLPSrvRqst), 10,
+      {
+         V2_FIELD(V2F_STRING, SLPSrvRqst, prlistlen, prlist),
+         V2_FIELD(V2F_STRING, SLPSrvRqst, srvtypelen, srvtype),
+         V2_FIELD(V2F_STRING, SLPSrvRqst, scopelistlen, scopelist),
+         V2_FIELD(V2F_STRING, SLPSrvRqst, predicatelen, predicate),
+         V2_FIELD(V2F_STRING, SLPSrvRqst, spistrlen, spistr),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_SRVRPLY */
+      sizeof(SLPSrvRply), 4,
+      {
+         V2_VALUE(V2F_ERRORCODE, SLPSrvRply, errorcode),
+         V2_FIELD(V2F_URLENTRIES, SLPSrvRply, urlcount, urlarray),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_SRVREG */
+      sizeof(SLPSrvReg), 0,
+      {
+         V2_VALUE(V2F_URLENTRY, SLPSrvReg, urlentry),
+         V2_FIELD(V2F_STRING, SLPSrvReg, srvtypelen, srvtype),
+         V2_FIELD(V2F_STRING, SLPSrvReg, scopelistlen, scopelist),
+         V2_FIELD(V2F_STRING, SLPSrvReg, attrlistlen, attrlist),
+         V2_FIELD(V2F_AUTHBLOCKS, SLPSrvReg, authcount, autharray),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_SRVDEREG */
+      sizeof(SLPSrvDeReg), 4,
+      {
+         V2_FIELD(V2F_STRING, SLPSrvDeReg, scopelistlen, scopelist),
+         V2_VALUE(V2F_URLENTRY, SLPSrvDeReg, urlentry),
+         V2_FIELD(V2F_STRING, SLPSrvDeReg, taglistlen, taglist),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_SRVACK */
+      sizeof(SLPSrvAck), 2,
+      {
+         V2_VALUE(V2F_ERRORCODE, SLPSrvAck, errorcode),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_ATTRRQST */
+      sizeof(SLPAttrRqst), 10,
+      {
+         V2_FIELD(V2F_STRING, SLPAttrRqst, prlistlen, prlist),
+         V2_FIELD(V2F_STRING, SLPAttrRqst, urllen, url),
+         V2_FIELD(V2F_STRING, SLPAttrRqst, scopelistlen, scopelist),
+         V2_FIELD(V2F_STRING, SLPAttrRqst, taglistlen, taglist),
+         V2_FIELD(V2F_STRING, SLPAttrRqst, spistrlen, spistr),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_ATTRRPLY */
+      sizeof(SLPAttrRply), 5,
+      {
+         V2_VALUE(V2F_ERRORCODE, SLPAttrRply, errorcode),
+         V2_FIELD(V2F_STRING, SLPAttrRply, attrlistlen, attrlist),
+         V2_FIELD(V2F_AUTHBLOCKS, SLPAttrRply, authcount, autharray),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_DAADVERT */
+      sizeof(SLPDAAdvert), 15,
+      {
+         V2_VALUE(V2F_ERRORCODE, SLPDAAdvert, errorcode),
+         V2_VALUE(V2F_UINT32, SLPDAAdvert, bootstamp),
+         V2_FIELD(V2F_STRING, SLPDAAdvert, urllen, url),
+         V2_FIELD(V2F_STRING, SLPDAAdvert, scopelistlen, scopelist),
+         V2_FIELD(V2F_STRING, SLPDAAdvert, attrlistlen, attrlist),
+         V2_FIELD(V2F_STRING, SLPDAAdvert, spilistlen, spilist),
+         V2_FIELD(V2F_AUTHBLOCKS, SLPDAAdvert, authcount, autharray),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_SRVTYPERQST */
+      sizeof(SLPSrvTypeRqst), 6,
+      {
+         V2_FIELD(V2F_STRING, SLPSrvTypeRqst, prlistlen, prlist),
+         V2_FIELD(V2F_NAMINGAUTH, SLPSrvTypeRqst, namingauthlen, namingauth),
+         V2_FIELD(V2F_STRING, SLPSrvTypeRqst, scopelistlen, scopelist),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_SRVTYPERPLY */
+      sizeof(SLPSrvTypeRply), 4,
+      {
+         V2_VALUE(V2F_ERRORCODE, SLPSrvTypeRply, errorcode),
+         V2_FIELD(V2F_STRING, SLPSrvTypeRply, srvtypelistlen, srvtypelist),
+         V2_END
+      }
+   },
+   {  /* SLP_FUNCT_SAADVERT */
+      sizeof(SLPSAAdvert), 7,
+      {
+         V2_FIELD(V2F_STRING, SLPSAAdvert, urllen, url),
+         V2_FIELD(V2F_STRING, SLPSAAdvert, scopelistlen, scopelist),
+         V2_FIELD(V2F_STRING, SLPSAAdvert, attrlistlen, attrlist),
+         V2_FIELD(V2F_AUTHBLOCKS, SLPSAAdvert, authcount, autharray),
+         V2_END
+      }
+   },
+};
+
+/** Round array sizes up so that each array in a block is aligned. */
+#define V2_ALIGN(n) (((n) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+/** The most authentication blocks to leave room for after an array. */
+#define V2_AUTH_SLACK   2
+
+/** The state of a walk over an SLPv2 message body.
+ *
+ * @internal
+ */
+typedef struct V2Cursor
+{
+   uint8_t * curpos;    /*!< The next byte to parse */
+   uint8_t * end;       /*!< One past the last byte of the message */
+   SLPMessage * msg;    /*!< The message being parsed */
+   const V2Layout * layout;   /*!< The layout of its body */
+   uint8_t * free;      /*!< The unclaimed part of the newest array block */
+   size_t freelen;      /*!< The size of the unclaimed part */
+} V2Cursor;
+
+/** Claim space for an array from the message's array blocks.
+ *
+ * Array blocks are chained through their first word, newest first, from
+ * SLPMessage::arrays. A new block leaves room for a few authentication
+ * blocks after the array it is allocated for - as many as could still be
+ * in the message - so that signed messages usually need just the one.
+ *
+ * @param[in,out] c - The cursor of the current walk, positioned just
+ *    after the count of array elements.
+ * @param[in] size - The size of the array in bytes.
+ *
+ * @return The array, or 0 if out of memory.
+ *
+ * @internal
+ */
+static void * v2ClaimArray(V2Cursor * c, size_t size)
+{
+   void * array;
+
+   size = V2_ALIGN(size);
+   if (c->freelen < size)
+   {
+      size_t slack = (c->end - c->curpos) / 10;
+      uint8_t * block;
+
+      if (slack > V2_AUTH_SLACK)
+         slack = V2_AUTH_SLACK;
+      slack *= V2_ALIGN(sizeof(SLPAuthBlock));
+      block = xmalloc(V2_ALIGN(sizeof(void *)) + size + slack);
+      if (block == 0)
+         return 0;
+      *(void **)block = c->msg->arrays;
+      c->msg->arrays = block;
+      c->free = block + V2_ALIGN(sizeof(void *));
+      c->freelen = size + slack;
+   }
+   array = c->free;
+   c->free += size;
+   c->freelen -= size;
+   return array;
+}
+
+/** Parse a 16-bit length and the string it describes.
+ *
+ * @param[in,out] c - The cursor of the current walk.
+ * @param[out] lenp - The address in which to store the string length.
+ * @param[out] strp - The address in which to store the string pointer.
  *
- * @return Zero on success, SLP_ERROR_INTERNAL_ERROR (out of memory)
- *    or SLP_ERROR_PARSE_ERROR.
+ * @return Zero on success, or SLP_ERROR_PARSE_ERROR.
  *
  * @internal
  */
-static int v2ParseAuthBlock(SLPBuffer buffer, SLPAuthBlock * authblock)
+static int v2ParseString(V2Cursor * c, size_t * lenp, const char ** strp)
+{
+   if (c->end - c->curpos < 2)
+      return SLP_ERROR_PARSE_ERROR;
+   *lenp = AS_UINT16(c->curpos);
+   c->curpos += 2;
+   if ((size_t)(c->end - c->curpos) < *lenp)
+      return SLP_ERROR_PARSE_ERROR;
+   *strp = (const char *)c->curpos;
+   c->curpos += *lenp;
+   return 0;
+}
+
+/** Parse an 8-bit count and the authentication blocks that follow it.
+ *
+ * @param[in,out] c - The cursor of the current walk.
+ * @param[out] countp - The address in which to store the block count.
+ * @param[out] arrayp - The address in which to store the block array, or
+ *    0 when there are no blocks.
+ *
+ * @return Zero on success, SLP_ERROR_PARSE_ERROR, or
+ *    SLP_ERROR_INTERNAL_ERROR if out of memory.
+ *
+ * @internal
+ */
+static int v2ParseAuthBlocks(V2Cursor * c, int * countp,
+      SLPAuthBlock ** arrayp)
 {
 /*  0                   1                   2                   3
     0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -66,44 +320,74 @@ static int v2ParseAuthBlock(SLPBuffer buffer, SLPAuthBlock * authblock)
    |              Structured Authentication Block ...              \
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
 
-   /* Enforce v2 authentication block size limits. */
-   if (buffer->end - buffer->curpos < 10)
+   SLPAuthBlock * array;
+   int count;
+   int i;
+
+   if (c->curpos == c->end)
       return SLP_ERROR_PARSE_ERROR;
+   count = *c->curpos++;
+   array = 0;
+   if (count)
+   {
+      /* Each block takes at least 10 bytes. */
+      if ((size_t)(c->end - c->curpos) < count * 10u)
+         return SLP_ERROR_PARSE_ERROR;
+      array = v2ClaimArray(c, count * sizeof(SLPAuthBlock));
+      if (array == 0)
+         return SLP_ERROR_INTERNAL_ERROR;
+   }
 
-   /* Save pointer to opaque authentication block. */
-   authblock->opaque = buffer->curpos;
+   for (i = 0; i < count; i++)
+   {
+      SLPAuthBlock * authblock = &array[i];
 
-   /* Parse individual authentication block fields. */
-   authblock->bsd = GetUINT16(&buffer->curpos);
-   authblock->length = GetUINT16(&buffer->curpos);
-   authblock->timestamp = GetUINT32(&buffer->curpos);
-   authblock->spistrlen = GetUINT16(&buffer->curpos);
-   authblock->spistr = GetStrPtr(&buffer->curpos, authblock->spistrlen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+      /* Enforce v2 authentication block size limits. */
+      if (c->end - c->curpos < 10)
+         return SLP_ERROR_PARSE_ERROR;
 
-   /* Parse structured authentication block. */
-   authblock->authstruct = (char *)buffer->curpos;
-   authblock->opaquelen = authblock->length;
-   buffer->curpos = authblock->opaque + authblock->length;
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+      authblock->opaque = c->curpos;
+      authblock->bsd = AS_UINT16(c->curpos);
+      c->curpos += 2;
+      authblock->length = AS_UINT16(c->curpos);
+      c->curpos += 2;
+      authblock->timestamp = AS_UINT32(c->curpos);
+      c->curpos += 4;
+      authblock->spistrlen = AS_UINT16(c->curpos);
+      c->curpos += 2;
+      if ((size_t)(c->end - c->curpos) < authblock->spistrlen)
+         return SLP_ERROR_PARSE_ERROR;
+      authblock->spistr = (const char *)c->curpos;
+      c->curpos += authblock->spistrlen;
+      authblock->authstruct = (char *)c->curpos;
+      authblock->opaquelen = authblock->length;
+
+      /* The block length covers the fields above and must stay inside
+       * the message.
+       */
+      if (authblock->length < (size_t)(c->curpos - authblock->opaque)
+            || authblock->length > (size_t)(c->end - authblock->opaque))
+         return SLP_ERROR_PARSE_ERROR;
+      c->curpos = authblock->opaque + authblock->length;
+   }
 
+   *countp = count;
+   *arrayp = array;
    return 0;
 }
 
 /** Parse a URL entry.
  *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] urlentry - The URL entry object into which 
- *    @p buffer should be parsed.
+ * @param[in,out] c - The cursor of the current walk.
+ * @param[out] urlentry - The URL entry object into which the entry
+ *    should be parsed.
  *
- * @return Zero on success, SLP_ERROR_INTERNAL_ERROR (out of memory)
- *    or SLP_ERROR_PARSE_ERROR.
+ * @return Zero on success, SLP_ERROR_PARSE_ERROR, or
+ *    SLP_ERROR_INTERNAL_ERROR if out of memory.
  *
  * @internal
  */
-static int v2ParseUrlEntry(SLPBuffer buffer, SLPUrlEntry * urlentry)
+static int v2ParseUrlEntry(V2Cursor * c, SLPUrlEntry * urlentry)
 {
 /*  0                   1                   2                   3
     0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -115,398 +399,711 @@ static int v2ParseUrlEntry(SLPBuffer buffer, SLPUrlEntry * urlentry)
    |# of URL auths |            Auth. blocks (if any)              \
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
 
+   int result;
+
    /* Enforce SLPv2 URL entry size limits. */
-   if (buffer->end - buffer->curpos < 6)
+   if (c->end - c->curpos < 6)
       return SLP_ERROR_PARSE_ERROR;
 
-   /* Save pointer to opaque URL entry block. */
-   urlentry->opaque = buffer->curpos;
+   urlentry->opaque = c->curpos;
+   urlentry->reserved = *c->curpos++;
+   urlentry->lifetime = AS_UINT16(c->curpos);
+   c->curpos += 2;
+   result = v2ParseString(c, &urlentry->urllen, &urlentry->url);
+   if (result == 0)
+      result = v2ParseAuthBlocks(c, &urlentry->authcount,
+            &urlentry->autharray);
+   urlentry->opaquelen = c->curpos - urlentry->opaque;
+   return result;
+}
 
-   /* Parse individual URL entry fields. */
-   urlentry->reserved = *buffer->curpos++;
-   urlentry->lifetime = GetUINT16(&buffer->curpos);
-   urlentry->urllen = GetUINT16(&buffer->curpos);
-   urlentry->url = GetStrPtr(&buffer->curpos, urlentry->urllen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+/** Walk an SLPv2 message body layout, storing fields into the body.
+ *
+ * @param[in,out] c - The cursor of the walk, which names the message
+ *    whose body is filled in and its layout.
+ *
+ * @return Zero on success, SLP_ERROR_PARSE_ERROR, or
+ *    SLP_ERROR_INTERNAL_ERROR if out of memory.
+ *
+ * @internal
+ */
+static int v2ParseFields(V2Cursor * c)
+{
+   SLPMessage * msg = c->msg;
+   uint8_t * body = (uint8_t *)&msg->body;
+   const V2Field * field = c->layout->fields;
+   int result = 0;
 
-   /* Parse authentication block. */
-   urlentry->authcount = *buffer->curpos++;
-   if (urlentry->authcount)
+   for (; result == 0 && field->kind != V2F_END; field++)
    {
-      int i;
-      urlentry->autharray = xmalloc(urlentry->authcount 
-            * sizeof(SLPAuthBlock));
-      if (urlentry->autharray == 0)
-         return SLP_ERROR_INTERNAL_ERROR;
-      memset(urlentry->autharray, 0, urlentry->authcount 
-            * sizeof(SLPAuthBlock));
-      for (i = 0; i < urlentry->authcount; i++)
+      void * value = body + field->off;
+      void * ptr = body + field->ptroff;
+
+      switch (field->kind)
       {
-         int result = v2ParseAuthBlock(buffer, &urlentry->autharray[i]);
-         if (result != 0)
-            return result;
+         case V2F_ERRORCODE:
+         {
+            int errorcode;
+
+            if (c->end - c->curpos < 2)
+               return SLP_ERROR_PARSE_ERROR;
+            errorcode = AS_UINT16(c->curpos);
+            c->curpos += 2;
+            *(int *)value = errorcode;
+            if (errorcode)
+            {
+               /* Don't trust the rest of the packet. */
+               memset(&msg->body, 0, c->layout->size);
+               *(int *)value = errorcode;
+               return 0;
+            }
+            break;
+         }
+
+         case V2F_UINT32:
+            if (c->end - c->curpos < 4)
+               return SLP_ERROR_PARSE_ERROR;
+            *(uint32_t *)value = AS_UINT32(c->curpos);
+            c->curpos += 4;
+            break;
+
+         case V2F_STRING:
+            result = v2ParseString(c, value, ptr);
+            break;
+
+         case V2F_NAMINGAUTH:
+         {
+            size_t len;
+
+            if (c->end - c->curpos < 2)
+               return SLP_ERROR_PARSE_ERROR;
+            len = AS_UINT16(c->curpos);
+            c->curpos += 2;
+            *(size_t *)value = len;
+            *(const char **)ptr = 0;
+            if (len == 0xffff)
+               break;   /* all naming authorities */
+            if ((size_t)(c->end - c->curpos) < len)
+               return SLP_ERROR_PARSE_ERROR;
+            if (len)
+               *(const char **)ptr = (const char *)c->curpos;
+            c->curpos += len;
+            break;
+         }
+
+         case V2F_URLENTRY:
+            result = v2ParseUrlEntry(c, value);
+            break;
+
+         case V2F_URLENTRIES:
+         {
+            SLPUrlEntry * array = 0;
+            int count;
+            int i;
+
+            if (c->end - c->curpos < 2)
+               return SLP_ERROR_PARSE_ERROR;
+            count = AS_UINT16(c->curpos);
+            c->curpos += 2;
+            if (count)
+            {
+               /* Each entry takes at least 6 bytes. */
+               if ((size_t)(c->end - c->curpos) < count * 6u)
+                  return SLP_ERROR_PARSE_ERROR;
+               array = v2ClaimArray(c, count * sizeof(SLPUrlEntry));
+               if (array == 0)
+                  return SLP_ERROR_INTERNAL_ERROR;
+            }
+            *(int *)value = count;
+            *(SLPUrlEntry **)ptr = array;
+            for (i = 0; result == 0 && i < count; i++)
+               result = v2ParseUrlEntry(c, &array[i]);
+            break;
+         }
+
+         case V2F_AUTHBLOCKS:
+            result = v2ParseAuthBlocks(c, value, ptr);
+            break;
       }
    }
-   urlentry->opaquelen = buffer->curpos - urlentry->opaque;
-
-   /* Terminate the URL string for caller convenience - we're overwriting 
-    * the first byte of the "# of URL auths" field, but it's okay because
-    * we've already read and stored it away.
-    */
-   if(urlentry->url)
-      ((uint8_t *)urlentry->url)[urlentry->urllen] = 0;
+   return result;
+}
 
-   return 0;
+/** Terminate a parsed string for caller convenience.
+ *
+ * This overwrites the first byte of the following field, which has
+ * already been parsed. Message buffers are always allocated one byte
+ * larger than requested, so a string at the very end is safe too.
+ *
+ * @internal
+ */
+static void v2Terminate(const char * str, size_t len)
+{
+   if (str)
+      ((uint8_t *)str)[len] = 0;
 }
 
-/** Parse a service request.
+/** Finish a parsed SLPv2 message body.
  *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] srvrqst - The service request object into which 
- *    @p buffer should be parsed.
+ * Sets the fields that do not come from the wire, and terminates the
+ * strings callers expect to be terminated. This runs after the whole
+ * message, extensions included, has been parsed, so nothing still to be
+ * read is overwritten.
  *
- * @return Zero on success, or a non-zero error code.
+ * @param[in,out] msg - The parsed message.
  *
  * @internal
  */
-static int v2ParseSrvRqst(SLPBuffer buffer, SLPSrvRqst * srvrqst)
+static void v2FinishBody(SLPMessage * msg)
 {
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |      length of <PRList>       |        <PRList> String        \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |   length of <service-type>    |    <service-type> String      \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |    length of <scope-list>     |     <scope-list> String       \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |  length of predicate string   |  Service Request <predicate>  \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |  length of <SLP SPI> string   |       <SLP SPI> String        \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
-
-   /* Enforce v2 service request size limits. */
-   if (buffer->end - buffer->curpos < 10)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Parse the <PRList> string. */
-   srvrqst->prlistlen = GetUINT16(&buffer->curpos);
-   srvrqst->prlist = GetStrPtr(&buffer->curpos, srvrqst->prlistlen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Parse the <service-type> string. */
-   srvrqst->srvtypelen = GetUINT16(&buffer->curpos);
-   srvrqst->srvtype = GetStrPtr(&buffer->curpos, srvrqst->srvtypelen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Parse the <scope-list> string. */
-   srvrqst->scopelistlen = GetUINT16(&buffer->curpos);
-   srvrqst->scopelist = GetStrPtr(&buffer->curpos, srvrqst->scopelistlen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Parse the <predicate> string. */
-   srvrqst->predicatever = 2;  /* SLPv2 predicate (LDAPv3) */
-   srvrqst->predicatelen = GetUINT16(&buffer->curpos);
-   srvrqst->predicate = GetStrPtr(&buffer->curpos, srvrqst->predicatelen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+   SLPUrlEntry * urlentries = 0;
+   int urlcount = 0;
+   int i;
 
-   /* Parse the <SLP SPI> string. */
-   srvrqst->spistrlen = GetUINT16(&buffer->curpos);
-   srvrqst->spistr = GetStrPtr(&buffer->curpos, srvrqst->spistrlen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+   switch (msg->header.functionid)
+   {
+      case SLP_FUNCT_SRVRQST:
+         msg->body.srvrqst.predicatever = 2;  /* SLPv2 predicate (LDAPv3) */
+         break;
+
+      case SLP_FUNCT_SRVRPLY:
+         urlentries = msg->body.srvrply.urlarray;
+         urlcount = msg->body.srvrply.urlcount;
+         break;
+
+      case SLP_FUNCT_SRVREG:
+         urlentries = &msg->body.srvreg.urlentry;
+         urlcount = 1;
+         break;
+
+      case SLP_FUNCT_SRVDEREG:
+         urlentries = &msg->body.srvdereg.urlentry;
+         urlcount = 1;
+         break;
+
+      case SLP_FUNCT_ATTRRPLY:
+         v2Terminate(msg->body.attrrply.attrlist,
+               msg->body.attrrply.attrlistlen);
+         break;
+
+      case SLP_FUNCT_DAADVERT:
+         v2Terminate(msg->body.daadvert.url, msg->body.daadvert.urllen);
+         break;
+
+      case SLP_FUNCT_SRVTYPERPLY:
+         v2Terminate(msg->body.srvtyperply.srvtypelist,
+               msg->body.srvtyperply.srvtypelistlen);
+         break;
+
+      case SLP_FUNCT_SAADVERT:
+         v2Terminate(msg->body.saadvert.url, msg->body.saadvert.urllen);
+         break;
+   }
 
-   return 0;
+   if (urlentries)
+      for (i = 0; i < urlcount; i++)
+         v2Terminate(urlentries[i].url, urlentries[i].urllen);
 }
 
-/** Parse a service reply.
+/** Parse a service extension.
  *
  * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] srvrply - The service reply object into which 
+ * @param[out] msg - The service extension object into which 
  *    @p buffer should be parsed.
  *
  * @return Zero on success, or a non-zero error code.
  *
+ * @note Parse extensions @b after all standard protocol fields are parsed.
+ *
  * @internal
  */
-static int v2ParseSrvRply(SLPBuffer buffer, SLPSrvRply * srvrply)
+static int v2ParseExtension(SLPBuffer buffer, SLPMessage * msg)
 {
 /*  0                   1                   2                   3
     0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |        Error Code             |        URL Entry count        |
+   |         Extension ID          |       Next Extension Offset   |
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |       <URL Entry 1>          ...       <URL Entry N>          \
+   | Offset, contd.|                Extension Data                 \
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
 
-   /* Enforce v2 service reply size limits. */
-   if (buffer->end - buffer->curpos < 4)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Parse out the error code. */
-   srvrply->errorcode = GetUINT16(&buffer->curpos);
-   if (srvrply->errorcode)
-   {  /* don't trust the rest of the packet */
-      int err = srvrply->errorcode;
-      memset(srvrply, 0, sizeof(SLPSrvRply));
-      srvrply->errorcode = err;
-      return 0;
-   }
+   int result = 0;
+   int bufsz = (int)(buffer->end - buffer->start);
+   int nextoffset = msg->header.extoffset;
 
-   /* Parse the URL entry. */
-   srvrply->urlcount = GetUINT16(&buffer->curpos);
-   if (srvrply->urlcount)
+   while (nextoffset)
    {
-      int i;
-      srvrply->urlarray = xmalloc(sizeof(SLPUrlEntry) * srvrply->urlcount);
-      if (srvrply->urlarray == 0)
-         return SLP_ERROR_INTERNAL_ERROR;
-      memset(srvrply->urlarray, 0, sizeof(SLPUrlEntry) * srvrply->urlcount);
-      for (i = 0; i < srvrply->urlcount; i++)
+      int extid;
+
+      /* check for circular reference in list
+       * if the size gets below zero, we know we're
+       * reprocessing extensions in a loop.
+       */
+      bufsz -= 5;
+      if (bufsz <= 0) 
+         return SLP_ERROR_PARSE_ERROR;
+
+      buffer->curpos = buffer->start + nextoffset;
+      
+      if (buffer->curpos + 5 > buffer->end)
+         return SLP_ERROR_PARSE_ERROR;
+
+      extid = GetUINT16(&buffer->curpos);
+      nextoffset = GetUINT24(&buffer->curpos);
+      switch (extid)
       {
-         int result;
-         result = v2ParseUrlEntry(buffer, &srvrply->urlarray[i]);
-         if (result != 0)
-            return result;
+         /* Support the standard and experimental versions of this extension 
+          * in order to support 1.2.x for a time while the experimental
+          * version is deprecated.
+          */
+         case SLP_EXTENSION_ID_REG_PID:
+         case SLP_EXTENSION_ID_REG_PID_EXP:
+            if (msg->header.functionid == SLP_FUNCT_SRVREG)
+            {
+               if (buffer->curpos + 4 > buffer->end)
+                  return SLP_ERROR_PARSE_ERROR;
+               msg->body.srvreg.pid = GetUINT32(&buffer->curpos);
+            }
+            break;
+
+         default:
+            /* These are required extensions. Error if not handled. */
+            if (extid >= 0x4000 && extid <= 0x7FFF)
+               return SLP_ERROR_OPTION_NOT_UNDERSTOOD;
+            break;
       }
    }
-   return 0;
+   return result;
 }
 
-/** Parse a service registration.
+/** Parse an SLPv2 message header.
  *
  * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] srvreg - The service registration object into which 
+ * @param[out] header - The address of a message header into which 
  *    @p buffer should be parsed.
  *
- * @return Zero on success, or a non-zero error code.
- *
- * @internal
+ * @return Zero on success, or a non-zero error code, either
+ *    SLP_ERROR_VER_NOT_SUPPORTED or SLP_ERROR_PARSE_ERROR.
  */
-static int v2ParseSrvReg(SLPBuffer buffer, SLPSrvReg * srvreg)
+int SLPv2MessageParseHeader(SLPBuffer buffer, SLPHeader * header)
 {
-   int result;
-
 /*  0                   1                   2                   3
     0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |                          <URL-Entry>                          \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   | length of service type string |        <service-type>         \
+   |    Version    |  Function-ID  |            Length             |
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |     length of <scope-list>    |         <scope-list>          \
+   | Length, contd.|O|F|R|       reserved          |Next Ext Offset|
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |  length of attr-list string   |          <attr-list>          \
+   |  Next Extension Offset, contd.|              XID              |
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |# of AttrAuths |(if present) Attribute Authentication Blocks...\
+   |      Language Tag Length      |         Language Tag          \
    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
 
-   /* Parse the <URL-Entry>. */
-   result = v2ParseUrlEntry(buffer, &srvreg->urlentry);
-   if (result != 0)
-      return result;
+   /* Check for invalid length - 18 bytes is the smallest v2 message. */
+   if (buffer->end - buffer->start < 18)
+      return SLP_ERROR_PARSE_ERROR;
 
-   /* Parse the <service-type> string. */
-   srvreg->srvtypelen = GetUINT16(&buffer->curpos);
-   srvreg->srvtype = GetStrPtr(&buffer->curpos, srvreg->srvtypelen);
+   /* Parse header fields. */
+   header->version = *buffer->curpos++;
+   header->functionid = *buffer->curpos++;
+   header->length = GetUINT24(&buffer->curpos);
+   header->flags = GetUINT16(&buffer->curpos);
+   header->encoding = 0; /* not used for SLPv2 */
+   header->extoffset = GetUINT24(&buffer->curpos);
+   header->xid = GetUINT16(&buffer->curpos);
+   header->langtaglen = GetUINT16(&buffer->curpos);
+   header->langtag = GetStrPtr(&buffer->curpos, header->langtaglen);
+
+   /* Enforce language tag size limits. */
    if (buffer->curpos > buffer->end)
       return SLP_ERROR_PARSE_ERROR;
 
-   /* Parse the <scope-list> string. */
-   srvreg->scopelistlen = GetUINT16(&buffer->curpos);
-   srvreg->scopelist = GetStrPtr(&buffer->curpos, srvreg->scopelistlen);
-   if (buffer->curpos > buffer->end)
+   /* Enforce function id range. */
+   if (header->functionid < SLP_FUNCT_SRVRQST 
+         || header->functionid > SLP_FUNCT_SAADVERT)
       return SLP_ERROR_PARSE_ERROR;
 
-   /* Parse the <attr-list> string. */
-   srvreg->attrlistlen = GetUINT16(&buffer->curpos);
-   srvreg->attrlist = GetStrPtr(&buffer->curpos, srvreg->attrlistlen);
-   if (buffer->curpos > buffer->end)
+   /* Enforce reserved flags constraint. */
+   if (header->flags & 0x1fff)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Enforce extension offset limits. */
+   if (buffer->start + header->extoffset > buffer->end)
       return SLP_ERROR_PARSE_ERROR;
 
-   /* Parse AttrAuth block list (if present). */
-   srvreg->authcount = *buffer->curpos++;
-   if (srvreg->authcount)
-   {
-      int i;
-      srvreg->autharray = xmalloc(srvreg->authcount * sizeof(SLPAuthBlock));
-      if (srvreg->autharray == 0)
-         return SLP_ERROR_INTERNAL_ERROR;
-      memset(srvreg->autharray, 0,  srvreg->authcount * sizeof(SLPAuthBlock));
-      for (i = 0; i < srvreg->authcount; i++)
-      {
-         result = v2ParseAuthBlock(buffer, &srvreg->autharray[i]);
-         if (result != 0)
-            return result;
-      }
-   }
    return 0;
 }
 
-/** Parse a service deregistration.
+/** Parse the body of an SLPv2 message whose header is already parsed.
  *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] srvdereg - The service deregistration object into which 
+ * @param[in] buffer - The buffer from which data should be parsed, with
+ *    its current position just past the message header.
+ * @param[in] header - The parsed header of the message in @p buffer.
+ * @param[out] msg - The message object into which 
  *    @p buffer should be parsed.
  *
- * @return Zero on success, or a non-zero error code.
+ * @return Zero on success, SLP_ERROR_PARSE_ERROR, or
+ *    SLP_ERROR_INTERNAL_ERROR if out of memory.
  *
- * @internal
+ * @remarks The message must have been reset by SLPMessageFreeInternals.
+ *    On success, pointers in the SLPMessage reference memory in the
+ *    parsed SLPBuffer.
  */
-static int v2ParseSrvDeReg(SLPBuffer buffer, SLPSrvDeReg * srvdereg)
+int SLPv2MessageParseBody(const SLPBuffer buffer, const SLPHeader * header,
+      SLPMessage * msg)
 {
+   const V2Layout * layout;
+   V2Cursor c;
    int result;
 
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |    Length of <scope-list>     |         <scope-list>          \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |                           URL Entry                           \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |      Length of <tag-list>     |            <tag-list>         \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+   if (header != &msg->header)
+   {
+      msg->header = *header;
+      msg->header.langtag = (const char *)buffer->curpos - header->langtaglen;
+   }
 
-   /* Enforce SLPv2 service deregister size limits. */
-   if (buffer->end - buffer->curpos < 4)
+   /* Enforce function id range and the function's size limits. */
+   if (header->functionid < SLP_FUNCT_SRVRQST 
+         || header->functionid > SLP_FUNCT_SAADVERT)
+      return SLP_ERROR_MESSAGE_NOT_SUPPORTED;
+   layout = &v2Layouts[header->functionid];
+   if ((size_t)(buffer->end - buffer->curpos) < layout->minlen)
       return SLP_ERROR_PARSE_ERROR;
 
-   /* Parse the <scope-list>. */
-   srvdereg->scopelistlen = GetUINT16(&buffer->curpos);
-   srvdereg->scopelist = GetStrPtr(&buffer->curpos, srvdereg->scopelistlen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+   c.curpos = buffer->curpos;
+   c.end = buffer->end;
+   c.msg = msg;
+   c.layout = layout;
+   c.free = 0;
+   c.freelen = 0;
+   result = v2ParseFields(&c);
+   buffer->curpos = c.curpos;
 
-   /* Parse the URL entry. */
-   result = v2ParseUrlEntry(buffer, &srvdereg->urlentry);
-   if (result)
-      return result;
+   if (result == 0 && msg->header.extoffset)
+      result = v2ParseExtension(buffer, msg);
 
-   /* Parse the <tag-list>. */
-   srvdereg->taglistlen = GetUINT16(&buffer->curpos);
-   srvdereg->taglist = GetStrPtr(&buffer->curpos, srvdereg->taglistlen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+   if (result == 0)
+      v2FinishBody(msg);
 
-   return 0;
+   return result;
 }
 
-/** Parse a server ACK.
+/** Parse a wire buffer into an SLPv2 message descriptor.
  *
  * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] srvack - The server ACK object into which 
+ * @param[out] msg - The message object into which 
  *    @p buffer should be parsed.
  *
- * @return Zero (success) always.
+ * @return Zero on success, SLP_ERROR_PARSE_ERROR, or
+ *    SLP_ERROR_INTERNAL_ERROR if out of memory. If SLPMessage
+ *    is invalid then return is not successful.
  *
- * @internal
+ * @remarks On success, pointers in the SLPMessage reference memory in
+ *    the parsed SLPBuffer. If SLPBufferFree is called then the pointers
+ *    in @p message will be invalidated.
+ *
+ * @remarks It is assumed that SLPMessageParseBuffer is calling this 
+ *    routine and has already reset the message to accomodate new buffer
+ *    data.
  */
-static int v2ParseSrvAck(SLPBuffer buffer, SLPSrvAck * srvack)
+int SLPv2MessageParseBuffer(SLPBuffer buffer, SLPMessage * msg)
 {
-/*  0                   1
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |          Error Code           |
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+   int result;
 
-   /* Parse the Error Code. */
-   srvack->errorcode = GetUINT16(&buffer->curpos);
+   /* parse the header first */
+   result = SLPv2MessageParseHeader(buffer, &msg->header);
+   if (result == 0)
+      result = SLPv2MessageParseBody(buffer, &msg->header, msg);
 
-   return 0;
+   return result;
 }
 
-/** Parse an attribute request.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] attrrqst - The attribute request object into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, or a non-zero error code.
- *
- * @internal
- */
-static int v2ParseAttrRqst(SLPBuffer buffer, SLPAttrRqst * attrrqst)
-{
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |       length of PRList        |        <PRList> String        \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |         length of URL         |              URL              \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |    length of <scope-list>     |      <scope-list> string      \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |  length of <tag-list> string  |       <tag-list> string       \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |   length of <SLP SPI> string  |        <SLP SPI> string       \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+#if defined(SLP_V2MESSAGE_TEST) || defined(SLP_V2MESSAGE_BENCH)
 
-   /* Enforce v2 attribute request size limits. */
-   if (buffer->end - buffer->curpos < 10)
-      return SLP_ERROR_PARSE_ERROR;
+#include <stdio.h>
+#include <stdlib.h>
 
-   /* Parse the <PRList> string. */
-   attrrqst->prlistlen = GetUINT16(&buffer->curpos);
-   attrrqst->prlist = GetStrPtr(&buffer->curpos, attrrqst->prlistlen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+/* The cursor parser the layout table replaced: one routine per function,
+ * an allocation per URL entry and authentication block array, and the
+ * header parsed by every caller that wanted a body.
+ */
 
-   /* Parse the URL. */
-   attrrqst->urllen = GetUINT16(&buffer->curpos);
-   attrrqst->url = GetStrPtr(&buffer->curpos, attrrqst->urllen);
-   if (buffer->curpos > buffer->end)
+static int v2CursorParseAuthBlock(SLPBuffer buffer, SLPAuthBlock * authblock)
+{
+   /* Enforce v2 authentication block size limits. */
+   if (buffer->end - buffer->curpos < 10)
       return SLP_ERROR_PARSE_ERROR;
 
-   /* Parse the <scope-list> string. */
-   attrrqst->scopelistlen = GetUINT16(&buffer->curpos);
-   attrrqst->scopelist = GetStrPtr(&buffer->curpos, attrrqst->scopelistlen);
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
+   /* Save pointer to opaque authentication block. */
+   authblock->opaque = buffer->curpos;
 
-   /* Parse the <tag-list> string. */
-   attrrqst->taglistlen = GetUINT16(&buffer->curpos);
-   attrrqst->taglist = GetStrPtr(&buffer->curpos, attrrqst->taglistlen);
+   /* Parse individual authentication block fields. */
+   authblock->bsd = GetUINT16(&buffer->curpos);
+   authblock->length = GetUINT16(&buffer->curpos);
+   authblock->timestamp = GetUINT32(&buffer->curpos);
+   authblock->spistrlen = GetUINT16(&buffer->curpos);
+   authblock->spistr = GetStrPtr(&buffer->curpos, authblock->spistrlen);
    if (buffer->curpos > buffer->end)
       return SLP_ERROR_PARSE_ERROR;
 
-   /* Parse the <SLP SPI> string. */
-   attrrqst->spistrlen = GetUINT16(&buffer->curpos);
-   attrrqst->spistr = GetStrPtr(&buffer->curpos, attrrqst->spistrlen);
+   /* Parse structured authentication block. */
+   authblock->authstruct = (char *)buffer->curpos;
+   authblock->opaquelen = authblock->length;
+   buffer->curpos = authblock->opaque + authblock->length;
    if (buffer->curpos > buffer->end)
       return SLP_ERROR_PARSE_ERROR;
 
    return 0;
 }
 
-/** Parse an attribute reply.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] attrrply - The attribute reply object into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, or a non-zero error code.
- *
- * @internal
- */
-static int v2ParseAttrRply(SLPBuffer buffer, SLPAttrRply * attrrply)
+static int v2CursorParseUrlEntry(SLPBuffer buffer, SLPUrlEntry * urlentry)
 {
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |         Error Code            |      length of <attr-list>    |
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |                         <attr-list>                           \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |# of AttrAuths |  Attribute Authentication Block (if present)  \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+   /* Enforce SLPv2 URL entry size limits. */
+   if (buffer->end - buffer->curpos < 6)
+      return SLP_ERROR_PARSE_ERROR;
 
-   /* Enforce SLPv2 attribute request size limits. */
-   if (buffer->end - buffer->curpos < 5)
+   /* Save pointer to opaque URL entry block. */
+   urlentry->opaque = buffer->curpos;
+
+   /* Parse individual URL entry fields. */
+   urlentry->reserved = *buffer->curpos++;
+   urlentry->lifetime = GetUINT16(&buffer->curpos);
+   urlentry->urllen = GetUINT16(&buffer->curpos);
+   urlentry->url = GetStrPtr(&buffer->curpos, urlentry->urllen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse authentication block. */
+   urlentry->authcount = *buffer->curpos++;
+   if (urlentry->authcount)
+   {
+      int i;
+      urlentry->autharray = xmalloc(urlentry->authcount 
+            * sizeof(SLPAuthBlock));
+      if (urlentry->autharray == 0)
+         return SLP_ERROR_INTERNAL_ERROR;
+      memset(urlentry->autharray, 0, urlentry->authcount 
+            * sizeof(SLPAuthBlock));
+      for (i = 0; i < urlentry->authcount; i++)
+      {
+         int result = v2CursorParseAuthBlock(buffer, &urlentry->autharray[i]);
+         if (result != 0)
+            return result;
+      }
+   }
+   urlentry->opaquelen = buffer->curpos - urlentry->opaque;
+
+   /* Terminate the URL string for caller convenience - we're overwriting 
+    * the first byte of the "# of URL auths" field, but it's okay because
+    * we've already read and stored it away.
+    */
+   if(urlentry->url)
+      ((uint8_t *)urlentry->url)[urlentry->urllen] = 0;
+
+   return 0;
+}
+
+static int v2CursorParseSrvRqst(SLPBuffer buffer, SLPSrvRqst * srvrqst)
+{
+   /* Enforce v2 service request size limits. */
+   if (buffer->end - buffer->curpos < 10)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <PRList> string. */
+   srvrqst->prlistlen = GetUINT16(&buffer->curpos);
+   srvrqst->prlist = GetStrPtr(&buffer->curpos, srvrqst->prlistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <service-type> string. */
+   srvrqst->srvtypelen = GetUINT16(&buffer->curpos);
+   srvrqst->srvtype = GetStrPtr(&buffer->curpos, srvrqst->srvtypelen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <scope-list> string. */
+   srvrqst->scopelistlen = GetUINT16(&buffer->curpos);
+   srvrqst->scopelist = GetStrPtr(&buffer->curpos, srvrqst->scopelistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <predicate> string. */
+   srvrqst->predicatever = 2;  /* SLPv2 predicate (LDAPv3) */
+   srvrqst->predicatelen = GetUINT16(&buffer->curpos);
+   srvrqst->predicate = GetStrPtr(&buffer->curpos, srvrqst->predicatelen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <SLP SPI> string. */
+   srvrqst->spistrlen = GetUINT16(&buffer->curpos);
+   srvrqst->spistr = GetStrPtr(&buffer->curpos, srvrqst->spistrlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   return 0;
+}
+
+static int v2CursorParseSrvRply(SLPBuffer buffer, SLPSrvRply * srvrply)
+{
+   /* Enforce v2 service reply size limits. */
+   if (buffer->end - buffer->curpos < 4)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse out the error code. */
+   srvrply->errorcode = GetUINT16(&buffer->curpos);
+   if (srvrply->errorcode)
+   {  /* don't trust the rest of the packet */
+      int err = srvrply->errorcode;
+      memset(srvrply, 0, sizeof(SLPSrvRply));
+      srvrply->errorcode = err;
+      return 0;
+   }
+
+   /* Parse the URL entry. */
+   srvrply->urlcount = GetUINT16(&buffer->curpos);
+   if (srvrply->urlcount)
+   {
+      int i;
+      srvrply->urlarray = xmalloc(sizeof(SLPUrlEntry) * srvrply->urlcount);
+      if (srvrply->urlarray == 0)
+         return SLP_ERROR_INTERNAL_ERROR;
+      memset(srvrply->urlarray, 0, sizeof(SLPUrlEntry) * srvrply->urlcount);
+      for (i = 0; i < srvrply->urlcount; i++)
+      {
+         int result;
+         result = v2CursorParseUrlEntry(buffer, &srvrply->urlarray[i]);
+         if (result != 0)
+            return result;
+      }
+   }
+   return 0;
+}
+
+static int v2CursorParseSrvReg(SLPBuffer buffer, SLPSrvReg * srvreg)
+{
+   int result;
+
+   /* Parse the <URL-Entry>. */
+   result = v2CursorParseUrlEntry(buffer, &srvreg->urlentry);
+   if (result != 0)
+      return result;
+
+   /* Parse the <service-type> string. */
+   srvreg->srvtypelen = GetUINT16(&buffer->curpos);
+   srvreg->srvtype = GetStrPtr(&buffer->curpos, srvreg->srvtypelen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <scope-list> string. */
+   srvreg->scopelistlen = GetUINT16(&buffer->curpos);
+   srvreg->scopelist = GetStrPtr(&buffer->curpos, srvreg->scopelistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <attr-list> string. */
+   srvreg->attrlistlen = GetUINT16(&buffer->curpos);
+   srvreg->attrlist = GetStrPtr(&buffer->curpos, srvreg->attrlistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse AttrAuth block list (if present). */
+   srvreg->authcount = *buffer->curpos++;
+   if (srvreg->authcount)
+   {
+      int i;
+      srvreg->autharray = xmalloc(srvreg->authcount * sizeof(SLPAuthBlock));
+      if (srvreg->autharray == 0)
+         return SLP_ERROR_INTERNAL_ERROR;
+      memset(srvreg->autharray, 0,  srvreg->authcount * sizeof(SLPAuthBlock));
+      for (i = 0; i < srvreg->authcount; i++)
+      {
+         result = v2CursorParseAuthBlock(buffer, &srvreg->autharray[i]);
+         if (result != 0)
+            return result;
+      }
+   }
+   return 0;
+}
+
+static int v2CursorParseSrvDeReg(SLPBuffer buffer, SLPSrvDeReg * srvdereg)
+{
+   int result;
+
+   /* Enforce SLPv2 service deregister size limits. */
+   if (buffer->end - buffer->curpos < 4)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <scope-list>. */
+   srvdereg->scopelistlen = GetUINT16(&buffer->curpos);
+   srvdereg->scopelist = GetStrPtr(&buffer->curpos, srvdereg->scopelistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the URL entry. */
+   result = v2CursorParseUrlEntry(buffer, &srvdereg->urlentry);
+   if (result)
+      return result;
+
+   /* Parse the <tag-list>. */
+   srvdereg->taglistlen = GetUINT16(&buffer->curpos);
+   srvdereg->taglist = GetStrPtr(&buffer->curpos, srvdereg->taglistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   return 0;
+}
+
+static int v2CursorParseSrvAck(SLPBuffer buffer, SLPSrvAck * srvack)
+{
+   /* Parse the Error Code. */
+   srvack->errorcode = GetUINT16(&buffer->curpos);
+
+   return 0;
+}
+
+static int v2CursorParseAttrRqst(SLPBuffer buffer, SLPAttrRqst * attrrqst)
+{
+   /* Enforce v2 attribute request size limits. */
+   if (buffer->end - buffer->curpos < 10)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <PRList> string. */
+   attrrqst->prlistlen = GetUINT16(&buffer->curpos);
+   attrrqst->prlist = GetStrPtr(&buffer->curpos, attrrqst->prlistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the URL. */
+   attrrqst->urllen = GetUINT16(&buffer->curpos);
+   attrrqst->url = GetStrPtr(&buffer->curpos, attrrqst->urllen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <scope-list> string. */
+   attrrqst->scopelistlen = GetUINT16(&buffer->curpos);
+   attrrqst->scopelist = GetStrPtr(&buffer->curpos, attrrqst->scopelistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <tag-list> string. */
+   attrrqst->taglistlen = GetUINT16(&buffer->curpos);
+   attrrqst->taglist = GetStrPtr(&buffer->curpos, attrrqst->taglistlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   /* Parse the <SLP SPI> string. */
+   attrrqst->spistrlen = GetUINT16(&buffer->curpos);
+   attrrqst->spistr = GetStrPtr(&buffer->curpos, attrrqst->spistrlen);
+   if (buffer->curpos > buffer->end)
+      return SLP_ERROR_PARSE_ERROR;
+
+   return 0;
+}
+
+static int v2CursorParseAttrRply(SLPBuffer buffer, SLPAttrRply * attrrply)
+{
+   /* Enforce SLPv2 attribute request size limits. */
+   if (buffer->end - buffer->curpos < 5)
       return SLP_ERROR_PARSE_ERROR;
 
    /* Parse the Error Code. */
@@ -537,7 +1134,7 @@ static int v2ParseAttrRply(SLPBuffer buffer, SLPAttrRply * attrrply)
       memset(attrrply->autharray, 0, attrrply->authcount * sizeof(SLPAuthBlock));
       for (i = 0; i < attrrply->authcount; i++)
       {
-         int result = v2ParseAuthBlock(buffer, &attrrply->autharray[i]);
+         int result = v2CursorParseAuthBlock(buffer, &attrrply->autharray[i]);
          if (result != 0)
             return result;
       }
@@ -552,36 +1149,8 @@ static int v2ParseAttrRply(SLPBuffer buffer, SLPAttrRply * attrrply)
    return 0;
 }
 
-/** Parse a DA advertisement.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] daadvert - The DA advertisement object into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, or a non-zero error code.
- *
- * @internal
- */
-static int v2ParseDAAdvert(SLPBuffer buffer, SLPDAAdvert * daadvert)
+static int v2CursorParseDAAdvert(SLPBuffer buffer, SLPDAAdvert * daadvert)
 {
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |          Error Code           |  DA Stateless Boot Timestamp  |
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |DA Stateless Boot Time,, contd.|         Length of URL         |
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   \                              URL                              \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |     Length of <scope-list>    |         <scope-list>          \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |     Length of <attr-list>     |          <attr-list>          \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |    Length of <SLP SPI List>   |     <SLP SPI List> String     \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   | # Auth Blocks |         Authentication block (if any)         \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
-
    /* Enforce SLPv2 DA advertisement size limits. */
    if (buffer->end - buffer->curpos < 15)
       return SLP_ERROR_PARSE_ERROR;
@@ -637,7 +1206,7 @@ static int v2ParseDAAdvert(SLPBuffer buffer, SLPDAAdvert * daadvert)
             * daadvert->authcount);
       for (i = 0; i < daadvert->authcount; i++)
       {
-         int result = v2ParseAuthBlock(buffer, &daadvert->autharray[i]);
+         int result = v2CursorParseAuthBlock(buffer, &daadvert->autharray[i]);
          if (result != 0)
             return result;
       }
@@ -653,29 +1222,9 @@ static int v2ParseDAAdvert(SLPBuffer buffer, SLPDAAdvert * daadvert)
    return 0;
 }
 
-/** Parse a service type request.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] srvtyperqst - The service type request object into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, or a non-zero error code.
- *
- * @internal
- */
-static int v2ParseSrvTypeRqst(SLPBuffer buffer, 
+static int v2CursorParseSrvTypeRqst(SLPBuffer buffer, 
       SLPSrvTypeRqst * srvtyperqst)
 {
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |        length of PRList       |        <PRList> String        \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |   length of Naming Authority  |   <Naming Authority String>   \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |     length of <scope-list>    |      <scope-list> String      \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
-
    /* Enforce SLPv2 service type request size limits. */
    if (buffer->end - buffer->curpos < 6)
       return SLP_ERROR_PARSE_ERROR;
@@ -706,27 +1255,9 @@ static int v2ParseSrvTypeRqst(SLPBuffer buffer,
    return 0;
 }
 
-/** Parse a service type reply.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] srvtyperply - The service type reply object into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, or a non-zero error code.
- *
- * @internal
- */
-static int v2ParseSrvTypeRply(SLPBuffer buffer, 
+static int v2CursorParseSrvTypeRply(SLPBuffer buffer, 
       SLPSrvTypeRply * srvtyperply)
 {
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |           Error Code          |    length of <srvType-list>   |
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |                       <srvtype--list>                         \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
-
    /* Enforce SLPv2 service type reply size limits. */
    if (buffer->end - buffer->curpos < 4)
       return SLP_ERROR_PARSE_ERROR;
@@ -760,30 +1291,8 @@ static int v2ParseSrvTypeRply(SLPBuffer buffer,
    return 0;
 }
 
-/** Parse an SA advertisement.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] saadvert - The SA advertisement object into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, or a non-zero error code.
- *
- * @internal
- */
-static int v2ParseSAAdvert(SLPBuffer buffer, SLPSAAdvert * saadvert)
+static int v2CursorParseSAAdvert(SLPBuffer buffer, SLPSAAdvert * saadvert)
 {
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |         Length of URL         |              URL              \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |     Length of <scope-list>    |         <scope-list>          \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |     Length of <attr-list>     |          <attr-list>          \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   | # auth blocks |        authentication block (if any)          \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
-
    /* Enforce SLPv2 SA advertisement size limits. */
    if (buffer->end - buffer->curpos < 7)
       return SLP_ERROR_PARSE_ERROR;
@@ -819,7 +1328,7 @@ static int v2ParseSAAdvert(SLPBuffer buffer, SLPSAAdvert * saadvert)
             * sizeof(SLPAuthBlock));
       for (i = 0; i < saadvert->authcount; i++)
       {
-         int result = v2ParseAuthBlock(buffer, &saadvert->autharray[i]);
+         int result = v2CursorParseAuthBlock(buffer, &saadvert->autharray[i]);
          if (result != 0)
             return result;
       }
@@ -835,206 +1344,59 @@ static int v2ParseSAAdvert(SLPBuffer buffer, SLPSAAdvert * saadvert)
    return 0;
 }
 
-/** Parse a service extension.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] msg - The service extension object into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, or a non-zero error code.
- *
- * @note Parse extensions @b after all standard protocol fields are parsed.
- *
- * @internal
- */
-static int v2ParseExtension(SLPBuffer buffer, SLPMessage * msg)
-{
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |         Extension ID          |       Next Extension Offset   |
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   | Offset, contd.|                Extension Data                 \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
-
-   int result = 0;
-   int bufsz = (int)(buffer->end - buffer->start);
-   int nextoffset = msg->header.extoffset;
-
-   while (nextoffset)
-   {
-      int extid;
-
-      /* check for circular reference in list
-       * if the size gets below zero, we know we're
-       * reprocessing extensions in a loop.
-       */
-      bufsz -= 5;
-      if (bufsz <= 0) 
-         return SLP_ERROR_PARSE_ERROR;
-
-      buffer->curpos = buffer->start + nextoffset;
-      
-      if (buffer->curpos + 5 > buffer->end)
-         return SLP_ERROR_PARSE_ERROR;
-
-      extid = GetUINT16(&buffer->curpos);
-      nextoffset = GetUINT24(&buffer->curpos);
-      switch (extid)
-      {
-         /* Support the standard and experimental versions of this extension 
-          * in order to support 1.2.x for a time while the experimental
-          * version is deprecated.
-          */
-         case SLP_EXTENSION_ID_REG_PID:
-         case SLP_EXTENSION_ID_REG_PID_EXP:
-            if (msg->header.functionid == SLP_FUNCT_SRVREG)
-            {
-               if (buffer->curpos + 4 > buffer->end)
-                  return SLP_ERROR_PARSE_ERROR;
-               msg->body.srvreg.pid = GetUINT32(&buffer->curpos);
-            }
-            break;
-
-         default:
-            /* These are required extensions. Error if not handled. */
-            if (extid >= 0x4000 && extid <= 0x7FFF)
-               return SLP_ERROR_OPTION_NOT_UNDERSTOOD;
-            break;
-      }
-   }
-   return result;
-}
-
-/** Parse an SLPv2 message header.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] header - The address of a message header into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, or a non-zero error code, either
- *    SLP_ERROR_VER_NOT_SUPPORTED or SLP_ERROR_PARSE_ERROR.
- */
-int SLPv2MessageParseHeader(SLPBuffer buffer, SLPHeader * header)
-{
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |    Version    |  Function-ID  |            Length             |
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   | Length, contd.|O|F|R|       reserved          |Next Ext Offset|
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |  Next Extension Offset, contd.|              XID              |
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |      Language Tag Length      |         Language Tag          \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
-
-   /* Check for invalid length - 18 bytes is the smallest v2 message. */
-   if (buffer->end - buffer->start < 18)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Parse header fields. */
-   header->version = *buffer->curpos++;
-   header->functionid = *buffer->curpos++;
-   header->length = GetUINT24(&buffer->curpos);
-   header->flags = GetUINT16(&buffer->curpos);
-   header->encoding = 0; /* not used for SLPv2 */
-   header->extoffset = GetUINT24(&buffer->curpos);
-   header->xid = GetUINT16(&buffer->curpos);
-   header->langtaglen = GetUINT16(&buffer->curpos);
-   header->langtag = GetStrPtr(&buffer->curpos, header->langtaglen);
-
-   /* Enforce language tag size limits. */
-   if (buffer->curpos > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Enforce function id range. */
-   if (header->functionid < SLP_FUNCT_SRVRQST 
-         || header->functionid > SLP_FUNCT_SAADVERT)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Enforce reserved flags constraint. */
-   if (header->flags & 0x1fff)
-      return SLP_ERROR_PARSE_ERROR;
-
-   /* Enforce extension offset limits. */
-   if (buffer->start + header->extoffset > buffer->end)
-      return SLP_ERROR_PARSE_ERROR;
-
-   return 0;
-}
-
-/** Parse a wire buffer into an SLPv2 message descriptor.
- *
- * @param[in] buffer - The buffer from which data should be parsed.
- * @param[out] msg - The message object into which 
- *    @p buffer should be parsed.
- *
- * @return Zero on success, SLP_ERROR_PARSE_ERROR, or
- *    SLP_ERROR_INTERNAL_ERROR if out of memory. If SLPMessage
- *    is invalid then return is not successful.
- *
- * @remarks On success, pointers in the SLPMessage reference memory in
- *    the parsed SLPBuffer. If SLPBufferFree is called then the pointers
- *    in @p message will be invalidated.
- *
- * @remarks It is assumed that SLPMessageParseBuffer is calling this 
- *    routine and has already reset the message to accomodate new buffer
- *    data.
- */
-int SLPv2MessageParseBuffer(SLPBuffer buffer, SLPMessage * msg)
+static int v2CursorParseBuffer(SLPBuffer buffer, SLPMessage * msg)
 {
    int result;
 
-   /* parse the header first */
    result = SLPv2MessageParseHeader(buffer, &msg->header);
    if (result == 0)
    {
-      /* switch on the function id to parse the body */
       switch (msg->header.functionid)
       {
          case SLP_FUNCT_SRVRQST:
-            result = v2ParseSrvRqst(buffer, &msg->body.srvrqst);
+            result = v2CursorParseSrvRqst(buffer, &msg->body.srvrqst);
             break;
 
          case SLP_FUNCT_SRVRPLY:
-            result = v2ParseSrvRply(buffer, &msg->body.srvrply);
+            result = v2CursorParseSrvRply(buffer, &msg->body.srvrply);
             break;
 
          case SLP_FUNCT_SRVREG:
-            result = v2ParseSrvReg(buffer, &msg->body.srvreg);
+            result = v2CursorParseSrvReg(buffer, &msg->body.srvreg);
             break;
 
          case SLP_FUNCT_SRVDEREG:
-            result = v2ParseSrvDeReg(buffer, &msg->body.srvdereg);
+            result = v2CursorParseSrvDeReg(buffer, &msg->body.srvdereg);
             break;
 
          case SLP_FUNCT_SRVACK:
-            result = v2ParseSrvAck(buffer, &msg->body.srvack);
+            result = v2CursorParseSrvAck(buffer, &msg->body.srvack);
             break;
 
          case SLP_FUNCT_ATTRRQST:
-            result = v2ParseAttrRqst(buffer, &msg->body.attrrqst);
+            result = v2CursorParseAttrRqst(buffer, &msg->body.attrrqst);
             break;
 
          case SLP_FUNCT_ATTRRPLY:
-            result = v2ParseAttrRply(buffer, &msg->body.attrrply);
+            result = v2CursorParseAttrRply(buffer, &msg->body.attrrply);
             break;
 
          case SLP_FUNCT_DAADVERT:
-            result = v2ParseDAAdvert(buffer, &msg->body.daadvert);
+            result = v2CursorParseDAAdvert(buffer, &msg->body.daadvert);
             break;
 
          case SLP_FUNCT_SRVTYPERQST:
-            result = v2ParseSrvTypeRqst(buffer, &msg->body.srvtyperqst);
+            result = v2CursorParseSrvTypeRqst(buffer, 
+                  &msg->body.srvtyperqst);
             break;
 
          case SLP_FUNCT_SRVTYPERPLY:
-            result = v2ParseSrvTypeRply(buffer, &msg->body.srvtyperply);
+            result = v2CursorParseSrvTypeRply(buffer, 
+                  &msg->body.srvtyperply);
             break;
 
          case SLP_FUNCT_SAADVERT:
-            result = v2ParseSAAdvert(buffer, &msg->body.saadvert);
+            result = v2CursorParseSAAdvert(buffer, &msg->body.saadvert);
             break;
 
          default:
@@ -1048,4 +1410,574 @@ int SLPv2MessageParseBuffer(SLPBuffer buffer, SLPMessage * msg)
    return result;
 }
 
+static void v2CursorFreeInternals(SLPMessage * mp)
+{
+   SLPAuthBlock ** auths[3];
+   int n = 0;
+   int i;
+
+   switch (mp->header.functionid)
+   {
+      case SLP_FUNCT_SRVRPLY:
+         if (mp->body.srvrply.urlarray)
+         {
+            for (i = 0; i < mp->body.srvrply.urlcount; i++)
+               xfree(mp->body.srvrply.urlarray[i].autharray);
+            xfree(mp->body.srvrply.urlarray);
+            mp->body.srvrply.urlarray = 0;
+         }
+         break;
+
+      case SLP_FUNCT_SRVREG:
+         auths[n++] = &mp->body.srvreg.urlentry.autharray;
+         auths[n++] = &mp->body.srvreg.autharray;
+         break;
+
+      case SLP_FUNCT_SRVDEREG:
+         auths[n++] = &mp->body.srvdereg.urlentry.autharray;
+         break;
+
+      case SLP_FUNCT_ATTRRPLY:
+         auths[n++] = &mp->body.attrrply.autharray;
+         break;
+
+      case SLP_FUNCT_DAADVERT:
+         auths[n++] = &mp->body.daadvert.autharray;
+         break;
+
+      case SLP_FUNCT_SAADVERT:
+         auths[n++] = &mp->body.saadvert.autharray;
+         break;
+   }
+   for (i = 0; i < n; i++)
+      if (*auths[i])
+      {
+         xfree(*auths[i]);
+         *auths[i] = 0;
+      }
+}
+
+/* A sample SLPv2 message on the wire. */
+typedef struct V2Sample
+{
+   const char * name;
+   size_t len;
+   uint8_t data[512];
+} V2Sample;
+
+static uint8_t * PutString(uint8_t * p, const char * str)
+{
+   size_t len = strlen(str);
+
+   PutUINT16(&p, len);
+   memcpy(p, str, len);
+   return p + len;
+}
+
+static uint8_t * PutAuthBlock(uint8_t * p, const char * spi)
+{
+   size_t siglen = 40;
+
+   PutUINT16(&p, 2);                   /* DSA with SHA-1 */
+   PutUINT16(&p, 10 + strlen(spi) + siglen);
+   PutUINT32(&p, 0x3b9aca00);
+   p = PutString(p, spi);
+   memset(p, 0xa5, siglen);
+   return p + siglen;
+}
+
+static uint8_t * PutUrlEntry(uint8_t * p, const char * url, int authcount)
+{
+   *p++ = 0;
+   PutUINT16(&p, 10800);
+   p = PutString(p, url);
+   *p++ = (uint8_t)authcount;
+   while (authcount--)
+      p = PutAuthBlock(p, "openslp-spi");
+   return p;
+}
+
+static uint8_t * PutHeader(V2Sample * s, const char * name, int functionid)
+{
+   uint8_t * p = s->data;
+
+   s->name = name;
+   *p++ = 2;
+   *p++ = (uint8_t)functionid;
+   PutUINT24(&p, 0);                   /* length, set by FinishSample */
+   PutUINT16(&p, 0);
+   PutUINT24(&p, 0);
+   PutUINT16(&p, 0x2a2a);
+   return PutString(p, "en");
+}
+
+static void FinishSample(V2Sample * s, uint8_t * end)
+{
+   uint8_t * p = s->data + 2;
+
+   s->len = end - s->data;
+   PutUINT24(&p, s->len);
+}
+
+/* Fill @p samples with one of each kind of message an SA, UA and DA
+ * exchange, in the shapes they usually take. Returns the sample count.
+ */
+static int BuildSamples(V2Sample * samples)
+{
+   static const char * urls[] =
+   {
+      "service:printer:lpr://printer1.example.com/queue1",
+      "service:printer:lpr://printer2.example.com/queue1",
+      "service:printer:ipp://printer3.example.com:631/ipp",
+      "service:printer:ipp://printer4.example.com:631/ipp",
+      "service:printer:lpr://printer5.example.com/queue2",
+      "service:printer:lpr://printer6.example.com/queue2",
+      "service:printer:ipp://printer7.example.com:631/ipp",
+      "service:printer:ipp://printer8.example.com:631/ipp",
+   };
+   V2Sample * s = samples;
+   uint8_t * p;
+   int i;
+
+   p = PutHeader(s, "SrvRqst", SLP_FUNCT_SRVRQST);
+   p = PutString(p, "192.168.1.7,192.168.1.9");
+   p = PutString(p, "service:printer");
+   p = PutString(p, "DEFAULT,engineering");
+   p = PutString(p, "(&(location=3rd floor)(color=true))");
+   p = PutString(p, "");
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvRply", SLP_FUNCT_SRVRPLY);
+   PutUINT16(&p, 0);
+   PutUINT16(&p, sizeof(urls) / sizeof(*urls));
+   for (i = 0; i < (int)(sizeof(urls) / sizeof(*urls)); i++)
+      p = PutUrlEntry(p, urls[i], 0);
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvRply (auth)", SLP_FUNCT_SRVRPLY);
+   PutUINT16(&p, 0);
+   PutUINT16(&p, 2);
+   p = PutUrlEntry(p, urls[0], 1);
+   p = PutUrlEntry(p, urls[1], 1);
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvRply (error)", SLP_FUNCT_SRVRPLY);
+   PutUINT16(&p, SLP_ERROR_SCOPE_NOT_SUPPORTED);
+   PutUINT16(&p, 0);
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvReg", SLP_FUNCT_SRVREG);
+   p = PutUrlEntry(p, urls[2], 0);
+   p = PutString(p, "service:printer:ipp");
+   p = PutString(p, "DEFAULT");
+   p = PutString(p, "(location=3rd floor),(color=true),(ppm=40),"
+         "(media=a4,letter,legal),x-duplex");
+   *p++ = 0;
+   {
+      /* OpenSLP's process watcher extension */
+      uint8_t * ext = s->data + 7;
+
+      PutUINT24(&ext, p - s->data);
+      PutUINT16(&p, SLP_EXTENSION_ID_REG_PID);
+      PutUINT24(&p, 0);
+      PutUINT32(&p, 4242);
+   }
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvReg (auth)", SLP_FUNCT_SRVREG);
+   p = PutUrlEntry(p, urls[3], 1);
+   p = PutString(p, "service:printer:ipp");
+   p = PutString(p, "DEFAULT");
+   p = PutString(p, "(location=4th floor),(color=false)");
+   *p++ = 1;
+   p = PutAuthBlock(p, "openslp-spi");
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvDeReg", SLP_FUNCT_SRVDEREG);
+   p = PutString(p, "DEFAULT");
+   p = PutUrlEntry(p, urls[2], 0);
+   p = PutString(p, "");
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvAck", SLP_FUNCT_SRVACK);
+   PutUINT16(&p, 0);
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "AttrRqst", SLP_FUNCT_ATTRRQST);
+   p = PutString(p, "");
+   p = PutString(p, urls[2]);
+   p = PutString(p, "DEFAULT");
+   p = PutString(p, "location,color");
+   p = PutString(p, "");
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "AttrRply", SLP_FUNCT_ATTRRPLY);
+   PutUINT16(&p, 0);
+   p = PutString(p, "(location=3rd floor),(color=true)");
+   *p++ = 0;
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "DAAdvert", SLP_FUNCT_DAADVERT);
+   PutUINT16(&p, 0);
+   PutUINT32(&p, 1000000000);
+   p = PutString(p, "service:directory-agent://192.168.1.7");
+   p = PutString(p, "DEFAULT,engineering");
+   p = PutString(p, "");
+   p = PutString(p, "");
+   *p++ = 0;
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvTypeRqst", SLP_FUNCT_SRVTYPERQST);
+   p = PutString(p, "");
+   PutUINT16(&p, 0xffff);
+   p = PutString(p, "DEFAULT");
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SrvTypeRply", SLP_FUNCT_SRVTYPERPLY);
+   PutUINT16(&p, 0);
+   p = PutString(p, "service:printer:lpr,service:printer:ipp,"
+         "service:directory-agent");
+   FinishSample(s++, p);
+
+   p = PutHeader(s, "SAAdvert", SLP_FUNCT_SAADVERT);
+   p = PutString(p, "service:service-agent://192.168.1.9");
+   p = PutString(p, "DEFAULT");
+   p = PutString(p, "");
+   *p++ = 0;
+   FinishSample(s++, p);
+
+   return (int)(s - samples);
+}
+
+#endif
+
+#ifdef SLP_V2MESSAGE_TEST
+
+/* Parse a sample with either parser into a buffer of exactly its size. */
+static int ParseSample(const V2Sample * s, size_t len, int cursor,
+      SLPBuffer * bufp, SLPMessage * msg)
+{
+   *bufp = SLPBufferAlloc(len);
+   if (*bufp == 0)
+      return SLP_ERROR_INTERNAL_ERROR;
+   memcpy((*bufp)->start, s->data, len);
+   return cursor? v2CursorParseBuffer(*bufp, msg):
+         SLPv2MessageParseBuffer(*bufp, msg);
+}
+
+static int SameOffset(const void * p1, SLPBuffer b1,
+      const void * p2, SLPBuffer b2)
+{
+   if (p1 == 0 || p2 == 0)
+      return p1 == p2;
+   return (const uint8_t *)p1 - b1->start == (const uint8_t *)p2 - b2->start;
+}
+
+#define SAME(f)      (m1->f == m2->f)
+#define SAME_PTR(f)  SameOffset(m1->f, b1, m2->f, b2)
+#define SAME_STR(f)  (SAME(f##len) && SAME_PTR(f))
+
+static int SameAuthBlocks(int count, const SLPAuthBlock * a1, SLPBuffer b1,
+      const SLPAuthBlock * a2, SLPBuffer b2)
+{
+   int i;
+
+   for (i = 0; i < count; i++)
+   {
+      const SLPAuthBlock * m1 = &a1[i];
+      const SLPAuthBlock * m2 = &a2[i];
+
+      if (!SAME(bsd) || !SAME(length) || !SAME(timestamp)
+            || !SAME_STR(spistr) || !SAME_PTR(authstruct)
+            || !SAME(opaquelen) || !SAME_PTR(opaque))
+         return 0;
+   }
+   return 1;
+}
+
+static int SameUrlEntries(int count, const SLPUrlEntry * u1, SLPBuffer b1,
+      const SLPUrlEntry * u2, SLPBuffer b2)
+{
+   int i;
+
+   for (i = 0; i < count; i++)
+   {
+      const SLPUrlEntry * m1 = &u1[i];
+      const SLPUrlEntry * m2 = &u2[i];
+
+      if (!SAME(reserved) || !SAME(lifetime) || !SAME_STR(url)
+            || !SAME(authcount) || !SAME(opaquelen) || !SAME_PTR(opaque)
+            || !SameAuthBlocks(m1->authcount, m1->autharray, b1,
+                  m2->autharray, b2))
+         return 0;
+   }
+   return 1;
+}
+
+/* Compare two parses of the same message, field by field. */
+static int SameMessage(const SLPMessage * m1, SLPBuffer b1,
+      const SLPMessage * m2, SLPBuffer b2)
+{
+   if (!SAME(header.version) || !SAME(header.functionid)
+         || !SAME(header.length) || !SAME(header.flags)
+         || !SAME(header.extoffset) || !SAME(header.xid)
+         || !SAME_STR(header.langtag))
+      return 0;
+
+   /* Both must have left the same strings terminated. */
+   if (memcmp(b1->start, b2->start, b1->end - b1->start + 1) != 0)
+      return 0;
+
+   switch (m1->header.functionid)
+   {
+      case SLP_FUNCT_SRVRQST:
+         return SAME_STR(body.srvrqst.prlist)
+               && SAME_STR(body.srvrqst.srvtype)
+               && SAME_STR(body.srvrqst.scopelist)
+               && SAME(body.srvrqst.predicatever)
+               && SAME_STR(body.srvrqst.predicate)
+               && SAME_STR(body.srvrqst.spistr);
+
+      case SLP_FUNCT_SRVRPLY:
+         return SAME(body.srvrply.errorcode)
+               && SAME(body.srvrply.urlcount)
+               && SameUrlEntries(m1->body.srvrply.urlcount,
+                     m1->body.srvrply.urlarray, b1,
+                     m2->body.srvrply.urlarray, b2);
+
+      case SLP_FUNCT_SRVREG:
+         return SameUrlEntries(1, &m1->body.srvreg.urlentry, b1,
+                     &m2->body.srvreg.urlentry, b2)
+               && SAME_STR(body.srvreg.srvtype)
+               && SAME_STR(body.srvreg.scopelist)
+               && SAME_STR(body.srvreg.attrlist)
+               && SAME(body.srvreg.authcount)
+               && SameAuthBlocks(m1->body.srvreg.authcount,
+                     m1->body.srvreg.autharray, b1,
+                     m2->body.srvreg.autharray, b2)
+               && SAME(body.srvreg.pid);
+
+      case SLP_FUNCT_SRVDEREG:
+         return SAME_STR(body.srvdereg.scopelist)
+               && SameUrlEntries(1, &m1->body.srvdereg.urlentry, b1,
+                     &m2->body.srvdereg.urlentry, b2)
+               && SAME_STR(body.srvdereg.taglist);
+
+      case SLP_FUNCT_SRVACK:
+         return SAME(body.srvack.errorcode);
+
+      case SLP_FUNCT_ATTRRQST:
+         return SAME_STR(body.attrrqst.prlist)
+               && SAME_STR(body.attrrqst.url)
+               && SAME_STR(body.attrrqst.scopelist)
+               && SAME_STR(body.attrrqst.taglist)
+               && SAME_STR(body.attrrqst.spistr);
+
+      case SLP_FUNCT_ATTRRPLY:
+         return SAME(body.attrrply.errorcode)
+               && SAME_STR(body.attrrply.attrlist)
+               && SAME(body.attrrply.authcount)
+               && SameAuthBlocks(m1->body.attrrply.authcount,
+                     m1->body.attrrply.autharray, b1,
+                     m2->body.attrrply.autharray, b2);
+
+      case SLP_FUNCT_DAADVERT:
+         return SAME(body.daadvert.errorcode)
+               && SAME(body.daadvert.bootstamp)
+               && SAME_STR(body.daadvert.url)
+               && SAME_STR(body.daadvert.scopelist)
+               && SAME_STR(body.daadvert.attrlist)
+               && SAME_STR(body.daadvert.spilist)
+               && SAME(body.daadvert.authcount)
+               && SameAuthBlocks(m1->body.daadvert.authcount,
+                     m1->body.daadvert.autharray, b1,
+                     m2->body.daadvert.autharray, b2);
+
+      case SLP_FUNCT_SRVTYPERQST:
+         return SAME_STR(body.srvtyperqst.prlist)
+               && SAME_STR(body.srvtyperqst.namingauth)
+               && SAME_STR(body.srvtyperqst.scopelist);
+
+      case SLP_FUNCT_SRVTYPERPLY:
+         return SAME(body.srvtyperply.errorcode)
+               && SAME_STR(body.srvtyperply.srvtypelist);
+
+      case SLP_FUNCT_SAADVERT:
+         return SAME_STR(body.saadvert.url)
+               && SAME_STR(body.saadvert.scopelist)
+               && SAME_STR(body.saadvert.attrlist)
+               && SAME(body.saadvert.authcount)
+               && SameAuthBlocks(m1->body.saadvert.authcount,
+                     m1->body.saadvert.autharray, b1,
+                     m2->body.saadvert.autharray, b2);
+   }
+   return 0;
+}
+
+/* Parse a sample, or a damaged copy of one, with both parsers. The layout
+ * parser is the stricter of the two, so whatever it accepts the cursor
+ * parser must accept and read the same way.
+ */
+static int test_Sample(const V2Sample * s, size_t len, int damaged)
+{
+   SLPMessage * m1 = SLPMessageAlloc();
+   SLPMessage * m2 = SLPMessageAlloc();
+   SLPBuffer b1 = 0;
+   SLPBuffer b2 = 0;
+   int result = -1;
+   int r1;
+   int r2;
+
+   if (m1 == 0 || m2 == 0)
+      goto done;
+
+   r1 = ParseSample(s, len, 0, &b1, m1);
+   if (r1 == SLP_ERROR_INTERNAL_ERROR)
+      goto done;
+   if (r1 != 0 && damaged)
+      result = 0;
+   else if (r1 == 0)
+   {
+      r2 = ParseSample(s, len, 1, &b2, m2);
+      if (r2 == 0 && SameMessage(m1, b1, m2, b2))
+         result = 0;
+   }
+   if (result != 0)
+      printf("%s: layout parser %s a %s message of %u bytes\n", s->name,
+            r1? "rejected": "misread", damaged? "damaged": "valid",
+            (unsigned)len);
+
+done:
+   if (m1)
+      SLPMessageFree(m1);
+   if (m2)
+   {
+      v2CursorFreeInternals(m2);
+      xfree(m2);
+   }
+   if (b1)
+      SLPBufferFree(b1);
+   if (b2)
+      SLPBufferFree(b2);
+   return result;
+}
+
+/* ------------ Test main for the slp_v2message.c module --------------
+ *
+ * Compile with:
+ *    gcc -g -Wall -I .. -O0 -D SLP_V2MESSAGE_TEST -D DEBUG -D HAVE_CONFIG_H \
+ *       -o slp-v2message-test slp_v2message.c slp_message.c slp_buffer.c \
+ *       slp_compare.c slp_linkedlist.c slp_xmalloc.c slp_v1message.c slp_utf8.c
+ */
+int main(void)
+{
+   V2Sample samples[16];
+   int nsamples = BuildSamples(samples);
+   int i;
+
+   for (i = 0; i < nsamples; i++)
+   {
+      V2Sample damaged = samples[i];
+      size_t len;
+      size_t pos;
+
+      /* Every sample must parse the same way with both parsers. */
+      if (test_Sample(&samples[i], samples[i].len, 0) != 0)
+         return -1;
+
+      /* Truncated anywhere, and with any byte inverted, a sample must be
+       * rejected cleanly or parsed the same way by both parsers.
+       */
+      for (len = 0; len < samples[i].len; len++)
+         if (test_Sample(&samples[i], len, 1) != 0)
+            return -1;
+
+      for (pos = 0; pos < samples[i].len; pos++)
+      {
+         damaged.data[pos] ^= 0xff;
+         if (test_Sample(&damaged, damaged.len, 1) != 0)
+            return -1;
+         damaged.data[pos] ^= 0xff;
+      }
+   }
+   return 0;
+}
+
+#endif /* SLP_V2MESSAGE_TEST */
+
+#ifdef SLP_V2MESSAGE_BENCH
+
+/* ------------- Benchmark main for the slp_v2message.c module -------------
+ *
+ * Times the layout parser against the cursor parser it replaced over a mix
+ * of the messages an SA, UA and DA exchange. Each message is copied into
+ * the receive buffer first, as the parsers terminate strings in place.
+ *
+ * Build and run with:
+ *    make slp-v2message-bench && ./slp-v2message-bench [iterations]
+ */
+
+typedef int BenchParse(SLPBuffer, SLPMessage *);
+typedef void BenchFree(SLPMessage *);
+
+static double BenchSeconds(clock_t start)
+{
+   return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char * argv[])
+{
+   V2Sample samples[16];
+   int nsamples = BuildSamples(samples);
+   const char * names[] = {"cursor", "layout"};
+   BenchParse * parsers[] = {v2CursorParseBuffer, SLPv2MessageParseBuffer};
+   BenchFree * frees[] = {v2CursorFreeInternals, SLPMessageFreeInternals};
+   long iters = argc > 1? atol(argv[1]): 200000;
+   SLPBuffer buffer = SLPBufferAlloc(sizeof(samples[0].data));
+   SLPMessage * msg = SLPMessageAlloc();
+   int k;
+
+   if (buffer == 0 || msg == 0)
+      return 1;
+
+   printf("%ld iterations\n", iters);
+   for (k = 0; k < 2; k++)
+   {
+      double total = 0;
+      int i;
+
+      for (i = 0; i < nsamples; i++)
+      {
+         const V2Sample * s = &samples[i];
+         clock_t start = clock();
+         double secs;
+         long n;
+
+         for (n = 0; n < iters; n++)
+         {
+            memcpy(buffer->start, s->data, s->len);
+            buffer->curpos = buffer->start;
+            buffer->end = buffer->start + s->len;
+
+            /* The cursor parser leaves absent arrays alone. */
+            memset(&msg->body, 0, sizeof(msg->body));
+            if (parsers[k](buffer, msg) != 0)
+               return 1;
+            frees[k](msg);
+         }
+         secs = BenchSeconds(start);
+         total += secs;
+         printf("%-8s %-16s %8.1f ns/message\n", names[k], s->name,
+               secs * 1e9 / iters);
+      }
+      printf("%-8s %-16s %8.1f ns/message\n", names[k], "(all)",
+            total * 1e9 / iters / nsamples);
+   }
+   SLPMessageFree(msg);
+   SLPBufferFree(buffer);
+   return 0;
+}
+
+#endif /* SLP_V2MESSAGE_BENCH */
+
 /*=========================================================================*/
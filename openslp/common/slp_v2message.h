@@ -50,6 +50,9 @@
 
 int SLPv2MessageParseHeader(const SLPBuffer buffer, SLPHeader * header);
 
+int SLPv2MessageParseBody(const SLPBuffer buffer, const SLPHeader * header,
+      SLPMessage * msg);
+
 int SLPv2MessageParseBuffer(const SLPBuffer buffer, SLPMessage * msg);
 
 /*! @} */
@@ -54,6 +54,8 @@
 #include "slp_debug.h"
 #include "slp_spi.h"
 #include "slp_auth.h"
+#include "slp_arena.h"
+#include "slp_hash.h"
 
 #define MINIMUM_DISCOVERY_INTERVAL  300    /* 5 minutes */
 #define MAX_RETRANSMITS             5      /* we'll only re-xmit 5 times! */
@@ -69,15 +71,6 @@ typedef enum
    SLPDELATTRS
 } SLPCallType;
 
-/** Used to collate Service URLS.
- */
-typedef struct _SLPSrvUrlCollatedItem
-{
-   SLPListItem listitem;         /*!< Makes this a list item. */
-   char * srvurl;                /*!< The item's service URL. */
-   unsigned short lifetime;      /*!< The item's lifetime. */
-} SLPSrvUrlCollatedItem;
-
 /** Used to pass all user parameters for "registration" requests.
  */
 typedef struct _SLPRegParams
@@ -174,6 +167,7 @@ typedef struct _SLPHandleInfo
 #define SLP_HANDLE_SIG 0xbeeffeed
    unsigned int sig;             /*!< A handle signature value. */
    intptr_t inUse;               /*!< A lock used to control access. */
+   intptr_t cancelled;           /*!< Nonzero once a stream is cancelled. */
 
 #ifdef ENABLE_ASYNC_API
    SLPBoolean isAsync;           /*!< Is operation sync or async? */
@@ -204,8 +198,8 @@ typedef struct _SLPHandleInfo
    size_t langtaglen;            /*!< The length in bytes of @p langtag. */
    char * langtag;               /*!< The language tag assoicated. */
    int callbackcount;            /*!< The callbacks made in this request. */
-   SLPList collatedsrvurls;      /*!< The list of collated service URLs. */
-   char * collatedsrvtypes;      /*!< The list of collated service types. */
+   SLPArena collatearena;        /*!< Memory for the current collation. */
+   SLPHashTable collated;        /*!< The set of collated results. */
 
 #ifdef ENABLE_SLPv2_SECURITY
    SLPSpiHandle hspi;            /*!< The Security Parameter Index value. */
@@ -215,6 +209,7 @@ typedef struct _SLPHandleInfo
 } SLPHandleInfo; 
 
 sockfd_t NetworkConnectToSlpd(void * peeraddr);
+SLPError NetworkCheckConnection(sockfd_t fd);
 void NetworkDisconnectDA(SLPHandleInfo * handle);
 void NetworkDisconnectSA(SLPHandleInfo * handle);
 sockfd_t NetworkConnectToDA(SLPHandleInfo * handle, const char * scopelist,
@@ -230,6 +225,14 @@ SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
       size_t bufsize, NetworkRplyCallback callback, void * cookie, 
       int isV1); 
 
+SLPError NetworkDARqstRply(SLPHandleInfo * handle, void * buf,
+      char buftype, size_t bufsize, NetworkRplyCallback callback,
+      void * cookie, int isV1);
+
+SLPError NetworkPipelineRqstRply(sockfd_t sock, void * peeraddr,
+      const char * langtag, char buftype, size_t count, void ** bufs, 
+      size_t * bufsizes, NetworkRplyCallback callback, void ** cookies);
+
 SLPError NetworkMcastRqstRply(SLPHandleInfo * handle,
       void * buf, char buftype, size_t bufsize, 
       NetworkRplyCallback callback, void * cookie, int isV1);
@@ -249,10 +252,19 @@ SLPError NetworkMultiUcastRqstRply(
                          int isV1);
 #endif
 
+int ConnPoolInit(void);
+sockfd_t ConnPoolGet(const void * peeraddr, int socktype);
+void ConnPoolRelease(sockfd_t sock, const void * peeraddr);
+void ConnPoolFreeAll(void);
+
 sockfd_t KnownDAConnect(SLPHandleInfo * handle, size_t scopelistlen, 
       const char * scopelist, void * peeraddr);
 
 void KnownDABadDA(void * daaddr);
+void KnownDAObserve(const void * daaddr, int rtt);
+SLPBoolean KnownDAHedgeFind(SLPHandleInfo * handle, size_t scopelistlen,
+      const char * scopelist, const void * daaddr, void * hedgeaddr,
+      int * wait);
 int KnownDAGetScopes(size_t * scopelistlen, char ** scopelist, 
       SLPHandleInfo * handle);
 void KnownDAProcessSrvRqst(SLPHandleInfo * handle);
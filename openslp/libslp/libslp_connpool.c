@@ -0,0 +1,244 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Process-wide pool of connections to DAs and the local slpd.
+ *
+ * Sockets to DAs and to slpd are leased from this pool by SLP handles 
+ * and returned to it when the handle no longer needs them, so that 
+ * handles opened one after another reuse connections instead of each 
+ * creating (and for streams, handshaking) their own. Idle sockets are 
+ * keyed by peer address and socket type, health-checked before reuse, 
+ * and closed once they have been idle for longer than 
+ * net.slp.connectionPoolIdleTimeout seconds.
+ *
+ * @file       libslp_connpool.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    LibSLPCode
+ */
+
+#include "slp.h"
+#include "libslp.h"
+#include "slp_net.h"
+#include "slp_property.h"
+#include "slp_xmalloc.h"
+
+/** An idle pooled connection. */
+typedef struct _ConnPoolEntry
+{
+   SLPListItem listitem;         /*!< Makes this an SLPList item. */
+   sockfd_t sock;                /*!< The idle socket. */
+   int socktype;                 /*!< SOCK_STREAM, SOCK_SEQPACKET or SOCK_DGRAM. */
+   struct sockaddr_storage addr; /*!< The peer address of @e sock. */
+   time_t idlesince;             /*!< When @e sock was returned. */
+} ConnPoolEntry;
+
+static SLPMutexHandle s_ConnPoolLock = 0; /*!< Protects s_ConnPool. */
+static SLPList s_ConnPool = {0, 0, 0};    /*!< Idle sockets, oldest first. */
+
+/** Compare two peer addresses, including their ports.
+ *
+ * @param[in] addr1 - The first address.
+ * @param[in] addr2 - The second address.
+ *
+ * @return True if @p addr1 and @p addr2 name the same peer.
+ *
+ * @internal
+ */
+static bool ConnPoolSamePeer(const void * addr1, const void * addr2)
+{
+   const struct sockaddr * a1 = addr1;
+
+   if (SLPNetCompareAddrs(addr1, addr2) != 0)
+      return false;
+   if (a1->sa_family == AF_INET)
+      return ((const struct sockaddr_in *)addr1)->sin_port
+            == ((const struct sockaddr_in *)addr2)->sin_port;
+   if (a1->sa_family == AF_INET6)
+      return ((const struct sockaddr_in6 *)addr1)->sin6_port
+            == ((const struct sockaddr_in6 *)addr2)->sin6_port;
+   return true;
+}
+
+/** Close and free a pool entry.
+ *
+ * @param[in] entry - The entry to free. It must not be in the pool.
+ *
+ * @internal
+ */
+static void ConnPoolEntryFree(ConnPoolEntry * entry)
+{
+   closesocket(entry->sock);
+   xfree(entry);
+}
+
+/** Close idle sockets that have exceeded the idle timeout.
+ *
+ * @param[in] now - The current time.
+ *
+ * @note The pool lock must be held.
+ *
+ * @internal
+ */
+static void ConnPoolReap(time_t now)
+{
+   int idletimeout = SLPPropertyAsInteger("net.slp.connectionPoolIdleTimeout");
+
+   /* The pool is ordered oldest first, so stop at the first fresh entry. */
+   while (s_ConnPool.head)
+   {
+      ConnPoolEntry * entry = (ConnPoolEntry *)s_ConnPool.head;
+      if (now - entry->idlesince < idletimeout)
+         break;
+      ConnPoolEntryFree((ConnPoolEntry *)SLPListUnlink(&s_ConnPool, 
+            &entry->listitem));
+   }
+}
+
+/** Initialize the connection pool.
+ *
+ * @return Zero on success, or a non-zero value if resources could not
+ *    be allocated.
+ */
+int ConnPoolInit(void)
+{
+   s_ConnPoolLock = SLPMutexCreate();
+   return s_ConnPoolLock? 0: -1;
+}
+
+/** Lease an idle connection to a peer from the pool.
+ *
+ * The most recently used idle socket of the requested type connected to
+ * @p peeraddr is removed from the pool and returned. Connected sockets that
+ * the peer has closed, or on which unsolicited data is waiting, are 
+ * discarded rather than returned.
+ *
+ * @param[in] peeraddr - The address of the peer.
+ * @param[in] socktype - The socket type: SOCK_STREAM, SOCK_SEQPACKET
+ *    or SOCK_DGRAM.
+ *
+ * @return A socket connected to @p peeraddr, or SLP_INVALID_SOCKET if
+ *    there is no healthy idle socket for the peer in the pool.
+ */
+sockfd_t ConnPoolGet(const void * peeraddr, int socktype)
+{
+   SLPListItem * item;
+   sockfd_t sock = SLP_INVALID_SOCKET;
+
+   if (s_ConnPoolLock == 0)
+      return SLP_INVALID_SOCKET;
+
+   SLPMutexAcquire(s_ConnPoolLock);
+   ConnPoolReap(time(0));
+   item = s_ConnPool.tail;
+   while (item)
+   {
+      ConnPoolEntry * entry = (ConnPoolEntry *)item;
+      item = item->previous;
+      if (entry->socktype == socktype 
+            && ConnPoolSamePeer(&entry->addr, peeraddr))
+      {
+         SLPListUnlink(&s_ConnPool, &entry->listitem);
+         if (socktype != SOCK_DGRAM 
+               && NetworkCheckConnection(entry->sock) != SLP_OK)
+         {
+            ConnPoolEntryFree(entry);
+            continue;
+         }
+         sock = entry->sock;
+         xfree(entry);
+         break;
+      }
+   }
+   SLPMutexRelease(s_ConnPoolLock);
+   return sock;
+}
+
+/** Return a leased connection to the pool.
+ *
+ * The socket becomes available to other handles for reuse. If the pool
+ * already holds net.slp.connectionPoolSize idle sockets, the one idle 
+ * longest is closed to make room.
+ *
+ * @param[in] sock - The socket to return. The caller must not use it 
+ *    again. Only sockets on which the last request completed normally
+ *    should be returned; others should be closed.
+ * @param[in] peeraddr - The address of the peer @p sock is connected to.
+ */
+void ConnPoolRelease(sockfd_t sock, const void * peeraddr)
+{
+   int socktype = 0;
+   socklen_t stypesz = sizeof(socktype);
+   int poolsize = SLPPropertyAsInteger("net.slp.connectionPoolSize");
+   ConnPoolEntry * entry;
+
+   if (sock == SLP_INVALID_SOCKET)
+      return;
+
+   if (s_ConnPoolLock == 0 || poolsize <= 0
+         || getsockopt(sock, SOL_SOCKET, SO_TYPE, 
+               (char *)&socktype, &stypesz) != 0
+         || (entry = xmalloc(sizeof(ConnPoolEntry))) == 0)
+   {
+      closesocket(sock);
+      return;
+   }
+   entry->sock = sock;
+   entry->socktype = socktype;
+   memcpy(&entry->addr, peeraddr, sizeof(entry->addr));
+   entry->idlesince = time(0);
+
+   SLPMutexAcquire(s_ConnPoolLock);
+   ConnPoolReap(entry->idlesince);
+   while (s_ConnPool.count >= poolsize)
+      ConnPoolEntryFree((ConnPoolEntry *)SLPListUnlink(&s_ConnPool, 
+            s_ConnPool.head));
+   SLPListLinkTail(&s_ConnPool, &entry->listitem);
+   SLPMutexRelease(s_ConnPoolLock);
+}
+
+/** Close all pooled connections and release pool resources.
+ */
+void ConnPoolFreeAll(void)
+{
+   if (s_ConnPoolLock == 0)
+      return;
+
+   SLPMutexAcquire(s_ConnPoolLock);
+   while (s_ConnPool.head)
+      ConnPoolEntryFree((ConnPoolEntry *)SLPListUnlink(&s_ConnPool, 
+            s_ConnPool.head));
+   SLPMutexRelease(s_ConnPoolLock);
+   SLPMutexDestroy(s_ConnPoolLock);
+   s_ConnPoolLock = 0;
+}
+
+/*=========================================================================*/
@@ -250,9 +250,8 @@ static SLPError ProcessAttrRqst(SLPHandleInfo * handle)
          break;
       }
 
-      serr = NetworkRqstRply(sock, &peeraddr, handle->langtag, 0, buf, 
-            SLP_FUNCT_ATTRRQST, curpos - buf, ProcessAttrRplyCallback, 
-            handle, isV1);
+      serr = NetworkDARqstRply(handle, buf, SLP_FUNCT_ATTRRQST, 
+            curpos - buf, ProcessAttrRplyCallback, handle, isV1);
       if (serr)
          NetworkDisconnectDA(handle);
 
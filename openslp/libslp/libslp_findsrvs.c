@@ -46,6 +46,7 @@
 #include "slp_property.h"
 #include "slp_xmalloc.h"
 #include "slp_message.h"
+#include "slp_compare.h"
 
 /** Collates response data to user callback for SLPFindSrv requests.
  *
@@ -67,8 +68,8 @@ static SLPBoolean CollateToSLPSrvURLCallback(SLPHandle hSLP,
       SLPError errorcode)
 {
    int maxResults;
+   bool isnew;
    SLPHandleInfo * handle = hSLP;
-   SLPSrvUrlCollatedItem * collateditem;
 
 #ifdef ENABLE_ASYNC_API
    /* Do not collate for async calls. */
@@ -82,6 +83,10 @@ static SLPBoolean CollateToSLPSrvURLCallback(SLPHandle hSLP,
    if (maxResults == -1)
       maxResults = INT_MAX;
 
+   /* A cancelled stream stops on any reply, even one with no new URL. */
+   if (handle->cancelled)
+      goto CLEANUP;
+
    if (errorcode == SLP_LAST_CALL || handle->callbackcount > maxResults)
    {
       /* We are done so call the caller's callback for each
@@ -97,48 +102,32 @@ static SLPBoolean CollateToSLPSrvURLCallback(SLPHandle hSLP,
    /* We're adding another result - increment result count. */
    handle->callbackcount++;
 
-   /* Add the service URL to the colation list. */
-   collateditem = (SLPSrvUrlCollatedItem *)handle->collatedsrvurls.head;
-   while (collateditem)
+   /* Create the collation set with the first result. */
+   if (handle->collatearena == 0)
    {
-      if (strcmp(collateditem->srvurl, pcSrvURL) == 0)
-         break;
-      collateditem = (SLPSrvUrlCollatedItem *)collateditem->listitem.next;
+      handle->collatearena = SLPArenaCreate(0);
+      if (handle->collatearena == 0)
+         return SLP_TRUE;
+      SLPHashTableInit(&handle->collated, handle->collatearena);
    }
 
-   /* Create a new item if none was found. */
-   if (collateditem == 0)
+   /* Add the service URL to the collation set, and call the caller's 
+    * callback if it was not already there. 
+    */
+   if (SLPHashTableInsert(&handle->collated, pcSrvURL, 
+         strlen(pcSrvURL), &isnew) != 0 && isnew)
    {
-      collateditem = xmalloc(sizeof(SLPSrvUrlCollatedItem) 
-            + strlen(pcSrvURL) + 1);
-      if (collateditem)
-      {
-         memset(collateditem, 0, sizeof(SLPSrvUrlCollatedItem));
-         collateditem->srvurl = (char *)(collateditem + 1);
-         strcpy(collateditem->srvurl, pcSrvURL);
-         collateditem->lifetime = sLifetime;
-
-         /* Add the new item to the collated list. */
-         SLPListLinkTail(&handle->collatedsrvurls, 
-               (SLPListItem *)collateditem);
-
-         /* Call the caller's callback. */
-         if (handle->params.findsrvs.callback(handle, pcSrvURL, sLifetime, 
-               SLP_OK, handle->params.findsrvs.cookie) == SLP_FALSE)
-            goto CLEANUP;
-      }
+      if (handle->params.findsrvs.callback(handle, pcSrvURL, sLifetime, 
+            SLP_OK, handle->params.findsrvs.cookie) == SLP_FALSE)
+         goto CLEANUP;
    }
    return SLP_TRUE;
 
 CLEANUP:
 
-   /* Free the collation list. */
-   while (handle->collatedsrvurls.count)
-   {
-      collateditem = (SLPSrvUrlCollatedItem *)SLPListUnlink(
-            &handle->collatedsrvurls, handle->collatedsrvurls.head);
-      xfree(collateditem);
-   }   
+   /* Free the collation set. */
+   SLPArenaFree(handle->collatearena);
+   handle->collatearena = 0;
    handle->callbackcount = 0;
 
    return SLP_FALSE;
@@ -233,6 +222,67 @@ static SLPBoolean ProcessSrvRplyCallback(SLPError errorcode,
    return result;
 }
 
+/** Formats the body of a service request.
+ *
+ * @param[in] srvtype - The service type.
+ * @param[in] srvtypelen - The length of @p srvtype.
+ * @param[in] scopelist - The scope list.
+ * @param[in] scopelistlen - The length of @p scopelist.
+ * @param[in] predicate - The search filter.
+ * @param[in] predicatelen - The length of @p predicate.
+ * @param[in] spistr - The SLP SPI string, or NULL.
+ * @param[in] spistrlen - The length of @p spistr.
+ * @param[out] end - The address of storage for the end of the body.
+ *
+ * @return The newly allocated body (free with xfree), or NULL if memory
+ *    could not be allocated.
+ *
+ * @internal
+ */
+static uint8_t * BuildSrvRqst(const char * srvtype, size_t srvtypelen,
+      const char * scopelist, size_t scopelistlen, const char * predicate,
+      size_t predicatelen, const char * spistr, size_t spistrlen, 
+      uint8_t ** end)
+{
+   uint8_t * buf;
+   uint8_t * curpos;
+
+/*  0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |   length of <service-type>    |    <service-type> String      \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |    length of <scope-list>     |     <scope-list> String       \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |  length of predicate string   |  Service Request <predicate>  \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |  length of <SLP SPI> string   |       <SLP SPI> String        \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+   buf = curpos = xmalloc(
+         + 2 + srvtypelen
+         + 2 + scopelistlen
+         + 2 + predicatelen
+         + 2 + spistrlen);
+   if (buf == 0)
+      return 0;
+
+   /* <service-type> */
+   PutL16String(&curpos, srvtype, srvtypelen);
+
+   /* <scope-list> */
+   PutL16String(&curpos, scopelist, scopelistlen);
+
+   /* predicate string */
+   PutL16String(&curpos, predicate, predicatelen);
+
+   /* <SLP SPI> */
+   PutL16String(&curpos, spistr, spistrlen);
+
+   *end = curpos;
+   return buf;
+}
+
 /** Formats and sends an SLPFindSrvs wire buffer request.
  *
  * @param handle - The OpenSLP session handle, containing request 
@@ -267,44 +317,18 @@ static SLPError ProcessSrvRqst(SLPHandleInfo * handle)
             &spistrlen, &spistr);
 #endif
 
-/*  0                   1                   2                   3
-    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |   length of <service-type>    |    <service-type> String      \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |    length of <scope-list>     |     <scope-list> String       \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |  length of predicate string   |  Service Request <predicate>  \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-   |  length of <SLP SPI> string   |       <SLP SPI> String        \
-   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
-
-   buf = curpos = xmalloc(
-         + 2 + handle->params.findsrvs.srvtypelen
-         + 2 + handle->params.findsrvs.scopelistlen
-         + 2 + handle->params.findsrvs.predicatelen
-         + 2 + spistrlen);
+   buf = BuildSrvRqst(handle->params.findsrvs.srvtype, 
+         handle->params.findsrvs.srvtypelen, 
+         handle->params.findsrvs.scopelist, 
+         handle->params.findsrvs.scopelistlen, 
+         handle->params.findsrvs.predicate,
+         handle->params.findsrvs.predicatelen, spistr, spistrlen, &curpos);
    if (buf == 0)
    {
       xfree(spistr);
       return SLP_MEMORY_ALLOC_FAILED;
    }
 
-   /* <service-type> */
-   PutL16String(&curpos, handle->params.findsrvs.srvtype, 
-         handle->params.findsrvs.srvtypelen);
-
-   /* <scope-list> */
-   PutL16String(&curpos, handle->params.findsrvs.scopelist,
-         handle->params.findsrvs.scopelistlen);
-
-   /* predicate string */
-   PutL16String(&curpos, handle->params.findsrvs.predicate,
-         handle->params.findsrvs.predicatelen);
-
-   /* <SLP SPI> */
-   PutL16String(&curpos, (char *)spistr, spistrlen);
-
    /* Call the RqstRply engine. */
    do
    {
@@ -348,9 +372,8 @@ static SLPError ProcessSrvRqst(SLPHandleInfo * handle)
          break;
       }
 
-      serr = NetworkRqstRply(sock, &peeraddr, handle->langtag, 0, buf, 
-            SLP_FUNCT_SRVRQST, curpos - buf, ProcessSrvRplyCallback, 
-            handle, false);
+      serr = NetworkDARqstRply(handle, buf, SLP_FUNCT_SRVRQST, 
+            curpos - buf, ProcessSrvRplyCallback, handle, false);
       if (serr)
          NetworkDisconnectDA(handle);
 
@@ -495,4 +518,701 @@ SLPEXP SLPError SLPAPI SLPFindSrvs(
    return serr;
 }
 
+/** A queued streaming result.
+ */
+typedef struct _SLPStreamResult
+{
+   char * srvurl;                /*!< The service URL (owned by the queue). */
+   unsigned short lifetime;      /*!< The lifetime of @e srvurl. */
+} SLPStreamResult;
+
+/** Streaming service request state.
+ *
+ * Results produced on the request thread are handed to the application 
+ * thread through a fixed-size ring of SLPStreamResult entries. The 
+ * request thread waits on @e notfull when the ring is full; the 
+ * application thread waits on @e notempty when it is empty.
+ */
+typedef struct _SLPSrvURLStreamInfo
+{
+#define SLP_STREAM_SIG 0xfeedbeef
+   unsigned int sig;             /*!< A stream signature value. */
+   SLPHandleInfo * handle;       /*!< The handle running the request. */
+   SLPThreadHandle th;           /*!< The request thread. */
+   SLPMutexHandle lock;          /*!< Protects the fields below. */
+   SLPCondHandle notempty;       /*!< Signaled when a result is queued. */
+   SLPCondHandle notfull;        /*!< Signaled when a result is taken. */
+   SLPStreamResult * ring;       /*!< The result queue. */
+   int ringsize;                 /*!< The number of entries in @e ring. */
+   int head;                     /*!< The index of the oldest result. */
+   int count;                    /*!< The number of queued results. */
+   bool done;                    /*!< The request has completed. */
+   bool cancelled;               /*!< The application has cancelled. */
+   SLPError result;              /*!< The request's completion code. */
+} SLPSrvURLStreamInfo;
+
+/** Queues results from a streaming request for the application.
+ *
+ * @param[in] hSLP - The SLP handle object associated with the request.
+ * @param[in] pcSrvURL - The service URL for this pass.
+ * @param[in] sLifetime - The lifetime value for @p pcSrvURL.
+ * @param[in] errorcode - The error code received on this pass.
+ * @param[in] pvCookie - The stream associated with the request.
+ *
+ * @return SLP_TRUE to continue the request; SLP_FALSE once the stream 
+ *    has been cancelled.
+ *
+ * @internal
+ */
+static SLPBoolean SLPCALLBACK StreamSrvURLCallback(SLPHandle hSLP, 
+      const char * pcSrvURL, unsigned short sLifetime, 
+      SLPError errorcode, void * pvCookie)
+{
+   SLPSrvURLStreamInfo * stream = pvCookie;
+   SLPBoolean result;
+   char * srvurl;
+
+   (void)hSLP;
+
+   if (errorcode != SLP_OK || pcSrvURL == 0)
+      return stream->cancelled? SLP_FALSE: SLP_TRUE;
+
+   /* Copy the URL before taking the lock; it is handed to the caller. */
+   if ((srvurl = xstrdup(pcSrvURL)) == 0)
+      return SLP_TRUE;
+
+   SLPMutexAcquire(stream->lock);
+   while (stream->count == stream->ringsize && !stream->cancelled)
+      SLPCondWait(stream->notfull, stream->lock);
+   if (stream->cancelled)
+   {
+      xfree(srvurl);
+      result = SLP_FALSE;
+   }
+   else
+   {
+      SLPStreamResult * slot = &stream->ring[(stream->head + stream->count) 
+            % stream->ringsize];
+      slot->srvurl = srvurl;
+      slot->lifetime = sLifetime;
+      stream->count++;
+      SLPCondSignal(stream->notempty);
+      result = SLP_TRUE;
+   }
+   SLPMutexRelease(stream->lock);
+   return result;
+}
+
+/** Thread start procedure for streaming find services requests.
+ *
+ * @param[in,out] stream - The stream whose request is to be run.
+ *
+ * @return Zero (the result is stored in the stream).
+ *
+ * @internal
+ */
+static void * StreamProcessSrvRqst(SLPSrvURLStreamInfo * stream)
+{
+   SLPError serr = ProcessSrvRqst(stream->handle);
+
+   SLPMutexAcquire(stream->lock);
+   stream->result = serr;
+   stream->done = true;
+   SLPCondBroadcast(stream->notempty);
+   SLPMutexRelease(stream->lock);
+   return 0;
+}
+
+/** Free a stream and its resources.
+ *
+ * @param[in] stream - The stream to free. The request thread must not
+ *    be running.
+ *
+ * @internal
+ */
+static void StreamFree(SLPSrvURLStreamInfo * stream)
+{
+   SLPHandleInfo * handle = stream->handle;
+
+   while (stream->count)
+   {
+      xfree(stream->ring[stream->head].srvurl);
+      stream->head = (stream->head + 1) % stream->ringsize;
+      stream->count--;
+   }
+   xfree((void *)handle->params.findsrvs.srvtype);
+   xfree((void *)handle->params.findsrvs.scopelist);
+   xfree((void *)handle->params.findsrvs.predicate);
+   if (stream->notfull)
+      SLPCondDestroy(stream->notfull);
+   if (stream->notempty)
+      SLPCondDestroy(stream->notempty);
+   if (stream->lock)
+      SLPMutexDestroy(stream->lock);
+   xfree(stream->ring);
+   stream->sig = 0;
+   xfree(stream);
+
+   /* the cancel applied to this stream only, not to later requests */
+   handle->cancelled = 0;
+   SLPSpinLockRelease(&handle->inUse);
+}
+
+/** Start a service request whose results are read as a stream.
+ *
+ * Issues the same query as SLPFindSrvs, but on a separate thread. Rather
+ * than being passed to a callback, results are queued as they arrive, 
+ * and the caller retrieves them at its own pace with SLPFindSrvsNext. At
+ * most net.slp.streamQueueLength results are held; while the queue is 
+ * full the request waits for the caller. 
+ *
+ * @param[in] hSLP - The language specific SLPHandle on which to search 
+ *    for services. The handle is in use until SLPFindSrvsCancel is
+ *    called on the returned stream.
+ * @param[in] pcServiceType - The Service Type String, as for SLPFindSrvs.
+ * @param[in] pcScopeList - The scope list, as for SLPFindSrvs.
+ * @param[in] pcSearchFilter - The LDAPv3 search filter, as for 
+ *    SLPFindSrvs.
+ * @param[out] phStream - The address of storage for the new stream.
+ *
+ * @return If an error occurs in starting the operation, one of the 
+ *    SLPError codes is returned, and no stream is created.
+ *
+ * @remarks Every stream returned must eventually be released with
+ *    SLPFindSrvsCancel, whether or not all results have been read.
+ */
+SLPEXP SLPError SLPAPI SLPFindSrvsStart(
+      SLPHandle hSLP,
+      const char * pcServiceType,
+      const char * pcScopeList,
+      const char * pcSearchFilter,
+      SLPSrvURLStream * phStream)
+{
+   bool inuse;
+   SLPHandleInfo * handle = hSLP;
+   SLPSrvURLStreamInfo * stream;
+
+   /* Check for invalid parameters. */
+   SLP_ASSERT(handle != 0);
+   SLP_ASSERT(handle->sig == SLP_HANDLE_SIG);
+   SLP_ASSERT(pcServiceType != 0);
+   SLP_ASSERT(*pcServiceType != 0);
+   SLP_ASSERT(phStream != 0);
+
+   if (handle == 0 || handle->sig != SLP_HANDLE_SIG 
+         || pcServiceType == 0 || *pcServiceType == 0 
+         || phStream == 0)
+      return SLP_PARAMETER_BAD;
+
+   *phStream = 0;
+
+   /* Check to see if the handle is in use. */
+   inuse = SLPSpinLockTryAcquire(&handle->inUse);
+   SLP_ASSERT(!inuse);
+   if (inuse)
+      return SLP_HANDLE_IN_USE;
+
+   /* Get a scope list if not supplied. */
+   if (pcScopeList == 0 || *pcScopeList == 0)
+      pcScopeList = SLPPropertyGet("net.slp.useScopes", 0, 0);
+
+   /* Ensure there's a scope list of some sort... */
+   if (pcScopeList == 0)
+      pcScopeList = "";
+
+   /* Get a search filter if not supplied */
+   if (pcSearchFilter == 0)
+      pcSearchFilter = "";
+
+   /* Set the handle up with copies of the parameters, since the request
+    * outlives this call.
+    */
+   handle->params.findsrvs.srvtypelen = strlen(pcServiceType);
+   handle->params.findsrvs.srvtype = xstrdup(pcServiceType);
+   handle->params.findsrvs.scopelistlen = strlen(pcScopeList);
+   handle->params.findsrvs.scopelist = xstrdup(pcScopeList);
+   handle->params.findsrvs.predicatelen = strlen(pcSearchFilter);
+   handle->params.findsrvs.predicate = xstrdup(pcSearchFilter);
+   handle->params.findsrvs.callback = StreamSrvURLCallback;
+   handle->cancelled = 0;
+
+   stream = xcalloc(1, sizeof(SLPSrvURLStreamInfo));
+   if (stream == 0)
+   {
+      xfree((void *)handle->params.findsrvs.srvtype);
+      xfree((void *)handle->params.findsrvs.scopelist);
+      xfree((void *)handle->params.findsrvs.predicate);
+      SLPSpinLockRelease(&handle->inUse);
+      return SLP_MEMORY_ALLOC_FAILED;
+   }
+   stream->sig = SLP_STREAM_SIG;
+   stream->handle = handle;
+   stream->ringsize = SLPPropertyAsInteger("net.slp.streamQueueLength");
+   if (stream->ringsize < 1)
+      stream->ringsize = 1;
+   handle->params.findsrvs.cookie = stream;
+
+   /* Ensure all allocations and thread creation succeed. */
+   if (handle->params.findsrvs.srvtype == 0
+         || handle->params.findsrvs.scopelist == 0
+         || handle->params.findsrvs.predicate == 0
+         || (stream->ring = xmalloc(stream->ringsize 
+               * sizeof(SLPStreamResult))) == 0
+         || (stream->lock = SLPMutexCreate()) == 0
+         || (stream->notempty = SLPCondCreate()) == 0
+         || (stream->notfull = SLPCondCreate()) == 0
+         || (stream->th = SLPThreadCreate((SLPThreadStartProc)
+               StreamProcessSrvRqst, stream)) == 0)
+   {
+      StreamFree(stream);
+      return SLP_MEMORY_ALLOC_FAILED;
+   }
+
+   *phStream = stream;
+   return SLP_OK;
+}
+
+/** Retrieve the next result from a service request stream.
+ *
+ * Waits until a service URL is available or the request completes. 
+ * Results are collated exactly as for SLPFindSrvs on a synchronous 
+ * handle, so each service URL is returned once.
+ *
+ * @param[in] hStream - The stream returned by SLPFindSrvsStart.
+ * @param[out] ppcSrvURL - The address of storage for the next service
+ *    URL. The caller must free the URL with SLPFree.
+ * @param[out] psLifetime - The address of storage for the lifetime of 
+ *    the returned URL; may be NULL.
+ *
+ * @return SLP_OK if a URL was returned in @p ppcSrvURL; SLP_LAST_CALL if 
+ *    the request has completed and all results have been read; or the 
+ *    SLPError code with which the request failed.
+ */
+SLPEXP SLPError SLPAPI SLPFindSrvsNext(
+      SLPSrvURLStream hStream,
+      char ** ppcSrvURL,
+      unsigned short * psLifetime)
+{
+   SLPError serr;
+   SLPSrvURLStreamInfo * stream = hStream;
+
+   /* Check for invalid parameters. */
+   SLP_ASSERT(stream != 0);
+   SLP_ASSERT(stream->sig == SLP_STREAM_SIG);
+   SLP_ASSERT(ppcSrvURL != 0);
+
+   if (stream == 0 || stream->sig != SLP_STREAM_SIG || ppcSrvURL == 0)
+      return SLP_PARAMETER_BAD;
+
+   *ppcSrvURL = 0;
+
+   SLPMutexAcquire(stream->lock);
+   while (stream->count == 0 && !stream->done)
+      SLPCondWait(stream->notempty, stream->lock);
+   if (stream->count)
+   {
+      SLPStreamResult * slot = &stream->ring[stream->head];
+      *ppcSrvURL = slot->srvurl;
+      if (psLifetime)
+         *psLifetime = slot->lifetime;
+      stream->head = (stream->head + 1) % stream->ringsize;
+      stream->count--;
+      SLPCondSignal(stream->notfull);
+      serr = SLP_OK;
+   }
+   else
+      serr = stream->result != SLP_OK? stream->result: SLP_LAST_CALL;
+   SLPMutexRelease(stream->lock);
+
+   return serr;
+}
+
+/** Cancel a service request stream and release its resources.
+ *
+ * Stops the request if it is still running, discards any unread 
+ * results, and releases the SLPHandle on which the stream was started.
+ *
+ * @param[in] hStream - The stream returned by SLPFindSrvsStart.
+ *
+ * @remarks The request stops at the next reply it receives, whether or
+ *    not that reply holds a new result. While no reply arrives it cannot
+ *    stop until its current wait for replies ends, so this call may block
+ *    for one retransmission timeout (net.slp.unicastTimeouts or 
+ *    net.slp.multicastTimeouts), or for net.slp.unicastMaximumWait when
+ *    the request went to a DA over TCP.
+ */
+SLPEXP void SLPAPI SLPFindSrvsCancel(SLPSrvURLStream hStream)
+{
+   SLPSrvURLStreamInfo * stream = hStream;
+
+   /* Check for invalid parameters. */
+   SLP_ASSERT(stream != 0);
+   SLP_ASSERT(stream->sig == SLP_STREAM_SIG);
+
+   if (stream == 0 || stream->sig != SLP_STREAM_SIG)
+      return;
+
+   SLPAtomicXchg(&stream->handle->cancelled, 1);
+   SLPMutexAcquire(stream->lock);
+   stream->cancelled = true;
+   SLPCondBroadcast(stream->notfull);
+   SLPMutexRelease(stream->lock);
+
+   SLPThreadWait(stream->th);
+   StreamFree(stream);
+}
+
+/** Per-query state for a batch of service requests.
+ */
+typedef struct _SLPSrvBatchQuery
+{
+   struct _SLPSrvBatch * batch;  /*!< The batch this query belongs to. */
+   unsigned int index;           /*!< The index of this query in the batch. */
+   const char * srvtype;         /*!< The service type. */
+   size_t srvtypelen;            /*!< The length of @e srvtype. */
+   const char * scopelist;       /*!< The scope list. */
+   size_t scopelistlen;          /*!< The length of @e scopelist. */
+   const char * predicate;       /*!< The search filter. */
+   size_t predicatelen;          /*!< The length of @e predicate. */
+   uint8_t * buf;                /*!< The formatted request body. */
+   size_t bufsize;               /*!< The size of @e buf. */
+   bool sent;                    /*!< Already pipelined to a DA. */
+   bool answered;                /*!< A DA has replied to this query. */
+   bool stopped;                 /*!< The caller wants no more results. */
+} SLPSrvBatchQuery;
+
+/** State for a batch of service requests.
+ */
+typedef struct _SLPSrvBatch
+{
+   SLPHandleInfo * handle;          /*!< The handle running the batch. */
+   SLPSrvURLBatchCallback * callback;  /*!< The caller's callback. */
+   void * cookie;                   /*!< The caller's callback cookie. */
+   SLPSrvBatchQuery * queries;      /*!< The queries in the batch. */
+   unsigned int count;              /*!< The number of @e queries. */
+} SLPSrvBatch;
+
+/** Reports a result for one query of a batch to the caller.
+ *
+ * @param[in] query - The query to which the result belongs.
+ * @param[in] pcSrvURL - The service URL, or NULL.
+ * @param[in] sLifetime - The lifetime of @p pcSrvURL.
+ * @param[in] errorcode - The error code for this result.
+ *
+ * @return SLP_FALSE if the caller wants no more results for @p query.
+ *
+ * @internal
+ */
+static SLPBoolean BatchReport(SLPSrvBatchQuery * query, 
+      const char * pcSrvURL, unsigned short sLifetime, SLPError errorcode)
+{
+   SLPSrvBatch * batch = query->batch;
+
+   if (!query->stopped && batch->callback(batch->handle, query->index, 
+         pcSrvURL, sLifetime, errorcode, batch->cookie) == SLP_FALSE)
+      query->stopped = true;
+   return query->stopped? SLP_FALSE: SLP_TRUE;
+}
+
+/** Forwards collated results of a single batch query to the caller.
+ *
+ * Used for queries that could not be pipelined to a DA, and are thus run
+ * through ProcessSrvRqst one at a time. SLP_LAST_CALL is withheld here; 
+ * SLPFindSrvsBatch reports it once the query is complete.
+ *
+ * @param[in] hSLP - The SLP handle object associated with the request.
+ * @param[in] pcSrvURL - The service URL for this pass.
+ * @param[in] sLifetime - The lifetime value for @p pcSrvURL.
+ * @param[in] errorcode - The error code received on this pass.
+ * @param[in] pvCookie - The SLPSrvBatchQuery being run.
+ *
+ * @return SLP_TRUE to continue the request, or SLP_FALSE to stop it.
+ *
+ * @internal
+ */
+static SLPBoolean SLPCALLBACK BatchSrvURLCallback(SLPHandle hSLP, 
+      const char * pcSrvURL, unsigned short sLifetime, 
+      SLPError errorcode, void * pvCookie)
+{
+   (void)hSLP;
+
+   if (errorcode == SLP_LAST_CALL)
+      return SLP_FALSE;
+   return BatchReport(pvCookie, pcSrvURL, sLifetime, errorcode);
+}
+
+/** Reports a pipelined DA reply for one query of a batch.
+ *
+ * @param[in] errorcode - The network operation error code.
+ * @param[in] peeraddr - The network address of the responder.
+ * @param[in] replybuf - The response buffer from the network request.
+ * @param[in] cookie - The SLPSrvBatchQuery answered by @p replybuf.
+ *
+ * @return SLP_TRUE (replies for other queries may follow).
+ *
+ * @internal
+ */
+static SLPBoolean BatchSrvRplyCallback(SLPError errorcode, 
+      void * peeraddr, SLPBuffer replybuf, void * cookie)
+{
+   SLPMessage * replymsg;
+   SLPSrvBatchQuery * query = cookie;
+
+   if (errorcode != SLP_OK)
+      return SLP_TRUE;
+
+   replymsg = SLPMessageAlloc();
+   if (replymsg)
+   {
+      if (!SLPMessageParseBuffer(peeraddr, 0, replybuf, replymsg)
+            && replymsg->header.functionid == SLP_FUNCT_SRVRPLY)
+      {
+         int i;
+         SLPUrlEntry * urlentry = replymsg->body.srvrply.urlarray;
+
+         /* The DA has answered, even if it found nothing or failed. */
+         query->answered = true;
+
+         for (i = 0; replymsg->body.srvrply.errorcode == 0
+               && i < replymsg->body.srvrply.urlcount; i++)
+         {
+#ifdef ENABLE_SLPv2_SECURITY
+            /* Validate the service authblocks. */
+            if (SLPPropertyAsBoolean("net.slp.securityEnabled") 
+                  && SLPAuthVerifyUrl(query->batch->handle->hspi, 1, 
+                        &urlentry[i]))
+               continue; /* Authentication failed, skip this URLEntry. */
+#endif
+            if (BatchReport(query, urlentry[i].url, 
+                  (unsigned short)urlentry[i].lifetime, SLP_OK) == SLP_FALSE)
+               break;
+         }
+      }
+      SLPMessageFree(replymsg);
+   }
+   return SLP_TRUE;
+}
+
+/** Sends as many batch queries as possible to DAs, pipelined per DA.
+ *
+ * Connects to a DA supporting the scopes of the first query not yet 
+ * sent, then sends that query and every other unsent query whose scopes 
+ * the same DA supports, back to back on the one DA socket. This repeats 
+ * until every query has been tried. Queries for which no DA could be 
+ * found, or which the DA did not answer, are left unanswered.
+ *
+ * @param[in] batch - The batch whose queries are to be sent.
+ *
+ * @internal
+ */
+static void BatchPipelineToDAs(SLPSrvBatch * batch)
+{
+   SLPHandleInfo * handle = batch->handle;
+   struct sockaddr_storage peeraddr;
+   void ** bufs;
+   size_t * bufsizes;
+   void ** cookies;
+   unsigned int i, j;
+
+   bufs = xmalloc(batch->count * (sizeof(void *) * 2 + sizeof(size_t)));
+   if (bufs == 0)
+      return;
+   cookies = bufs + batch->count;
+   bufsizes = (size_t *)(cookies + batch->count);
+
+   for (i = 0; i < batch->count; i++)
+   {
+      SLPSrvBatchQuery * first = &batch->queries[i];
+      size_t n = 0;
+      sockfd_t sock;
+
+      if (first->sent)
+         continue;
+      first->sent = true;
+
+      sock = NetworkConnectToDA(handle, first->scopelist, 
+            first->scopelistlen, &peeraddr);
+      if (sock == SLP_INVALID_SOCKET)
+         continue;
+
+      /* Gather every unsent query this DA can answer. */
+      for (j = i; j < batch->count; j++)
+      {
+         SLPSrvBatchQuery * query = &batch->queries[j];
+         if (j != i && (query->sent || SLPSubsetStringList(handle->dascopelen,
+               handle->dascope, query->scopelistlen, query->scopelist) == 0))
+            continue;
+         query->sent = true;
+         bufs[n] = query->buf;
+         bufsizes[n] = query->bufsize;
+         cookies[n++] = query;
+      }
+
+      if (NetworkPipelineRqstRply(sock, &peeraddr, handle->langtag, 
+            SLP_FUNCT_SRVRQST, n, bufs, bufsizes, BatchSrvRplyCallback, 
+            cookies) != SLP_OK)
+         NetworkDisconnectDA(handle);
+   }
+   xfree(bufs);
+}
+
+/** Return the services matching each of a batch of queries.
+ *
+ * Issues every query in @p pQueries, reporting results through 
+ * @p callback along with the index of the query they belong to. Queries
+ * that can be answered by the same DA are sent to it together before any
+ * reply is awaited, so the batch costs about one round trip per DA rather than
+ * one per query. Queries that no DA can answer are then issued one at a
+ * time, exactly as SLPFindSrvs would issue them.
+ *
+ * @param[in] hSLP - The language specific SLPHandle on which to search 
+ *    for services.
+ * @param[in] pQueries - An array of queries. See SLPFindSrvs for the 
+ *    meaning of each field.
+ * @param[in] uiCount - The number of queries in @p pQueries.
+ * @param[in] callback - A callback function through which the results of 
+ *    each query are reported.
+ * @param[in] pvCookie - Memory passed to the @p callback code from the 
+ *    client. May be NULL.
+ *
+ * @return If an error occurs in starting the operation, one of the 
+ *    SLPError codes is returned.
+ *
+ * @remarks The batch always completes before this call returns, even on
+ *    an asynchronous handle.
+ */
+SLPEXP SLPError SLPAPI SLPFindSrvsBatch(
+      SLPHandle hSLP,
+      const SLPSrvQuery * pQueries,
+      unsigned int uiCount,
+      SLPSrvURLBatchCallback callback,
+      void * pvCookie)
+{
+   bool inuse;
+   unsigned int i;
+   size_t spistrlen = 0;
+   char * spistr = 0;
+   const char * defscopes;
+   SLPError serr = SLP_OK;
+   SLPSrvBatch batch;
+   SLPHandleInfo * handle = hSLP;
+
+   /* Check for invalid parameters. */
+   SLP_ASSERT(handle != 0);
+   SLP_ASSERT(handle->sig == SLP_HANDLE_SIG);
+   SLP_ASSERT(pQueries != 0 || uiCount == 0);
+   SLP_ASSERT(callback != 0);
+
+   if (handle == 0 || handle->sig != SLP_HANDLE_SIG 
+         || (pQueries == 0 && uiCount != 0) || callback == 0)
+      return SLP_PARAMETER_BAD;
+
+   for (i = 0; i < uiCount; i++)
+      if (pQueries[i].s_pcSrvType == 0 || *pQueries[i].s_pcSrvType == 0)
+         return SLP_PARAMETER_BAD;
+
+   /* Check to see if the handle is in use. */
+   inuse = SLPSpinLockTryAcquire(&handle->inUse);
+   SLP_ASSERT(!inuse);
+   if (inuse)
+      return SLP_HANDLE_IN_USE;
+
+   batch.handle = handle;
+   batch.callback = callback;
+   batch.cookie = pvCookie;
+   batch.count = uiCount;
+   batch.queries = xcalloc(uiCount? uiCount: 1, sizeof(SLPSrvBatchQuery));
+   if (batch.queries == 0)
+   {
+      SLPSpinLockRelease(&handle->inUse);
+      return SLP_MEMORY_ALLOC_FAILED;
+   }
+
+#ifdef ENABLE_SLPv2_SECURITY
+   if (SLPPropertyAsBoolean("net.slp.securityEnabled"))
+      SLPSpiGetDefaultSPI(handle->hspi, SLPSPI_KEY_TYPE_PUBLIC, 
+            &spistrlen, &spistr);
+#endif
+
+   /* Get a scope list for queries that don't supply one. */
+   defscopes = SLPPropertyGet("net.slp.useScopes", 0, 0);
+   if (defscopes == 0)
+      defscopes = "";
+
+   /* Format every request up front. */
+   for (i = 0; i < uiCount; i++)
+   {
+      SLPSrvBatchQuery * query = &batch.queries[i];
+      uint8_t * end;
+
+      query->batch = &batch;
+      query->index = i;
+      query->srvtype = pQueries[i].s_pcSrvType;
+      query->srvtypelen = strlen(query->srvtype);
+      query->scopelist = pQueries[i].s_pcScopeList;
+      if (query->scopelist == 0 || *query->scopelist == 0)
+         query->scopelist = defscopes;
+      query->scopelistlen = strlen(query->scopelist);
+      query->predicate = pQueries[i].s_pcSearchFilter;
+      if (query->predicate == 0)
+         query->predicate = "";
+      query->predicatelen = strlen(query->predicate);
+
+      /* DA and SA discovery requests are never sent to a single DA. */
+      if (strncasecmp(query->srvtype, SLP_DA_SERVICE_TYPE, 
+               query->srvtypelen) == 0
+            || strncasecmp(query->srvtype, SLP_SA_SERVICE_TYPE, 
+               query->srvtypelen) == 0)
+      {
+         query->sent = true;
+         continue;
+      }
+
+      query->buf = BuildSrvRqst(query->srvtype, query->srvtypelen,
+            query->scopelist, query->scopelistlen, query->predicate, 
+            query->predicatelen, spistr, spistrlen, &end);
+      if (query->buf == 0)
+      {
+         serr = SLP_MEMORY_ALLOC_FAILED;
+         goto CLEANUP;
+      }
+      query->bufsize = end - query->buf;
+   }
+
+#ifndef UNICAST_NOT_SUPPORTED
+   if (handle->dounicast != 1)
+#endif
+      BatchPipelineToDAs(&batch);
+
+   for (i = 0; i < uiCount; i++)
+   {
+      SLPSrvBatchQuery * query = &batch.queries[i];
+
+      /* Fall back to the usual request path for unanswered queries. */
+      if (!query->answered && !query->stopped)
+      {
+         handle->params.findsrvs.srvtypelen = query->srvtypelen;
+         handle->params.findsrvs.srvtype = query->srvtype;
+         handle->params.findsrvs.scopelistlen = query->scopelistlen;
+         handle->params.findsrvs.scopelist = query->scopelist;
+         handle->params.findsrvs.predicatelen = query->predicatelen;
+         handle->params.findsrvs.predicate = query->predicate;
+         handle->params.findsrvs.callback = BatchSrvURLCallback;
+         handle->params.findsrvs.cookie = query;
+         ProcessSrvRqst(handle);
+      }
+      BatchReport(query, 0, 0, SLP_LAST_CALL);
+   }
+
+CLEANUP:
+
+   for (i = 0; i < uiCount; i++)
+      xfree(batch.queries[i].buf);
+   xfree(batch.queries);
+   xfree(spistr);
+   SLPSpinLockRelease(&handle->inUse);
+
+   return serr;
+}
+
 /*=========================================================================*/
@@ -48,6 +48,107 @@
 #include "slp_compare.h"
 #include "slp_message.h"
 
+/** Adds a list of service types to the collation set.
+ *
+ * Each item of @p pcSrvTypes is keyed on its normalized form, so that
+ * service types differing only in case, escaping or white space are
+ * collated as one. The first spelling seen is the one reported.
+ *
+ * @param[in] handle - The SLP handle object associated with the request.
+ * @param[in] pcSrvTypes - A comma-separated list of service types.
+ *
+ * @internal
+ */
+static void CollateSrvTypes(SLPHandleInfo * handle, const char * pcSrvTypes)
+{
+   size_t srvtypeslen = strlen(pcSrvTypes);
+   const char * listend = pcSrvTypes + srvtypeslen;
+   const char * itembegin = pcSrvTypes;
+   const char * itemend = itembegin;
+   char * normbuf;
+
+   /* Create the collation set with the first reply. */
+   if (handle->collatearena == 0)
+   {
+      handle->collatearena = SLPArenaCreate(0);
+      if (handle->collatearena == 0)
+         return;
+      SLPHashTableInit(&handle->collated, handle->collatearena);
+   }
+
+   /* Normalized items are never longer than the original list. */
+   normbuf = SLPArenaAlloc(handle->collatearena, srvtypeslen + 1);
+   if (normbuf == 0)
+      return;
+
+   while (itemend < listend)
+   {
+      size_t normlen;
+      bool isnew;
+      SLPHashEntry * entry;
+
+      itembegin = itemend;
+
+      /* Seek to the end of the next list item, break on commas. */
+      while (itemend < listend && itemend[0] != ',')
+         itemend++;
+
+      normlen = SLPNormalizeString(itemend - itembegin, itembegin, 
+            normbuf, 1);
+      if (normlen != 0)
+      {
+         entry = SLPHashTableInsert(&handle->collated, normbuf, normlen, 
+               &isnew);
+         if (entry && isnew)
+            entry->value = SLPArenaStrDup(handle->collatearena, 
+                  itembegin, itemend - itembegin);
+      }
+      itemend++;
+   }
+}
+
+/** Builds the collated service type list.
+ *
+ * @param[in] handle - The SLP handle object associated with the request.
+ *
+ * @return The comma-separated list of collated service types, allocated
+ *    from the collation arena, or NULL if there are none.
+ *
+ * @internal
+ */
+static char * CollatedSrvTypes(SLPHandleInfo * handle)
+{
+   size_t srvtypeslen = 0;
+   SLPHashEntry * entry;
+   char * srvtypes;
+   char * curpos;
+
+   if (handle->collatearena == 0 || handle->collated.count == 0)
+      return 0;
+
+   for (entry = handle->collated.head; entry; entry = entry->next)
+      if (entry->value)
+         srvtypeslen += strlen(entry->value) + 1; /* +1 - comma */
+
+   srvtypes = curpos = SLPArenaAlloc(handle->collatearena, srvtypeslen + 1);
+   if (srvtypes == 0)
+      return 0;
+
+   for (entry = handle->collated.head; entry; entry = entry->next)
+   {
+      if (entry->value)
+      {
+         size_t len = strlen(entry->value);
+         if (curpos != srvtypes)
+            *curpos++ = ',';
+         memcpy(curpos, entry->value, len);
+         curpos += len;
+      }
+   }
+   *curpos = 0;
+   return curpos != srvtypes? srvtypes: 0;
+}
+
 /** Collates response data to user callback for SLPFindSrvType requests.
  *
  * @param[in] hSLP - The SLP handle object associated with the request.
@@ -67,7 +168,6 @@ static SLPBoolean CollateToSLPSrvTypeCallback(SLPHandle hSLP,
 {
    int maxResults;
    char * srvtypes;
-   size_t srvtypeslen;
    SLPHandleInfo * handle = hSLP;
 
    handle->callbackcount++;
@@ -87,59 +187,24 @@ static SLPBoolean CollateToSLPSrvTypeCallback(SLPHandle hSLP,
    if (errorcode == SLP_LAST_CALL || handle->callbackcount > maxResults)
    {
       /* We're done. Send back the collated srvtype string. */
-      if (handle->collatedsrvtypes)
-         if (handle->params.findsrvtypes.callback(handle, 
-               handle->collatedsrvtypes, SLP_OK, 
-               handle->params.findsrvtypes.cookie) == SLP_TRUE)
+      srvtypes = CollatedSrvTypes(handle);
+      if (srvtypes)
+         if (handle->params.findsrvtypes.callback(handle, srvtypes, 
+               SLP_OK, handle->params.findsrvtypes.cookie) == SLP_TRUE)
             handle->params.findsrvtypes.callback(handle, 0,
                   SLP_LAST_CALL, handle->params.findsrvtypes.cookie);
 
-      /* Free the collatedsrvtype string. */
-      if (handle->collatedsrvtypes)
-      {
-         xfree(handle->collatedsrvtypes);
-         handle->collatedsrvtypes = 0;
-      }
+      /* Free the collation set and the collated srvtype string. */
+      SLPArenaFree(handle->collatearena);
+      handle->collatearena = 0;
       handle->callbackcount = 0;
       return SLP_FALSE;
    }
    else if (errorcode != SLP_OK)
       return SLP_TRUE;
 
-   /* Add the service types to the colation. */
-   srvtypeslen = strlen(pcSrvTypes) + 1; /* +1 - terminator */
-   if (handle->collatedsrvtypes)
-      srvtypeslen += strlen(handle->collatedsrvtypes) + 1; /* +1 - comma */
-
-   srvtypes = xmalloc(srvtypeslen);
-   if (srvtypes)
-   {
-      if (handle->collatedsrvtypes)
-      {
-         if (SLPUnionStringList(strlen(handle->collatedsrvtypes), 
-               handle->collatedsrvtypes, strlen(pcSrvTypes), pcSrvTypes,
-               &srvtypeslen, srvtypes) != (int)srvtypeslen)
-         {
-            xfree(handle->collatedsrvtypes);
-            handle->collatedsrvtypes = srvtypes;
-         }
-         else
-         {
-#ifndef COLLATION_CHANGES
-            xfree(handle->collatedsrvtypes);
-            handle->collatedsrvtypes = srvtypes;
-            handle->collatedsrvtypes[srvtypeslen] = 0;
-#else
-            xfree(srvtypes);
-#endif
-         }   
-      }
-      else
-      {
-         strcpy(srvtypes, pcSrvTypes);
-         handle->collatedsrvtypes = srvtypes;
-      }
-   }
+   /* Add the service types to the collation. */
+   CollateSrvTypes(handle, pcSrvTypes);
    return SLP_TRUE;
 }
 
@@ -268,9 +333,8 @@ static SLPError ProcessSrvTypeRqst(SLPHandleInfo * handle)
                curpos - buf, ProcessSrvTypeRplyCallback, 0, false);
          break;
       }
-      serr = NetworkRqstRply(sock, &peeraddr, handle->langtag, 0, buf,
-            SLP_FUNCT_SRVTYPERQST, curpos - buf, ProcessSrvTypeRplyCallback,
-            handle, false);
+      serr = NetworkDARqstRply(handle, buf, SLP_FUNCT_SRVTYPERQST,
+            curpos - buf, ProcessSrvTypeRplyCallback, handle, false);
 
       if (serr)
          NetworkDisconnectDA(handle);
@@ -53,8 +53,8 @@ static intptr_t s_OpenSLPHandleCount = 0; /*!< Tracks OpenSLP handles. */
 
 /** Initialize the User Agent library.
  *
- * Initializes the network sub-system if required, the debug memory
- * allocator, and the transaction id (XID) sub-system.
+ * Initializes the network sub-system if required, the connection pool,
+ * the debug memory allocator, and the transaction id (XID) sub-system.
  *
  * @return An OpenSLP API error code.
  *
@@ -70,12 +70,19 @@ static SLPError InitUserAgentLibrary(void)
          SLPAtomicDec(&s_OpenSLPHandleCount);
          return SLP_MEMORY_ALLOC_FAILED;
       }
+      if (ConnPoolInit() != 0)
+      {
+         LIBSLPPropertyCleanup();
+         SLPAtomicDec(&s_OpenSLPHandleCount);
+         return SLP_MEMORY_ALLOC_FAILED;
+      }
 #ifdef _WIN32
       {
          WSADATA wsaData;
          WORD wVersionRequested = MAKEWORD(1,1);
          if (WSAStartup(wVersionRequested, &wsaData) != 0)
          {
+            ConnPoolFreeAll();
             LIBSLPPropertyCleanup();
             SLPAtomicDec(&s_OpenSLPHandleCount);
             return SLP_NETWORK_INIT_FAILED;
@@ -99,8 +106,8 @@ static SLPError InitUserAgentLibrary(void)
 
 /** Cleans up the User Agent library.
  *
- * Deinitializes the network sub-system if required, and the debug
- * memory allocator.
+ * Deinitializes the network sub-system if required, the connection
+ * pool, and the debug memory allocator.
  *
  * @internal
  */
@@ -108,6 +115,7 @@ static void ExitUserAgentLibrary(void)
 {
    if (SLPAtomicDec(&s_OpenSLPHandleCount) == 0)
    {
+      ConnPoolFreeAll();
       KnownDAFreeAll();
       LIBSLPPropertyCleanup();
 #ifdef DEBUG
@@ -266,19 +274,20 @@ SLPEXP void SLPAPI SLPClose(SLPHandle hSLP)
    if (handle->langtag)
       xfree(handle->langtag);
 
+   SLPArenaFree(handle->collatearena);
+
 #ifndef UNICAST_NOT_SUPPORTED
    xfree(handle->unicastscope);
    if (handle->unicastsock != SLP_INVALID_SOCKET)
       closesocket(handle->unicastsock);
 #endif
 
+   /* Return cached connections to the pool for other handles to use. */
    xfree(handle->sascope);
-   if (handle->sasock != SLP_INVALID_SOCKET)
-      closesocket(handle->sasock);
+   ConnPoolRelease(handle->sasock, &handle->saaddr);
 
    xfree(handle->dascope);
-   if (handle->dasock != SLP_INVALID_SOCKET)
-      closesocket(handle->dasock);
+   ConnPoolRelease(handle->dasock, &handle->daaddr);
 
    handle->sig = 0;
    xfree(handle);
@@ -46,8 +46,10 @@
 #include "slp_net.h"
 #include "slp_parse.h"
 #include "slp_network.h"
+#include "slp_pid.h"
 #include "slp_database.h"
 #include "slp_compare.h"
+#include "slp_dacache.h"
 #include "slp_xmalloc.h"
 #include "slp_property.h"
 
@@ -57,11 +59,571 @@ static SLPDatabase G_KnownDACache = {0, 0, 0};
 /** The time of the last Multicast for known DAs */
 static time_t G_KnownDALastCacheRefresh = 0;
 
+/** The DA cache slpd publishes, once mapped. */
+static SLPDACacheHeader * G_KnownDASharedCache = 0;
+
+/** How quickly and reliably a DA has been answering.
+ *
+ * The averages are kept the way TCP keeps them (RFC 6298): the smoothed
+ * round trip time moves 1/8 of the way towards each sample, its mean
+ * deviation 1/4 of the way, and the error rate 1/8 of the way.
+ */
+typedef struct _KnownDAStats
+{
+   int srtt;         /*!< Smoothed round trip time in 1/8 ms, or -1. */
+   int rttvar;       /*!< Mean deviation of the round trip time in 1/4 ms. */
+   int errors;       /*!< Smoothed fraction of failed requests, in 1/1024. */
+} KnownDAStats;
+
+/** The round trip time in ms charged to a DA that has failed without
+ * ever answering; that of a DA that answers only when retried.
+ */
+#define KNOWNDA_UNMEASURED_RTT   2000
+
+/** Backs G_KnownDAStats; lives until KnownDAFreeAll. */
+static SLPArena G_KnownDAStatsArena = 0;
+
+/** DA address -> KnownDAStats, kept when DAs leave the cache so that a
+ * DA that comes back is remembered.
+ */
+static SLPHashTable G_KnownDAStats;
+
+/** The state of the generator behind the power-of-two choices. */
+static uint32_t G_KnownDARandom = 0;
+
+/** Although spanning lists are lists of IPV4 socket addresses, they may be
+ * copied as if they were generic socket addresses, so they are padded out
+ * to make sure there is enough memory following the last one.
+ */
+#define DESTADDR_PADDING (sizeof(struct sockaddr_storage) - sizeof(struct sockaddr_in))
+
+/** A known DA, as seen by the scope index. */
+typedef struct _KnownDAIndexEntry
+{
+   SLPDatabaseEntry * entry;     /*!< The DA's cache entry. */
+   KnownDAStats * stats;         /*!< How well the DA has been answering. */
+   unsigned order;               /*!< The DA's position in the cache. */
+   unsigned mark;                /*!< The last selection that gathered it. */
+} KnownDAIndexEntry;
+
+/** One of the DAs that support a scope. */
+typedef struct _KnownDAScopeItem
+{
+   struct _KnownDAScopeItem * next;
+   KnownDAIndexEntry * da;
+} KnownDAScopeItem;
+
+/** The DAs that support a scope, in cache order. */
+typedef struct _KnownDAScope
+{
+   KnownDAScopeItem * head;
+   KnownDAScopeItem ** tail;
+} KnownDAScope;
+
+/** The DAs chosen for a requested scope list and SPI. */
+typedef struct _KnownDASelection
+{
+   KnownDAIndexEntry ** choices; /*!< The DAs with every scope and the SPI. */
+   int choicecount;              /*!< The number of DAs in @e choices. */
+   int spancount;                /*!< The number of DAs in @e span. */
+   struct sockaddr_in * span;    /*!< DAs that between them have every scope. */
+} KnownDASelection;
+
+/** Backs the scope index and the selections; reset when they are rebuilt. */
+static SLPArena G_KnownDAIndexArena = 0;
+
+/** Whether the scope index and selections reflect the cache. */
+static int G_KnownDAIndexValid = 0;
+
+/** The cached DAs, in cache order. */
+static KnownDAIndexEntry * G_KnownDAIndex = 0;
+
+/** The number of entries in G_KnownDAIndex. */
+static size_t G_KnownDAIndexCount = 0;
+
+/** Normalised scope -> KnownDAScope. */
+static SLPHashTable G_KnownDAScopes;
+
+/** Normalised scope list and SPI -> KnownDASelection. */
+static SLPHashTable G_KnownDASelections;
+
+/** The union of the scopes of all cached DAs. */
+static char * G_KnownDAScopeUnion = 0;
+
+/** The length of G_KnownDAScopeUnion. */
+static size_t G_KnownDAScopeUnionLen = 0;
+
+/** Stamped on the DAs gathered for a selection. */
+static unsigned G_KnownDAMark = 0;
+
+/** Find the statistics kept for a DA.
+ *
+ * @param[in] daaddr - The address of the DA.
+ * @param[in] create - Whether to start statistics for a new DA.
+ *
+ * @return The DA's statistics, or NULL if there are none.
+ *
+ * @internal
+ */
+static KnownDAStats * KnownDAStatsFind(const void * daaddr, bool create)
+{
+   const struct sockaddr * addr = daaddr;
+   SLPHashEntry * hashentry;
+   KnownDAStats * stats;
+   const void * key;
+   size_t keylen;
+
+   if (addr->sa_family == AF_INET)
+   {
+      key = &((const struct sockaddr_in *)addr)->sin_addr;
+      keylen = sizeof(struct in_addr);
+   }
+   else if (addr->sa_family == AF_INET6)
+   {
+      key = &((const struct sockaddr_in6 *)addr)->sin6_addr;
+      keylen = sizeof(struct in6_addr);
+   }
+   else
+      return 0;
+
+   if (!create)
+   {
+      if (G_KnownDAStatsArena == 0)
+         return 0;
+      hashentry = SLPHashTableFind(&G_KnownDAStats, key, keylen);
+      return hashentry? hashentry->value: 0;
+   }
+
+   if (G_KnownDAStatsArena == 0)
+   {
+      if ((G_KnownDAStatsArena = SLPArenaCreate(0)) == 0)
+         return 0;
+      SLPHashTableInit(&G_KnownDAStats, G_KnownDAStatsArena);
+   }
+   if ((hashentry = SLPHashTableInsert(&G_KnownDAStats, key, keylen, 0)) == 0)
+      return 0;
+   if ((stats = hashentry->value) == 0)
+   {
+      if ((stats = SLPArenaAlloc(G_KnownDAStatsArena, sizeof(*stats))) == 0)
+         return 0;
+      stats->srtt = -1;
+      stats->rttvar = 0;
+      stats->errors = 0;
+      hashentry->value = stats;
+   }
+   return stats;
+}
+
+/** The cost of sending a request to a DA.
+ *
+ * The DA's smoothed round trip time, inflated by up to 16 times as its
+ * error rate approaches one. A DA that has not been measured costs
+ * nothing, so that it is tried and measured, unless it has failed
+ * already; then it costs as if it took KNOWNDA_UNMEASURED_RTT to answer.
+ *
+ * @internal
+ */
+static unsigned long KnownDACost(const KnownDAIndexEntry * da)
+{
+   unsigned long srtt;
+
+   if (da->stats == 0 || (da->stats->srtt < 0 && da->stats->errors == 0))
+      return 0;
+   srtt = da->stats->srtt < 0? KNOWNDA_UNMEASURED_RTT * 8:
+         (unsigned long)da->stats->srtt;
+   return (srtt + 8) * (1024 + 15 * (unsigned long)da->stats->errors) / 1024;
+}
+
+/** Discard the scope index and selections; the cache has changed.
+ *
+ * @internal
+ */
+static void KnownDAIndexInvalidate(void)
+{
+   G_KnownDAIndexValid = 0;
+}
+
+/** Rebuild the scope index from the cache if it has changed.
+ *
+ * @return Zero on success, or a non-zero value on memory allocation
+ *    failure.
+ *
+ * @internal
+ */
+static int KnownDAIndexBuild(void)
+{
+   SLPDatabaseHandle dh;
+   SLPDatabaseEntry * entry;
+   size_t unionsize = 1;
+   size_t count = 0;
+   char * normbuf;
+
+   if (G_KnownDAIndexValid)
+      return 0;
+
+   if (G_KnownDAIndexArena == 0)
+   {
+      G_KnownDAIndexArena = SLPArenaCreate(0);
+      if (G_KnownDAIndexArena == 0)
+         return -1;
+   }
+   SLPArenaReset(G_KnownDAIndexArena);
+   SLPHashTableInit(&G_KnownDAScopes, G_KnownDAIndexArena);
+   SLPHashTableInit(&G_KnownDASelections, G_KnownDAIndexArena);
+   G_KnownDAIndexCount = 0;
+   G_KnownDAScopeUnionLen = 0;
+
+   if ((dh = SLPDatabaseOpen(&G_KnownDACache)) == 0)
+      return -1;
+
+   /* size the index and the scope union */
+   while ((entry = SLPDatabaseEnum(dh)) != 0)
+   {
+      unionsize += entry->msg->body.daadvert.scopelistlen + 1;
+      count++;
+   }
+   G_KnownDAIndex = SLPArenaAlloc(G_KnownDAIndexArena,
+         (count + 1) * sizeof(KnownDAIndexEntry));
+   G_KnownDAScopeUnion = SLPArenaAlloc(G_KnownDAIndexArena, unionsize);
+   normbuf = SLPArenaAlloc(G_KnownDAIndexArena, unionsize);
+   if (G_KnownDAIndex == 0 || G_KnownDAScopeUnion == 0 || normbuf == 0)
+   {
+      SLPDatabaseClose(dh);
+      return -1;
+   }
+
+   /* file each DA under each of its scopes */
+   SLPDatabaseRewind(dh);
+   while ((entry = SLPDatabaseEnum(dh)) != 0)
+   {
+      SLPDAAdvert * daadvert = &entry->msg->body.daadvert;
+      KnownDAIndexEntry * da = &G_KnownDAIndex[G_KnownDAIndexCount];
+      const char * listend = daadvert->scopelist + daadvert->scopelistlen;
+      const char * itemend = daadvert->scopelist;
+      const char * itembegin;
+      size_t newlen;
+
+      da->entry = entry;
+      da->stats = KnownDAStatsFind(&entry->msg->peer, true);
+      da->order = (unsigned)G_KnownDAIndexCount++;
+      da->mark = G_KnownDAMark;
+
+      while (itemend < listend)
+      {
+         size_t normlen;
+         SLPHashEntry * hashentry;
+         KnownDAScope * scope;
+         KnownDAScopeItem * item;
+
+         itembegin = itemend;
+         while (itemend < listend && itemend[0] != ',')
+            itemend++;
+         normlen = SLPNormalizeString(itemend - itembegin, itembegin,
+               normbuf, 1);
+         itemend++;
+         if (normlen == 0)
+            continue;
+
+         hashentry = SLPHashTableInsert(&G_KnownDAScopes, normbuf, normlen, 0);
+         if (hashentry == 0)
+            break;
+         if ((scope = hashentry->value) == 0)
+         {
+            scope = SLPArenaAlloc(G_KnownDAIndexArena, sizeof(KnownDAScope));
+            if (scope == 0)
+               break;
+            scope->head = 0;
+            scope->tail = &scope->head;
+            hashentry->value = scope;
+         }
+         if ((item = SLPArenaAlloc(G_KnownDAIndexArena,
+               sizeof(KnownDAScopeItem))) == 0)
+            break;
+         item->next = 0;
+         item->da = da;
+         *scope->tail = item;
+         scope->tail = &item->next;
+      }
+      if (itemend < listend)
+      {
+         SLPDatabaseClose(dh);
+         return -1;
+      }
+
+      newlen = unionsize;
+      SLPUnionStringList(G_KnownDAScopeUnionLen, G_KnownDAScopeUnion,
+            daadvert->scopelistlen, daadvert->scopelist, &newlen,
+            G_KnownDAScopeUnion);
+      G_KnownDAScopeUnionLen = newlen;
+   }
+   SLPDatabaseClose(dh);
+
+   G_KnownDAIndexValid = 1;
+   return 0;
+}
+
+/** Order DAs by cost, then by their position in the cache.
+ *
+ * @internal
+ */
+static int KnownDACompareCost(const void * p1, const void * p2)
+{
+   const KnownDAIndexEntry * da1 = *(KnownDAIndexEntry * const *)p1;
+   const KnownDAIndexEntry * da2 = *(KnownDAIndexEntry * const *)p2;
+   unsigned long cost1 = KnownDACost(da1);
+   unsigned long cost2 = KnownDACost(da2);
+
+   if (cost1 != cost2)
+      return cost1 < cost2? -1: 1;
+   return da1->order < da2->order? -1: da1->order > da2->order;
+}
+
+/** Check that a DA supports an SPI.
+ *
+ * @internal
+ */
+static int KnownDAHasSpi(KnownDAIndexEntry * da, size_t spistrlen,
+      const char * spistr)
+{
+#ifdef ENABLE_SLPv2_SECURITY
+   return SLPCompareString(da->entry->msg->body.daadvert.spilistlen,
+         da->entry->msg->body.daadvert.spilist, spistrlen, spistr) == 0;
+#else
+   (void)da;
+   (void)spistr;
+   (void)spistrlen;
+   return 1;
+#endif
+}
+
+/** Choose the DAs for a scope list and SPI.
+ *
+ * The DAs that support any of the scopes are gathered through the scope
+ * index, and are considered cheapest first. The choice is remembered until
+ * the cache next changes, so a repeated request costs a hash lookup; the
+ * costs it was ordered by may have moved on by then, which is why a single
+ * DA is picked from @e choices by their current costs.
+ *
+ * @param[in] scopelistlen - The length of @p scopelist.
+ * @param[in] scopelist - The list of scopes the DAs should support.
+ * @param[in] spistrlen - The length of @p spistr.
+ * @param[in] spistr - The Security Parameter Index value to use.
+ *
+ * @return The selection, valid until the cache changes, or NULL on
+ *    memory allocation failure.
+ *
+ * @internal
+ */
+static KnownDASelection * KnownDASelect(size_t scopelistlen,
+      const char * scopelist, size_t spistrlen, const char * spistr)
+{
+   KnownDASelection * selection = 0;
+   KnownDAIndexEntry ** candidates;
+   SLPHashEntry * memo;
+   const char * listend = scopelist + scopelistlen;
+   const char * itemend = scopelist;
+   const char * itembegin;
+   char * scopesleft;
+   int scopesleftlen;
+   size_t ncandidates = 0;
+   size_t keylen;
+   size_t i;
+   char * key;
+
+   if (KnownDAIndexBuild() != 0)
+      return 0;
+
+   /* the key is the normalised scope list, a NUL and the SPI */
+   if ((key = xmalloc(scopelistlen + 1 + spistrlen)) == 0)
+      return 0;
+   keylen = SLPNormalizeString(scopelistlen, scopelist, key, 1);
+   key[keylen++] = 0;
+   if (spistrlen)
+      memcpy(key + keylen, spistr, spistrlen);
+   keylen += spistrlen;
+   memo = SLPHashTableInsert(&G_KnownDASelections, key, keylen, 0);
+   xfree(key);
+   if (memo == 0 || memo->value != 0)
+      return memo? memo->value: 0;
+
+   selection = SLPArenaAlloc(G_KnownDAIndexArena, sizeof(KnownDASelection));
+   candidates = SLPArenaAlloc(G_KnownDAIndexArena,
+         (G_KnownDAIndexCount + 1) * sizeof(KnownDAIndexEntry *));
+   scopesleft = xmalloc(scopelistlen + 1);
+   if (selection == 0 || candidates == 0 || scopesleft == 0)
+   {
+      xfree(scopesleft);
+      return 0;
+   }
+   selection->choices = 0;
+   selection->choicecount = 0;
+   selection->spancount = 0;
+   selection->span = 0;
+
+   /* gather the DAs with any of the scopes, cheapest first */
+   G_KnownDAMark++;
+   while (itemend < listend)
+   {
+      size_t normlen;
+      SLPHashEntry * hashentry;
+      KnownDAScope * scope;
+      KnownDAScopeItem * item;
+
+      itembegin = itemend;
+      while (itemend < listend && itemend[0] != ',')
+         itemend++;
+      normlen = SLPNormalizeString(itemend - itembegin, itembegin,
+            scopesleft, 1);
+      itemend++;
+
+      hashentry = SLPHashTableFind(&G_KnownDAScopes, scopesleft, normlen);
+      if (hashentry == 0)
+         continue;
+      scope = hashentry->value;
+      for (item = scope->head; item; item = item->next)
+         if (item->da->mark != G_KnownDAMark)
+         {
+            item->da->mark = G_KnownDAMark;
+            candidates[ncandidates++] = item->da;
+         }
+   }
+   qsort(candidates, ncandidates, sizeof(KnownDAIndexEntry *),
+         KnownDACompareCost);
+
+   /* the DAs with all the scopes */
+   selection->choices = SLPArenaAlloc(G_KnownDAIndexArena,
+         (ncandidates + 1) * sizeof(KnownDAIndexEntry *));
+   if (selection->choices == 0)
+   {
+      xfree(scopesleft);
+      return 0;
+   }
+   for (i = 0; i < ncandidates; i++)
+   {
+      SLPDAAdvert * daadvert = &candidates[i]->entry->msg->body.daadvert;
+
+      if (SLPSubsetStringList(daadvert->scopelistlen, daadvert->scopelist,
+            scopelistlen, scopelist) != 0
+            && KnownDAHasSpi(candidates[i], spistrlen, spistr))
+         selection->choices[selection->choicecount++] = candidates[i];
+   }
+
+   /* and a set of DAs, cheapest first, that between them have the scopes;
+      the list is 0.0.0.0 terminated, and padded so the last address may
+      be copied as if it were a generic socket address */
+   selection->span = SLPArenaAlloc(G_KnownDAIndexArena,
+         (ncandidates + 1) * sizeof(struct sockaddr_in) + DESTADDR_PADDING);
+   if (selection->span == 0)
+   {
+      xfree(scopesleft);
+      return 0;
+   }
+   memcpy(scopesleft, scopelist, scopelistlen);
+   scopesleftlen = (int)scopelistlen;
+   for (i = 0; i < ncandidates && scopesleftlen; i++)
+   {
+      SLPMessage * msg = candidates[i]->entry->msg;
+
+      if (SLPIntersectStringList(msg->body.daadvert.scopelistlen,
+               msg->body.daadvert.scopelist, scopesleftlen, scopesleft)
+            && KnownDAHasSpi(candidates[i], spistrlen, spistr)
+            && msg->peer.ss_family == AF_INET && SLPNetIsIPV4())
+      {
+         /* Remove the DA's scopes from the remaining list of scopes */
+         (void)SLPIntersectRemoveStringList((int)msg->body.daadvert.scopelistlen,
+               msg->body.daadvert.scopelist, &scopesleftlen, scopesleft);
+         memset(&selection->span[selection->spancount], 0,
+               sizeof(struct sockaddr_in));
+         memcpy(&selection->span[selection->spancount].sin_addr,
+               &((struct sockaddr_in *)&msg->peer)->sin_addr,
+               sizeof(struct in_addr));
+         selection->span[selection->spancount].sin_family = PF_INET;
+         selection->spancount++;
+      }
+   }
+   if (scopesleftlen)
+   {
+      /* some of the requested scopes are not handled by any cached DA */
+      selection->spancount = 0;
+   }
+   memset(&selection->span[selection->spancount], 0,
+         sizeof(struct sockaddr_in));
+   xfree(scopesleft);
+
+   memo->value = selection;
+   return selection;
+}
+
+/** Pick a random number below a limit.
+ *
+ * A xorshift generator; the choice between DAs needs to be spread, not
+ * unpredictable.
+ *
+ * @internal
+ */
+static unsigned KnownDARandom(unsigned limit)
+{
+   uint32_t x = G_KnownDARandom;
+
+   if (x == 0)
+      x = ((uint32_t)time(0) ^ (uint32_t)SLPPidGet() * 2654435761U) | 1;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   G_KnownDARandom = x;
+   return x % limit;
+}
+
+/** Choose one of the DAs of a selection that have every scope.
+ *
+ * Two of the DAs are picked at random, and the one that has been answering
+ * faster and more reliably wins. This spreads the load while steering
+ * clear of slow DAs, without every agent piling onto the same fastest one.
+ *
+ * @param[in] selection - The DAs to choose from.
+ * @param[in] family - The address family the DA must have, or AF_UNSPEC.
+ *
+ * @return The chosen DA, or NULL if there is none of @p family.
+ *
+ * @internal
+ */
+static KnownDAIndexEntry * KnownDAChoose(KnownDASelection * selection,
+      int family)
+{
+   KnownDAIndexEntry * da1;
+   KnownDAIndexEntry * da2;
+   unsigned i, j;
+
+   if (selection->choicecount == 0)
+      return 0;
+   if (selection->choicecount == 1)
+      da1 = da2 = selection->choices[0];
+   else
+   {
+      i = KnownDARandom(selection->choicecount);
+      j = KnownDARandom(selection->choicecount - 1);
+      if (j >= i)
+         j++;
+      da1 = selection->choices[i];
+      da2 = selection->choices[j];
+   }
+   if (family != AF_UNSPEC)
+   {
+      if (da1->entry->msg->peer.ss_family != family)
+         da1 = da2;
+      if (da2->entry->msg->peer.ss_family != family)
+         da2 = da1;
+      if (da1->entry->msg->peer.ss_family != family)
+         return 0;
+   }
+   return KnownDACost(da2) < KnownDACost(da1)? da2: da1;
+}
+
 /** Locate a known DA matching the desired scope list and SPI.
  *
  * Searches the known DA list in the database for a DA that matches the
- * specified scope list and security parameter index (SPI) value. Returns
- * the network address for the first DA to match the specified criteria.
+ * specified scope list and security parameter index (SPI) value, choosing
+ * between them by how well they have been answering.
  *
  * @param[in] scopelist - The list of scopes whose DA's should be found. All
  *    DA's that support a proper subset of this scope list will be returned.
@@ -79,39 +641,111 @@ static time_t G_KnownDALastCacheRefresh = 0;
 static SLPBoolean KnownDAListFind(size_t scopelistlen, const char * scopelist,
       size_t spistrlen, const char * spistr, void * daaddr, size_t daaddrsz)
 {
-   int result;
-   SLPDatabaseHandle dh;
-   SLPDatabaseEntry * entry;
+   KnownDASelection * selection;
+   KnownDAIndexEntry * da;
 
-#ifndef ENABLE_SLPv2_SECURITY
-   (void)spistr;
-   (void)spistrlen;
+   selection = KnownDASelect(scopelistlen, scopelist, spistrlen, spistr);
+   if (selection == 0 || (da = KnownDAChoose(selection, AF_UNSPEC)) == 0)
+      return SLP_FALSE;
+   memcpy(daaddr, &da->entry->msg->peer, daaddrsz);
+   return SLP_TRUE;
+}
+
+/** Find a DA to send a hedged request to.
+ *
+ * Finds the cheapest DA other than @p daaddr that serves the scope list,
+ * and estimates how long @p daaddr should be given to answer first.
+ *
+ * @param[in] handle - The SLP handle associated with this request.
+ * @param[in] scopelistlen - The length of @p scopelist.
+ * @param[in] scopelist - The list of scopes the DA must support.
+ * @param[in] daaddr - The address of the DA the request is sent to.
+ * @param[out] hedgeaddr - The address of the second DA.
+ * @param[out] wait - The estimated 95th percentile round trip time of
+ *    @p daaddr in milliseconds, or -1 if it has not been measured.
+ *
+ * @return A boolean value; True if a second DA was found.
+ */
+SLPBoolean KnownDAHedgeFind(SLPHandleInfo * handle, size_t scopelistlen,
+      const char * scopelist, const void * daaddr, void * hedgeaddr,
+      int * wait)
+{
+   const struct sockaddr * addr = daaddr;
+   KnownDASelection * selection;
+   KnownDAIndexEntry * hedge = 0;
+   KnownDAStats * stats;
+   size_t spistrlen = 0;
+   char * spistr = 0;
+   int i;
+
+#ifdef ENABLE_SLPv2_SECURITY
+   if (SLPPropertyAsBoolean("net.slp.securityEnabled"))
+      SLPSpiGetDefaultSPI(handle->hspi, SLPSPI_KEY_TYPE_PUBLIC,
+            &spistrlen, &spistr);
+#else
+   (void)handle;
 #endif
 
-   result = SLP_FALSE;
-   if ((dh = SLPDatabaseOpen(&G_KnownDACache)) != 0)
+   selection = KnownDASelect(scopelistlen, scopelist, spistrlen, spistr);
+   xfree(spistr);
+   if (selection == 0)
+      return SLP_FALSE;
+
+   /* the second DA is sent to on the same socket */
+   for (i = 0; i < selection->choicecount; i++)
    {
-      /* Check to see if there a matching entry, and then check scopes. */
-      while ((entry = SLPDatabaseEnum(dh)) != 0)
-      {
-         if (SLPSubsetStringList(entry->msg->body.daadvert.scopelistlen,
-               entry->msg->body.daadvert.scopelist, scopelistlen,
-               scopelist) != 0)
-         {
-#if defined(ENABLE_SLPv2_SECURITY)
-            if (SLPCompareString(entry->msg->body.daadvert.spilistlen,
-                  entry->msg->body.daadvert.spilist, spistrlen, spistr) == 0)
-#endif
-            {
-               memcpy(daaddr, &entry->msg->peer, daaddrsz);
-               result = SLP_TRUE;
-               break;
-            }
-         }
-      }
-      SLPDatabaseClose(dh);
+      KnownDAIndexEntry * da = selection->choices[i];
+
+      if (da->entry->msg->peer.ss_family == addr->sa_family
+            && SLPNetCompareAddrs(&da->entry->msg->peer, daaddr) != 0
+            && (hedge == 0 || KnownDACost(da) < KnownDACost(hedge)))
+         hedge = da;
+   }
+   if (hedge == 0)
+      return SLP_FALSE;
+
+   memcpy(hedgeaddr, &hedge->entry->msg->peer, sizeof(struct sockaddr_storage));
+   SLPNetSetPort(hedgeaddr, (uint16_t)SLPPropertyAsInteger("net.slp.port"));
+
+   /* the mean plus twice the mean deviation */
+   stats = KnownDAStatsFind(daaddr, false);
+   *wait = (stats && stats->srtt >= 0)? stats->srtt / 8 + stats->rttvar / 2: -1;
+   return SLP_TRUE;
+}
+
+/** Record how a request to a DA went.
+ *
+ * Addresses that are not those of DAs that have been known are ignored.
+ *
+ * @param[in] daaddr - The address the request was sent to.
+ * @param[in] rtt - The time it took the DA to answer in milliseconds, or
+ *    -1 if it did not answer.
+ */
+void KnownDAObserve(const void * daaddr, int rtt)
+{
+   KnownDAStats * stats = KnownDAStatsFind(daaddr, false);
+
+   if (stats == 0)
+      return;
+
+   if (rtt < 0)
+   {
+      stats->errors += (1024 - stats->errors) / 8;
+      return;
+   }
+   stats->errors -= (stats->errors + 7) / 8;
+   if (stats->srtt < 0)
+   {
+      stats->srtt = rtt * 8;
+      stats->rttvar = rtt * 2;
+   }
+   else
+   {
+      int delta = rtt * 8 - stats->srtt;
+
+      stats->srtt += delta / 8;
+      stats->rttvar += ((delta < 0? -delta: delta) / 2 - stats->rttvar) / 4;
    }
-   return result;
 }
 
 /** Find a list of DAs that, between them, handle all the given scopes
@@ -137,114 +771,41 @@ int KnownDASpanningListFind(int scopelistlen,
                             const char* spistr,
                             struct sockaddr_in** daaddrs)
 {
-#define NUM_DAS_CHUNK_SIZE	10
-   SLPDatabaseHandle dh;
-   SLPDatabaseEntry * entry;
-   char* scopesleft;
-   int scopesleftlen = scopelistlen;
-   int numdas = 0;
-   int numdasallocated = 0;
-
-   struct sockaddr_in * destaddrs = 0;
-
-   /* Although we are creating a list of IPV4 socket addresses, they may be copied as if they were
-    * generic socket addresses, so pad out the list to make sure there is enough memory following
-    * the last one
-    */
-#define DESTADDR_PADDING    (sizeof (struct sockaddr_storage) - sizeof (struct sockaddr_in))
-
-   scopesleft = malloc(scopelistlen);
-   if (!scopesleft)
-   {
-      /* memory allocation failure */
+   KnownDASelection * selection;
+   KnownDAIndexEntry * da;
+   struct sockaddr_in * destaddrs;
+   size_t size;
+   int i;
+
+   *daaddrs = 0;
+   selection = KnownDASelect(scopelistlen, scopelist, spistrlen, spistr);
+   if (selection == 0 || selection->spancount == 0)
       return 0;
-   }
-   memcpy(scopesleft, scopelist, scopelistlen);
 
-   dh = SLPDatabaseOpen(&G_KnownDACache);
-   if (dh)
+   /* One DA will do; choose it as KnownDAListFind would. */
+   if (selection->spancount == 1 && SLPNetIsIPV4()
+         && (da = KnownDAChoose(selection, AF_INET)) != 0)
    {
-      /*----------------------------------------*/
-      /* Check for matching entries             */
-      /*----------------------------------------*/
-      while(scopesleftlen)
-      {
-         entry = SLPDatabaseEnum(dh);
-         if (entry == NULL)
-            break;
-
-         /* Check scopes */
-         if (SLPIntersectStringList(entry->msg->body.daadvert.scopelistlen,
-               entry->msg->body.daadvert.scopelist, scopesleftlen, scopesleft))
-         {
-            /* This DA handles at least one of the remaining scopes */
-#ifdef ENABLE_SLPv2_SECURITY
-            if (SLPCompareString(entry->msg->body.daadvert.spilistlen,
-                  entry->msg->body.daadvert.spilist, (int)spistrlen, spistr) == 0)
-#else
-               (void) spistr;  /*prevent compiler warnings about unused parameters*/
-               (void) spistrlen;
-#endif
-               {
-                  if (entry->msg->peer.ss_family == AF_INET && SLPNetIsIPV4())
-                  {
-                     /* Remove the DA's scopes from the remaining list of scopes */
-                     (void)SLPIntersectRemoveStringList((int)entry->msg->body.daadvert.scopelistlen,
-                           entry->msg->body.daadvert.scopelist, &scopesleftlen, scopesleft);
-                     if (numdas >= numdasallocated)
-                     {
-                        struct sockaddr_in * tmp_destaddrs;
-                        /* We need a bigger array of addresses */
-                        numdasallocated += NUM_DAS_CHUNK_SIZE;
-                        if ((tmp_destaddrs = xrealloc(destaddrs, numdasallocated * sizeof (struct sockaddr_in) + DESTADDR_PADDING)) == 0)
-                        {
-                           SLPDatabaseClose(dh);
-                           xfree(destaddrs);
-                           xfree(scopesleft);
-                           return 0;
-                        }
-                        destaddrs = tmp_destaddrs;
-                     }
-                     memcpy(&destaddrs[numdas].sin_addr, &(((struct sockaddr_in *)&entry->msg->peer)->sin_addr),
-                           sizeof(struct in_addr));
-                     destaddrs[numdas].sin_family = PF_INET;
-                     destaddrs[numdas].sin_port = htons((uint16_t)SLPPropertyAsInteger("net.slp.port"));
-                     ++numdas;
-                  }
-               }
-            }
-         }
-         SLPDatabaseClose(dh);
-      }
+      size = 2 * sizeof(struct sockaddr_in) + DESTADDR_PADDING;
+      if ((destaddrs = xmalloc(size)) == 0)
+         return 0;
+      memset(destaddrs, 0, size);
+      destaddrs[0].sin_family = PF_INET;
+      destaddrs[0].sin_addr = ((struct sockaddr_in *)&da->entry->msg->peer)->sin_addr;
+      destaddrs[0].sin_port = htons((uint16_t)SLPPropertyAsInteger("net.slp.port"));
+      *daaddrs = destaddrs;
+      return 1;
+   }
 
-      if (numdas && scopesleftlen)
-      {
-         /* some, but not all, of the requested scopes are not handled by any of the cached DAs */
-         xfree(destaddrs);
-         destaddrs = 0;
-         numdas = 0;
-      }
-      else if (numdas)
-      {
-         /* Add a terminating address entry with an IP address of 0.0.0.0 */
-         if (numdas >= numdasallocated)
-         {
-            struct sockaddr_in * tmp_destaddrs;
-            /* We need a bigger array of addresses */
-            numdasallocated += 1;
-            if ((tmp_destaddrs = xrealloc(destaddrs, numdasallocated * sizeof (struct sockaddr_in) + DESTADDR_PADDING)) == 0)
-            {
-               xfree(destaddrs);
-               xfree(scopesleft);
-               return 0;
-            }
-            destaddrs = tmp_destaddrs;
-        }
-        destaddrs[numdas].sin_addr.s_addr = 0;
-    }
-    *daaddrs = destaddrs;
-    xfree(scopesleft);
-    return numdas;
+   size = (selection->spancount + 1) * sizeof(struct sockaddr_in)
+         + DESTADDR_PADDING;
+   if ((destaddrs = xmalloc(size)) == 0)
+      return 0;
+   memcpy(destaddrs, selection->span, size);
+   for (i = 0; i < selection->spancount; i++)
+      destaddrs[i].sin_port = htons((uint16_t)SLPPropertyAsInteger("net.slp.port"));
+   *daaddrs = destaddrs;
+   return selection->spancount;
 }
 
 /** Add an entry to the KnownDA cache.
@@ -281,18 +842,43 @@ static int KnownDAAdd(SLPMessage * msg, SLPBuffer buf)
          /* Assume DAs are identical if their URLs match. */
          if (!SLPCompareString(entrydaadvert->urllen, entrydaadvert->url,
                daadvert->urllen, daadvert->url))
-         {
-            SLPDatabaseRemove(dh, entry);
             break;
-         }
       }
 
-      /* Create and link in a new entry. */
-      entry = SLPDatabaseEntryCreate(msg, buf);
       if (entry)
-         SLPDatabaseAdd(dh, entry);
+      {
+         /* Update the entry in place; the scope index only changes if the
+            DA's scopes, SPIs or address did. */
+         SLPMessage * oldmsg = entry->msg;
+         SLPBuffer oldbuf = entry->buf;
+         SLPDAAdvert * entrydaadvert = &oldmsg->body.daadvert;
+
+         if (SLPCompareString(entrydaadvert->scopelistlen,
+                  entrydaadvert->scopelist, daadvert->scopelistlen,
+                  daadvert->scopelist) != 0
+               || SLPCompareString(entrydaadvert->spilistlen,
+                  entrydaadvert->spilist, daadvert->spilistlen,
+                  daadvert->spilist) != 0
+               || SLPNetCompareAddrs(&oldmsg->peer, &msg->peer) != 0)
+            KnownDAIndexInvalidate();
+         entry->msg = msg;
+         entry->buf = buf;
+         SLPMessageFree(oldmsg);
+         SLPBufferFree(oldbuf);
+      }
       else
-         result = SLP_MEMORY_ALLOC_FAILED;
+      {
+         /* Create and link in a new entry. */
+         entry = SLPDatabaseEntryCreate(msg, buf);
+         if (entry)
+         {
+            KnownDAStatsFind(&msg->peer, true);
+            SLPDatabaseAdd(dh, entry);
+            KnownDAIndexInvalidate();
+         }
+         else
+            result = SLP_MEMORY_ALLOC_FAILED;
+      }
       SLPDatabaseClose(dh);
    }
    return result;
@@ -608,20 +1194,81 @@ static int KnownDADiscoverFromProperties(size_t scopelistlen,
    return result;
 }
 
+/** Reads the DAs slpd publishes in its shared DA cache.
+ *
+ * The cache holds the DAAdverts slpd would send in reply to a DA
+ * SrvRqst through the loopback, so they are added just as if they had
+ * been, but without a round trip to slpd.
+ *
+ * @return The number of *new* DAs found, or -1 if there is no cache
+ *    to read, and slpd must be asked instead.
+ *
+ * @internal
+ */
+static int KnownDADiscoverFromSharedCache(void)
+{
+   const char * path = SLPGetProperty("net.slp.DACacheFile");
+   uint8_t * entries = 0;
+   size_t length = 0;
+   uint32_t count = 0;
+   const uint8_t * cur;
+   int result = 0;
+
+   if (path == 0 || *path == 0)
+      return -1;
+
+   if (G_KnownDASharedCache == 0
+         && (G_KnownDASharedCache = SLPDACacheMap(path)) == 0)
+      return -1;
+   if (SLPDACacheRead(G_KnownDASharedCache, &entries, &length, &count) != 0)
+   {
+      /* slpd may have restarted and replaced the cache; map it again */
+      SLPDACacheUnmap(G_KnownDASharedCache);
+      if ((G_KnownDASharedCache = SLPDACacheMap(path)) == 0
+            || SLPDACacheRead(G_KnownDASharedCache, &entries, &length,
+                  &count) != 0)
+         return -1;
+   }
+
+   cur = entries;
+   while (count-- && cur)
+   {
+      struct sockaddr_storage peeraddr;
+      struct _SLPBuffer msgbuf;
+      const uint8_t * msg;
+      size_t msglen;
+
+      cur = SLPDACacheGetEntry(cur, entries + length, &peeraddr, &msg,
+            &msglen);
+      if (cur == 0)
+         break;
+
+      /* a read-only view; the callback copies what it keeps */
+      memset(&msgbuf, 0, sizeof(msgbuf));
+      msgbuf.start = msgbuf.curpos = (uint8_t *)msg;
+      msgbuf.end = msgbuf.start + msglen;
+      msgbuf.allocated = msglen;
+      KnownDADiscoveryCallback(SLP_OK, &peeraddr, &msgbuf, &result);
+   }
+   xfree(entries);
+   return result;
+}
+
 /** Asks slpd if it knows about a DA.
  *
  * @param[in] handle - The SLP handle associated with this request.
  *
  * @return The number of *new* DAs found.
  *
+ * @remarks slpd's shared DA cache is read instead, where there is one.
+ *
  * @internal
  */
 static int KnownDADiscoverFromIPC(SLPHandleInfo * handle)
 {
    int result = 0;
    struct sockaddr_storage peeraddr;
-
-   sockfd_t sockfd = NetworkConnectToSlpd(&peeraddr);
+   sockfd_t sockfd;
 
    /* First clear the database out so we don't hang on to stale DAs */
    SLPDatabaseHandle dh = SLPDatabaseOpen(&G_KnownDACache);
@@ -636,7 +1283,13 @@ static int KnownDADiscoverFromIPC(SLPHandleInfo * handle)
       }
       SLPDatabaseClose(dh);
    }
+   KnownDAIndexInvalidate();
+
+   if ((result = KnownDADiscoverFromSharedCache()) >= 0)
+      return result;
+   result = 0;
 
+   sockfd = NetworkConnectToSlpd(&peeraddr);
    if (sockfd != SLP_INVALID_SOCKET)
    {
       /* Now we can re-populate the database */
@@ -772,6 +1425,23 @@ SLPBoolean KnownDASpanningListFromCache(SLPHandleInfo * handle,
                                              daaddrs) == 0 ? SLP_FALSE : SLP_TRUE;
     }
 
+    /* Requests to several DAs at once are not hedged, so when requests
+       are to be hedged one that a single DA can answer is left to
+       NetworkConnectToDA and NetworkDARqstRply. */
+    if (result == SLP_TRUE
+            && SLPPropertyAsInteger("net.slp.DAHedgeMinimumWait") > 0)
+    {
+        KnownDASelection * selection = KnownDASelect(scopelistlen,
+                scopelist, spistrlen, spistr);
+
+        if (selection && selection->choicecount > 1)
+        {
+            xfree(*daaddrs);
+            *daaddrs = 0;
+            result = SLP_FALSE;
+        }
+    }
+
 #ifdef ENABLE_SLPv2_SECURITY
     if(spistr) xfree(spistr);
 #endif
@@ -815,6 +1485,14 @@ sockfd_t KnownDAConnect(SLPHandleInfo * handle, size_t scopelistlen,
             || (addr->sa_family == AF_INET && SLPNetIsIPV4()))
       {
          SLPNetSetPort(peeraddr, (uint16_t)SLPPropertyAsInteger("net.slp.port"));
+
+         /* A pooled socket to this DA was in successful use within the
+          * pool's idle timeout, so there is no need to test the DA again.
+          */
+         sock = ConnPoolGet(peeraddr, SOCK_DGRAM);
+         if (sock != SLP_INVALID_SOCKET)
+            break;
+
          sock = SLPNetworkCreateDatagram(addr->sa_family);
          /* Now test if the DA will actually respond */
          if (sock != SLP_INVALID_SOCKET)
@@ -851,6 +1529,7 @@ void KnownDABadDA(void * daaddr)
          if (SLPNetCompareAddrs(daaddr, &entry->msg->peer) == 0)
          {
             SLPDatabaseRemove(dh, entry);
+            KnownDAIndexInvalidate();
             break;
          }
       }
@@ -873,8 +1552,6 @@ int KnownDAGetScopes(size_t * scopelistlen,
    #define SCOPE_LIST_CHUNK_SIZE	64
 
    size_t newlen;
-   SLPDatabaseHandle dh;
-   SLPDatabaseEntry * entry;
    char const * useScopes;
 
    /** known scope list length */
@@ -897,35 +1574,18 @@ int KnownDAGetScopes(size_t * scopelistlen,
          KnownDADiscoverFromMulticast(0,"", handle);
       }
 
-      /* Enumerate all the knownda entries and generate a scopelist. */
-      dh = SLPDatabaseOpen(&G_KnownDACache);
-      if (dh)
+      /* Start from the scopes of all the known DAs. */
+      if (KnownDAIndexBuild() == 0 && G_KnownDAScopeUnionLen)
       {
-         /* Check to find the requested entry. */
-         while (1)
+         if (G_KnownDAScopeUnionLen > G_KnownDAScopesBufferLen)
          {
-            entry = SLPDatabaseEnum(dh);
-            if (!entry)
-               break;
-
-            newlen = G_KnownDAScopesBufferLen;
-            while (SLPUnionStringList(G_KnownDAScopesLen, G_KnownDAScopes,
-                  entry->msg->body.daadvert.scopelistlen,
-                  entry->msg->body.daadvert.scopelist, &newlen,
-                  G_KnownDAScopes) < 0)
-            {
-               newlen += SCOPE_LIST_CHUNK_SIZE;
-               G_KnownDAScopesBufferLen = newlen;
-               G_KnownDAScopes = xrealloc(G_KnownDAScopes, G_KnownDAScopesBufferLen);
-               if (!G_KnownDAScopes)
-               {
-                  G_KnownDAScopesLen = 0;
-                  break;
-               }
-            }
-            G_KnownDAScopesLen = newlen;
+            G_KnownDAScopesBufferLen = G_KnownDAScopeUnionLen;
+            G_KnownDAScopes = xrealloc(G_KnownDAScopes, G_KnownDAScopesBufferLen);
+            if (!G_KnownDAScopes)
+               return -1;
          }
-         SLPDatabaseClose(dh);
+         memcpy(G_KnownDAScopes, G_KnownDAScopeUnion, G_KnownDAScopeUnionLen);
+         G_KnownDAScopesLen = G_KnownDAScopeUnionLen;
       }
 
       /* Explicitly add in the useScopes property */
@@ -1032,6 +1692,21 @@ void KnownDAFreeAll(void)
       SLPDatabaseClose(dh);
    }
    G_KnownDALastCacheRefresh = 0;
+
+   SLPArenaFree(G_KnownDAIndexArena);
+   G_KnownDAIndexArena = 0;
+   G_KnownDAIndexValid = 0;
+   G_KnownDAIndex = 0;
+   G_KnownDAIndexCount = 0;
+   G_KnownDAScopeUnion = 0;
+   G_KnownDAScopeUnionLen = 0;
+
+   SLPArenaFree(G_KnownDAStatsArena);
+   G_KnownDAStatsArena = 0;
+
+   if (G_KnownDASharedCache)
+      SLPDACacheUnmap(G_KnownDASharedCache);
+   G_KnownDASharedCache = 0;
 }
 
 /*=========================================================================*/
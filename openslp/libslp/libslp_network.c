@@ -371,11 +371,46 @@ static int NetworkGetMcastAddrs(const char msgtype, uint8_t * msg,
  *    entry; the size of the address stored in @p peeraddr on exit.
  *
  * @return The connected socket, or -1 if no DA connection can be made.
+ *
+ * @note An idle connection to slpd from the connection pool is used in
+ *    preference to a new one, and slpd's local socket is used in
+ *    preference to loopback TCP. A local connection reports the loopback
+ *    address in @p peeraddr, so callers need not tell the two apart.
  */
 sockfd_t NetworkConnectToSlpd(void * peeraddr)
 {
    sockfd_t sock = SLP_INVALID_SOCKET;
 
+#ifdef SLP_HAVE_LOCAL_SOCKET
+   /* Try slpd's AF_UNIX socket first. */
+   if (SLPNetIsIPV4())
+   {
+      int tempAddr = INADDR_LOOPBACK;
+      SLPNetSetAddr(peeraddr, AF_INET,
+            (uint16_t)SLPPropertyAsInteger("net.slp.port"), &tempAddr);
+   }
+   else
+      SLPNetSetAddr(peeraddr, AF_INET6,
+            (uint16_t)SLPPropertyAsInteger("net.slp.port"),
+            &slp_in6addr_loopback);
+   sock = ConnPoolGet(peeraddr, SOCK_SEQPACKET);
+   if (sock == SLP_INVALID_SOCKET)
+   {
+      /* Give slpd one unicast timeout to accept before trying TCP. */
+      int timeouts[MAX_RETRANSMITS] = {0};
+      struct timeval timeout;
+
+      SLPPropertyAsIntegerVector("net.slp.unicastTimeouts", timeouts,
+            MAX_RETRANSMITS);
+      timeout.tv_sec = timeouts[0] / 1000;
+      timeout.tv_usec = (timeouts[0] % 1000) * 1000;
+      sock = SLPNetworkConnectLocal(
+            SLPGetProperty("net.slp.localSocketPath"), &timeout);
+   }
+   if (sock != SLP_INVALID_SOCKET)
+      return sock;
+#endif
+
    /* Note that these don't actually test the connection to slpd.
     * They don't have to, since all code that calls this function eventually
     * does a NetworkRqstRply, which has retry logic for the datagram case.
@@ -385,11 +420,16 @@ sockfd_t NetworkConnectToSlpd(void * peeraddr)
    timeout.tv_usec = (timeout.tv_sec % 1000) * 1000;
    timeout.tv_sec = timeout.tv_sec / 1000;
 
+   /* Prefer an idle pooled connection to a new one. */
    if (SLPNetIsIPV6())
       if (!SLPNetSetAddr(peeraddr, AF_INET6,
             (uint16_t)SLPPropertyAsInteger("net.slp.port"),
             &slp_in6addr_loopback))
-         sock = SLPNetworkConnectStream(peeraddr, &timeout);                
+      {
+         sock = ConnPoolGet(peeraddr, SOCK_STREAM);
+         if (sock == SLP_INVALID_SOCKET)
+            sock = SLPNetworkConnectStream(peeraddr, &timeout);
+      }
 
    if (sock == SLP_INVALID_SOCKET && SLPNetIsIPV4())
    {
@@ -397,7 +437,9 @@ sockfd_t NetworkConnectToSlpd(void * peeraddr)
       if (SLPNetSetAddr(peeraddr, AF_INET,
             (uint16_t)SLPPropertyAsInteger("net.slp.port"), &tempAddr) == 0)
       {
-         sock = SLPNetworkConnectStream(peeraddr, &timeout);
+         sock = ConnPoolGet(peeraddr, SOCK_STREAM);
+         if (sock == SLP_INVALID_SOCKET)
+            sock = SLPNetworkConnectStream(peeraddr, &timeout);
       }
    }
    return sock;
@@ -409,7 +451,7 @@ sockfd_t NetworkConnectToSlpd(void * peeraddr)
  *
  * @return SLP_OK if socket is still alive; SLP_NETWORK_ERROR if not.
  */
-static SLPError NetworkCheckConnection(sockfd_t fd)
+SLPError NetworkCheckConnection(sockfd_t fd)
 {
    int r;
 #ifdef HAVE_POLL
@@ -499,9 +541,16 @@ sockfd_t NetworkConnectToDA(SLPHandleInfo * handle, const char * scopelist,
       memcpy(peeraddr, &handle->daaddr, sizeof(struct sockaddr_storage));
    else
    {
-      /* Close existing handle because it doesn't support the scope. */
+      /* Give up the existing socket because it doesn't support the scope,
+       * returning it to the pool if it is still usable.
+       */
       if (handle->dasock != SLP_INVALID_SOCKET)
-         closesocket(handle->dasock);
+      {
+         if (NetworkCheckConnection(handle->dasock) == SLP_OK)
+            ConnPoolRelease(handle->dasock, &handle->daaddr);
+         else
+            closesocket(handle->dasock);
+      }
 
       /* Attempt to connect to DA that does support the scope. */
       handle->dasock = KnownDAConnect(handle, scopelistlen, scopelist,
@@ -547,9 +596,14 @@ sockfd_t NetworkConnectToSA(SLPHandleInfo * handle, const char * scopelist,
       memcpy(saaddr, &handle->saaddr, sizeof(handle->saaddr));
    else
    {
-      /* Close last cached SA socket - scopes not supported. */
+      /* Give up last cached SA socket - scopes not supported. */
       if (handle->sasock != SLP_INVALID_SOCKET)
-         closesocket(handle->sasock);
+      {
+         if (NetworkCheckConnection(handle->sasock) == SLP_OK)
+            ConnPoolRelease(handle->sasock, &handle->saaddr);
+         else
+            closesocket(handle->sasock);
+      }
 
       /* Attempt to connect to slpd via loopback. */
       handle->sasock = NetworkConnectToSlpd(&handle->saaddr);
@@ -566,10 +620,35 @@ sockfd_t NetworkConnectToSA(SLPHandleInfo * handle, const char * scopelist,
    return handle->sasock;
 }
 
-/** Make a request and wait for a reply, or timeout.
+/** The milliseconds elapsed since a time.
+ *
+ * @param[in] since - The earlier time.
+ *
+ * @return The milliseconds between @p since and now.
+ *
+ * @internal
+ */
+static int ElapsedMs(const struct timeval * since)
+{
+   struct timeval now;
+
+   gettimeofday(&now, 0);
+   timeval_subtract(&now, (struct timeval *)since);
+   return (int)(now.tv_sec * 1000 + now.tv_usec / 1000);
+}
+
+/** Make a request and wait for a reply, or timeout, optionally hedged.
+ *
+ * A unicast datagram request is hedged by sending it, with the same XID,
+ * to a second peer if the first has not answered within @p hedgewait
+ * milliseconds; retransmissions then go to both, and the first reply is
+ * taken. The time each known DA takes to answer, or its failure to, is
+ * recorded for DA selection.
  *
  * @param[in] sock - The socket to send/receive on.
  * @param[in] peeraddr - The address to send to.
+ * @param[in] hedgeaddr - The address to send a hedged request to, or NULL.
+ * @param[in] hedgewait - The milliseconds to wait before hedging.
  * @param[in] langtag - The language to send in.
  * @param[in] extoffset - The offset to the first extension in @p buf.
  * @param[in] buf - The message to send.
@@ -580,10 +659,13 @@ sockfd_t NetworkConnectToSA(SLPHandleInfo * handle, const char * scopelist,
  * @param[in] isV1 - Whether or not to use a V1 header.
  *
  * @return SLP_OK on success, or an SLP error code on failure.
+ *
+ * @internal
  */
-SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
-      const char * langtag, size_t extoffset, void * buf, char buftype,
-      size_t bufsize, NetworkRplyCallback callback, void * cookie, int isV1)
+static SLPError NetworkHedgedRqstRply(sockfd_t sock, void * peeraddr,
+      void * hedgeaddr, int hedgewait, const char * langtag,
+      size_t extoffset, void * buf, char buftype, size_t bufsize,
+      NetworkRplyCallback callback, void * cookie, int isV1)
 {
    char * prlist = 0;
    unsigned short flags;
@@ -604,8 +686,12 @@ SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
    int totaltimeout = 0;
    int xid = SLPXidGenerate();
    int timeouts[MAX_RETRANSMITS];
+   int observe = 0;
+   bool hedged = false;
 
    struct sockaddr_storage addr;
+   struct timeval sent;
+   struct timeval hedgesent;
    size_t langtaglen = strlen(langtag);
 
    /* Determine unicast/multicast, TCP/UDP and timeout values. */
@@ -633,6 +719,7 @@ SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
          xmitcount = 0;                /* Datagrams must be retried. */
          looprecv  = 1;
          stoploopifrecv = 1;           /* The peer has sent the single response. */
+         observe = 1;                  /* Time the peer, in case it is a DA. */
       }
       else
       {
@@ -641,6 +728,8 @@ SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
          stoploopifrecv = 0;
       }
    }
+   if (!observe)
+      hedgeaddr = 0;
 
    /* Special case for fake SLP_FUNCT_DASRVRQST. */
    if (buftype == SLP_FUNCT_DASRVRQST)
@@ -821,6 +910,8 @@ SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
       /* -- End SLP Message -- */
 
       /* Send the buffer. */
+      if (xmitcount == 1)
+         gettimeofday(&sent, 0);
       if (SLPNetworkSendMessage(sock, socktype, sendbuf,
             sendbuf->curpos - sendbuf->start, peeraddr,
             &timeout) != 0)
@@ -832,16 +923,64 @@ SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
          goto FINISHED;
       }
 
+      /* Once hedged, every retransmission goes to both peers; a hedge
+       * that is not due before the first retransmission goes with it.
+       */
+      if (hedgeaddr && (hedged || xmitcount > 1))
+      {
+         if (!hedged)
+            gettimeofday(&hedgesent, 0);
+         hedged = true;
+         SLPNetworkSendMessage(sock, socktype, sendbuf,
+               sendbuf->curpos - sendbuf->start, hedgeaddr, &timeout);
+      }
+
       /* ----- Main Receive Loop ----- */
       do
       {
+         struct timeval wait = timeout;
+         int hedgedue = 0;
+
          /* Set peer family to "not set" so we can detect if it was set. */
          addr.ss_family = AF_UNSPEC;
 
+         /* Wake up to hedge if that is due before the timeout. */
+         if (hedgeaddr && !hedged)
+         {
+            hedgedue = hedgewait - ElapsedMs(&sent);
+            if (hedgedue < 0)
+               hedgedue = 0;
+            if (hedgedue < timeout.tv_sec * 1000 + timeout.tv_usec / 1000)
+            {
+               wait.tv_sec = hedgedue / 1000;
+               wait.tv_usec = (hedgedue % 1000) * 1000;
+            }
+            else
+               hedgedue = -1;
+         }
+
          /* Receive the response. */
          if (SLPNetworkRecvMessage(sock, socktype, &recvbuf,
-               &addr, &timeout) != 0)
+               &addr, &wait) != 0)
          {
+            if (errno == ETIMEDOUT && hedgeaddr && !hedged && hedgedue >= 0)
+            {
+               /* The peer is slow; ask the second one as well and give
+                * them both what is left of the timeout.
+                */
+               gettimeofday(&hedgesent, 0);
+               hedged = true;
+               SLPNetworkSendMessage(sock, socktype, sendbuf,
+                     sendbuf->curpos - sendbuf->start, hedgeaddr, &timeout);
+               timeout.tv_sec -= wait.tv_sec;
+               timeout.tv_usec -= wait.tv_usec;
+               if (timeout.tv_usec < 0)
+               {
+                  timeout.tv_usec += 1000000;
+                  timeout.tv_sec--;
+               }
+               continue;
+            }
             if (errno == ETIMEDOUT)
                result = SLP_NETWORK_TIMED_OUT;
             else
@@ -862,6 +1001,22 @@ SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
                if (addr.ss_family == AF_UNSPEC)
                   memcpy(&addr, peeraddr, sizeof(addr));
 
+               /* The first reply times whichever peer sent it. A hedge
+                * peer beaten by the first peer, having had as long as the
+                * first peer had before it was hedged, has missed.
+                */
+               if (observe && rplycount == 1)
+               {
+                  if (hedged && SLPNetCompareAddrs(&addr, hedgeaddr) == 0)
+                     KnownDAObserve(&addr, ElapsedMs(&hedgesent));
+                  else
+                  {
+                     KnownDAObserve(&addr, ElapsedMs(&sent));
+                     if (hedged && ElapsedMs(&hedgesent) >= hedgewait)
+                        KnownDAObserve(hedgeaddr, -1);
+                  }
+               }
+
                /* Call the callback with the result and recvbuf. */
                if (callback(result, &addr, recvbuf, cookie) == SLP_FALSE)
                   goto CLEANUP; /* Caller doesn't want any more info. */
@@ -901,6 +1056,14 @@ SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
 
 FINISHED:
 
+   /* Nobody answered. */
+   if (observe && rplycount == 0 && result == SLP_NETWORK_TIMED_OUT)
+   {
+      KnownDAObserve(peeraddr, -1);
+      if (hedged)
+         KnownDAObserve(hedgeaddr, -1);
+   }
+
    /* Notify the callback that we're done. */
    if (rplycount != 0 || (result == SLP_NETWORK_TIMED_OUT
          && SLPNetIsMCast(peeraddr)))
@@ -922,6 +1085,291 @@ CLEANUP:
    return result;
 }
 
+/** Make a request and wait for a reply, or timeout.
+ *
+ * @param[in] sock - The socket to send/receive on.
+ * @param[in] peeraddr - The address to send to.
+ * @param[in] langtag - The language to send in.
+ * @param[in] extoffset - The offset to the first extension in @p buf.
+ * @param[in] buf - The message to send.
+ * @param[in] buftype - The type of @p buf.
+ * @param[in] bufsize - The size of @p buf.
+ * @param[in] callback - The user callback to call with response data.
+ * @param[in] cookie - A pass through value from the caller to @p callback.
+ * @param[in] isV1 - Whether or not to use a V1 header.
+ *
+ * @return SLP_OK on success, or an SLP error code on failure.
+ */
+SLPError NetworkRqstRply(sockfd_t sock, void * peeraddr,
+      const char * langtag, size_t extoffset, void * buf, char buftype,
+      size_t bufsize, NetworkRplyCallback callback, void * cookie, int isV1)
+{
+   return NetworkHedgedRqstRply(sock, peeraddr, 0, 0, langtag, extoffset,
+         buf, buftype, bufsize, callback, cookie, isV1);
+}
+
+/** Make a request of the DA connected by NetworkConnectToDA.
+ *
+ * If net.slp.DAHedgeMinimumWait is set and another known DA serves the
+ * scopes, a DA that has not answered within its usual time (an estimate
+ * of its 95th percentile round trip time, but no less than the property)
+ * is not waited on alone: the request also goes to the other DA, and the
+ * first reply is taken.
+ *
+ * @param[in] handle - The SLP handle holding the DA connection.
+ * @param[in] buf - The message to send.
+ * @param[in] buftype - The type of @p buf.
+ * @param[in] bufsize - The size of @p buf.
+ * @param[in] callback - The user callback to call with response data.
+ * @param[in] cookie - A pass through value from the caller to @p callback.
+ * @param[in] isV1 - Whether or not to use a V1 header.
+ *
+ * @return SLP_OK on success, or an SLP error code on failure.
+ */
+SLPError NetworkDARqstRply(SLPHandleInfo * handle, void * buf,
+      char buftype, size_t bufsize, NetworkRplyCallback callback,
+      void * cookie, int isV1)
+{
+   struct sockaddr_storage hedgeaddr;
+   int minwait = SLPPropertyAsInteger("net.slp.DAHedgeMinimumWait");
+   int hedgewait;
+
+   if (minwait <= 0 || KnownDAHedgeFind(handle, handle->dascopelen,
+         handle->dascope, &handle->daaddr, &hedgeaddr, &hedgewait) == SLP_FALSE)
+      return NetworkHedgedRqstRply(handle->dasock, &handle->daaddr, 0, 0,
+            handle->langtag, 0, buf, buftype, bufsize, callback, cookie, isV1);
+
+   /* A DA that has not been timed is given until its first retransmission. */
+   if (hedgewait < 0)
+   {
+      int timeouts[MAX_RETRANSMITS];
+
+      SLPPropertyAsIntegerVector("net.slp.unicastTimeouts",
+            timeouts, MAX_RETRANSMITS);
+      hedgewait = timeouts[0];
+   }
+   if (hedgewait < minwait)
+      hedgewait = minwait;
+   return NetworkHedgedRqstRply(handle->dasock, &handle->daaddr, &hedgeaddr,
+         hedgewait, handle->langtag, 0, buf, buftype, bufsize, callback,
+         cookie, isV1);
+}
+
+/** Send several requests to one peer and dispatch their replies.
+ *
+ * All requests are sent to @p peeraddr back to back, each with its own 
+ * XID, before any reply is read. Replies are then matched to requests by
+ * XID as they arrive, so the whole set costs roughly one round trip to 
+ * the peer rather than one per request. Only one reply is expected per 
+ * request, as is the case for a unicast request to a DA.
+ *
+ * On a datagram socket, unanswered requests are retransmitted on the 
+ * net.slp.unicastTimeouts schedule. On a stream socket, requests are 
+ * sent once and replies are awaited for net.slp.unicastMaximumWait.
+ *
+ * @param[in] sock - The socket to send/receive on.
+ * @param[in] peeraddr - The address to send to.
+ * @param[in] langtag - The language to send in.
+ * @param[in] buftype - The function-id of every request.
+ * @param[in] count - The number of requests.
+ * @param[in] bufs - The message bodies to send, as for NetworkRqstRply.
+ * @param[in] bufsizes - The sizes of the buffers in @p bufs.
+ * @param[in] callback - The callback to call with each reply.
+ * @param[in] cookies - The per-request values passed to @p callback.
+ *
+ * @return SLP_OK if every request was answered; otherwise an SLP error
+ *    code. Requests that were answered before an error was encountered
+ *    have already been passed to @p callback.
+ */
+SLPError NetworkPipelineRqstRply(sockfd_t sock, void * peeraddr,
+      const char * langtag, char buftype, size_t count, void ** bufs, 
+      size_t * bufsizes, NetworkRplyCallback callback, void ** cookies)
+{
+   size_t i;
+   size_t pending = 0;
+   size_t mtu = getmtu();
+   size_t langtaglen = strlen(langtag);
+   socklen_t stypesz = sizeof(int);
+   int socktype = SOCK_STREAM;
+   int xmitcount = 0;
+   int totaltimeout = 0;
+   int maxwait = SLPPropertyAsInteger("net.slp.unicastMaximumWait");
+   int timeouts[MAX_RETRANSMITS];
+   struct timeval timeout, deadline, now;
+   struct sockaddr_storage addr;
+   SLPBuffer * sendbufs;
+   SLPBuffer recvbuf = 0;
+   SLPError result = SLP_OK;
+   int * xids;
+
+   if (count == 0)
+      return SLP_OK;
+
+   getsockopt(sock, SOL_SOCKET, SO_TYPE, (char *)&socktype, &stypesz);
+   SLPPropertyAsIntegerVector("net.slp.unicastTimeouts", 
+         timeouts, MAX_RETRANSMITS);
+
+   xids = xmalloc(count * sizeof(int));
+   sendbufs = xcalloc(count, sizeof(SLPBuffer));
+   if (xids == 0 || sendbufs == 0)
+   {
+      result = SLP_MEMORY_ALLOC_FAILED;
+      goto CLEANUP;
+   }
+
+   /* Format each request. */
+   for (i = 0; i < count; i++)
+   {
+      size_t size = CalcBufferSize(0, buftype, langtaglen, 0, bufsizes[i]);
+      SLPBuffer sendbuf;
+
+      /* Requests too large for a datagram are left to the caller. */
+      xids[i] = -1;
+      if (socktype == SOCK_DGRAM && size > mtu)
+         continue;
+
+      if ((sendbuf = sendbufs[i] = SLPBufferAlloc(size)) == 0)
+      {
+         result = SLP_MEMORY_ALLOC_FAILED;
+         goto CLEANUP;
+      }
+      xids[i] = SLPXidGenerate();
+      pending++;
+
+      /* -- Begin SLP Header -- */
+
+      /* Version */
+      *sendbuf->curpos++ = 2;
+
+      /* Function-ID */
+      *sendbuf->curpos++ = buftype;
+
+      /* Length */
+      PutUINT24(&sendbuf->curpos, size);
+
+      /* Flags */
+      PutUINT16(&sendbuf->curpos, 0);
+
+      /* Extension Offset */
+      PutUINT24(&sendbuf->curpos, 0);
+
+      /* XID */
+      PutUINT16(&sendbuf->curpos, xids[i]);
+
+      /* Language Tag Length */
+      PutUINT16(&sendbuf->curpos, langtaglen);
+
+      /* Language Tag */
+      memcpy(sendbuf->curpos, langtag, langtaglen);
+      sendbuf->curpos += langtaglen;
+
+      /* -- End SLP Header -- */
+
+      /* Empty <PRList> for appropriate message types. */
+      if (buftype == SLP_FUNCT_SRVRQST
+            || buftype == SLP_FUNCT_ATTRRQST
+            || buftype == SLP_FUNCT_SRVTYPERQST)
+         PutUINT16(&sendbuf->curpos, 0);
+
+      memcpy(sendbuf->curpos, bufs[i], bufsizes[i]);
+      sendbuf->curpos += bufsizes[i];
+   }
+
+   /* ----- Main Retransmission Loop ----- */
+   while (pending && xmitcount < MAX_RETRANSMITS)
+   {
+      /* Setup the deadline for this round of replies. */
+      if (socktype == SOCK_DGRAM)
+      {
+         totaltimeout += timeouts[xmitcount];
+         if (totaltimeout >= maxwait || !timeouts[xmitcount])
+         {
+            result = SLP_NETWORK_TIMED_OUT;
+            break; /* Max timeout exceeded - we're done. */
+         }
+         timeout.tv_sec = timeouts[xmitcount] / 1000;
+         timeout.tv_usec = (timeouts[xmitcount] % 1000) * 1000;
+      }
+      else
+      {
+         timeout.tv_sec = maxwait / 1000;
+         timeout.tv_usec = (maxwait % 1000) * 1000;
+         xmitcount = MAX_RETRANSMITS - 1; /* Streams manage own retries. */
+      }
+      xmitcount++;
+      gettimeofday(&deadline, 0);
+      timeval_add(&deadline, &timeout);
+
+      /* Send every unanswered request before waiting for any reply. */
+      for (i = 0; i < count; i++)
+      {
+         if (xids[i] == -1)
+            continue;
+         if (SLPNetworkSendMessage(sock, socktype, sendbufs[i], 
+               sendbufs[i]->curpos - sendbufs[i]->start, peeraddr, 
+               &timeout) != 0)
+         {
+            result = errno == ETIMEDOUT? 
+                  SLP_NETWORK_TIMED_OUT: SLP_NETWORK_ERROR;
+            goto CLEANUP;
+         }
+      }
+
+      /* ----- Main Receive Loop ----- */
+      result = SLP_OK;
+      while (pending)
+      {
+         gettimeofday(&now, 0);
+         timeout = deadline;
+         timeval_subtract(&timeout, &now);
+         if (timeout.tv_sec < 0 
+               || (timeout.tv_sec == 0 && timeout.tv_usec <= 0))
+         {
+            result = SLP_NETWORK_TIMED_OUT;
+            break;
+         }
+
+         if (SLPNetworkRecvMessage(sock, socktype, &recvbuf, 
+               &addr, &timeout) != 0)
+         {
+            result = errno == ETIMEDOUT? 
+                  SLP_NETWORK_TIMED_OUT: SLP_NETWORK_ERROR;
+            if (result == SLP_NETWORK_ERROR && socktype != SOCK_DGRAM)
+               goto CLEANUP;
+            break;
+         }
+
+         /* Match the reply to its request by XID. */
+         for (i = 0; i < count; i++)
+         {
+            if (xids[i] != -1 && AS_UINT16(recvbuf->start + 10) == xids[i])
+            {
+               xids[i] = -1;
+               pending--;
+               memcpy(&addr, peeraddr, sizeof(addr));
+               callback(SLP_OK, &addr, recvbuf, cookies[i]);
+               break;
+            }
+         }
+      }
+   }
+
+   if (pending && result == SLP_OK)
+      result = SLP_NETWORK_TIMED_OUT;
+
+CLEANUP:
+
+   /* Free resources. */
+   if (sendbufs)
+      for (i = 0; i < count; i++)
+         SLPBufferFree(sendbufs[i]);
+   xfree(sendbufs);
+   xfree(xids);
+   SLPBufferFree(recvbuf);
+
+   return result;
+}
+
 /** Make a request and wait for a reply, or timeout.
  *
  * @param[in] handle - The SLP handle associated with this request.
@@ -1515,6 +1963,7 @@ SLPError NetworkMultiUcastRqstRply(
     char                v1flags;
     unsigned int        msglen;
     struct timeval      now;
+    struct timeval      sent;
     struct timeval      timeout;
     struct timeval      timeout_end;
     struct timeval      max_timeout_end;
@@ -1740,6 +2189,7 @@ SLPError NetworkMultiUcastRqstRply(
     timeout.tv_sec = maxwait / 1000;
     timeout.tv_usec = (maxwait % 1000) * 1000;
     gettimeofday(&max_timeout_end, 0);
+    sent = max_timeout_end;
     timeval_add(&max_timeout_end, &timeout);
 
     /*--------------------------*/
@@ -2078,6 +2528,7 @@ SLPError NetworkMultiUcastRqstRply(
                                 ++rplycount;
                                 pconn->read_buffer->curpos = pconn->read_buffer->end;
                                 pconn->state = CONN_COMPLETE;
+                                KnownDAObserve(&destaddr[i], ElapsedMs(&sent));
 
                                 /* Call the callback with the result and the receive buffer */
                                 if(callback(result,&destaddr[i],pconn->read_buffer,cookie) == SLP_FALSE)
@@ -2164,6 +2615,7 @@ SLPError NetworkMultiUcastRqstRply(
                         ++rplycount;
                         udp_recvbuf->curpos = udp_recvbuf->end;
                         pconn->state = CONN_COMPLETE;
+                        KnownDAObserve(&destaddr[i], ElapsedMs(&sent));
 
                         /* Call the callback with the result and the receive buffer */
                         if(callback(result,&destaddr[i],udp_recvbuf,cookie) == SLP_FALSE)
@@ -2191,6 +2643,7 @@ SLPError NetworkMultiUcastRqstRply(
         if (pconn->state != CONN_COMPLETE)
         {
             /* this DA failed or timed out, so mark it as bad */
+            KnownDAObserve(&destaddr[i], -1);
             KnownDABadDA(&destaddr[i].sin_addr);
         }
     }
@@ -448,6 +448,74 @@ typedef SLPBoolean SLPCALLBACK SLPAttrCallback(
       SLPError       errCode, 
       void *         pvCookie); 
 
+/** SLPSrvURLStream (post RFC 2614)
+ * The SLPSrvURLStream type is returned by SLPFindSrvsStart() and is a 
+ * parameter to SLPFindSrvsNext() and SLPFindSrvsCancel(). It represents
+ * a service request whose results are delivered through a bounded queue
+ * to an application thread, rather than through a callback. The type is 
+ * opaque.
+ */
+typedef void * SLPSrvURLStream;
+
+/** SLPSrvQuery (post RFC 2614)
+ *
+ * The SLPSrvQuery structure describes one query of a batch passed to the 
+ * SLPFindSrvsBatch() function. The fields have the same meaning as the 
+ * parameters of the same name to SLPFindSrvs().
+ */
+typedef struct srvquery {
+
+   const char * s_pcSrvType;
+   /*!< The service type to find. May not be the empty string or NULL. */
+
+   const char * s_pcScopeList;
+   /*!< A comma-separated list of scope names, or NULL or the empty 
+    * string for the scopes the local host is configured to query.
+    */
+
+   const char * s_pcSearchFilter;
+   /*!< An LDAPv3 search filter, or NULL or the empty string to match 
+    * all services of the requested type.
+    */
+
+} SLPSrvQuery;
+
+/** SLPSrvURLBatchCallback (post RFC 2614)
+ *
+ * The SLPSrvURLBatchCallback type is the type of the callback function 
+ * parameter to the SLPFindSrvsBatch() function. It is called as for 
+ * SLPSrvURLCallback, with the addition of the index of the query to 
+ * which each result belongs. Results for different queries may be 
+ * interleaved; each query is ended by a call with SLP_LAST_CALL.
+ *
+ * @param[in] hSLP - The SLPHandle used to initiate the operation.
+ *
+ * @param[in] uiQuery - The index into the batch of the query to which 
+ *    this result belongs.
+ *
+ * @param[in] pcSrvURL - A character buffer containing the returned 
+ *    service URL. May be NULL if errCode not SLP_OK.
+ *
+ * @param[in] sLifetime - An unsigned short giving the life time of the 
+ *    service advertisement, in seconds.
+ *
+ * @param[in] errCode - An error code, as for SLPSrvURLCallback.
+ *
+ * @param[in] pvCookie - Memory passed down from the client code that 
+ *    called SLPFindSrvsBatch(). May be NULL.
+ *
+ * @return The client code should return SLP_TRUE if more data is 
+ *    desired for query @p uiQuery, otherwise SLP_FALSE. Other queries
+ *    in the batch are not affected.
+ */
+typedef SLPBoolean SLPCALLBACK SLPSrvURLBatchCallback(
+      SLPHandle      hSLP,
+      unsigned int   uiQuery,
+      const char *   pcSrvURL, 
+      unsigned short sLifetime, 
+      SLPError       errCode,
+      void *         pvCookie);
+
 /*=========================================================================
  * SLPOpen (4.4.1)
  */
@@ -514,6 +582,39 @@ SLPEXP SLPError SLPAPI SLPFindSrvs(
       SLPSrvURLCallback callback, 
       void *            pvCookie);
 
+/*=========================================================================
+ * SLPFindSrvsStart (post RFC 2614)
+ */
+SLPEXP SLPError SLPAPI SLPFindSrvsStart(
+      SLPHandle         hSLP, 
+      const char *      pcServiceType,
+      const char *      pcScopeList, 
+      const char *      pcSearchFilter, 
+      SLPSrvURLStream * phStream);
+
+/*=========================================================================
+ * SLPFindSrvsNext (post RFC 2614)
+ */
+SLPEXP SLPError SLPAPI SLPFindSrvsNext(
+      SLPSrvURLStream   hStream,
+      char **           ppcSrvURL,
+      unsigned short *  psLifetime);
+
+/*=========================================================================
+ * SLPFindSrvsCancel (post RFC 2614)
+ */
+SLPEXP void SLPAPI SLPFindSrvsCancel(SLPSrvURLStream hStream);
+
+/*=========================================================================
+ * SLPFindSrvsBatch (post RFC 2614)
+ */
+SLPEXP SLPError SLPAPI SLPFindSrvsBatch(
+      SLPHandle               hSLP, 
+      const SLPSrvQuery *     pQueries,
+      unsigned int            uiCount,
+      SLPSrvURLBatchCallback  callback, 
+      void *                  pvCookie);
+
 /*=========================================================================
  * SLPFindAttrs (4.5.6)
  */
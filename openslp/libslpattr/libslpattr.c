@@ -424,24 +424,18 @@ static char * unescape_into(char * dest, const char * src, size_t len,
  */
 static int count_digits(int number)
 {
-   int count = 0;
-
-   /***** As far as I recall, log is undefined at one... *****/
-   if (number == 1)
-      return 1;
-   if (number == -1)
-      return 2;
+   /* Not ceil(log10()), which is one short for powers of ten. */
+   unsigned int magnitude = number < 0? 0u - (unsigned int) number:
+         (unsigned int) number;
+   int count = number < 0? 1: 0; /* The negative sign. */
 
-   /***** Does it require a negative sign? *****/
-   if (number < 0)
-      count += 1;
-
-   /***** Count digits *****/
-   /*** Can't take the log of zero. ***/
-   if (number == 0)
-      return 1 + count;
+   do
+   {
+      count++;
+      magnitude /= 10;
+   } while (magnitude);
 
-   return count + (int) (ceil(log10((double) labs(number))));
+   return count;
 }
 
 
@@ -825,6 +819,9 @@ SLPError SLPAttrAlloc(const char * lang, const FILE * template_h,
    (*slp_attr)->lang = strdup(lang);   /* free()'d in SLPAttrFree(). */
    (*slp_attr)->attrs = 0;
    (*slp_attr)->attr_count = 0;
+   (*slp_attr)->compact = 0;
+   (*slp_attr)->compact_str = 0;
+   (*slp_attr)->compact_len = 0;
 
    /***** Report. *****/
    return SLP_OK;
@@ -863,6 +860,13 @@ void SLPAttrFree(SLPAttributes slp_attr_h)
    slp_attr = (struct xx_SLPAttributes *) slp_attr_h;
 
    /***** Free held resources. *****/
+   if (slp_attr->compact)
+   {
+      /* Everything lives in the one block. */
+      free(slp_attr->compact);
+      slp_attr->compact = 0;
+      slp_attr->attrs = 0;
+   }
    while (slp_attr->attrs)
    {
       var_t * attr = slp_attr->attrs;
@@ -883,6 +887,58 @@ void SLPAttrFree(SLPAttributes slp_attr_h)
 }
 
 
+/* Compares a tag with the tag of a var, ignoring case.
+ *
+ * This is the order in which the vars of a compact list are sorted.
+ */
+static int tag_compare(const var_t * var, const char * tag, size_t tag_len)
+{
+   size_t len = var->tag_len < tag_len? var->tag_len: tag_len;
+   size_t i;
+
+   /* Not strncasecmp: the order has to be that of the folded characters. */
+   for (i = 0; i < len; i++)
+   {
+      int c1 = tolower((unsigned char) var->tag[i]);
+      int c2 = tolower((unsigned char) tag[i]);
+
+      if (c1 != c2)
+         return c1 - c2;
+   }
+   if (var->tag_len == tag_len)
+      return 0;
+   return var->tag_len < tag_len? -1: 1;
+}
+
+
+/* Binary searches a sorted array of vars for a tag.
+ *
+ * Where a tag appears more than once the first one is returned, which is
+ * the one a linear search of the list the array was built from finds.
+ *
+ * Returns a 0 if the value could not be found.
+ */
+static var_t * compact_find(var_t * dir, int count, const char * tag,
+      size_t tag_len)
+{
+   int lo = 0;
+   int hi = count;
+
+   while (lo < hi)
+   {
+      int mid = lo + (hi - lo) / 2;
+
+      if (tag_compare(&dir[mid], tag, tag_len) < 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   if (lo < count && tag_compare(&dir[lo], tag, tag_len) == 0)
+      return &dir[lo];
+   return 0;
+}
+
+
 /* Insert a variable into the var list. */
 static void attr_add(struct xx_SLPAttributes * slp_attr, var_t * var)
 {
@@ -902,6 +958,10 @@ var_t * attr_val_find_str(struct xx_SLPAttributes * slp_attr,
 {
    var_t * var;
 
+   if (slp_attr->compact)
+      return compact_find(slp_attr->attrs, slp_attr->attr_count, tag,
+            tag_len);
+
    var = slp_attr->attrs;
    while (var)
    {
@@ -919,6 +979,90 @@ var_t * attr_val_find_str(struct xx_SLPAttributes * slp_attr,
    return 0;
 }
 
+/* Turns a compact list back into an ordinary one so that it can be
+ * modified. Vars keep their types, values, order and modified flags.
+ *
+ * Returns:
+ *  SLP_OK
+ *  SLP_MEMORY_ALLOC_FAILED -- The list is left compact.
+ */
+static SLPError attr_expand(struct xx_SLPAttributes * slp_attr)
+{
+   var_t * dir = slp_attr->attrs;
+   var_t * list = 0;
+   int i;
+
+   if (slp_attr->compact == 0)
+      return SLP_OK;
+
+   /***** Copy the vars, last first, so that prepending keeps the order. *****/
+   for (i = slp_attr->attr_count - 1; i >= 0; i--)
+   {
+      var_t * var;
+      value_t * src;
+      value_t * last = 0;
+
+      var = var_new(dir[i].tag, dir[i].tag_len);
+      if (var == 0)
+         break;
+      var->type = dir[i].type;
+      var->modified = dir[i].modified;
+      var->next = list;
+      list = var;
+
+      for (src = dir[i].list; src; src = src->next)
+      {
+         size_t extra = 0;
+         value_t * value;
+
+         if (var->type == SLP_STRING || var->type == SLP_OPAQUE)
+            extra = src->unescaped_len;
+         value = value_new(extra);
+         if (value == 0)
+            break;
+         value->escaped_len = src->escaped_len;
+         value->unescaped_len = src->unescaped_len;
+         value->data = src->data;
+         if (var->type == SLP_STRING || var->type == SLP_OPAQUE)
+         {
+            value->data.va_str = ((char *) value) + sizeof(value_t);
+            memcpy(value->data.va_str, src->data.va_str, extra);
+         }
+
+         /* Each value is its own chunk. */
+         if (last)
+            last->next = last->next_chunk = value;
+         else
+            var->list = value;
+         last = value;
+         var->list_size++;
+      }
+      if (src != 0)
+         break;
+   }
+
+   /***** Back out on allocation failure. *****/
+   if (i >= 0)
+   {
+      while (list)
+      {
+         var_t * var = list;
+         list = var->next;
+         var->next = 0;
+         var_free(var);
+      }
+      return SLP_MEMORY_ALLOC_FAILED;
+   }
+
+   free(slp_attr->compact);
+   slp_attr->compact = 0;
+   slp_attr->compact_str = 0;
+   slp_attr->compact_len = 0;
+   slp_attr->attrs = list;
+
+   return SLP_OK;
+}
+
 /* Test a variable's type. Returns SLP_OK if the match is alright, or some
  * other error code (meant to be forwarded to the application) if the match is
  * bad.
@@ -956,6 +1100,16 @@ static SLPError generic_set_val(struct xx_SLPAttributes * slp_attr, const char *
  *****************************************************************************/
 {
    var_t * var;
+   SLPError err;
+
+   /***** A compact list can't be modified in place. *****/
+   if ((err = attr_expand(slp_attr)) != SLP_OK)
+   {
+      if (value)
+         value_free(value);
+      return err;
+   }
+
    /***** Create a new attribute. *****/
    if ((var = attr_val_find_str(slp_attr, tag, tag_len)) == 0)
    {
@@ -969,7 +1123,6 @@ static SLPError generic_set_val(struct xx_SLPAttributes * slp_attr, const char *
    }
    else
    {
-      SLPError err;
       /*** The attribute already exists. ***/
       /*** Verify type. ***/
       err = attr_type_verify(slp_attr, var, attr_type);
@@ -1616,8 +1769,6 @@ static int internal_store(struct xx_SLPAttributes * slp_attr, char const * tag,
             else
                SLP_ASSERT(0);
 
-            mem_block += val->unescaped_len;
-
             break;
          case(SLP_INTEGER):
             val->data.va_int = (int) strtol(cur_start, 0, 0);
@@ -1628,11 +1779,20 @@ static int internal_store(struct xx_SLPAttributes * slp_attr, char const * tag,
          case(SLP_STRING):
             {
                char * err;
+               char const * data_start = cur_start;
+
+               /* Opaques are stored without their \FF prefix, as
+                * SLPAttrSet_opaque() stores them. */
+               if (type == SLP_OPAQUE && cur_end - cur_start >= OPAQUE_PREFIX_LEN
+                     && strncmp(cur_start, OPAQUE_PREFIX, OPAQUE_PREFIX_LEN) == 0)
+                  data_start += OPAQUE_PREFIX_LEN;
 
                val->data.va_str = mem_block;
-               val->escaped_len = cur_end - cur_start;
-               err = unescape_into(val->data.va_str, cur_start,
-                           val->escaped_len, &val->unescaped_len);
+               err = unescape_into(val->data.va_str, data_start,
+                           cur_end - data_start, &val->unescaped_len);
+               val->escaped_len = type == SLP_OPAQUE
+                     ? val->unescaped_len * ESCAPED_LEN + OPAQUE_PREFIX_LEN
+                     : (size_t)(cur_end - cur_start);
                if (err == 0)
                {
                   /* FIXME */
@@ -1766,6 +1926,33 @@ SLPError SLPAttrSerialize(SLPAttributes attr_h,
    char * tag_cur; /* Current position within tag string. */
    char * tag_end; /* end of current position within tag string. */
 
+   /***** A compact list is already serialized. *****/
+   if (slp_attr->compact_str != 0 && (tags == 0 || *tags == 0)
+         && find_delta != SLP_TRUE)
+   {
+      int i;
+
+      if (count != 0)
+         *count = slp_attr->compact_len + 1;
+      if (*out_buffer == 0)
+      {
+         build_str = (char *) malloc(slp_attr->compact_len + 1);
+         if (build_str == 0)
+            return SLP_MEMORY_ALLOC_FAILED;
+      }
+      else
+      {
+         if (slp_attr->compact_len + 1 > bufferlen)
+            return SLP_BUFFER_OVERFLOW;
+         build_str = *out_buffer;
+      }
+      memcpy(build_str, slp_attr->compact_str, slp_attr->compact_len + 1);
+      for (i = 0; i < slp_attr->attr_count; i++)
+         slp_attr->attrs[i].modified = SLP_FALSE;
+      *out_buffer = build_str;
+      return SLP_OK;
+   }
+
    size = 0;
    var_count = 0;
 
@@ -1987,6 +2174,173 @@ SLPError SLPAttrSerialize(SLPAttributes attr_h,
 }
 
 
+/* A var and its position in the list it came from. Used to sort a list for
+ * SLPAttrCompact without disturbing the order of duplicated tags.
+ */
+typedef struct xx_compact_ent_t
+{
+   var_t * var;
+   int pos;
+} compact_ent_t;
+
+static int compact_ent_compare(const void * a, const void * b)
+{
+   const compact_ent_t * ea = (const compact_ent_t *) a;
+   const compact_ent_t * eb = (const compact_ent_t *) b;
+   int result;
+
+   result = tag_compare(ea->var, eb->var->tag, eb->var->tag_len);
+   if (result != 0)
+      return result;
+   return ea->pos - eb->pos;
+}
+
+/* Converts an attribute list into its compact form.
+ *
+ * A compact list is held in a single allocation: the vars, sorted by tag
+ * so that lookups are binary searches, then the values of every var packed
+ * one after the other, then the tags and string and opaque data, and
+ * finally the serialized list, so that serializing all of the attributes
+ * is a copy.
+ *
+ * A compact list can be read through the whole API. Modifying it (setting
+ * a value or freshening) first turns it back into an ordinary list.
+ *
+ * Returns:
+ *  SLP_OK -- The list is compact (or already was).
+ *  SLP_MEMORY_ALLOC_FAILED -- The list is left as it was.
+ */
+SLPError SLPAttrCompact(SLPAttributes attr_h)
+{
+   struct xx_SLPAttributes * slp_attr = (struct xx_SLPAttributes *) attr_h;
+   compact_ent_t * ents = 0;
+   var_t * var;
+   var_t * dir;
+   var_t * old_list;
+   value_t * value;
+   value_t * packed;
+   char * block;
+   char * data;
+   char * str;
+   size_t str_size;
+   size_t data_size = 0;
+   size_t value_count = 0;
+   int count = 0;
+   int i;
+   SLPError err;
+
+   if (slp_attr->compact)
+      return SLP_OK;
+
+   /***** Find the size of the serialized list. *****/
+   str = (char *) &str_size; /* Any non-null buffer: we only want the size. */
+   err = SLPAttrSerialize(attr_h, 0, &str, 0, &str_size, SLP_FALSE);
+   if (err != SLP_BUFFER_OVERFLOW)
+      return err;
+
+   /***** Size and sort the vars. *****/
+   for (var = slp_attr->attrs; var; var = var->next)
+   {
+      count++;
+      data_size += var->tag_len + 1;
+      for (value = var->list; value; value = value->next)
+      {
+         value_count++;
+         if (var->type == SLP_STRING || var->type == SLP_OPAQUE)
+            data_size += value->unescaped_len;
+      }
+   }
+   if (count != 0)
+   {
+      ents = (compact_ent_t *) malloc(count * sizeof(compact_ent_t));
+      if (ents == 0)
+         return SLP_MEMORY_ALLOC_FAILED;
+      for (i = 0, var = slp_attr->attrs; var; i++, var = var->next)
+      {
+         ents[i].var = var;
+         ents[i].pos = i;
+      }
+      qsort(ents, count, sizeof(compact_ent_t), compact_ent_compare);
+   }
+
+   block = (char *) malloc(count * sizeof(var_t)
+         + value_count * sizeof(value_t) + data_size + str_size);
+   if (block == 0)
+   {
+      free(ents);
+      return SLP_MEMORY_ALLOC_FAILED;
+   }
+   dir = (var_t *) block;
+   packed = (value_t *) (dir + count);
+   data = (char *) (packed + value_count);
+
+   /***** Lay out the vars and their values. *****/
+   for (i = 0; i < count; i++)
+   {
+      var_t * src = ents[i].var;
+
+      dir[i].next = i + 1 < count? &dir[i + 1]: 0;
+      dir[i].type = src->type;
+      dir[i].tag_len = src->tag_len;
+      dir[i].list_size = src->list_size;
+      dir[i].modified = src->modified;
+      dir[i].tag = data;
+      memcpy(data, src->tag, src->tag_len);
+      data[src->tag_len] = 0;
+      data += src->tag_len + 1;
+
+      dir[i].list = src->list? packed: 0;
+      for (value = src->list; value; value = value->next, packed++)
+      {
+         *packed = *value;
+         packed->next = value->next? packed + 1: 0;
+         packed->next_chunk = 0;
+         packed->last_value_in_chunk = 0;
+         if (src->type == SLP_STRING || src->type == SLP_OPAQUE)
+         {
+            packed->data.va_str = data;
+            memcpy(data, value->data.va_str, value->unescaped_len);
+            data += value->unescaped_len;
+         }
+      }
+   }
+
+   /***** Switch to the compact vars and serialize them into the block. *****/
+   old_list = slp_attr->attrs;
+   slp_attr->attrs = count? dir: 0;
+   slp_attr->compact = block;
+   str = data;
+   err = SLPAttrSerialize(attr_h, 0, &str, str_size, &str_size, SLP_FALSE);
+   if (err != SLP_OK)
+   {
+      slp_attr->attrs = old_list;
+      slp_attr->compact = 0;
+      free(block);
+      free(ents);
+      return err;
+   }
+   slp_attr->compact_str = str;
+   slp_attr->compact_len = str_size - 1;
+
+   /* Serializing cleared the modified flags; put them back. */
+   for (i = 0; i < count; i++)
+      dir[i].modified = ents[i].var->modified;
+
+   /***** Free the list. *****/
+   while (old_list)
+   {
+      var = old_list;
+      old_list = var->next;
+      var->next = 0;
+      var_free(var);
+   }
+   free(ents);
+
+   return SLP_OK;
+}
+
+
+
 
 /* Stores an escaped value into an attribute. Determines type of attribute at
  * the same time.
@@ -2137,6 +2491,7 @@ static SLPError attr_destringify(struct xx_SLPAttributes * slp_attr,
    } state = START_ATTR; /* The current state of the parse. */
    char const *tag; /* A tag that has been parsed. (carries data across state changes)*/
    int tag_len = 0; /* length of the tag (in bytes) */
+   SLPError err;
 
    (void)policy;
 
@@ -2144,6 +2499,10 @@ static SLPError attr_destringify(struct xx_SLPAttributes * slp_attr,
    if (strlen(str) == 0)
       return SLP_OK;
 
+   /***** A compact list can't be modified in place. *****/
+   if ((err = attr_expand(slp_attr)) != SLP_OK)
+      return err;
+
    tag = 0;
    cur = str;
    /***** Pull apart str. *****/
@@ -2701,4 +3060,204 @@ SLPBoolean SLPAttrIterValueNext(SLPAttrIterator iter_h, SLPValue *value)
    return SLP_TRUE;
 }
 
+
+#ifdef LIBSLPATTR_TEST
+
+/* Checks that two attribute lists hold the same vars with the same values,
+ * as seen by looking each tag up in both (which, for a duplicated tag, finds
+ * the same one of them in either list).
+ */
+static int test_same_attrs(SLPAttributes a_h, SLPAttributes b_h)
+{
+   struct xx_SLPAttributes * a = (struct xx_SLPAttributes *) a_h;
+   struct xx_SLPAttributes * b = (struct xx_SLPAttributes *) b_h;
+   var_t * var;
+
+   if (a->attr_count != b->attr_count)
+      return -1;
+   for (var = a->attrs; var; var = var->next)
+   {
+      var_t * va = attr_val_find_str(a, var->tag, var->tag_len);
+      var_t * vb = attr_val_find_str(b, var->tag, var->tag_len);
+      value_t * x;
+      value_t * y;
+
+      if (vb == 0 || vb->type != va->type || vb->list_size != va->list_size)
+         return -1;
+      for (x = va->list, y = vb->list; x && y; x = x->next, y = y->next)
+      {
+         switch (va->type)
+         {
+            case SLP_BOOLEAN:
+               if (x->data.va_bool != y->data.va_bool)
+                  return -1;
+               break;
+            case SLP_INTEGER:
+               if (x->data.va_int != y->data.va_int)
+                  return -1;
+               break;
+            default:
+               if (x->unescaped_len != y->unescaped_len || memcmp(
+                     x->data.va_str, y->data.va_str, x->unescaped_len) != 0)
+                  return -1;
+               break;
+         }
+      }
+      if (x || y)
+         return -1;
+   }
+   return 0;
+}
+
+/* Compacts a parsed copy of str and checks it against the list form:
+ * lookups, the getters, iteration, serialization and modification.
+ */
+static int test_SLPAttrCompact(const char * str)
+{
+   SLPAttributes list;
+   SLPAttributes compact;
+   SLPAttributes reparsed;
+   SLPAttributes reparsed2;
+   SLPAttrIterator iter;
+   char const * tag;
+   SLPType type;
+   char * out = 0;
+   char * out2 = 0;
+   char small[1];
+   char * buf;
+   size_t count;
+   size_t size;
+   int * ints;
+   int tags = 0;
+   int result = -1;
+
+   if (SLPAttrAllocStr("en", 0, SLP_FALSE, &list, str) != SLP_OK)
+      return -1;
+   if (SLPAttrAllocStr("en", 0, SLP_FALSE, &compact, str) != SLP_OK)
+      return -1;
+   if (SLPAttrCompact(compact) != SLP_OK || SLPAttrCompact(compact) != SLP_OK)
+      return -1;
+   if (test_same_attrs(list, compact) != 0)
+      goto done;
+
+   /* Tags are case insensitive. */
+   if (SLPAttrGetType(list, "NAME", &type) == SLP_OK
+         && (SLPAttrGetType(compact, "name", &type) != SLP_OK
+         || SLPAttrGetType(compact, "NaMe", &type) != SLP_OK))
+      goto done;
+   if (SLPAttrGetType(compact, "no-such-tag", &type) != SLP_TAG_ERROR)
+      goto done;
+
+   /* Every tag is iterated over. */
+   if (SLPAttrIteratorAlloc(compact, &iter) != SLP_OK)
+      goto done;
+   while (SLPAttrIterNext(iter, &tag, &type))
+      tags++;
+   SLPAttrIteratorFree(iter);
+   if (tags != ((struct xx_SLPAttributes *) list)->attr_count)
+      goto done;
+
+   /* The copied serialization reports its size as a normal serialization
+    * does, and parses back to the same attributes as that one.
+    */
+   if (SLPAttrSerialize(compact, 0, &out, 0, &count, SLP_FALSE) != SLP_OK)
+      goto done;
+   if (SLPAttrSerialize(list, 0, &out2, 0, &size, SLP_FALSE) != SLP_OK
+         || size != count || strlen(out) + 1 != count)
+      goto done;
+   if (SLPAttrAllocStr("en", 0, SLP_FALSE, &reparsed, out) != SLP_OK)
+      goto done;
+   if (SLPAttrAllocStr("en", 0, SLP_FALSE, &reparsed2, out2) != SLP_OK)
+   {
+      SLPAttrFree(reparsed);
+      goto done;
+   }
+   result = test_same_attrs(reparsed, reparsed2);
+   SLPAttrFree(reparsed);
+   SLPAttrFree(reparsed2);
+   if (result != 0)
+      goto done;
+   result = -1;
+   out2[0] = 0;
+   if (SLPAttrSerialize(compact, 0, &out2, count, &size, SLP_FALSE) != SLP_OK
+         || strcmp(out, out2) != 0)
+      goto done;
+   buf = small;
+   if (count > 1 && SLPAttrSerialize(compact, 0, &buf, sizeof small, &size,
+         SLP_FALSE) != SLP_BUFFER_OVERFLOW)
+      goto done;
+   free(out2);
+   out2 = 0;
+
+   /* Serializing a chosen set of tags gives the same string either way. */
+   free(out);
+   out = 0;
+   if (SLPAttrSerialize(list, "x,name,kw", &out, 0, &count, SLP_FALSE)
+            != SLP_OK
+         || SLPAttrSerialize(compact, "x,name,kw", &out2, 0, &size,
+            SLP_FALSE) != SLP_OK
+         || strcmp(out, out2) != 0)
+      goto done;
+
+   /* Modifying a compact list expands it first. */
+   if (SLPAttrSet_int(list, "added", 42, SLP_ADD) != SLP_OK
+         || SLPAttrSet_int(compact, "added", 42, SLP_ADD) != SLP_OK
+         || ((struct xx_SLPAttributes *) compact)->compact != 0
+         || test_same_attrs(list, compact) != 0)
+      goto done;
+   if (SLPAttrGet_int(compact, "added", &ints, &size) != SLP_OK
+         || size != 1 || ints[0] != 42)
+      goto done;
+   free(ints);
+   if (SLPAttrFreshen(list, "(more=yes)") != SLP_OK
+         || SLPAttrCompact(compact) != SLP_OK
+         || SLPAttrFreshen(compact, "(more=yes)") != SLP_OK
+         || test_same_attrs(list, compact) != 0)
+      goto done;
+
+   result = 0;
+
+done:
+   free(out);
+   free(out2);
+   SLPAttrFree(list);
+   SLPAttrFree(compact);
+   return result;
+}
+
+/* ---------------- Test main for the libslpattr.c module ----------------
+ *
+ * Compile with:
+ *    gcc -g -Wall -I .. -o0 -D LIBSLPATTR_TEST -D DEBUG -D HAVE_CONFIG_H \
+ *       -o slp-attr-test libslpattr.c ../common/slp_compare.c \
+ *       ../common/slp_debug.c ../common/slp_linkedlist.c \
+ *       ../common/slp_xmalloc.c -lm
+ */
+int main(void)
+{
+   static const char * lists[] =
+   {
+      "",
+      "kw",
+      "(name=foo)",
+      "(name=Foo),(x=4),kw,(b=true),(Y=-12,7,3)",
+      "(z=1),(y=2),(x=3),(w=4),(v=5),(u=6),(t=7),(s=8),(r=9),(q=10)",
+      "(s=a\\2cb,c\\29d,e),(n=false),zz,aa,MM,(name=x),(i=100,-1000)",
+      "(dup=1),(DUP=2),(dup=three),(t=true),Kw,kw",
+      "(a=1),(ab=2),(abc=3),(b=4),(AB=y),(a-b=x),(a.b=z)",
+   };
+   size_t i;
+
+   for (i = 0; i < sizeof(lists) / sizeof(*lists); i++)
+      if (test_SLPAttrCompact(lists[i]) != 0)
+      {
+         printf("FAIL: \"%s\"\n", lists[i]);
+         return -1;
+      }
+
+   return 0;
+}
+
+#endif /* LIBSLPATTR_TEST */
+
 /*=========================================================================*/
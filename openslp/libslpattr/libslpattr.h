@@ -166,6 +166,8 @@ SLPError SLPAttrSerialize(SLPAttributes attr_h,
 
 SLPError SLPAttrFreshen(SLPAttributes attr_h, const char * new_attrs);
 
+SLPError SLPAttrCompact(SLPAttributes attr_h);
+
 SLPError SLPAttributeSearchString(size_t search_str_len, const char * search_str, size_t *processed_len, char * *processed_str);
 
 /* Functions. */
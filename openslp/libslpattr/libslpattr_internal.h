@@ -107,6 +107,12 @@ typedef struct xx_var_t
  *****************************************************************************/
 
 /* The opaque struct representing a SLPAttributes handle.
+ *
+ * A handle is either a list or compact (see SLPAttrCompact). A compact
+ * handle keeps all of its vars, values and strings in the single block
+ * pointed to by compact: attrs is then an array of attr_count vars sorted
+ * by tag (still linked through next), each var's values are packed
+ * contiguously, and compact_str holds the serialized list.
  */
 struct xx_SLPAttributes
 {
@@ -114,6 +120,9 @@ struct xx_SLPAttributes
    char * lang; /* Language. */
    var_t * attrs; /* List of vars to be sent. */
    int attr_count; /* The number of attributes */
+   char * compact; /* The block holding a compact list, or 0. */
+   char * compact_str; /* The serialized compact list (inside compact). */
+   size_t compact_len; /* The length of compact_str, excluding the null. */
 };
 
 /* Finds a variable by its tag. */
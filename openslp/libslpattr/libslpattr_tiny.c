@@ -112,6 +112,13 @@ SLPError SLPAttrFreshen(SLPAttributes attr_h, const char * new_attrs)
 }
 
 
+/* The tiny attribute structure is always compact. */
+SLPError SLPAttrCompact(SLPAttributes attr_h)
+{
+   return SLP_OK;
+}
+
+
 SLPError SLPAttrSerialize(SLPAttributes attr_h,
       const char * tags /* NULL terminated */,
       char ** out_buffer /* Where to write. if *out_buffer == NULL, space is alloc'd */,
@@ -69,6 +69,25 @@
  */
 #define SLPD_COMFORT_SOCKETS 64
 
+/** Maximum number of unacknowledged messages on a DA forwarding channel.
+ */
+#define SLPD_FORWARD_WINDOW 16
+
+/** Size of a forwarding channel's xid index (a power of two, at least
+ *  twice SLPD_FORWARD_WINDOW so probe sequences stay short).
+ */
+#define SLPD_FORWARD_SLOTS 32
+
+/** Number of buckets in the outgoing socket peer address index (a power
+ *  of two).
+ */
+#define SLPD_OUTGOING_BUCKETS 64
+
+/** Number of one-second slots in the outgoing retry wheel (a power of
+ *  two). A retry due further out waits for the wheel to come round.
+ */
+#define SLPD_RETRY_SLOTS 64
+
 /** Maximum idle time (60 min) when not busy.
  */
 #define SLPD_CONFIG_CLOSE_CONN 900
@@ -0,0 +1,221 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Publishing the known DAs to local processes.
+ *
+ * When net.slp.DACacheFile is set, slpd keeps a copy of its known DA
+ * table in a shared DA cache (see slp_dacache.c) that every process
+ * linked with libslp maps read-only. libslp then learns the DAs without
+ * asking slpd over IPC, and without discovering them itself.
+ *
+ * The cache holds the same DAAdverts, in the same order, as the reply
+ * to a DA SrvRqst through the loopback: our own first if we are a DA,
+ * then every known DA. It is rewritten whenever the table changes, and
+ * from the age timer so that readers can tell a live slpd from one that
+ * stopped without removing the file.
+ *
+ * @file       slpd_dacache.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    SlpdCode
+ */
+
+#include "slpd_dacache.h"
+#include "slpd_knownda.h"
+#include "slpd_log.h"
+#include "slpd_property.h"
+
+#include "slp_dacache.h"
+#include "slp_net.h"
+#include "slp_xmalloc.h"
+
+static char * G_DACachePath = 0;             /*!< The cache file name. */
+static SLPDACacheHeader * G_DACache = 0;     /*!< The mapped cache. */
+static uint8_t * G_DACacheEntries = 0;       /*!< Scratch for the entries. */
+static size_t G_DACacheRoom = 0;             /*!< Size of the scratch. */
+static int G_DACacheFull = 0;                /*!< Overflow was logged. */
+
+/** Add a DAAdvert to the entries being published.
+ *
+ * @param[in] addr - The DA's address.
+ * @param[in] buf - The DAAdvert message buffer.
+ * @param[in,out] used - The length of the entries so far.
+ *
+ * @return Zero on success, a positive value if the DA's address is of
+ *    an unknown family, or a negative value if the DAAdvert does not fit.
+ *
+ * @internal
+ */
+static int DACacheAdd(struct sockaddr_storage * addr, SLPBuffer buf,
+      size_t * used)
+{
+   size_t msglen = buf->end - buf->start;
+   uint8_t * msg;
+   size_t len;
+
+   if (SLP_DACACHE_ENTRYLEN(msglen) > G_DACacheRoom - *used)
+      return -1;
+
+   /* as for the loopback reply, the DA's port is ours */
+   SLPNetSetPort(addr, G_SlpdProperty.port);
+   len = SLPDACachePutEntry(G_DACacheEntries + *used, addr, buf->start,
+         msglen);
+   if (len == 0)
+      return 1;
+
+   /* TRICKY: clear the flags, as for the loopback reply. */
+   msg = G_DACacheEntries + *used + sizeof(SLPDACacheEntry);
+   if (*msg == 1)
+      msg[4] = 0;
+   else
+      TO_UINT16(msg + 5, 0);
+
+   *used += len;
+   return 0;
+}
+
+/** Create the shared DA cache, if one is configured.
+ *
+ * Must be called while slpd may still create files where the cache
+ * lives, that is before privileges are dropped.
+ *
+ * @return Zero - always; a cache that cannot be created is logged and
+ *    otherwise ignored, and libslp asks slpd over IPC instead.
+ */
+int SLPDDACacheInit(void)
+{
+   if (G_DACache || G_SlpdProperty.DACacheFile == 0
+         || *G_SlpdProperty.DACacheFile == 0)
+      return 0;
+
+   G_DACacheRoom = SLP_DACACHE_SIZE - sizeof(SLPDACacheHeader);
+   G_DACachePath = xstrdup(G_SlpdProperty.DACacheFile);
+   G_DACacheEntries = xmalloc(G_DACacheRoom);
+   if (G_DACachePath && G_DACacheEntries)
+      G_DACache = SLPDACacheCreate(G_DACachePath, SLP_DACACHE_SIZE);
+   if (G_DACache == 0)
+   {
+      SLPDLog("Could not create DA cache %s\n", G_SlpdProperty.DACacheFile);
+      SLPDDACacheDeinit();
+      return 0;
+   }
+
+   SLPDLog("Publishing known DAs in %s\n", G_DACachePath);
+   SLPDDACachePublish();
+   return 0;
+}
+
+/** Remove the shared DA cache. */
+void SLPDDACacheDeinit(void)
+{
+   if (G_DACache)
+      SLPDACacheDestroy(G_DACache, G_DACachePath);
+   G_DACache = 0;
+   xfree(G_DACachePath);
+   xfree(G_DACacheEntries);
+   G_DACachePath = 0;
+   G_DACacheEntries = 0;
+   G_DACacheRoom = 0;
+   G_DACacheFull = 0;
+}
+
+/** Rewrite the shared DA cache from the known DA table.
+ *
+ * Called whenever a DA is added, updated or removed, and from the age
+ * timer.
+ */
+void SLPDDACachePublish(void)
+{
+   SLPMessage * msg;
+   SLPBuffer buf;
+   size_t used = 0;
+   uint32_t count = 0;
+   uint32_t flags = 0;
+   void * eh;
+
+   if (G_DACache == 0)
+      return;
+
+   /* If we are a DA, we come first, so local requests stay local. */
+   if (G_SlpdProperty.isDA)
+   {
+      struct sockaddr_storage loaddr;
+      SLPBuffer tmp = 0;
+
+      if (SLPNetIsIPV4())
+      {
+         int addr = INADDR_LOOPBACK;
+         SLPNetSetAddr(&loaddr, AF_INET, G_SlpdProperty.port, &addr);
+      }
+      else
+         SLPNetSetAddr(&loaddr, AF_INET6, G_SlpdProperty.port,
+               &slp_in6addr_loopback);
+
+      if (SLPDKnownDAGenerateMyDAAdvert(&loaddr, 0, 0, 0, 0, &tmp) == 0)
+      {
+         int added = DACacheAdd(&loaddr, tmp, &used);
+
+         if (added == 0)
+            count++;
+         else if (added < 0)
+            flags |= SLP_DACACHE_INCOMPLETE;
+      }
+      if (tmp)
+         SLPBufferFree(tmp);
+   }
+
+   if ((eh = SLPDKnownDAEnumStart()) != 0)
+   {
+      while (SLPDKnownDAEnum(eh, &msg, &buf) != 0)
+      {
+         struct sockaddr_storage addr = msg->peer;
+         int added = DACacheAdd(&addr, buf, &used);
+
+         if (added < 0)
+         {
+            flags |= SLP_DACACHE_INCOMPLETE;
+            break;
+         }
+         if (added == 0)
+            count++;
+      }
+      SLPDKnownDAEnumEnd(eh);
+   }
+
+   if ((flags & SLP_DACACHE_INCOMPLETE) && !G_DACacheFull)
+      SLPDLog("Too many DAs for DA cache %s; local processes will ask "
+            "slpd instead\n", G_DACachePath);
+   G_DACacheFull = (flags & SLP_DACACHE_INCOMPLETE) != 0;
+
+   SLPDACachePublish(G_DACache, G_DACacheEntries, used, count, flags);
+}
+
+/*=========================================================================*/
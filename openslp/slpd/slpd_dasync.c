@@ -0,0 +1,853 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Anti-entropy replication between DAs serving the same scopes.
+ *
+ * DAs that serve a scope learn its registrations only from the SAs that
+ * send them, so a DA that restarts stays incomplete until every SA has
+ * refreshed. When net.slp.DASyncInterval is set, a DA asks each peer DA
+ * for the registrations it lacks whenever it first hears from the peer,
+ * and again every interval after that.
+ *
+ * The request is an ordinary SrvRqst for SLPD_DASYNC_SERVICE_TYPE in the
+ * scopes both DAs serve, sent over a TCP connection that is kept open
+ * between rounds. Its predicate carries a digest of the requester's
+ * registrations in those scopes, hashed by URL into SLPD_DASYNC_BUCKETS
+ * buckets. The peer digests its own registrations the same way, queues
+ * every registration of a bucket whose digest differs on its forwarding
+ * channel to the requester, and answers with an empty SrvRply - which is
+ * also all that a DA without this extension does.
+ *
+ * Registrations are copied, and a copy ages out with the lifetime it had
+ * left on the DA that sent it. A copy is tagged SLP_REG_SOURCE_PEER_DA,
+ * and like any registration may only be replaced or removed from the
+ * address it came from, that of the peer DA.
+ *
+ * A DA keeps a tombstone for every registration deregistered from it
+ * until any copy of it on a peer DA has aged out. It does not take a
+ * copy back from a peer DA while the tombstone lasts, and sends the
+ * deregistration on to a peer DA that asks to sync, which drops its copy
+ * if it came from us.
+ *
+ * @file       slpd_dasync.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    SlpdCode
+ */
+
+#include "slpd_dasync.h"
+#include "slpd_database.h"
+#include "slpd_knownda.h"
+#include "slpd_outgoing.h"
+#include "slpd_property.h"
+#include "slpd_socket.h"
+
+#include "slp_compare.h"
+#include "slp_hash.h"
+#include "slp_net.h"
+#include "slp_xid.h"
+#include "slp_xmalloc.h"
+
+/** The length of the "(tag=digests)" predicate of a DA sync request. */
+#define DASYNC_PREDICATE_LEN \
+      (sizeof(SLPD_DASYNC_DIGEST_TAG) - 1 + 3 + SLPD_DASYNC_BUCKETS * 8)
+
+/** A recent deregistration. */
+typedef struct _DASyncTombstone
+{
+   SLPListItem listitem;   /*!< Makes this a list item. */
+   time_t expiry;          /*!< When every copy has aged out. */
+   size_t urllen;          /*!< The length of @e url in bytes. */
+   char * url;             /*!< The URL deregistered. */
+   size_t scopelistlen;    /*!< The length of @e scopelist in bytes. */
+   char * scopelist;       /*!< The scopes of the registration. */
+} DASyncTombstone;
+
+/** The tombstones of recent deregistrations, oldest first. */
+static SLPList G_DASyncTombstones = {0, 0, 0};
+
+/** Test whether we are a DA that syncs with its peers.
+ *
+ * @return Non-zero if DA sync is enabled.
+ *
+ * @internal
+ */
+static int DASyncEnabled(void)
+{
+   return G_SlpdProperty.isDA && G_SlpdProperty.DASyncInterval > 0;
+}
+
+/** Find the tombstone of a registration, dropping expired ones.
+ *
+ * @param[in] srvreg - The registration.
+ *
+ * @return The tombstone of a deregistration of the URL of @p srvreg in
+ *    any of its scopes, or NULL if there is none.
+ *
+ * @internal
+ */
+static DASyncTombstone * DASyncTombstoneFind(SLPSrvReg * srvreg)
+{
+   DASyncTombstone * tomb = (DASyncTombstone *)G_DASyncTombstones.head;
+   time_t now = time(0);
+
+   while (tomb)
+   {
+      DASyncTombstone * next = (DASyncTombstone *)tomb->listitem.next;
+
+      if (tomb->expiry <= now)
+         xfree(SLPListUnlink(&G_DASyncTombstones, &tomb->listitem));
+      else if (SLPCompareString(tomb->urllen, tomb->url,
+                  srvreg->urlentry.urllen, srvreg->urlentry.url) == 0
+            && SLPIntersectStringList(tomb->scopelistlen, tomb->scopelist,
+                  srvreg->scopelistlen, srvreg->scopelist))
+         return tomb;
+      tomb = next;
+   }
+   return 0;
+}
+
+/** Test whether a registration takes part in a sync.
+ *
+ * @param[in] msg - The SrvReg message of the registration.
+ * @param[in] scopelistlen - The length of @p scopelist in bytes.
+ * @param[in] scopelist - The scopes being synced.
+ *
+ * @return Non-zero if every scope of the registration is in
+ *    @p scopelist, so that either DA can hold it.
+ *
+ * @internal
+ */
+static int DASyncCovers(SLPMessage * msg, size_t scopelistlen,
+      const char * scopelist)
+{
+   /* SLPv1 registrations are kept in SLPv1 wire format; leave them be */
+   return msg->header.version == 2
+         && SLPSubsetStringList(scopelistlen, scopelist,
+               msg->body.srvreg.scopelistlen, msg->body.srvreg.scopelist);
+}
+
+/** Digest a registration.
+ *
+ * @param[in] srvreg - The registration to digest.
+ * @param[out] bucket - The digest bucket of the registration.
+ *
+ * @return The digest of everything but the lifetime of @p srvreg.
+ *
+ * @internal
+ */
+static uint32_t DASyncEntryDigest(SLPSrvReg * srvreg, unsigned * bucket)
+{
+   uint32_t digest = SLPHash(srvreg->urlentry.url, srvreg->urlentry.urllen);
+
+   *bucket = digest % SLPD_DASYNC_BUCKETS;
+   digest = digest * 31 + SLPHash(srvreg->srvtype, srvreg->srvtypelen);
+   digest = digest * 31 + SLPHash(srvreg->scopelist, srvreg->scopelistlen);
+   digest = digest * 31 + SLPHash(srvreg->attrlist, srvreg->attrlistlen);
+   return digest;
+}
+
+/** Digest the registrations in a set of scopes.
+ *
+ * @param[in] scopelistlen - The length of @p scopelist in bytes.
+ * @param[in] scopelist - The scopes being synced.
+ * @param[out] digests - The SLPD_DASYNC_BUCKETS bucket digests.
+ *
+ * @remarks A bucket digest is the sum of the digests of its
+ *    registrations, so it does not depend on their order.
+ *
+ * @internal
+ */
+static void DASyncDigest(size_t scopelistlen, const char * scopelist,
+      uint32_t * digests)
+{
+   void * eh;
+   SLPMessage * msg;
+   SLPBuffer buf;
+   unsigned bucket;
+
+   memset(digests, 0, SLPD_DASYNC_BUCKETS * sizeof(*digests));
+
+   eh = SLPDDatabaseEnumStart();
+   if (eh == 0)
+      return;
+
+   while (SLPDDatabaseEnum(eh, &msg, &buf))
+   {
+      if (DASyncCovers(msg, scopelistlen, scopelist))
+      {
+         uint32_t digest = DASyncEntryDigest(&msg->body.srvreg, &bucket);
+         digests[bucket] += digest;
+      }
+   }
+   SLPDDatabaseEnumEnd(eh);
+}
+
+/** Parse the digests out of the predicate of a DA sync request.
+ *
+ * @param[in] predicatelen - The length of @p predicate in bytes.
+ * @param[in] predicate - The predicate of the request.
+ * @param[out] digests - The SLPD_DASYNC_BUCKETS bucket digests.
+ *
+ * @return Zero on success, or non-zero if @p predicate is malformed.
+ *
+ * @internal
+ */
+static int DASyncParseDigests(size_t predicatelen, const char * predicate,
+      uint32_t * digests)
+{
+   size_t taglen = sizeof(SLPD_DASYNC_DIGEST_TAG) - 1;
+   const char * hex;
+   int i, j;
+
+   if (predicatelen != DASYNC_PREDICATE_LEN
+         || predicate[0] != '('
+         || memcmp(predicate + 1, SLPD_DASYNC_DIGEST_TAG, taglen) != 0
+         || predicate[taglen + 1] != '='
+         || predicate[predicatelen - 1] != ')')
+      return -1;
+
+   hex = predicate + taglen + 2;
+   for (i = 0; i < SLPD_DASYNC_BUCKETS; i++)
+   {
+      digests[i] = 0;
+      for (j = 0; j < 8; j++, hex++)
+      {
+         if (*hex >= '0' && *hex <= '9')
+            digests[i] = (digests[i] << 4) | (*hex - '0');
+         else if (*hex >= 'a' && *hex <= 'f')
+            digests[i] = (digests[i] << 4) | (*hex - 'a' + 10);
+         else
+            return -1;
+      }
+   }
+   return 0;
+}
+
+/** Collect the scopes we serve that a peer DA serves too.
+ *
+ * @param[in] scopelistlen - The length of @p scopelist in bytes.
+ * @param[in] scopelist - The scopes of the peer DA.
+ * @param[out] len - The length of the returned list in bytes.
+ *
+ * @return The (null-terminated) list of common scopes, which the caller
+ *    must free with xfree, or NULL if there are none or on memory
+ *    allocation failure.
+ *
+ * @internal
+ */
+static char * DASyncScopes(size_t scopelistlen, const char * scopelist,
+      size_t * len)
+{
+   const char * item = G_SlpdProperty.useScopes;
+   const char * end = item + G_SlpdProperty.useScopesLen;
+   const char * comma;
+   char * scopes;
+
+   *len = 0;
+   if (item == 0 || (scopes = xmalloc(G_SlpdProperty.useScopesLen + 1)) == 0)
+      return 0;
+
+   while (item < end)
+   {
+      comma = memchr(item, ',', end - item);
+      if (comma == 0)
+         comma = end;
+      if (comma > item && SLPContainsStringList(scopelistlen, scopelist,
+            comma - item, item))
+      {
+         if (*len)
+            scopes[(*len)++] = ',';
+         memcpy(scopes + *len, item, comma - item);
+         *len += comma - item;
+      }
+      item = comma + 1;
+   }
+
+   if (*len == 0)
+   {
+      xfree(scopes);
+      return 0;
+   }
+   scopes[*len] = 0;
+   return scopes;
+}
+
+/** Send a registration to the DA that asked for it.
+ *
+ * @param[in] peer - The address of the DA.
+ * @param[in] msg - The SrvReg message of the registration.
+ * @param[in] buf - The SrvReg message buffer of the registration.
+ *
+ * @internal
+ */
+static void DASyncPush(struct sockaddr_storage * peer, SLPMessage * msg,
+      SLPBuffer buf)
+{
+   SLPBuffer dup;
+   uint8_t * lifetime;
+
+   if (msg->body.srvreg.urlentry.lifetime <= 0)
+      return;
+
+   dup = SLPBufferDup(buf);
+   if (dup == 0)
+      return;
+
+   /* the copy gets the lifetime the registration has left here */
+   lifetime = dup->start + (msg->body.srvreg.urlentry.opaque - buf->start) + 1;
+   PutUINT16(&lifetime, msg->body.srvreg.urlentry.lifetime);
+
+   SLPDOutgoingForward(peer, dup, 0);
+}
+
+/** Build the SrvDeReg of a tombstone.
+ *
+ * @param[in] tomb - The tombstone of the deregistration.
+ *
+ * @return The SrvDeReg message buffer, or NULL on memory allocation
+ *    failure.
+ *
+ * @internal
+ */
+static SLPBuffer DASyncMakeDeReg(DASyncTombstone * tomb)
+{
+   size_t size;
+   SLPBuffer buf;
+
+   size = 14 + G_SlpdProperty.localeLen    /* header and lang tag     */
+         + 2 + tomb->scopelistlen
+         + 5 + tomb->urllen + 1            /* URL entry, no auths     */
+         + 2;                              /* empty tag list          */
+   buf = SLPBufferAlloc(size);
+   if (buf == 0)
+      return 0;
+
+   /* header */
+   *buf->curpos++ = 2;
+   *buf->curpos++ = SLP_FUNCT_SRVDEREG;
+   PutUINT24(&buf->curpos, size);
+   PutUINT16(&buf->curpos, 0);
+   PutUINT24(&buf->curpos, 0);
+   PutUINT16(&buf->curpos, 0);
+   PutUINT16(&buf->curpos, G_SlpdProperty.localeLen);
+   memcpy(buf->curpos, G_SlpdProperty.locale, G_SlpdProperty.localeLen);
+   buf->curpos += G_SlpdProperty.localeLen;
+
+   /* scope list */
+   PutUINT16(&buf->curpos, tomb->scopelistlen);
+   memcpy(buf->curpos, tomb->scopelist, tomb->scopelistlen);
+   buf->curpos += tomb->scopelistlen;
+
+   /* URL entry */
+   *buf->curpos++ = 0;
+   PutUINT16(&buf->curpos, 0);
+   PutUINT16(&buf->curpos, tomb->urllen);
+   memcpy(buf->curpos, tomb->url, tomb->urllen);
+   buf->curpos += tomb->urllen;
+   *buf->curpos++ = 0;
+
+   /* tag list */
+   PutUINT16(&buf->curpos, 0);
+
+   buf->curpos = buf->start;
+   return buf;
+}
+
+/** Keep a tombstone for a registration that is being deregistered.
+ *
+ * @param[in] msg - The SrvReg message of the registration.
+ *
+ * @remarks The tombstone lasts as long as the registration had left,
+ *    which no copy of it on a peer DA can outlive.
+ */
+void SLPDDASyncTombstone(SLPMessage * msg)
+{
+   SLPSrvReg * srvreg = &msg->body.srvreg;
+   DASyncTombstone * tomb;
+
+   if (!DASyncEnabled() || msg->header.version != 2)
+      return;
+
+   if ((tomb = DASyncTombstoneFind(srvreg)) != 0)
+      xfree(SLPListUnlink(&G_DASyncTombstones, &tomb->listitem));
+
+   tomb = xmalloc(sizeof(*tomb) + srvreg->urlentry.urllen
+         + srvreg->scopelistlen);
+   if (tomb == 0)
+      return;
+   memset(tomb, 0, sizeof(*tomb));
+   tomb->expiry = time(0) + srvreg->urlentry.lifetime;
+   tomb->urllen = srvreg->urlentry.urllen;
+   tomb->url = (char *)(tomb + 1);
+   memcpy(tomb->url, srvreg->urlentry.url, tomb->urllen);
+   tomb->scopelistlen = srvreg->scopelistlen;
+   tomb->scopelist = tomb->url + tomb->urllen;
+   memcpy(tomb->scopelist, srvreg->scopelist, tomb->scopelistlen);
+   SLPListLinkTail(&G_DASyncTombstones, &tomb->listitem);
+}
+
+/** Test whether a registration may be added to the database.
+ *
+ * A copy from a peer DA of a registration that was deregistered from us
+ * since is refused. A registration from anywhere else lays the
+ * tombstone of its URL to rest.
+ *
+ * @param[in] msg - The SrvReg message of the registration, with its
+ *    source set.
+ *
+ * @return Non-zero if the registration may be added.
+ */
+int SLPDDASyncAccepts(SLPMessage * msg)
+{
+   DASyncTombstone * tomb;
+
+   if (G_DASyncTombstones.count == 0
+         || (tomb = DASyncTombstoneFind(&msg->body.srvreg)) == 0)
+      return 1;
+   if (msg->body.srvreg.source == SLP_REG_SOURCE_PEER_DA)
+      return 0;
+   xfree(SLPListUnlink(&G_DASyncTombstones, &tomb->listitem));
+   return 1;
+}
+
+/** Release the tombstones. */
+void SLPDDASyncDeinit(void)
+{
+   while (G_DASyncTombstones.count)
+      xfree(SLPListUnlink(&G_DASyncTombstones, G_DASyncTombstones.head));
+}
+
+/** Test whether an address is that of a DA we sync with.
+ *
+ * @param[in] addr - The address to test.
+ *
+ * @return Non-zero if we are a DA that syncs and @p addr is one of our
+ *    known DAs.
+ */
+int SLPDDASyncIsPeer(struct sockaddr_storage * addr)
+{
+   void * eh;
+   SLPMessage * msg;
+   SLPBuffer buf;
+   int found = 0;
+
+   if (!DASyncEnabled())
+      return 0;
+
+   eh = SLPDKnownDAEnumStart();
+   if (eh)
+   {
+      while (!found && SLPDKnownDAEnum(eh, &msg, &buf))
+         found = SLPNetCompareAddrs(&msg->peer, addr) == 0;
+      SLPDKnownDAEnumEnd(eh);
+   }
+   return found;
+}
+
+/** Ask a peer DA for the registrations we lack.
+ *
+ * @param[in] daadvert - The DAAdvert message of the peer DA.
+ *
+ * @remarks The request is queued on the TCP connection to the peer DA,
+ *    unless the previous one has not been answered yet.
+ */
+void SLPDDASyncRequest(SLPMessage * daadvert)
+{
+   SLPDAAdvert * da = &daadvert->body.daadvert;
+   uint32_t digests[SLPD_DASYNC_BUCKETS];
+   SLPDSocket * sock;
+   SLPBuffer buf;
+   char * scopes;
+   size_t scopeslen;
+   size_t size;
+   int i;
+
+   if (!DASyncEnabled())
+      return;
+
+   scopes = DASyncScopes(da->scopelistlen, da->scopelist, &scopeslen);
+   if (scopes == 0)
+      return;
+
+   sock = SLPDOutgoingConnect(1, &daadvert->peer);
+   if (sock == 0 || sock->sendbuf || sock->sendlist.count)
+      goto FINISHED;
+
+   DASyncDigest(scopeslen, scopes, digests);
+
+   size = 14 + G_SlpdProperty.localeLen    /* header and lang tag     */
+         + 2                               /* empty prlist            */
+         + 2 + sizeof(SLPD_DASYNC_SERVICE_TYPE) - 1
+         + 2 + scopeslen
+         + 2 + DASYNC_PREDICATE_LEN
+         + 2;                              /* empty SLP SPI           */
+   buf = SLPBufferAlloc(size);
+   if (buf == 0)
+      goto FINISHED;
+
+   /* header */
+   *buf->curpos++ = 2;
+   *buf->curpos++ = SLP_FUNCT_SRVRQST;
+   PutUINT24(&buf->curpos, size);
+   PutUINT16(&buf->curpos, 0);
+   PutUINT24(&buf->curpos, 0);
+   PutUINT16(&buf->curpos, SLPXidGenerate());
+   PutUINT16(&buf->curpos, G_SlpdProperty.localeLen);
+   memcpy(buf->curpos, G_SlpdProperty.locale, G_SlpdProperty.localeLen);
+   buf->curpos += G_SlpdProperty.localeLen;
+
+   /* prlist */
+   PutUINT16(&buf->curpos, 0);
+
+   /* service type */
+   PutUINT16(&buf->curpos, sizeof(SLPD_DASYNC_SERVICE_TYPE) - 1);
+   memcpy(buf->curpos, SLPD_DASYNC_SERVICE_TYPE,
+         sizeof(SLPD_DASYNC_SERVICE_TYPE) - 1);
+   buf->curpos += sizeof(SLPD_DASYNC_SERVICE_TYPE) - 1;
+
+   /* scope list */
+   PutUINT16(&buf->curpos, scopeslen);
+   memcpy(buf->curpos, scopes, scopeslen);
+   buf->curpos += scopeslen;
+
+   /* predicate */
+   PutUINT16(&buf->curpos, DASYNC_PREDICATE_LEN);
+   *buf->curpos++ = '(';
+   memcpy(buf->curpos, SLPD_DASYNC_DIGEST_TAG,
+         sizeof(SLPD_DASYNC_DIGEST_TAG) - 1);
+   buf->curpos += sizeof(SLPD_DASYNC_DIGEST_TAG) - 1;
+   *buf->curpos++ = '=';
+   for (i = 0; i < SLPD_DASYNC_BUCKETS; i++)
+   {
+      int shift;
+      for (shift = 28; shift >= 0; shift -= 4)
+         *buf->curpos++ = "0123456789abcdef"[(digests[i] >> shift) & 0xf];
+   }
+   *buf->curpos++ = ')';
+
+   /* SLP SPI */
+   PutUINT16(&buf->curpos, 0);
+
+   buf->curpos = buf->start;
+   SLPListLinkTail(&sock->sendlist, (SLPListItem *) buf);
+   if (sock->state == STREAM_CONNECT_IDLE)
+      sock->state = STREAM_WRITE_FIRST;
+
+FINISHED:
+
+   xfree(scopes);
+}
+
+/** Answer a DA sync request from a peer DA.
+ *
+ * Sends the peer every registration of each bucket whose digest differs
+ * from the peer's, and every recent deregistration in the scopes being
+ * synced. The caller answers the request itself.
+ *
+ * @param[in] message - The SrvRqst message of the request.
+ */
+void SLPDDASyncRespond(SLPMessage * message)
+{
+   SLPSrvRqst * srvrqst = &message->body.srvrqst;
+   uint32_t theirs[SLPD_DASYNC_BUCKETS];
+   uint32_t ours[SLPD_DASYNC_BUCKETS];
+   void * eh;
+   DASyncTombstone * tomb;
+   SLPMessage * msg;
+   SLPBuffer buf;
+   unsigned bucket;
+
+   if (!SLPDDASyncIsPeer(&message->peer)
+         || !SLPSubsetStringList(G_SlpdProperty.useScopesLen,
+               G_SlpdProperty.useScopes, srvrqst->scopelistlen,
+               srvrqst->scopelist)
+         || DASyncParseDigests(srvrqst->predicatelen, srvrqst->predicate,
+               theirs) != 0)
+      return;
+
+   DASyncDigest(srvrqst->scopelistlen, srvrqst->scopelist, ours);
+   if (memcmp(ours, theirs, sizeof(ours)) == 0)
+      return;
+
+   /* the peer may still have, and keep sending us, what was deregistered */
+   for (tomb = (DASyncTombstone *)G_DASyncTombstones.head; tomb;
+         tomb = (DASyncTombstone *)tomb->listitem.next)
+   {
+      if (tomb->expiry > time(0)
+            && SLPSubsetStringList(srvrqst->scopelistlen, srvrqst->scopelist,
+                  tomb->scopelistlen, tomb->scopelist)
+            && (buf = DASyncMakeDeReg(tomb)) != 0)
+         SLPDOutgoingForward(&message->peer, buf, 0);
+   }
+
+   eh = SLPDDatabaseEnumStart();
+   if (eh == 0)
+      return;
+
+   while (SLPDDatabaseEnum(eh, &msg, &buf))
+   {
+      if (DASyncCovers(msg, srvrqst->scopelistlen, srvrqst->scopelist))
+      {
+         DASyncEntryDigest(&msg->body.srvreg, &bucket);
+         if (ours[bucket] != theirs[bucket])
+            DASyncPush(&message->peer, msg, buf);
+      }
+   }
+   SLPDDatabaseEnumEnd(eh);
+}
+
+#ifdef SLPD_DASYNC_TEST
+
+/* ------------- Test main for the slpd_dasync.c module -------------------
+ *
+ * Checks the digests a sync request carries, the scopes two DAs sync, and
+ * that a copy from a peer DA can only be removed by that DA, and is not
+ * taken back once it was deregistered.
+ *
+ * Build and run with:
+ *    make slpd-dasync-test && ./slpd-dasync-test
+ */
+
+# define FAIL (printf("FAIL: %s at line %d.\n", __FILE__, __LINE__), (-1))
+# define PASS (printf("PASS: Success!\n"), (0))
+
+#define TEST_SA   0x0a000001     /* the address of an SA */
+#define TEST_DA   0x0a000002     /* the address of a peer DA */
+
+/* Parse a message as if it came from an address. */
+static SLPMessage * TestParse(SLPBuffer buf, int addr)
+{
+   struct sockaddr_storage peer;
+   SLPMessage * msg = SLPMessageAlloc();
+
+   memset(&peer, 0, sizeof(peer));
+   SLPNetSetAddr(&peer, AF_INET, SLP_RESERVED_PORT, &addr);
+   if (msg && SLPMessageParseBuffer(&peer, 0, buf, msg) != 0)
+   {
+      SLPMessageFree(msg);
+      msg = 0;
+   }
+   return msg;
+}
+
+/* Register a URL in the default scope from an address, as ProcessSrvReg
+ * would.
+ */
+static int TestReg(const char * url, int addr, int source)
+{
+   size_t urllen = strlen(url);
+   size_t len = 14 + 2 + 6 + urllen + 1 + 2 + 12 + 2 + 7 + 2 + 1;
+   SLPBuffer buf = SLPBufferAlloc(len);
+   SLPMessage * msg;
+   int result;
+
+   if (buf == 0)
+      return -1;
+   *buf->curpos++ = 2;
+   *buf->curpos++ = SLP_FUNCT_SRVREG;
+   PutUINT24(&buf->curpos, len);
+   PutUINT16(&buf->curpos, SLP_FLAG_FRESH);
+   PutUINT24(&buf->curpos, 0);
+   PutUINT16(&buf->curpos, 1);
+   PutUINT16(&buf->curpos, 2);
+   memcpy(buf->curpos, "en", 2), buf->curpos += 2;
+   *buf->curpos++ = 0;
+   PutUINT16(&buf->curpos, 300);
+   PutUINT16(&buf->curpos, urllen);
+   memcpy(buf->curpos, url, urllen), buf->curpos += urllen;
+   *buf->curpos++ = 0;
+   PutUINT16(&buf->curpos, 12);
+   memcpy(buf->curpos, "service:test", 12), buf->curpos += 12;
+   PutUINT16(&buf->curpos, 7);
+   memcpy(buf->curpos, "default", 7), buf->curpos += 7;
+   PutUINT16(&buf->curpos, 0);
+   *buf->curpos++ = 0;
+   buf->curpos = buf->start;
+
+   if ((msg = TestParse(buf, addr)) == 0)
+      return -1;
+   msg->body.srvreg.source = source;
+   if (!SLPDDASyncAccepts(msg))
+      result = SLP_ERROR_AUTHENTICATION_FAILED;
+   else
+      result = SLPDDatabaseReg(msg, buf);
+   if (result != SLP_ERROR_OK)
+   {
+      SLPMessageFree(msg);
+      SLPBufferFree(buf);
+   }
+   return result;
+}
+
+/* Deregister a URL in the default scope from an address. */
+static int TestDeReg(const char * url, int addr)
+{
+   DASyncTombstone tomb;
+   SLPBuffer buf;
+   SLPMessage * msg;
+   int result = -1;
+
+   memset(&tomb, 0, sizeof(tomb));
+   tomb.urllen = strlen(url);
+   tomb.url = (char *)url;
+   tomb.scopelistlen = 7;
+   tomb.scopelist = "default";
+   if ((buf = DASyncMakeDeReg(&tomb)) == 0)
+      return -1;
+   if ((msg = TestParse(buf, addr)) != 0)
+   {
+      result = SLPDDatabaseDeReg(msg);
+      SLPMessageFree(msg);
+   }
+   SLPBufferFree(buf);
+   return result;
+}
+
+/* Format digests as SLPDDASyncRequest does. */
+static void TestFormat(char * predicate, const uint32_t * digests)
+{
+   int i;
+
+   predicate += sprintf(predicate, "(%s=", SLPD_DASYNC_DIGEST_TAG);
+   for (i = 0; i < SLPD_DASYNC_BUCKETS; i++)
+      predicate += sprintf(predicate, "%08x", (unsigned)digests[i]);
+   strcpy(predicate, ")");
+}
+
+int main(void)
+{
+   char predicate[DASYNC_PREDICATE_LEN + 1];
+   uint32_t digests[SLPD_DASYNC_BUCKETS];
+   uint32_t parsed[SLPD_DASYNC_BUCKETS];
+   uint32_t before[SLPD_DASYNC_BUCKETS];
+   DASyncTombstone * tomb;
+   char * scopes;
+   size_t len;
+   int i;
+
+   /* An empty configuration file name leaves every property at its
+    * default, so the results do not depend on the host's slp.conf.
+    */
+   if (SLPDPropertyInit("") != 0 || SLPDDatabaseInit(0) != 0)
+      return FAIL;
+   G_SlpdProperty.isDA = 1;
+   G_SlpdProperty.DASyncInterval = 300;
+   G_SlpdProperty.checkSourceAddr = 1;
+
+   /* Digests survive the trip through the predicate; anything else in
+    * its place is rejected.
+    */
+   for (i = 0; i < SLPD_DASYNC_BUCKETS; i++)
+      digests[i] = 0x9e3779b9u * (i + 1);
+   TestFormat(predicate, digests);
+   if (DASyncParseDigests(DASYNC_PREDICATE_LEN, predicate, parsed) != 0
+         || memcmp(digests, parsed, sizeof(digests)) != 0)
+      return FAIL;
+   if (DASyncParseDigests(DASYNC_PREDICATE_LEN - 1, predicate, parsed) == 0)
+      return FAIL;
+   predicate[DASYNC_PREDICATE_LEN - 2] = 'A';
+   if (DASyncParseDigests(DASYNC_PREDICATE_LEN, predicate, parsed) == 0)
+      return FAIL;
+   TestFormat(predicate, digests);
+   predicate[1] = 'X';
+   if (DASyncParseDigests(DASYNC_PREDICATE_LEN, predicate, parsed) == 0)
+      return FAIL;
+
+   /* Two DAs sync the scopes they both serve. */
+   xfree(G_SlpdProperty.useScopes);
+   G_SlpdProperty.useScopes = xstrdup("default,b,c");
+   G_SlpdProperty.useScopesLen = strlen(G_SlpdProperty.useScopes);
+   scopes = DASyncScopes(11, "c,x,DEFAULT", &len);
+   if (scopes == 0 || len != 9 || strcmp(scopes, "default,c") != 0)
+      return FAIL;
+   xfree(scopes);
+   if (DASyncScopes(3, "x,y", &len) != 0 || len != 0)
+      return FAIL;
+
+   /* The digest of a bucket changes with its registrations, but not with
+    * their order.
+    */
+   DASyncDigest(7, "default", before);
+   if (TestReg("service:test://a", TEST_SA, SLP_REG_SOURCE_REMOTE) != 0
+         || TestReg("service:test://b", TEST_SA, SLP_REG_SOURCE_REMOTE) != 0)
+      return FAIL;
+   DASyncDigest(7, "default", digests);
+   if (memcmp(before, digests, sizeof(before)) == 0)
+      return FAIL;
+   if (TestDeReg("service:test://a", TEST_SA) != 0
+         || TestReg("service:test://a", TEST_SA, SLP_REG_SOURCE_REMOTE) != 0)
+      return FAIL;
+   DASyncDigest(7, "default", parsed);
+   if (memcmp(digests, parsed, sizeof(digests)) != 0)
+      return FAIL;
+
+   /* A copy from a peer DA can only be removed by that DA... */
+   if (TestReg("service:test://c", TEST_DA, SLP_REG_SOURCE_PEER_DA) != 0
+         || TestDeReg("service:test://c", TEST_SA)
+               != SLP_ERROR_AUTHENTICATION_FAILED
+         || TestReg("service:test://c", TEST_SA, SLP_REG_SOURCE_REMOTE)
+               != SLP_ERROR_AUTHENTICATION_FAILED
+         || TestDeReg("service:test://c", TEST_DA) != 0)
+      return FAIL;
+
+   /* ...and what was deregistered is not taken back from a peer DA, but
+    * may be registered again by anyone else.
+    */
+   if (TestDeReg("service:test://b", TEST_SA) != 0
+         || G_DASyncTombstones.count != 2
+         || TestReg("service:test://b", TEST_DA, SLP_REG_SOURCE_PEER_DA)
+               != SLP_ERROR_AUTHENTICATION_FAILED
+         || TestReg("service:test://c", TEST_DA, SLP_REG_SOURCE_PEER_DA)
+               != SLP_ERROR_AUTHENTICATION_FAILED
+         || TestReg("service:test://b", TEST_SA, SLP_REG_SOURCE_REMOTE) != 0
+         || G_DASyncTombstones.count != 1
+         || TestDeReg("service:test://b", TEST_SA) != 0
+         || TestReg("service:test://b", TEST_DA, SLP_REG_SOURCE_PEER_DA)
+               != SLP_ERROR_AUTHENTICATION_FAILED)
+      return FAIL;
+
+   /* Tombstones expire with the copies they guard against. */
+   for (tomb = (DASyncTombstone *)G_DASyncTombstones.head; tomb;
+         tomb = (DASyncTombstone *)tomb->listitem.next)
+      tomb->expiry = time(0);
+   if (TestReg("service:test://b", TEST_DA, SLP_REG_SOURCE_PEER_DA) != 0
+         || G_DASyncTombstones.count != 0)
+      return FAIL;
+
+   SLPDDASyncDeinit();
+   SLPDDatabaseDeinit();
+   return PASS;
+}
+
+#endif /* SLPD_DASYNC_TEST */
+
+/*=========================================================================*/
@@ -0,0 +1,74 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Anti-entropy replication between DAs serving the same scopes.
+ *
+ * @file       slpd_dasync.h
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    SlpdCode
+ */
+
+#ifndef SLPD_DASYNC_H_INCLUDED
+#define SLPD_DASYNC_H_INCLUDED
+
+/*!@defgroup SlpdCodeDASync DA Synchronisation */
+
+/*!@addtogroup SlpdCodeDASync
+ * @ingroup SlpdCode
+ * @{
+ */
+
+#include "slp_types.h"
+#include "slp_message.h"
+#include "slpd.h"
+
+/** The service type of a DA sync request. */
+#define SLPD_DASYNC_SERVICE_TYPE "service:x-openslp-dasync"
+
+/** The attribute tag that carries the digests in a DA sync request. */
+#define SLPD_DASYNC_DIGEST_TAG   "x-openslp-digest"
+
+/** The number of digest buckets the registrations are hashed into. */
+#define SLPD_DASYNC_BUCKETS      256
+
+int SLPDDASyncIsPeer(struct sockaddr_storage * addr);
+void SLPDDASyncRequest(SLPMessage * daadvert);
+void SLPDDASyncRespond(SLPMessage * message);
+void SLPDDASyncTombstone(SLPMessage * msg);
+int SLPDDASyncAccepts(SLPMessage * msg);
+void SLPDDASyncDeinit(void);
+
+/*! @} */
+
+#endif   /* SLPD_DASYNC_H_INCLUDED */
+
+/*=========================================================================*/
@@ -52,6 +52,7 @@
 
 #include "../libslpattr/libslpattr.h"
 #include "slpd_database.h"
+#include "slpd_dasync.h"
 #include "slpd_regfile.h"
 #include "slpd_property.h"
 #include "slpd_log.h"
@@ -67,7 +68,10 @@
 #include "slp_net.h"
 #include "slpd_incoming.h"
 #include "slpd_index.h"
+#include "slpd_intern.h"
+#include "slpd_snapshot.h"
 #include "slp_debug.h"
+#include "slp_hash.h"
 
 /* Entries used in the "handles" array in the database entry */
 #define HANDLE_ATTRS            0
@@ -75,6 +79,9 @@
 
 static IndexTreeNode *srvtype_index_tree = (IndexTreeNode *)0;
 
+/* Every entry, by normalised URL, to find the entry a registration replaces */
+static IndexTreeNode *url_index_tree = (IndexTreeNode *)0;
+
 #ifdef ENABLE_PREDICATES
 /** A structure to hold a tag and its index tree
  */
@@ -138,86 +145,501 @@ SLPTagIndex *findTagIndex(size_t tag_len, const char *tag)
    }
    return entry;
 }
+
+/** Parse an attribute list.
+ *
+ * The attributes are compacted (see SLPAttrCompact), as they are kept with
+ * the entry and only ever read from then on.
+ *
+ * @param[in] attrlistlen - Length of the attribute list
+ * @param[in] attrlist - Pointer to the attribute list
+ * @param[out] pattr - Buffer pointer to return the parsed attributes
+ *
+ * @return SLP_ERROR_OK on success, SLP_ERROR_PARSE_ERROR if the list is
+ *         invalid, or SLP_ERROR_INTERNAL_ERROR if memory runs out
+ */
+static int parseAttributes(size_t attrlistlen, const char *attrlist, SLPAttributes *pattr)
+{
+   int result = SLP_ERROR_INTERNAL_ERROR;
+   char attrnull;
+
+   /* TRICKY: Temporarily NULL terminate the attribute list. We can do this
+    * because there is room in the corresponding SLPv2 SRVREG SRVRQST
+    * messages. Basically we are squashing the authcount and
+    * the spi string length. Don't worry, we fix things up later and it is
+    * MUCH faster than a malloc for a new buffer 1 byte longer!
+    */
+   attrnull = attrlist[attrlistlen];
+   ((char *) attrlist)[attrlistlen] = 0;
+
+   /* Generate an SLPAttr from the comma delimited list */
+   *pattr = (SLPAttributes)0;
+   if (SLPAttrAlloc("en", NULL, SLP_FALSE, pattr) == 0)
+   {
+      result = SLP_ERROR_OK;
+      if (SLPAttrFreshen(*pattr, attrlist) != 0)
+      {
+         /* Invalid attributes */
+         SLPAttrFree(*pattr);
+         *pattr = (SLPAttributes)0;
+         result = SLP_ERROR_PARSE_ERROR;
+      }
+      else
+         SLPAttrCompact(*pattr); /* Still usable if this fails */
+   }
+
+   /* Restore the overwritten byte */
+   ((char *) attrlist)[attrlistlen] = attrnull;
+   return result;
+}
+
+/** Parse only the indexed attributes from an attribute list.
+ *
+ * Picks the "(tag=value-list)" items whose tag is indexed out of the list
+ * without parsing any of the others. Keywords are skipped, as only string
+ * values are indexed.
+ *
+ * @param[in] attrlistlen - Length of the attribute list
+ * @param[in] attrlist - Pointer to the attribute list
+ *
+ * @return The parsed indexed attributes, or NULL if there are none, they
+ *         are invalid, or memory runs out
+ */
+static SLPAttributes parseIndexedAttributes(size_t attrlistlen, const char *attrlist)
+{
+   const char *p = attrlist;
+   const char *end = attrlist + attrlistlen;
+   SLPAttributes attr = (SLPAttributes)0;
+   char *subset;
+   char *q;
+
+   if ((subset = (char *)xmalloc(attrlistlen + 1)) == 0)
+      return attr;
+   q = subset;
+
+   while (p < end)
+   {
+      const char *itemend;
+
+      while (p < end && isspace((unsigned char)*p))
+         p++;
+      if (p < end && *p == '(')
+      {
+         const char *tag = p + 1;
+         const char *tagend;
+
+         /* Parentheses are reserved, so the item ends at the next one */
+         if ((itemend = memchr(p, ')', end - p)) == 0)
+            break;
+         itemend++;
+         if ((tagend = memchr(tag, '=', itemend - tag)) == 0)
+            tagend = itemend - 1;
+         while (tag < tagend && isspace((unsigned char)*tag))
+            tag++;
+         while (tagend > tag && isspace((unsigned char)tagend[-1]))
+            tagend--;
+         if (findTagIndex(tagend - tag, tag))
+         {
+            if (q != subset)
+               *q++ = ',';
+            memcpy(q, p, itemend - p);
+            q += itemend - p;
+         }
+         p = itemend;
+      }
+      if ((p = memchr(p, ',', end - p)) == 0)
+         break;
+      p++;
+   }
+   *q = 0;
+
+   if (q != subset && SLPAttrAlloc("en", NULL, SLP_FALSE, &attr) == 0
+         && SLPAttrFreshen(attr, subset) != 0)
+   {
+      SLPAttrFree(attr);
+      attr = (SLPAttributes)0;
+   }
+   xfree(subset);
+   return attr;
+}
+
+/** Add or remove the indexed string values of a set of attributes to or
+ * from the attribute indexes.
+ *
+ * @param[in] attr - The attributes of @p entry
+ * @param[in] entry - The database entry
+ * @param[in] add - Non-zero to add to the indexes, zero to remove
+ */
+static void updateAttributeIndexes(SLPAttributes attr, SLPDatabaseEntry * entry, int add)
+{
+   const char * tag;
+   SLPType type;
+   SLPAttrIterator iter_h;
+   SLPError err = SLPAttrIteratorAlloc(attr, &iter_h);
+
+   if (err == SLP_OK)
+   {
+      /* For each attribute name */
+      while (SLPAttrIterNext(iter_h, (char const * *) &tag, &type) == SLP_TRUE)
+      {
+         /* Ensure it is a string value */
+         if (type == SLP_STRING)
+         {
+            /* Check to see if it is indexed */
+            SLPTagIndex *tag_index = findTagIndex(strlen(tag), tag);
+            if (tag_index)
+            {
+               SLPValue value;
+               /* For each value in the attribute's list */
+               while (SLPAttrIterValueNext(iter_h, &value) == SLP_TRUE)
+               {
+                  /* Add the value to, or remove it from, the index */
+                  if (add)
+                     tag_index->root_node = add_to_index(tag_index->root_node, value.len, value.data.va_str, (void *)entry);
+                  else
+                     tag_index->root_node = index_tree_delete(tag_index->root_node, value.len, value.data.va_str, (void *)entry);
+               }
+            }
+         }
+      }
+      SLPAttrIteratorFree(iter_h);
+   }
+}
 #endif /* ENABLE_PREDICATES */
 
-/** A structure to hold an allocated service type and its length.
+/** The pool of interned, normalised service types (without "service:").
+ */
+static SLPDInternPool srvtype_pool;
+
+/** The pool of interned, normalised scope names.
+ */
+static SLPDInternPool scope_pool;
+
+/** The normalised form of a registration, built once at registration time.
+ *
+ * Service types and scopes are interned, so they are matched against a
+ * request by pointer. The URL is unique to the entry, so it is kept as a
+ * private normalised copy with its hash. The tag filter lets a predicate
+ * reject the entry without parsing its attributes.
  */
 typedef struct
 {
-   char *srvtype;
-   size_t srvtypelen;
-} SLPNormalisedSrvtype;
+   SLPDInternStr * srvtype;      /* normalised service type */
+   size_t urllen;                /* length of the normalised URL */
+   char * url;                   /* normalised URL */
+   uint32_t urlhash;             /* hash of the normalised URL */
+   unsigned long generation;     /* database generation when registered */
+   unsigned long reload;         /* last regfile reload that kept the entry */
+#ifdef ENABLE_PREDICATES
+   SLPDTagFilter tagfilter;      /* the tags of the attribute list */
+#endif
+   size_t scopecount;            /* number of entries in scopes */
+   SLPDInternStr * scopes[1];    /* normalised scopes */
+} SLPDNormalisedReg;
 
-/** Takes a service type, and creates a normalised version of it.
+/** The normalised form of the strings in a request, built once per request.
  *
- * @param[in] srvtypelen - Length of the service type
- * @param[in] srvtype - Pointer to a buffer containing the service type
- * @param[out] normalisedSrvtypelen - Length of the normalised service type
- * @param[out] normalisedSrvtype - Buffer pointer to return the normalised service type
+ * Request strings are looked up in the pools without being added to them;
+ * a string that is not in a pool can not match any registration.
+ */
+typedef struct
+{
+   size_t srvtypelen;            /* length of the normalised service type */
+   char * srvtype;               /* normalised service type */
+   SLPDInternStr * isrvtype;     /* interned service type, or NULL */
+   int concrete;                 /* service type includes a concrete type */
+   size_t urllen;                /* length of the normalised URL */
+   char * url;                   /* normalised URL */
+   uint32_t urlhash;             /* hash of the normalised URL */
+   unsigned long generation;     /* database generation when registered */
+   size_t scopecount;            /* number of entries in scopes */
+   SLPDInternStr ** scopes;      /* registered scopes named in the request */
+} SLPDNormalisedQuery;
+
+/** Strip the optional "service:" prefix from a service type.
+ *
+ * @param[in,out] srvtypelen - Length of the service type
+ * @param[in,out] srvtype - Pointer to the service type
+ */
+static void stripServicePrefix(size_t *srvtypelen, const char **srvtype)
+{
+   if (*srvtypelen >= 8 && strncasecmp(*srvtype, "service:", 8) == 0)
+   {
+      *srvtype += 8;
+      *srvtypelen -= 8;
+   }
+}
+
+/** Count the items in a comma-separated list.
  *
- * @return SLP_ERROR_OK if the conversion can succeed, or SLP_ERROR_INTERNAL_ERROR
- *         if the buffer for the normalised service type cannot be allocated
+ * @param[in] listlen - Length of the list
+ * @param[in] list - Pointer to the list
  *
- * @remarks The "service:" prefix is ignored, if present
+ * @return The number of items in @p list, including empty ones
  */
-static int getNormalisedSrvtype(size_t srvtypelen, const char* srvtype, size_t *normalisedSrvtypeLen, char * *normalisedSrvtype)
+static size_t countListItems(size_t listlen, const char *list)
 {
-    /* Normalisation may involve collapsing escaped character sequences,
-     * and should never be longer than the service type itself, but allow
-     * for the addition of a trailing NUL
-     */
-   *normalisedSrvtype = (char *)xmalloc(srvtypelen+1);
-   if (!*normalisedSrvtype)
+   const char *end = list + listlen;
+   size_t count = 1;
+
+   while ((list = memchr(list, ',', end - list)) != 0)
+   {
+      count++;
+      list++;
+   }
+   return count;
+}
+
+/** Determine whether two interned scope arrays have a scope in common.
+ *
+ * @param[in] count1 - Number of entries in @p scopes1
+ * @param[in] scopes1 - First array of interned scopes
+ * @param[in] count2 - Number of entries in @p scopes2
+ * @param[in] scopes2 - Second array of interned scopes
+ *
+ * @return Non-zero if the arrays intersect, zero otherwise
+ */
+static int intersectScopes(size_t count1, SLPDInternStr * const *scopes1,
+      size_t count2, SLPDInternStr * const *scopes2)
+{
+   size_t i, j;
+
+   for (i = 0; i < count1; i++)
+      for (j = 0; j < count2; j++)
+         if (scopes1[i] == scopes2[j])
+            return 1;
+   return 0;
+}
+
+/** Determine whether a normalised registration has the URL of a request.
+ *
+ * @param[in] pNormalisedReg - The normalised registration
+ * @param[in] pQuery - The normalised request
+ *
+ * @return Non-zero if the URLs match, zero otherwise
+ */
+static int matchUrl(const SLPDNormalisedReg *pNormalisedReg, const SLPDNormalisedQuery *pQuery)
+{
+   return pNormalisedReg->urlhash == pQuery->urlhash
+         && pNormalisedReg->urllen == pQuery->urllen
+         && memcmp(pNormalisedReg->url, pQuery->url, pQuery->urllen) == 0;
+}
+
+/** Determine whether a normalised registration has the service type of a
+ * request, following the rules of SLPCompareSrvType.
+ *
+ * @param[in] pNormalisedReg - The normalised registration
+ * @param[in] pQuery - The normalised request
+ *
+ * @return Non-zero if the service types match, zero otherwise
+ */
+static int matchSrvtype(const SLPDNormalisedReg *pNormalisedReg, const SLPDNormalisedQuery *pQuery)
+{
+   const SLPDInternStr *srvtype = pNormalisedReg->srvtype;
+
+   if (srvtype == pQuery->isrvtype)
+      return 1;
+   if (pQuery->concrete)
+      return 0;
+
+   /* An abstract type also matches every concrete type under it */
+   return srvtype->len > pQuery->srvtypelen
+         && srvtype->str[pQuery->srvtypelen] == ':'
+         && memcmp(srvtype->str, pQuery->srvtype, pQuery->srvtypelen) == 0;
+}
+
+/** Release a normalised registration, and its references to interned strings
+ *
+ * @param[in] pNormalisedReg - Pointer to the allocated structure
+ */
+static void freeNormalisedReg(SLPDNormalisedReg *pNormalisedReg)
+{
+   size_t i;
+
+   if (pNormalisedReg)
+   {
+      SLPDInternRelease(&srvtype_pool, pNormalisedReg->srvtype);
+      for (i = 0; i < pNormalisedReg->scopecount; i++)
+         SLPDInternRelease(&scope_pool, pNormalisedReg->scopes[i]);
+      xfree(pNormalisedReg);
+   }
+}
+
+/** Takes a service registration, and creates its normalised form
+ *
+ * @param[in] reg - The service registration
+ * @param[out] ppNormalisedReg - Buffer pointer to return the allocated structure
+ *
+ * @return SLP_ERROR_INTERNAL_ERROR if the structure cannot be allocated, SLP_ERROR_OK otherwise
+ *
+ * @remarks The "service:" prefix of the service type is ignored, if present
+ */
+static int createNormalisedReg(const SLPSrvReg *reg, SLPDNormalisedReg **ppNormalisedReg)
+{
+   SLPDNormalisedReg *pNormalisedReg;
+   size_t srvtypelen = reg->srvtypelen;
+   const char *srvtype = reg->srvtype;
+   const char *item = reg->scopelist;
+   const char *listend = reg->scopelist + reg->scopelistlen;
+   size_t maxscopes = countListItems(reg->scopelistlen, reg->scopelist);
+
+   /* One allocation holds the structure, the scope array and the URL */
+   *ppNormalisedReg = pNormalisedReg = (SLPDNormalisedReg *)xmalloc(sizeof(SLPDNormalisedReg)
+         + (maxscopes - 1) * sizeof(SLPDInternStr *) + reg->urlentry.urllen + 1);
+   if (!pNormalisedReg)
       return SLP_ERROR_INTERNAL_ERROR;
+   pNormalisedReg->scopecount = 0;
+   pNormalisedReg->reload = 0;
+   pNormalisedReg->url = (char *)&pNormalisedReg->scopes[maxscopes];
+   pNormalisedReg->urllen = SLPNormalizeString(reg->urlentry.urllen, reg->urlentry.url, pNormalisedReg->url, 1);
+   pNormalisedReg->url[pNormalisedReg->urllen] = '\0';
+   pNormalisedReg->urlhash = SLPHash(pNormalisedReg->url, pNormalisedReg->urllen);
+#ifdef ENABLE_PREDICATES
+   SLPDTagFilterInit(&pNormalisedReg->tagfilter, reg->attrlistlen, reg->attrlist);
+#endif
 
-   /* The "service:" prefix is optional, so we strip it before the character normalisation */
-   if (srvtypelen >= 8 && strncmp(srvtype, "service:", 8) == 0)
+   stripServicePrefix(&srvtypelen, &srvtype);
+   pNormalisedReg->srvtype = SLPDInternGet(&srvtype_pool, srvtypelen, srvtype);
+   if (!pNormalisedReg->srvtype)
    {
-      srvtype += 8;
-      srvtypelen -= 8;
+      freeNormalisedReg(pNormalisedReg);
+      *ppNormalisedReg = (SLPDNormalisedReg *)0;
+      return SLP_ERROR_INTERNAL_ERROR;
+   }
+
+   while (reg->scopelistlen && item <= listend)
+   {
+      const char *itemend = memchr(item, ',', listend - item);
+      SLPDInternStr *scope;
+
+      if (!itemend)
+         itemend = listend;
+      scope = SLPDInternGet(&scope_pool, itemend - item, item);
+      if (!scope)
+      {
+         freeNormalisedReg(pNormalisedReg);
+         *ppNormalisedReg = (SLPDNormalisedReg *)0;
+         return SLP_ERROR_INTERNAL_ERROR;
+      }
+      if (scope->len)
+         pNormalisedReg->scopes[pNormalisedReg->scopecount++] = scope;
+      else
+         SLPDInternRelease(&scope_pool, scope);
+      item = itemend + 1;
    }
-   *normalisedSrvtypeLen = SLPNormalizeString(srvtypelen, srvtype, *normalisedSrvtype, 1);
    return SLP_ERROR_OK;
 }
 
-/** Takes a service type, and outputs a structure holding the normalised service type and its length
+/** Takes the strings of a request, and creates their normalised form
  *
  * @param[in] srvtypelen - Length of the service type
- * @param[in] srvtype - Pointer to a buffer containing the service type
- * @param[out] ppNormalisedSrvtype - Buffer pointer to return the allocated structure
+ * @param[in] srvtype - Pointer to the service type, or NULL if none
+ * @param[in] urllen - Length of the URL
+ * @param[in] url - Pointer to the URL, or NULL if none
+ * @param[in] scopelistlen - Length of the scope list
+ * @param[in] scopelist - Pointer to the scope list
+ * @param[out] ppQuery - Buffer pointer to return the allocated structure
  *
  * @return SLP_ERROR_INTERNAL_ERROR if the structure cannot be allocated, SLP_ERROR_OK otherwise
+ *
+ * @remarks The structure is freed with xfree
  */
-static int createNormalisedSrvtype(size_t srvtypelen, const char* srvtype, SLPNormalisedSrvtype **ppNormalisedSrvtype)
+static int createNormalisedQuery(size_t srvtypelen, const char *srvtype,
+      size_t urllen, const char *url, size_t scopelistlen, const char *scopelist,
+      SLPDNormalisedQuery **ppQuery)
 {
-   int result;
+   SLPDNormalisedQuery *pQuery;
+   const char *item = scopelist;
+   const char *listend = scopelist + scopelistlen;
+   size_t maxscopes = countListItems(scopelistlen, scopelist);
 
-   *ppNormalisedSrvtype = (SLPNormalisedSrvtype *)xmalloc(sizeof (SLPNormalisedSrvtype));
-   if (!*ppNormalisedSrvtype)
+   if (srvtype)
+      stripServicePrefix(&srvtypelen, &srvtype);
+   else
+      srvtypelen = 0;
+   if (!url)
+      urllen = 0;
+
+   /* One allocation holds the structure, the scope array and both strings */
+   *ppQuery = pQuery = (SLPDNormalisedQuery *)xmalloc(sizeof(SLPDNormalisedQuery)
+         + maxscopes * sizeof(SLPDInternStr *) + srvtypelen + urllen + 2);
+   if (!pQuery)
       return SLP_ERROR_INTERNAL_ERROR;
-
-   result = getNormalisedSrvtype(srvtypelen, srvtype, &(*ppNormalisedSrvtype)->srvtypelen, &(*ppNormalisedSrvtype)->srvtype);
-   if (result != SLP_ERROR_OK)
+   pQuery->scopes = (SLPDInternStr **)(pQuery + 1);
+   pQuery->scopecount = 0;
+   pQuery->srvtype = (char *)&pQuery->scopes[maxscopes];
+   pQuery->srvtypelen = SLPNormalizeString(srvtypelen, srvtype, pQuery->srvtype, 1);
+   pQuery->srvtype[pQuery->srvtypelen] = '\0';
+   pQuery->isrvtype = srvtype? SLPDInternFind(&srvtype_pool, srvtypelen, srvtype): 0;
+   pQuery->concrete = memchr(pQuery->srvtype, ':', pQuery->srvtypelen) != 0;
+   pQuery->url = pQuery->srvtype + pQuery->srvtypelen + 1;
+   pQuery->urllen = SLPNormalizeString(urllen, url, pQuery->url, 1);
+   pQuery->url[pQuery->urllen] = '\0';
+   pQuery->urlhash = SLPHash(pQuery->url, pQuery->urllen);
+
+   while (scopelistlen && item <= listend)
    {
-      xfree(*ppNormalisedSrvtype);
-      *ppNormalisedSrvtype = (SLPNormalisedSrvtype *)0;
+      const char *itemend = memchr(item, ',', listend - item);
+      SLPDInternStr *scope;
+
+      if (!itemend)
+         itemend = listend;
+      scope = SLPDInternFind(&scope_pool, itemend - item, item);
+      if (scope && scope->len)
+         pQuery->scopes[pQuery->scopecount++] = scope;
+      item = itemend + 1;
    }
-
-   return result;
+   return SLP_ERROR_OK;
 }
 
-/** Takes a normalised service type structure, and frees the allocated buffer, and the structure itself
+/** Stored as the parsed attributes of an entry whose attribute list is
+ * invalid, so that it is not parsed again.
+ */
+static char invalid_attrs;
+#define ATTRS_INVALID   ((SLPAttributes)&invalid_attrs)
+
+#ifdef ENABLE_PREDICATES
+/** Returns the parsed attributes of a database entry, parsing them the
+ * first time they are needed.
  *
- * @param[in] pNormalisedSrvtype - Pointer to the allocated structure
+ * @param[in] entry - The database entry
+ *
+ * @return The parsed attributes, or NULL if the entry's attribute list is
+ *         invalid or cannot be parsed
  */
-static void freeNormalisedSrvtype(SLPNormalisedSrvtype *pNormalisedSrvtype)
+static SLPAttributes getEntryAttributes(SLPDatabaseEntry * entry)
 {
-   if (pNormalisedSrvtype)
+   SLPAttributes attr = (SLPAttributes)entry->handles[HANDLE_ATTRS];
+
+   if (!attr)
    {
-      xfree(pNormalisedSrvtype->srvtype);
-      xfree(pNormalisedSrvtype);
+      SLPSrvReg * reg = &entry->msg->body.srvreg;
+      int result = parseAttributes(reg->attrlistlen, reg->attrlist, &attr);
+
+      /* Remember an invalid list, but retry after running out of memory */
+      if (result == SLP_ERROR_PARSE_ERROR)
+         entry->handles[HANDLE_ATTRS] = ATTRS_INVALID;
+      else if (result == SLP_ERROR_OK)
+         entry->handles[HANDLE_ATTRS] = attr;
    }
+   return attr == ATTRS_INVALID? (SLPAttributes)0: attr;
 }
+#endif
+
+/** The slpd static global database object.
+ */
+static SLPDDatabase G_SlpdDatabase;
+
+/** The compiled regfile the static registrations were loaded from, if
+ * any; they refer to its memory.
+ */
+static SLPDRegFileImage G_StaticImage = 0;
+
+/** The number of the regfile reload in progress, or of the last one. */
+static unsigned long G_StaticReload = 0;
+
+/** The number of static registrations read in by that reload. */
+static size_t G_StaticCurrent = 0;
 
 /** Remove an entry from the database.
  *
@@ -229,69 +651,59 @@ static void freeNormalisedSrvtype(SLPNormalisedSrvtype *pNormalisedSrvtype)
  */
 void SLPDDatabaseRemove(SLPDatabaseHandle dh, SLPDatabaseEntry * entry)
 {
-   SLPNormalisedSrvtype *pNormalisedSrvtype = (SLPNormalisedSrvtype *)entry->handles[HANDLE_SRVTYPE];
+   SLPDNormalisedReg *pNormalisedReg = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
    SLPAttributes slp_attr = (SLPAttributes)entry->handles[HANDLE_ATTRS];
 
    if (G_SlpdProperty.srvtypeIsIndexed)
    {
       /* Remove the index entries for this entry */
-      srvtype_index_tree = index_tree_delete(srvtype_index_tree, pNormalisedSrvtype->srvtypelen, pNormalisedSrvtype->srvtype, (void *)entry);
+      srvtype_index_tree = index_tree_delete(srvtype_index_tree, pNormalisedReg->srvtype->len, pNormalisedReg->srvtype->str, (void *)entry);
    }
 
-   if (pNormalisedSrvtype)
-      freeNormalisedSrvtype(pNormalisedSrvtype);
+   if (entry->msg->body.srvreg.source == SLP_REG_SOURCE_STATIC)
+   {
+      G_SlpdDatabase.staticcount--;
+      if (pNormalisedReg && pNormalisedReg->reload == G_StaticReload)
+         G_StaticCurrent--;
+   }
 
-   if (slp_attr)
+   if (pNormalisedReg)
    {
+      url_index_tree = index_tree_delete(url_index_tree, pNormalisedReg->urllen, pNormalisedReg->url, (void *)entry);
+      freeNormalisedReg(pNormalisedReg);
+   }
+
+   if (slp_attr == ATTRS_INVALID)
+      slp_attr = (SLPAttributes)0;
+
 #ifdef ENABLE_PREDICATES
-      /* Parsed attributes - remove them from the attribute indexes, if necessary */
-      if (G_SlpdProperty.indexedAttributes)
-      {
-         const char * tag;
-         SLPType type;
-         SLPAttrIterator iter_h;
-         SLPError err = SLPAttrIteratorAlloc(slp_attr, &iter_h);
+   /* Remove the entry from the attribute indexes, if necessary, using the
+    * full attributes if they were parsed, or else parsing the indexed ones
+    * again
+    */
+   if (G_SlpdProperty.indexedAttributes)
+   {
+      SLPSrvReg * reg = &entry->msg->body.srvreg;
+      SLPAttributes indexed_attr = slp_attr? slp_attr: parseIndexedAttributes(reg->attrlistlen, reg->attrlist);
 
-         if (err == SLP_OK)
-         {
-            /* For each attribute name */
-            while (SLPAttrIterNext(iter_h, (char const * *) &tag, &type) == SLP_TRUE)
-            {
-               /* Ensure it is a string value */
-               if (type == SLP_STRING)
-               {
-                  /* Check to see if it is indexed */
-                  SLPTagIndex *tag_index = findTagIndex(strlen(tag), tag);
-                  if (tag_index)
-                  {
-                     SLPValue value;
-                     /* For each value in the attribute's list */
-                     while (SLPAttrIterValueNext(iter_h, &value) == SLP_TRUE)
-                     {
-                        /* Remove the value from the index */
-                        tag_index->root_node = index_tree_delete(tag_index->root_node, value.len, value.data.va_str, (void *)entry);
-                     }
-                  }
-               }
-            }
-            SLPAttrIteratorFree(iter_h);
-         }
-      }
+      if (indexed_attr)
+         updateAttributeIndexes(indexed_attr, entry, 0);
+      if (indexed_attr && indexed_attr != slp_attr)
+         SLPAttrFree(indexed_attr);
+   }
 #endif
 
-      /* De-allocate the attribute structures */
+   /* De-allocate the attribute structures */
+   if (slp_attr)
       SLPAttrFree(slp_attr);
-   }
 
-   /* Now remove the entry itself */
+   /* Now remove the entry itself, invalidating cached cursor positions */
+   SLPDSnapshotLogRemove(entry->msg);
    SLPDatabaseRemove(dh, entry);
+   G_SlpdDatabase.removals++;
 }
 
 
-/** The slpd static global database object.
- */
-static SLPDDatabase G_SlpdDatabase;
-
 /** Ages the database entries and clears new and deleted entry lists
  *
  * @param[in] seconds - The number of seconds to age each entry by.
@@ -358,32 +770,25 @@ void SLPDDatabaseAge(int seconds, int ageall)
  */
 int SLPDDatabaseSrvtypeUsed(const char* srvtype, size_t srvtypelen)
 {
-   SLPDatabaseHandle dh;
-   SLPDatabaseEntry * entry;
-   SLPSrvReg * entryreg;
-   int result = 0;
+   /* Every registered service type holds a reference in the pool */
+   stripServicePrefix(&srvtypelen, &srvtype);
+   return SLPDInternFind(&srvtype_pool, srvtypelen, srvtype) != 0;
+}
 
-   dh = SLPDatabaseOpen(&G_SlpdDatabase.database);
-   if (dh)
+/** Fixup the lifetime of a registration a bit, so that it is not aged
+ * out before the registering agent refreshes it.
+ *
+ * @param[in,out] reg - The SrvReg being registered.
+ */
+static void fixupLifetime(SLPSrvReg * reg)
+{
+   if (reg->urlentry.lifetime > 0 && reg->urlentry.lifetime < SLP_LIFETIME_MAXIMUM)
    {
-      while (1)
-      {
-         entry = SLPDatabaseEnum(dh);
-         if (entry == 0)
-            break;
-
-         /* entry reg is the SrvReg message from the database */
-         entryreg = &entry->msg->body.srvreg;
-         if(SLPCompareString(entryreg->srvtypelen, entryreg->srvtype, srvtypelen, srvtype) == 0)
-         {
-            result = 1;
-            break;
-         }
-      }
-      SLPDatabaseClose(dh);
+      if (reg->urlentry.lifetime >= SLP_LIFETIME_MAXIMUM - SLPD_AGE_INTERVAL)
+         reg->urlentry.lifetime = SLP_LIFETIME_MAXIMUM - 1;
+      else
+         reg->urlentry.lifetime += SLPD_AGE_INTERVAL;
    }
-
-   return result;
 }
 
 /** Add a service registration to the database.
@@ -402,7 +807,9 @@ int SLPDDatabaseReg(SLPMessage * msg, SLPBuffer buf)
 {
    SLPDatabaseHandle dh;
    SLPDatabaseEntry * entry;
+#ifdef ENABLE_SLPv2_SECURITY
    SLPSrvReg * entryreg;
+#endif
    SLPSrvReg * reg;
    int result;
    int i;
@@ -451,26 +858,18 @@ int SLPDDatabaseReg(SLPMessage * msg, SLPBuffer buf)
       xfree(ifaces.bcast_addr);
    }
 
-   /* fixup the lifetime a bit */
-   if (reg->urlentry.lifetime > 0 && reg->urlentry.lifetime < SLP_LIFETIME_MAXIMUM)
-   {
-      if (reg->urlentry.lifetime >= SLP_LIFETIME_MAXIMUM - SLPD_AGE_INTERVAL)
-         reg->urlentry.lifetime = SLP_LIFETIME_MAXIMUM - 1;
-      else
-         reg->urlentry.lifetime += SLPD_AGE_INTERVAL;
-   }
+   fixupLifetime(reg);
 
    dh = SLPDatabaseOpen(&G_SlpdDatabase.database);
    if (dh)
    {
-      SLPNormalisedSrvtype *pNormalisedSrvtype = (SLPNormalisedSrvtype *)0;
+      SLPDNormalisedReg *pNormalisedReg = (SLPDNormalisedReg *)0;
+      SLPDNormalisedReg *entrynorm;
       SLPAttributes attr = (SLPAttributes)0;
-#ifdef ENABLE_PREDICATES
-      char attrnull;
-#endif
+      IndexTreeValue *value;
 
-      /* Get the normalised service type */
-      result = createNormalisedSrvtype(reg->srvtypelen, reg->srvtype, &pNormalisedSrvtype);
+      /* Get the normalised registration */
+      result = createNormalisedReg(reg, &pNormalisedReg);
       if (result != SLP_ERROR_OK)
       {
          SLPDatabaseClose(dh);
@@ -478,91 +877,69 @@ int SLPDDatabaseReg(SLPMessage * msg, SLPBuffer buf)
       }
 
 #ifdef ENABLE_PREDICATES
-      /* Get the parsed attributes */
-
-      /* TRICKY: Temporarily NULL terminate the attribute list. We can do this
-       * because there is room in the corresponding SLPv2 SRVREG SRVRQST
-       * messages. Basically we are squashing the authcount and
-       * the spi string length. Don't worry, we fix things up later and it is
-       * MUCH faster than a malloc for a new buffer 1 byte longer!
+      /* Get the parsed attributes, unless they are to be parsed when a
+       * predicate first needs them
        */
-      attrnull = reg->attrlist[reg->attrlistlen];
-      ((char *) reg->attrlist)[reg->attrlistlen] = 0;
-
-      /* Generate an SLPAttr from the comma delimited list */
-      if (SLPAttrAlloc("en", NULL, SLP_FALSE, &attr) == 0)
-      {
-         if (SLPAttrFreshen(attr, reg->attrlist) != 0)
-         {
-            /* Invalid attributes */
-            SLPAttrFree(attr);
-            attr = (SLPAttributes)0;
-         }
-      }
-
-      /* Restore the overwritten byte */
-      ((char *) reg->attrlist)[reg->attrlistlen] = attrnull;
+      if (!G_SlpdProperty.lazyAttributes
+            && parseAttributes(reg->attrlistlen, reg->attrlist, &attr) == SLP_ERROR_PARSE_ERROR)
+         attr = ATTRS_INVALID;
 #endif
 
       /* check to see if there is already an identical entry */
-      while (1)
+      for (value = find_in_index(url_index_tree, pNormalisedReg->urllen, pNormalisedReg->url);
+            value; value = value->next)
       {
-         entry = SLPDatabaseEnum(dh);
-         if (entry == 0)
-            break;
+         entry = (SLPDatabaseEntry *)value->p;
 
-         /* entry reg is the SrvReg message from the database */
-         entryreg = &entry->msg->body.srvreg;
+         /* entry norm is the normalised form of the SrvReg from the database */
+         entrynorm = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
 
-         if (SLPCompareString(entryreg->urlentry.urllen,
-               entryreg->urlentry.url, reg->urlentry.urllen,
-               reg->urlentry.url) == 0)
+         if (intersectScopes(entrynorm->scopecount, entrynorm->scopes,
+               pNormalisedReg->scopecount, pNormalisedReg->scopes))
          {
-            if (SLPIntersectStringList(entryreg->scopelistlen,
-                  entryreg->scopelist, reg->scopelistlen,reg->scopelist) > 0)
+            /* check to ensure the source addr is the same
+               as the original (for a copy, the DA it came from) */
+            if (G_SlpdProperty.checkSourceAddr)
             {
-               /* check to ensure the source addr is the same
-                  as the original */
-               if (G_SlpdProperty.checkSourceAddr)
-               {
-                  if ((entry->msg->peer.ss_family == AF_INET
-                        && msg->peer.ss_family == AF_INET
-                        && memcmp(&(((struct sockaddr_in *)
-                              &(entry->msg->peer))->sin_addr),
-                              &(((struct sockaddr_in *)
-                                    &(msg->peer))->sin_addr),
-                              sizeof(struct in_addr)))
-                        || (entry->msg->peer.ss_family == AF_INET6
-                              && msg->peer.ss_family == AF_INET6
-                              && memcmp(&(((struct sockaddr_in6 *)
-                                    &(entry->msg->peer))->sin6_addr),
-                                    &(((struct sockaddr_in6 *)
-                                          &(msg->peer))->sin6_addr),
-                                    sizeof(struct in6_addr))))
-                  {
-                     SLPDatabaseClose(dh);
-                     freeNormalisedSrvtype(pNormalisedSrvtype);
-                     if (attr)
-                        SLPAttrFree(attr);
-                     return SLP_ERROR_AUTHENTICATION_FAILED;
-                  }
-               }
-
-#ifdef ENABLE_SLPv2_SECURITY
-               if (entryreg->urlentry.authcount
-                     && entryreg->urlentry.authcount != reg->urlentry.authcount)
+               if ((entry->msg->peer.ss_family == AF_INET
+                     && msg->peer.ss_family == AF_INET
+                     && memcmp(&(((struct sockaddr_in *)
+                           &(entry->msg->peer))->sin_addr),
+                           &(((struct sockaddr_in *)
+                                 &(msg->peer))->sin_addr),
+                           sizeof(struct in_addr)))
+                     || (entry->msg->peer.ss_family == AF_INET6
+                           && msg->peer.ss_family == AF_INET6
+                           && memcmp(&(((struct sockaddr_in6 *)
+                                 &(entry->msg->peer))->sin6_addr),
+                                 &(((struct sockaddr_in6 *)
+                                       &(msg->peer))->sin6_addr),
+                                 sizeof(struct in6_addr))))
                {
                   SLPDatabaseClose(dh);
-                  freeNormalisedSrvtype(pNormalisedSrvtype);
-                  if (attr)
+                  freeNormalisedReg(pNormalisedReg);
+                  if (attr && attr != ATTRS_INVALID)
                      SLPAttrFree(attr);
                   return SLP_ERROR_AUTHENTICATION_FAILED;
                }
-#endif
-               /* Remove the identical entry */
-               SLPDDatabaseRemove(dh, entry);
-               break;
             }
+
+#ifdef ENABLE_SLPv2_SECURITY
+            /* entry reg is the SrvReg message from the database */
+            entryreg = &entry->msg->body.srvreg;
+            if (entryreg->urlentry.authcount
+                  && entryreg->urlentry.authcount != reg->urlentry.authcount)
+            {
+               SLPDatabaseClose(dh);
+               freeNormalisedReg(pNormalisedReg);
+               if (attr && attr != ATTRS_INVALID)
+                  SLPAttrFree(attr);
+               return SLP_ERROR_AUTHENTICATION_FAILED;
+            }
+#endif
+            /* Remove the identical entry */
+            SLPDDatabaseRemove(dh, entry);
+            break;
          }
       }
 
@@ -578,51 +955,39 @@ int SLPDDatabaseReg(SLPMessage * msg, SLPBuffer buf)
             else
                msg->body.srvreg.source = SLP_REG_SOURCE_REMOTE;
          }
+         if (msg->body.srvreg.source == SLP_REG_SOURCE_STATIC)
+         {
+            pNormalisedReg->reload = G_StaticReload;
+            G_SlpdDatabase.staticcount++;
+            G_StaticCurrent++;
+         }
 
-         /* add to database */
+         /* add to database, after every older registration */
          SLPDatabaseAdd(dh, entry);
+         pNormalisedReg->generation = ++G_SlpdDatabase.generation;
+         SLPDSnapshotLogReg(msg, buf);
 
          /* Update the service type index with the new entry */
-         entry->handles[HANDLE_SRVTYPE] = (void *)pNormalisedSrvtype;
+         entry->handles[HANDLE_SRVTYPE] = (void *)pNormalisedReg;
+         url_index_tree = add_to_index(url_index_tree, pNormalisedReg->urllen, pNormalisedReg->url, (void *)entry);
          if (G_SlpdProperty.srvtypeIsIndexed)
          {
-            srvtype_index_tree = add_to_index(srvtype_index_tree, pNormalisedSrvtype->srvtypelen, pNormalisedSrvtype->srvtype, (void *)entry);
+            srvtype_index_tree = add_to_index(srvtype_index_tree, pNormalisedReg->srvtype->len, pNormalisedReg->srvtype->str, (void *)entry);
          }
 
-         /* Update the attribute indexes */
+         /* Update the attribute indexes, from the full attributes if they
+          * were parsed, or else from just the indexed ones
+          */
          entry->handles[HANDLE_ATTRS] = (void *)attr;
 #ifdef ENABLE_PREDICATES
-         if (attr && G_SlpdProperty.indexedAttributes)
+         if (G_SlpdProperty.indexedAttributes)
          {
-            const char * tag;
-            SLPType type;
-            SLPAttrIterator iter_h;
-            SLPError err = SLPAttrIteratorAlloc(attr, &iter_h);
+            SLPAttributes indexed_attr = attr && attr != ATTRS_INVALID? attr: parseIndexedAttributes(reg->attrlistlen, reg->attrlist);
 
-            if (err == SLP_OK)
-            {
-               /* For each attribute name */
-               while (SLPAttrIterNext(iter_h, (char const * *) &tag, &type) == SLP_TRUE)
-               {
-                  /* Ensure it is a string value */
-                  if (type == SLP_STRING)
-                  {
-                     /* Check to see if it is indexed */
-                     SLPTagIndex *tag_index = findTagIndex(strlen(tag), tag);
-                     if (tag_index)
-                     {
-                        SLPValue value;
-                        /* For each value in the attribute's list */
-                        while (SLPAttrIterValueNext(iter_h, &value) == SLP_TRUE)
-                        {
-                           /* Add the value to the index */
-                           tag_index->root_node = add_to_index(tag_index->root_node, value.len, value.data.va_str, (void *)entry);
-                        }
-                     }
-                  }
-               }
-               SLPAttrIteratorFree(iter_h);
-            }
+            if (indexed_attr)
+               updateAttributeIndexes(indexed_attr, entry, 1);
+            if (indexed_attr && indexed_attr != attr)
+               SLPAttrFree(indexed_attr);
          }
 #endif
 
@@ -638,7 +1003,9 @@ int SLPDDatabaseReg(SLPMessage * msg, SLPBuffer buf)
       else
       {
          result = SLP_ERROR_INTERNAL_ERROR;
-         freeNormalisedSrvtype(pNormalisedSrvtype);
+         freeNormalisedReg(pNormalisedReg);
+         if (attr && attr != ATTRS_INVALID)
+            SLPAttrFree(attr);
       }
       SLPDatabaseClose(dh);
    }
@@ -659,7 +1026,9 @@ int SLPDDatabaseDeReg(SLPMessage * msg)
    SLPDatabaseHandle dh;
    SLPDatabaseEntry * entry = 0;
    SLPSrvReg * entryreg;
+   SLPDNormalisedReg * entrynorm;
    SLPSrvDeReg * dereg;
+   SLPDNormalisedQuery * pQuery;
    char srvtype[MAX_HOST_NAME];
    size_t srvtypelen = 0;
 
@@ -669,6 +1038,14 @@ int SLPDDatabaseDeReg(SLPMessage * msg)
       /* dereg is the SrvDereg being deregistered */
       dereg = &msg->body.srvdereg;
 
+      /* Normalise the URL and scopes being deregistered */
+      if (createNormalisedQuery(0, 0, dereg->urlentry.urllen, dereg->urlentry.url,
+            dereg->scopelistlen, dereg->scopelist, &pQuery) != SLP_ERROR_OK)
+      {
+         SLPDatabaseClose(dh);
+         return SLP_ERROR_INTERNAL_ERROR;
+      }
+
       /* check to see if there is an identical entry */
       while (1)
       {
@@ -678,17 +1055,15 @@ int SLPDDatabaseDeReg(SLPMessage * msg)
 
          /* entry reg is the SrvReg message from the database */
          entryreg = &entry->msg->body.srvreg;
+         entrynorm = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
 
-         if (SLPCompareString(entryreg->urlentry.urllen,
-               entryreg->urlentry.url, dereg->urlentry.urllen,
-               dereg->urlentry.url) == 0)
+         if (matchUrl(entrynorm, pQuery))
          {
-            if (SLPIntersectStringList(entryreg->scopelistlen,
-                  entryreg->scopelist, dereg->scopelistlen,
-                  dereg->scopelist) > 0)
+            if (intersectScopes(entrynorm->scopecount, entrynorm->scopes,
+                  pQuery->scopecount, pQuery->scopes))
             {
                /* Check to ensure the source addr is the same as */
-               /* the original */
+               /* the original (for a copy, the DA it came from) */
                if (G_SlpdProperty.checkSourceAddr)
                {
                   if ((entry->msg->peer.ss_family == AF_INET
@@ -706,6 +1081,7 @@ int SLPDDatabaseDeReg(SLPMessage * msg)
                                     sizeof(struct in6_addr))))
                   {
                      SLPDatabaseClose(dh);
+                     xfree(pQuery);
                      return SLP_ERROR_AUTHENTICATION_FAILED;
                   }
                }
@@ -716,6 +1092,7 @@ int SLPDDatabaseDeReg(SLPMessage * msg)
                            != dereg->urlentry.authcount)
                {
                   SLPDatabaseClose(dh);
+                  xfree(pQuery);
                   return SLP_ERROR_AUTHENTICATION_FAILED;
                }
 #endif
@@ -724,39 +1101,23 @@ int SLPDDatabaseDeReg(SLPMessage * msg)
                strncpy(srvtype, entryreg->srvtype, entryreg->srvtypelen);
                srvtypelen = entryreg->srvtypelen;
 
-               /* remove the registration from the database */
+               /* remove the registration from the database, and keep
+                  peer DAs from giving it back */
                SLPDLogRegistration("Deregistration",entry);
+               SLPDDASyncTombstone(entry->msg);
                SLPDDatabaseRemove(dh,entry);
 
-               break;
-            }
-         }
-      }
-      SLPDatabaseClose(dh);
-
-      if (entry != 0)
-      {
-         /* check to see if we can stop listening for service requests for this service */
-         dh = SLPDatabaseOpen(&G_SlpdDatabase.database);
-         if (dh)
-         {
-            while (1)
-            {
-               entry = SLPDatabaseEnum(dh);
-               if (entry == 0)
-                  break;
-
-               entryreg = &entry->msg->body.srvreg;
-               if (SLPCompareString(entryreg->srvtypelen, entryreg->srvtype,
-                     srvtypelen, srvtype) == 0)
-                  break;
+               break;
             }
          }
+      }
+      SLPDatabaseClose(dh);
+      xfree(pQuery);
 
-         SLPDatabaseClose(dh);
-
-         /* okay, remove the listening sockets */
-         if (entry == 0)
+      if (entry != 0)
+      {
+         /* check to see if we can stop listening for service requests for this service */
+         if (!SLPDDatabaseSrvtypeUsed(srvtype, srvtypelen))
             SLPDIncomingRemoveService(srvtype, srvtypelen);
       }
       else
@@ -765,27 +1126,53 @@ int SLPDDatabaseDeReg(SLPMessage * msg)
    return 0;
 }
 
-/** Test an entry for whether it should be returned.
+/** Remove a registration without the checks of a deregistration.
+ *
+ * Used to replay a removal recorded in the database log, which was
+ * checked when it was first made.
+ *
+ * @param[in] urllen - The length of @p url in bytes.
+ * @param[in] url - The URL of the registration.
+ * @param[in] scopelistlen - The length of @p scopelist in bytes.
+ * @param[in] scopelist - The scope list of the registration.
+ */
+void SLPDDatabaseForget(size_t urllen, const char * url,
+      size_t scopelistlen, const char * scopelist)
+{
+   SLPDatabaseHandle dh;
+   SLPDatabaseEntry * entry;
+
+   if ((dh = SLPDatabaseOpen(&G_SlpdDatabase.database)) != 0)
+   {
+      while ((entry = SLPDatabaseEnum(dh)) != 0)
+      {
+         SLPSrvReg * entryreg = &entry->msg->body.srvreg;
+
+         if (entryreg->urlentry.urllen == urllen
+               && entryreg->scopelistlen == scopelistlen
+               && memcmp(entryreg->urlentry.url, url, urllen) == 0
+               && memcmp(entryreg->scopelist, scopelist, scopelistlen) == 0)
+            SLPDDatabaseRemove(dh, entry);
+      }
+      SLPDatabaseClose(dh);
+   }
+}
+
+/** Test an entry for the SPI a request asks for.
  *
  * @param[in] msg - request message.
  * @param[in] entry - database entry to be tested.
  *
- * @return Non-zero if the entry matches the request, and should be returned,
- *         zero otherwise
+ * @return Non-zero if the entry carries an authentication block for the
+ *         request's SPI, or the request names none; zero otherwise.
  */
-static int SLPDDatabaseSrvRqstTestEntry(
-   SLPMessage * msg,
-#ifdef ENABLE_PREDICATES
-   SLPDPredicateTreeNode * predicate_parse_tree,
-#endif
-   SLPDatabaseEntry * entry)
+static int SLPDDatabaseSrvRqstTestSpi(SLPMessage * msg,
+      SLPDatabaseEntry * entry)
 {
+#ifdef ENABLE_SLPv2_SECURITY
    SLPSrvReg * entryreg;
    SLPSrvRqst * srvrqst;
-
-#ifdef ENABLE_SLPv2_SECURITY
    int i;
-#endif
 
    /* srvrqst is the SrvRqst being made */
    srvrqst = &(msg->body.srvrqst);
@@ -793,35 +1180,65 @@ static int SLPDDatabaseSrvRqstTestEntry(
    /* entry reg is the SrvReg message from the database */
    entryreg = &entry->msg->body.srvreg;
 
-   /* check the service type */
-   if (SLPCompareSrvType(srvrqst->srvtypelen, srvrqst->srvtype,
-         entryreg->srvtypelen, entryreg->srvtype) == 0
-         && SLPIntersectStringList(entryreg->scopelistlen,
-               entryreg->scopelist, srvrqst->scopelistlen,
-               srvrqst->scopelist) > 0)
+   if (srvrqst->spistrlen)
    {
+      for (i = 0; i < entryreg->urlentry.authcount; i++)
+         if (SLPCompareString(srvrqst->spistrlen,
+               srvrqst->spistr, entryreg->urlentry.autharray
+                     [i].spistrlen, entryreg->urlentry.autharray
+                     [i].spistr) == 0)
+            break;
+
+      if (i == entryreg->urlentry.authcount)
+         return 0;
+   }
+#else
+   (void)msg;
+   (void)entry;
+#endif
+   return 1;
+}
 
+/** Test an entry for whether it should be returned.
+ *
+ * @param[in] msg - request message.
+ * @param[in] query - normalised strings of the request message.
+ * @param[in] entry - database entry to be tested.
+ *
+ * @return Non-zero if the entry matches the request, and should be returned,
+ *         zero otherwise
+ */
+static int SLPDDatabaseSrvRqstTestEntry(
+   SLPMessage * msg,
+   const SLPDNormalisedQuery * query,
 #ifdef ENABLE_PREDICATES
-      if (SLPDPredicateTestTree(predicate_parse_tree, (SLPAttributes)entry->handles[HANDLE_ATTRS]))
+   SLPDPredicateProgram * predicate_program,
 #endif
-      {
+   SLPDatabaseEntry * entry)
+{
+   SLPDNormalisedReg * entrynorm;
 
-#ifdef ENABLE_SLPv2_SECURITY
-         if (srvrqst->spistrlen)
-         {
-            for (i = 0; i < entryreg->urlentry.authcount; i++)
-               if (SLPCompareString(srvrqst->spistrlen,
-                     srvrqst->spistr, entryreg->urlentry.autharray
-                           [i].spistrlen, entryreg->urlentry.autharray
-                           [i].spistr) == 0)
-                  break;
+   /* entry norm is the normalised form of the SrvReg from the database */
+   entrynorm = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
 
-            if (i == entryreg->urlentry.authcount)
-               return 0;
-         }
+   /* check the service type */
+   if (matchSrvtype(entrynorm, query)
+         && intersectScopes(entrynorm->scopecount, entrynorm->scopes,
+               query->scopecount, query->scopes))
+   {
+
+#ifdef ENABLE_PREDICATES
+      SLPAttributes attr;
+
+      /* Parse the entry's attributes only when there is a predicate, and
+       * the entry has the tags it needs
+       */
+      if (!predicate_program
+            || (SLPDPredicateMayMatch(predicate_program, &entrynorm->tagfilter)
+                  && (attr = getEntryAttributes(entry)) != 0
+                  && SLPDPredicateTestProgram(predicate_program, attr)))
 #endif
-         return 1;
-      }
+         return SLPDDatabaseSrvRqstTestSpi(msg, entry);
    }
    return 0;
 }
@@ -829,9 +1246,10 @@ static int SLPDDatabaseSrvRqstTestEntry(
 typedef struct
 {
    SLPMessage *                  msg;
+   const SLPDNormalisedQuery *   query;
    SLPDDatabaseSrvRqstResult **  result;
 #ifdef ENABLE_PREDICATES
-   SLPDPredicateTreeNode *       predicate_parse_tree;
+   SLPDPredicateProgram *        predicate_program;
 #endif
    int                           error_code;
 } SLPDDatabaseSrvRqstStartIndexCallbackParams;
@@ -850,7 +1268,7 @@ static void SLPDDatabaseSrvRqstStartIndexCallback(void * cookie, void *p)
    SLPDDatabaseSrvRqstResult ** result;
    SLPDatabaseEntry * entry;
 #ifdef ENABLE_PREDICATES
-   SLPDPredicateTreeNode * predicate_parse_tree;
+   SLPDPredicateProgram * predicate_program;
 #endif
    SLPSrvReg * entryreg;
 
@@ -863,13 +1281,14 @@ static void SLPDDatabaseSrvRqstStartIndexCallback(void * cookie, void *p)
    msg = params->msg;
    result = params->result;
 #ifdef ENABLE_PREDICATES
-   predicate_parse_tree = params->predicate_parse_tree;
+   predicate_program = params->predicate_program;
 #endif
    entry = (SLPDatabaseEntry *)p;
 
    if (SLPDDatabaseSrvRqstTestEntry(msg,
+                                    params->query,
 #ifdef ENABLE_PREDICATES
-                                    predicate_parse_tree,
+                                    predicate_program,
 #endif
                                     entry))
    {
@@ -892,6 +1311,8 @@ static void SLPDDatabaseSrvRqstStartIndexCallback(void * cookie, void *p)
  *
  * @param[in] msg - The SrvRqst to find.
  *
+ * @param[in] query - The normalised strings of the SrvRqst.
+ *
  * @param[out] result - The address of storage for the returned
  *    result structure
  *
@@ -901,55 +1322,30 @@ static void SLPDDatabaseSrvRqstStartIndexCallback(void * cookie, void *p)
  *    SLPDDatabaseSrvRqstEnd to free.
  */
 static int SLPDDatabaseSrvRqstStartIndexType(SLPMessage * msg,
+      const SLPDNormalisedQuery * query,
 #ifdef ENABLE_PREDICATES
-      SLPDPredicateTreeNode *parse_tree,
+      SLPDPredicateProgram * program,
 #endif
       SLPDDatabaseSrvRqstResult ** result)
 {
-   SLPSrvRqst * srvrqst;
-   size_t srvtypelen;
-   const char *srvtype;
-   size_t normalized_srvtypelen;
-   char *normalized_srvtype;
    SLPDDatabaseSrvRqstStartIndexCallbackParams params;
 
-   /* srvrqst is the SrvRqst being made */
-   srvrqst = &(msg->body.srvrqst);
-
-   srvtypelen = srvrqst->srvtypelen;
-   srvtype = srvrqst->srvtype;
-
-   if (srvtypelen >= 8)
-   {
-      if (strncasecmp(srvtype, "service:", 8) == 0)
-      {
-         /* Skip "service:" */
-         srvtypelen -= 8;
-         srvtype += 8;
-      }
-   }
-   /* the index contains normalized service type strings, so normalize the
-    * string we want to search for
+   /* Search the srvtype index - it contains normalized service type
+    * strings, and the query holds the normalized string we want
     */
-   if ((normalized_srvtype = (char *)xmalloc(srvtypelen + 1)) == 0)
-      return SLP_MEMORY_ALLOC_FAILED;
-   normalized_srvtypelen = SLPNormalizeString(srvtypelen, srvtype, normalized_srvtype, 1);
-   normalized_srvtype[normalized_srvtypelen] = '\0';
-
-   /* Search the srvtype index */
    params.msg = msg;
+   params.query = query;
    params.result = result;
 #ifdef ENABLE_PREDICATES
-   params.predicate_parse_tree = parse_tree;
+   params.predicate_program = program;
 #endif
    params.error_code = 0;
    find_and_call(srvtype_index_tree,
-      normalized_srvtypelen,
-      normalized_srvtype,
+      query->srvtypelen,
+      query->srvtype,
       SLPDDatabaseSrvRqstStartIndexCallback,
       (void *)&params);
 
-   xfree(normalized_srvtype);
    return params.error_code;
 }
 
@@ -958,6 +1354,8 @@ static int SLPDDatabaseSrvRqstStartIndexType(SLPMessage * msg,
  *
  * @param[in] msg - The SrvRqst to find.
  *
+ * @param[in] query - The normalised strings of the SrvRqst.
+ *
  * @param[out] result - The address of storage for the returned
  *    result structure
  *
@@ -971,7 +1369,8 @@ static int SLPDDatabaseSrvRqstStartIndexAttribute(
       const char *search_str,
       IndexTreeNode * attribute_index,
       SLPMessage * msg,
-      SLPDPredicateTreeNode *parse_tree,
+      const SLPDNormalisedQuery * query,
+      SLPDPredicateProgram * program,
       SLPDDatabaseSrvRqstResult ** result)
 {
    size_t processed_searchstr_len;
@@ -1006,8 +1405,9 @@ static int SLPDDatabaseSrvRqstStartIndexAttribute(
 
    /* Search the index */
    params.msg = msg;
+   params.query = query;
    params.result = result;
-   params.predicate_parse_tree = parse_tree;
+   params.predicate_program = program;
    params.error_code = 0;
    if (wildcard)
       find_leading_and_call(attribute_index,
@@ -1027,10 +1427,93 @@ static int SLPDDatabaseSrvRqstStartIndexAttribute(
 }
 #endif /* ENABLE_PREDICATES */
 
+#ifdef ENABLE_PREDICATES
+/** Find services in the database via linear scan, testing the predicate
+ * on a batch of entries at a time.
+ *
+ * Entries of the right service type and scope, and with the tags the
+ * predicate needs, are gathered until there are enough for a batch,
+ * which is then filtered by a single run of the predicate program.
+ * Results keep the order of the scan.
+ *
+ * @param[in] msg - The SrvRqst to find.
+ *
+ * @param[in] query - The normalised strings of the SrvRqst.
+ *
+ * @param[in] program - The compiled predicate of the SrvRqst.
+ *
+ * @param[out] result - The address of storage for the returned
+ *    result structure
+ *
+ * @return Zero on success, or a non-zero value on failure (not enough
+ *    result entries).
+ *
+ * @remarks Caller must pass @p result (dereferenced) to
+ *    SLPDDatabaseSrvRqstEnd to free.
+ */
+static int SLPDDatabaseSrvRqstStartScanBatch(SLPMessage * msg,
+      const SLPDNormalisedQuery * query,
+      SLPDPredicateProgram * program,
+      SLPDDatabaseSrvRqstResult ** result)
+{
+   SLPDatabaseEntry * batch[SLPD_PREDICATE_BATCH];
+   SLPAttributes attrs[SLPD_PREDICATE_BATCH];
+   SLPDatabaseHandle dh;
+   SLPDatabaseEntry * entry;
+   SLPDNormalisedReg * entrynorm;
+   unsigned long matches;
+   unsigned count = 0;
+   unsigned i;
+
+   dh = (*result)->reserved;
+   if (!dh)
+      return 0;
+
+   do
+   {
+      entry = SLPDatabaseEnum(dh);
+      if (entry)
+      {
+         entrynorm = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
+         if (!matchSrvtype(entrynorm, query)
+               || !intersectScopes(entrynorm->scopecount, entrynorm->scopes,
+                     query->scopecount, query->scopes)
+               || !SLPDPredicateMayMatch(program, &entrynorm->tagfilter)
+               || (attrs[count] = getEntryAttributes(entry)) == 0)
+            continue;
+         batch[count++] = entry;
+         if (count < SLPD_PREDICATE_BATCH)
+            continue;
+      }
+
+      /* The batch is full, or this is the end of the database */
+      matches = SLPDPredicateTestProgramBatch(program, attrs, count);
+      for (i = 0; i < count; i++)
+      {
+         if (!(matches & 1UL << i)
+               || !SLPDDatabaseSrvRqstTestSpi(msg, batch[i]))
+            continue;
+         if ((*result)->urlcount + 1 > G_SlpdDatabase.urlcount)
+         {
+            /* Oops we did not allocate a big enough result */
+            return 1;
+         }
+         (*result)->urlarray[(*result)->urlcount]
+               = &batch[i]->msg->body.srvreg.urlentry;
+         (*result)->urlcount ++;
+      }
+      count = 0;
+   } while (entry);
+   return 0;
+}
+#endif /* ENABLE_PREDICATES */
+
 /** Find services in the database via linear scan.
  *
  * @param[in] msg - The SrvRqst to find.
  *
+ * @param[in] query - The normalised strings of the SrvRqst.
+ *
  * @param[out] result - The address of storage for the returned
  *    result structure
  *
@@ -1040,8 +1523,9 @@ static int SLPDDatabaseSrvRqstStartIndexAttribute(
  *    SLPDDatabaseSrvRqstEnd to free.
  */
 static int SLPDDatabaseSrvRqstStartScan(SLPMessage * msg,
+      const SLPDNormalisedQuery * query,
 #ifdef ENABLE_PREDICATES
-      SLPDPredicateTreeNode *parse_tree,
+      SLPDPredicateProgram * program,
 #endif
       SLPDDatabaseSrvRqstResult ** result)
 {
@@ -1050,6 +1534,11 @@ static int SLPDDatabaseSrvRqstStartScan(SLPMessage * msg,
    SLPSrvReg * entryreg;
    /* SLPSrvRqst * srvrqst; */
 
+#ifdef ENABLE_PREDICATES
+   if (program)
+      return SLPDDatabaseSrvRqstStartScanBatch(msg, query, program, result);
+#endif
+
    dh = (*result)->reserved;
    if (dh)
    {
@@ -1064,8 +1553,9 @@ static int SLPDDatabaseSrvRqstStartScan(SLPMessage * msg,
             return 0; /* This is the only successful way out */
 
          if (SLPDDatabaseSrvRqstTestEntry(msg,
+                                          query,
 #ifdef ENABLE_PREDICATES
-                                          parse_tree,
+                                          program,
 #endif
                                           entry))
          {
@@ -1103,12 +1593,14 @@ int SLPDDatabaseSrvRqstStart(SLPMessage * msg,
 {
    SLPDatabaseHandle dh;
    SLPSrvRqst * srvrqst;
+   SLPDNormalisedQuery * query;
 
    int start_result;
    int use_index = 0;
 
 #ifdef ENABLE_PREDICATES
    SLPDPredicateTreeNode * predicate_parse_tree = (SLPDPredicateTreeNode *)0;
+   SLPDPredicateProgram * predicate_program = (SLPDPredicateProgram *)0;
 #endif
 
    /* start with the result set to NULL just to be safe */
@@ -1120,6 +1612,14 @@ int SLPDDatabaseSrvRqstStart(SLPMessage * msg,
       /* srvrqst is the SrvRqst being made */
       srvrqst = &(msg->body.srvrqst);
 
+      /* Normalise the service type and scopes being requested, once */
+      if (createNormalisedQuery(srvrqst->srvtypelen, srvrqst->srvtype, 0, 0,
+            srvrqst->scopelistlen, srvrqst->scopelist, &query) != SLP_ERROR_OK)
+      {
+         SLPDatabaseClose(dh);
+         return SLP_ERROR_INTERNAL_ERROR;
+      }
+
       while (1)
       {
          /* allocate result with generous array of url entry pointers */
@@ -1130,6 +1630,7 @@ int SLPDDatabaseSrvRqstStart(SLPMessage * msg,
          {
             /* out of memory */
             SLPDatabaseClose(dh);
+            xfree(query);
             return SLP_ERROR_INTERNAL_ERROR;
          }
          (*result)->urlarray = (SLPUrlEntry **)((*result) + 1);
@@ -1140,24 +1641,10 @@ int SLPDDatabaseSrvRqstStart(SLPMessage * msg,
          SLPDatabaseRewind(dh);
 
          /* Check if we can use the srvtype index */
-         if (G_SlpdProperty.srvtypeIsIndexed)
+         if (G_SlpdProperty.srvtypeIsIndexed && query->concrete)
          {
-            size_t srvtypelen = srvrqst->srvtypelen;
-            const char *srvtype = srvrqst->srvtype;
-            if (srvtypelen >= 8)
-            {
-               if (strncasecmp(srvtype, "service:", 8) == 0)
-               {
-                  /* Skip "service:" */
-                  srvtypelen -= 8;
-                  srvtype += 8;
-               }
-            }
-            if (memchr(srvtype, ':', srvtypelen))
-            {
-               /* Searching for a concrete type - can use the index */
-               use_index = 1;
-            }
+            /* Searching for a concrete type - can use the index */
+            use_index = 1;
          }
 
 #ifdef ENABLE_PREDICATES
@@ -1192,21 +1679,33 @@ int SLPDDatabaseSrvRqstStart(SLPMessage * msg,
                /* Found trash characters after the predicate - discard the parse tree before aborting */
                SLPDLog("Trash after predicate\n");
                freePredicateParseTree(predicate_parse_tree);
+               xfree(query);
                return 0;
             }
             else if (err != PREDICATE_PARSE_OK)
             {
                SLPDLog("Invalid predicate\n");
                /* Nothing matches an invalid predicate */
+               xfree(query);
                return 0;
             }
+
+            /* Compile the tree once; it is tested against every entry */
+            if (SLPDPredicateCompile(predicate_parse_tree,
+                  &predicate_program) != PREDICATE_PARSE_OK)
+            {
+               freePredicateParseTree(predicate_parse_tree);
+               xfree(query);
+               return SLP_ERROR_INTERNAL_ERROR;
+            }
          }
 #endif /* ENABLE_PREDICATES */
 
          if (use_index)
             start_result = SLPDDatabaseSrvRqstStartIndexType(msg,
+                                                             query,
 #ifdef ENABLE_PREDICATES
-                                                             predicate_parse_tree,
+                                                             predicate_program,
 #endif
                                                              result);
          else
@@ -1255,7 +1754,8 @@ int SLPDDatabaseSrvRqstStart(SLPMessage * msg,
                   tag_node->nodeBody.comparison.value_str,
                   tag_index->root_node,
                   msg,
-                  predicate_parse_tree,
+                  query,
+                  predicate_program,
                   result);
             }
             else
@@ -1263,17 +1763,24 @@ int SLPDDatabaseSrvRqstStart(SLPMessage * msg,
 #endif /* ENABLE_PREDICATES */
 
                start_result = SLPDDatabaseSrvRqstStartScan(msg,
+                                                           query,
 #ifdef ENABLE_PREDICATES
-                                                           predicate_parse_tree,
+                                                           predicate_program,
 #endif
                                                            result);
          }
 #ifdef ENABLE_PREDICATES
          if (predicate_parse_tree)
             freePredicateParseTree(predicate_parse_tree);
+         SLPDPredicateFreeProgram(predicate_program);
+         predicate_parse_tree = (SLPDPredicateTreeNode *)0;
+         predicate_program = (SLPDPredicateProgram *)0;
 #endif
          if (start_result == 0)
+         {
+            xfree(query);
             return 0;
+         }
 
          /* We didn't allocate enough URL entries - loop round after updating the number to allocate */
          G_SlpdDatabase.urlcount *= 2;
@@ -1312,7 +1819,9 @@ int SLPDDatabaseSrvTypeRqstStart(SLPMessage * msg,
    SLPDatabaseHandle dh;
    SLPDatabaseEntry * entry;
    SLPSrvReg * entryreg;
+   SLPDNormalisedReg * entrynorm;
    SLPSrvTypeRqst * srvtyperqst;
+   SLPDNormalisedQuery * query;
 
    dh = SLPDatabaseOpen(&G_SlpdDatabase.database);
    if (dh)
@@ -1320,6 +1829,14 @@ int SLPDDatabaseSrvTypeRqstStart(SLPMessage * msg,
       /* srvtyperqst is the SrvTypeRqst being made */
       srvtyperqst = &(msg->body.srvtyperqst);
 
+      /* Normalise the scopes being requested, once */
+      if (createNormalisedQuery(0, 0, 0, 0, srvtyperqst->scopelistlen,
+            srvtyperqst->scopelist, &query) != SLP_ERROR_OK)
+      {
+         SLPDatabaseClose(dh);
+         return SLP_ERROR_INTERNAL_ERROR;
+      }
+
       while (1)
       {
          /* allocate result with generous srvtypelist of url entry pointers */
@@ -1330,6 +1847,7 @@ int SLPDDatabaseSrvTypeRqstStart(SLPMessage * msg,
          {
             /* out of memory */
             SLPDatabaseClose(dh);
+            xfree(query);
             return SLP_ERROR_INTERNAL_ERROR;
          }
          (*result)->srvtypelist = (char*)((*result) + 1);
@@ -1343,16 +1861,19 @@ int SLPDDatabaseSrvTypeRqstStart(SLPMessage * msg,
          {
             entry = SLPDatabaseEnum(dh);
             if (entry == 0)
+            {
+               xfree(query);
                return 0; /* This is the only successful way out */
+            }
 
             /* entry reg is the SrvReg message from the database */
             entryreg = &entry->msg->body.srvreg;
+            entrynorm = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
 
             if (SLPCompareNamingAuth(entryreg->srvtypelen, entryreg->srvtype,
                      srvtyperqst->namingauthlen, srvtyperqst->namingauth) == 0
-                  && SLPIntersectStringList(srvtyperqst->scopelistlen,
-                        srvtyperqst->scopelist, entryreg->scopelistlen,
-                        entryreg->scopelist)
+                  && intersectScopes(query->scopecount, query->scopes,
+                        entrynorm->scopecount, entrynorm->scopes)
                   && SLPContainsStringList((*result)->srvtypelistlen,
                         (*result)->srvtypelist, entryreg->srvtypelen,
                         entryreg->srvtype) == 0)
@@ -1401,7 +1922,8 @@ void SLPDDatabaseSrvTypeRqstEnd(SLPDDatabaseSrvTypeRqstResult * result)
 
 /** Process an entry and incorporate its attributes into the result.
  *
- * @param[in] msg - request message.
+ * @param[in] attrrqst - request message.
+ * @param[in] query - normalised strings of the request message.
  * @param[in] entry - database entry to be tested.
  *
  * @return Non-zero if the entry matches the request, and should be returned,
@@ -1409,21 +1931,20 @@ void SLPDDatabaseSrvTypeRqstEnd(SLPDDatabaseSrvTypeRqstResult * result)
  */
 static int SLPDDatabaseAttrRqstProcessEntry(
    SLPAttrRqst * attrrqst,
-   SLPSrvReg * entryreg,
+   const SLPDNormalisedQuery * query,
+   SLPDatabaseEntry * entry,
    SLPDDatabaseAttrRqstResult ** result)
 {
+   SLPSrvReg * entryreg = &entry->msg->body.srvreg;
+   SLPDNormalisedReg * entrynorm = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
 #ifdef ENABLE_SLPv2_SECURITY
    int i;
 #endif
 
-   if (SLPCompareString(attrrqst->urllen, attrrqst->url,
-            entryreg->urlentry.urllen, entryreg->urlentry.url) == 0
-         || SLPCompareSrvType(attrrqst->urllen, attrrqst->url,
-               entryreg->srvtypelen, entryreg->srvtype) == 0)
+   if (matchUrl(entrynorm, query) || matchSrvtype(entrynorm, query))
    {
-      if (SLPIntersectStringList(attrrqst->scopelistlen,
-            attrrqst->scopelist, entryreg->scopelistlen,
-            entryreg->scopelist))
+      if (intersectScopes(query->scopecount, query->scopes,
+            entrynorm->scopecount, entrynorm->scopes))
       {
          if (attrrqst->taglistlen == 0)
          {
@@ -1470,6 +1991,7 @@ static int SLPDDatabaseAttrRqstProcessEntry(
 typedef struct
 {
    SLPMessage *                   msg;
+   const SLPDNormalisedQuery *    query;
    SLPDDatabaseAttrRqstResult **  result;
    int                            error_code;
 } SLPDDatabaseAttrRqstStartIndexCallbackParams;
@@ -1491,13 +2013,15 @@ static void SLPDDatabaseAttrRqstStartIndexCallback(void * cookie, void *p)
    entry = (SLPDatabaseEntry *)p;
    msg = params->msg;
 
-   (void)SLPDDatabaseAttrRqstProcessEntry(&msg->body.attrrqst, &entry->msg->body.srvreg, result);
+   (void)SLPDDatabaseAttrRqstProcessEntry(&msg->body.attrrqst, params->query, entry, result);
 }
 
 /** Find attributes in the database via srvtype index
  *
  * @param[in] msg - The AttrRqst to find.
  *
+ * @param[in] query - The normalised strings of the AttrRqst.
+ *
  * @param[out] result - The address of storage for the returned
  *    result structure.
  *
@@ -1507,13 +2031,14 @@ static void SLPDDatabaseAttrRqstStartIndexCallback(void * cookie, void *p)
  *    SLPDDatabaseAttrRqstEnd to free it.
  */
 int SLPDDatabaseAttrRqstStartIndexType(SLPMessage * msg,
+      const SLPDNormalisedQuery * query,
       SLPDDatabaseAttrRqstResult ** result)
 {
    SLPAttrRqst * attrrqst;
    size_t srvtypelen;
    const char *srvtype;
    const char *p;
-   SLPNormalisedSrvtype * pNormalisedSrvtype;
+   SLPDInternStr * isrvtype;
    SLPDDatabaseAttrRqstStartIndexCallbackParams params;
    char urlnull;
    char *urlnullptr;
@@ -1540,21 +2065,24 @@ int SLPDDatabaseAttrRqstStartIndexType(SLPMessage * msg,
       srvtypelen = p - srvtype;
    }
 
-   /* index contains normalised service types, so normalise this one before searching for it */
-   if (createNormalisedSrvtype(srvtypelen, srvtype, &pNormalisedSrvtype) == SLP_ERROR_OK)
+   /* index contains normalised service types, and every one of them is
+    * interned, so a service type that is not interned has no entries
+    */
+   stripServicePrefix(&srvtypelen, &srvtype);
+   isrvtype = SLPDInternFind(&srvtype_pool, srvtypelen, srvtype);
+   if (isrvtype)
    {
       /* Search the srvtype index */
       params.msg = msg;
+      params.query = query;
       params.result = result;
       params.error_code = 0;
       find_and_call(
          srvtype_index_tree,
-         pNormalisedSrvtype->srvtypelen,
-         pNormalisedSrvtype->srvtype,
+         isrvtype->len,
+         isrvtype->str,
          SLPDDatabaseAttrRqstStartIndexCallback,
          (void *)&params);
-
-      freeNormalisedSrvtype(pNormalisedSrvtype);
    }
 
    return 0;
@@ -1564,6 +2092,8 @@ int SLPDDatabaseAttrRqstStartIndexType(SLPMessage * msg,
  *
  * @param[in] msg - The AttrRqst to find.
  *
+ * @param[in] query - The normalised strings of the AttrRqst.
+ *
  * @param[out] result - The address of storage for the returned
  *    result structure.
  *
@@ -1573,11 +2103,11 @@ int SLPDDatabaseAttrRqstStartIndexType(SLPMessage * msg,
  *    SLPDDatabaseAttrRqstEnd to free it.
  */
 int SLPDDatabaseAttrRqstStartScan(SLPMessage * msg,
+      const SLPDNormalisedQuery * query,
       SLPDDatabaseAttrRqstResult ** result)
 {
    SLPDatabaseHandle dh;
    SLPDatabaseEntry * entry;
-   SLPSrvReg * entryreg;
    SLPAttrRqst * attrrqst;
 
    dh = (*result)->reserved;
@@ -1593,10 +2123,7 @@ int SLPDDatabaseAttrRqstStartScan(SLPMessage * msg,
          if (entry == 0)
             return 0;
 
-         /* entry reg is the SrvReg message from the database */
-         entryreg = &entry->msg->body.srvreg;
-
-         if (SLPDDatabaseAttrRqstProcessEntry(attrrqst, entryreg, result) != 0)
+         if (SLPDDatabaseAttrRqstProcessEntry(attrrqst, query, entry, result) != 0)
             return 0;
       }
    }
@@ -1619,6 +2146,8 @@ int SLPDDatabaseAttrRqstStart(SLPMessage * msg,
       SLPDDatabaseAttrRqstResult ** result)
 {
    SLPDatabaseHandle dh;
+   SLPAttrRqst * attrrqst = &msg->body.attrrqst;
+   SLPDNormalisedQuery * query;
    int start_result = 1;
 
    *result = xmalloc(sizeof(SLPDDatabaseAttrRqstResult));
@@ -1626,6 +2155,18 @@ int SLPDDatabaseAttrRqstStart(SLPMessage * msg,
       return SLP_ERROR_INTERNAL_ERROR;
 
    memset(*result, 0, sizeof(SLPDDatabaseAttrRqstResult));
+
+   /* The request names either a URL or a service type, so normalise it
+    * as both, together with the scopes, once
+    */
+   if (createNormalisedQuery(attrrqst->urllen, attrrqst->url, attrrqst->urllen,
+         attrrqst->url, attrrqst->scopelistlen, attrrqst->scopelist, &query) != SLP_ERROR_OK)
+   {
+      xfree(*result);
+      *result = 0;
+      return SLP_ERROR_INTERNAL_ERROR;
+   }
+
    dh = SLPDatabaseOpen(&G_SlpdDatabase.database);
    if (dh)
    {
@@ -1634,13 +2175,14 @@ int SLPDDatabaseAttrRqstStart(SLPMessage * msg,
       /* Check if we can use the srvtype index */
       if (G_SlpdProperty.srvtypeIsIndexed)
       {
-         start_result = SLPDDatabaseAttrRqstStartIndexType(msg, result);
+         start_result = SLPDDatabaseAttrRqstStartIndexType(msg, query, result);
       }
       else
       {
-         start_result = SLPDDatabaseAttrRqstStartScan(msg, result);
+         start_result = SLPDDatabaseAttrRqstStartScan(msg, query, result);
       }
    }
+   xfree(query);
 
    /** TODO: Figure out what to do with start_result. */
    (void)start_result;
@@ -1713,6 +2255,78 @@ void SLPDDatabaseEnumEnd(void * eh)
       SLPDatabaseClose((SLPDatabaseHandle)eh);
 }
 
+/** The generation of a registration in the database.
+ */
+#define ENTRY_GENERATION(entry) \
+      (((SLPDNormalisedReg *)(entry)->handles[HANDLE_SRVTYPE])->generation)
+
+/** Get the generation of the most recent registration.
+ *
+ * @return The generation; every registration in the database has a
+ *    generation no larger than this.
+ */
+unsigned long SLPDDatabaseGeneration(void)
+{
+   return G_SlpdDatabase.generation;
+}
+
+/** Position a cursor after the registrations up to a generation.
+ *
+ * @param[out] cursor - The cursor to initialize.
+ * @param[in] generation - The cursor will return registrations newer
+ *    than this; pass 0 to start at the oldest registration.
+ */
+void SLPDDatabaseCursorInit(SLPDDatabaseCursor * cursor,
+      unsigned long generation)
+{
+   cursor->generation = generation;
+   cursor->removals = 0;
+   cursor->entry = 0;
+}
+
+/** Return the next registration at a cursor and advance it.
+ *
+ * @param[in,out] cursor - The cursor, from SLPDDatabaseCursorInit.
+ * @param[in] limit - Stop at registrations newer than this generation.
+ * @param[out] msg - The address of storage for a SrvReg message object.
+ * @param[out] buf - The address of storage for a SrvReg buffer object.
+ *
+ * @return The next registration, or 0 if there is none up to @p limit.
+ *
+ * @remarks The database may change between calls. The cursor remembers
+ *    the entry it returned last and steps on from it in constant time
+ *    unless entries were removed since, in which case it finds its place
+ *    again by generation.
+ */
+SLPMessage * SLPDDatabaseCursorNext(SLPDDatabaseCursor * cursor,
+      unsigned long limit, SLPMessage ** msg, SLPBuffer * buf)
+{
+   SLPDatabaseEntry * entry;
+
+   if (cursor->entry && cursor->removals == G_SlpdDatabase.removals)
+      entry = (SLPDatabaseEntry *)((SLPListItem *)cursor->entry)->next;
+   else
+   {
+      entry = (SLPDatabaseEntry *)G_SlpdDatabase.database.head;
+      while (entry && ENTRY_GENERATION(entry) <= cursor->generation)
+         entry = (SLPDatabaseEntry *)entry->listitem.next;
+   }
+
+   if (entry == 0 || ENTRY_GENERATION(entry) > limit)
+   {
+      *msg = 0;
+      *buf = 0;
+      return 0;
+   }
+
+   cursor->generation = ENTRY_GENERATION(entry);
+   cursor->removals = G_SlpdDatabase.removals;
+   cursor->entry = entry;
+   *msg = entry->msg;
+   *buf = entry->buf;
+   return *msg;
+}
+
 /** Indicates whether or not the database is empty.
  *
  * Note also that this will return false if the
@@ -1752,9 +2366,13 @@ int SLPDDatabaseInit(const char * regfile)
 
    /* Set initial values */
    memset(&G_SlpdDatabase,0,sizeof(G_SlpdDatabase));
+   G_StaticImage = 0;
+   G_StaticCurrent = 0;
    G_SlpdDatabase.urlcount = SLPDDATABASE_INITIAL_URLCOUNT;
    G_SlpdDatabase.srvtypelistlen = SLPDDATABASE_INITIAL_SRVTYPELISTLEN;
    SLPDatabaseInit(&G_SlpdDatabase.database);
+   SLPDInternPoolInit(&srvtype_pool);
+   SLPDInternPoolInit(&scope_pool);
 
 #ifdef ENABLE_PREDICATES
    /* Initialise the tag indexes */
@@ -1829,7 +2447,77 @@ int SLPDDatabaseInit(const char * regfile)
    return SLPDDatabaseReInit(regfile);
 }
 
+/** Apply one registration read from the regfile during a reload.
+ *
+ * A static registration with the same URL and scope list as one already
+ * in the database, and byte for byte the same message, is kept: the new
+ * message merely takes the place of the old one, so that the old message
+ * (which may live in a regfile image about to be closed) can be released.
+ * Anything else is registered as usual, replacing an older registration
+ * of the URL in the same scopes.
+ *
+ * @param[in] msg - The SrvReg message read from the regfile.
+ * @param[in] buf - The buffer interpreted by @p msg.
+ *
+ * @return Zero if @p msg and @p buf were consumed, or a non-zero value
+ *    if the caller must free them.
+ */
+static int reloadStaticReg(SLPMessage * msg, SLPBuffer buf)
+{
+   SLPSrvReg * reg = &msg->body.srvreg;
+   SLPDatabaseEntry * entry = 0;
+   SLPDNormalisedReg * entrynorm;
+   SLPSrvReg * entryreg;
+   IndexTreeValue * value;
+   size_t urllen;
+   char * url;
+
+   /* look the registration up by its URL and scope list */
+   url = xmalloc(reg->urlentry.urllen + 1);
+   if (url)
+   {
+      urllen = SLPNormalizeString(reg->urlentry.urllen, reg->urlentry.url, url, 1);
+      for (value = find_in_index(url_index_tree, urllen, url); value; value = value->next)
+      {
+         entryreg = &((SLPDatabaseEntry *)value->p)->msg->body.srvreg;
+         if (entryreg->source == SLP_REG_SOURCE_STATIC
+               && entryreg->scopelistlen == reg->scopelistlen
+               && memcmp(entryreg->scopelist, reg->scopelist, reg->scopelistlen) == 0)
+         {
+            entry = (SLPDatabaseEntry *)value->p;
+            break;
+         }
+      }
+      xfree(url);
+   }
+
+   if (entry == 0
+         || entry->buf->end - entry->buf->start != buf->end - buf->start
+         || memcmp(entry->buf->start, buf->start, buf->end - buf->start) != 0)
+      return SLPDDatabaseReg(msg, buf);
+
+   /* unchanged - the normalised form and parsed attributes still apply */
+   fixupLifetime(reg);
+   SLPMessageFree(entry->msg);
+   SLPBufferFree(entry->buf);
+   entry->msg = msg;
+   entry->buf = buf;
+   entrynorm = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
+   if (entrynorm->reload != G_StaticReload)
+   {
+      entrynorm->reload = G_StaticReload;
+      G_StaticCurrent++;
+   }
+   return 0;
+}
+
 /** Re-initialize the database with changed registrations from a regfile.
+ *
+ * A compiled regfile that is unchanged since it was last loaded is left
+ * alone. Otherwise the file is compared, registration by registration,
+ * with the static registrations in the database: new and changed ones
+ * are registered, unchanged ones are kept as they are, and those that
+ * are no longer in the file are removed.
  *
  * @param[in] regfile - The registration file to register.
  *
@@ -1839,36 +2527,45 @@ int SLPDDatabaseReInit(const char * regfile)
 {
    SLPDatabaseHandle dh;
    SLPDatabaseEntry * entry;
+   SLPDNormalisedReg * entrynorm;
+   SLPDRegFileImage image;
    SLPMessage * msg;
    SLPBuffer buf;
    FILE * fd;
+   size_t pos;
 
-   /* open the database handle and remove all the static registrations
-      (the registrations from the /etc/slp.reg) file. */
-   dh = SLPDatabaseOpen(&G_SlpdDatabase.database);
-   if (dh)
+   image = regfile? SLPDRegFileImageOpen(regfile): 0;
+   if (image && G_StaticImage && SLPDRegFileImageSame(image, G_StaticImage))
    {
-      while (1)
-      {
-         entry = SLPDatabaseEnum(dh);
-         if (entry == 0)
-            break;
+      SLPDRegFileImageClose(image);
+      return 0;
+   }
 
-         if (entry->msg->body.srvreg.source == SLP_REG_SOURCE_STATIC)
-            SLPDDatabaseRemove(dh, entry);
+   G_StaticReload++;
+   G_StaticCurrent = 0;
+
+   if (image)
+   {
+      /* register the compiled registrations in place */
+      pos = 0;
+      while (SLPDRegFileImageReadSrvReg(image, &pos, &msg, &buf) >= 0)
+      {
+         if (msg && reloadStaticReg(msg, buf) != SLP_ERROR_OK)
+         {
+            SLPMessageFree(msg);
+            SLPBufferFree(buf);
+         }
       }
-      SLPDatabaseClose(dh);
    }
-
-   /* read static registration file if any */
-   if (regfile)
+   else if (regfile)
    {
+      /* read static registration file if any */
       fd = fopen(regfile, "rb");
       if (fd)
       {
          while (SLPDRegFileReadSrvReg(fd, &msg, &buf) == 0)
          {
-            if (SLPDDatabaseReg(msg, buf) != SLP_ERROR_OK)
+            if (reloadStaticReg(msg, buf) != SLP_ERROR_OK)
             {
                /* Only if the reg *didn't* succeed do we free the memory */
                SLPMessageFree(msg);
@@ -1878,6 +2575,28 @@ int SLPDDatabaseReInit(const char * regfile)
          fclose(fd);
       }
    }
+
+   /* remove the static registrations that are no longer in the file, if
+      there are any - a reload that changed nothing, or only added and
+      changed registrations, need not look through the database */
+   if (G_SlpdDatabase.staticcount > G_StaticCurrent
+         && (dh = SLPDatabaseOpen(&G_SlpdDatabase.database)) != 0)
+   {
+      while (G_SlpdDatabase.staticcount > G_StaticCurrent
+            && (entry = SLPDatabaseEnum(dh)) != 0)
+      {
+         entrynorm = (SLPDNormalisedReg *)entry->handles[HANDLE_SRVTYPE];
+         if (entry->msg->body.srvreg.source == SLP_REG_SOURCE_STATIC
+               && entrynorm->reload != G_StaticReload)
+            SLPDDatabaseRemove(dh, entry);
+      }
+      SLPDatabaseClose(dh);
+   }
+
+   /* the old static registrations may have lived in the old image */
+   if (G_StaticImage)
+      SLPDRegFileImageClose(G_StaticImage);
+   G_StaticImage = image;
    return 0;
 }
 
@@ -1886,7 +2605,22 @@ int SLPDDatabaseReInit(const char * regfile)
  */
 void SLPDDatabaseDeinit(void)
 {
+   SLPDatabaseHandle dh;
+   SLPDatabaseEntry * entry;
+
+   /* Remove the entries one by one, so their normalised forms are released */
+   if ((dh = SLPDatabaseOpen(&G_SlpdDatabase.database)) != 0)
+   {
+      while ((entry = SLPDatabaseEnum(dh)) != 0)
+         SLPDDatabaseRemove(dh, entry);
+      SLPDatabaseClose(dh);
+   }
+   if (G_StaticImage)
+      SLPDRegFileImageClose(G_StaticImage);
+   G_StaticImage = 0;
    SLPDatabaseDeinit(&G_SlpdDatabase.database);
+   SLPDInternPoolDeinit(&srvtype_pool);
+   SLPDInternPoolDeinit(&scope_pool);
 }
 
 /** Dumps currently valid service registrations present with slpd.
@@ -60,8 +60,24 @@ typedef struct _SLPDDatabase
    SLPDatabase database;
    int urlcount;
    size_t srvtypelistlen;
+   unsigned long generation;  /* stamped on each registration as it is added */
+   unsigned long removals;    /* bumped each time an entry is removed */
+   size_t staticcount;        /* number of registrations from the regfile */
 } SLPDDatabase;
 
+/** A position in the database that survives changes between calls.
+ *
+ * Registrations are kept in the order they were made, each stamped with
+ * a larger generation than the one before, so a cursor is just the
+ * generation of the last registration it returned.
+ */
+typedef struct _SLPDDatabaseCursor
+{
+   unsigned long generation;  /* generation of the last entry returned */
+   unsigned long removals;    /* database removal count when entry was cached */
+   void * entry;              /* the last entry returned, valid while removals match */
+} SLPDDatabaseCursor;
+
 typedef struct _SLPDDatabaseSrvRqstResult
 {
    void * reserved;
@@ -89,6 +105,8 @@ typedef struct _SLPDDatabaseAttrRqstResult
 void SLPDDatabaseAge(int seconds, int ageall);
 int SLPDDatabaseReg(SLPMessage * msg, SLPBuffer buf);
 int SLPDDatabaseDeReg(SLPMessage * msg);
+void SLPDDatabaseForget(size_t urllen, const char * url,
+      size_t scopelistlen, const char * scopelist);
 int SLPDDatabaseSrvRqstStart(SLPMessage * msg, 
       SLPDDatabaseSrvRqstResult ** result);
 void SLPDDatabaseSrvRqstEnd(SLPDDatabaseSrvRqstResult * result);
@@ -101,6 +119,11 @@ void SLPDDatabaseAttrRqstEnd(SLPDDatabaseAttrRqstResult * result);
 void * SLPDDatabaseEnumStart(void);
 SLPMessage * SLPDDatabaseEnum(void * eh, SLPMessage ** msg, SLPBuffer * buf);
 void SLPDDatabaseEnumEnd(void * eh);
+unsigned long SLPDDatabaseGeneration(void);
+void SLPDDatabaseCursorInit(SLPDDatabaseCursor * cursor,
+      unsigned long generation);
+SLPMessage * SLPDDatabaseCursorNext(SLPDDatabaseCursor * cursor,
+      unsigned long limit, SLPMessage ** msg, SLPBuffer * buf);
 int SLPDDatabaseIsEmpty(void);
 int SLPDDatabaseInit(const char * regfile);
 int SLPDDatabaseReInit(const char * regfile);
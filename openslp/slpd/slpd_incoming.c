@@ -184,8 +184,17 @@ static void IncomingStreamWrite(SLPList * socklist, SLPDSocket * sock)
 
    if (sock->sendbuf->end - sock->sendbuf->curpos != 0)
    {
+      size_t sendlen = sock->sendbuf->end - sock->sendbuf->curpos;
+
+      /* Local sockets preserve record boundaries, so send each message
+       * of a multi-message reply (the loopback DA response) on its own.
+       */
+      if (sock->islocal && sendlen >= 5
+            && (size_t)PEEK_LENGTH(sock->sendbuf->curpos) < sendlen)
+         sendlen = PEEK_LENGTH(sock->sendbuf->curpos);
+
       byteswritten = send(sock->fd, (char *)sock->sendbuf->curpos,
-            (int)(sock->sendbuf->end - sock->sendbuf->curpos), flags);
+            (int)sendlen, flags);
       if (byteswritten > 0)
       {
          /* reset lifetime to max because of activity */
@@ -227,6 +236,7 @@ static void IncomingStreamWrite(SLPList * socklist, SLPDSocket * sock)
 static void IncomingStreamRead(SLPList * socklist, SLPDSocket * sock)
 {
    int bytesread;
+   int result;
    size_t recvlen = 0;
    char peek[16];
    socklen_t peeraddrlen = sizeof(struct sockaddr_storage);
@@ -236,8 +246,11 @@ static void IncomingStreamRead(SLPList * socklist, SLPDSocket * sock)
       /*---------------------------------------------------*/
       /* take a peek at the packet to get size information */
       /*---------------------------------------------------*/
-      bytesread = recvfrom(sock->fd, (char *)peek, 16, MSG_PEEK,
-            (struct sockaddr *)&sock->peeraddr, &peeraddrlen);
+      if (sock->islocal)   /* keep the loopback stand-in peer address */
+         bytesread = recv(sock->fd, (char *)peek, 16, MSG_PEEK);
+      else
+         bytesread = recvfrom(sock->fd, (char *)peek, 16, MSG_PEEK,
+               (struct sockaddr *)&sock->peeraddr, &peeraddrlen);
       if (bytesread > 0 && bytesread >= (*peek == 2? 5: 4))
       {
          recvlen = PEEK_LENGTH(peek);
@@ -278,8 +291,14 @@ static void IncomingStreamRead(SLPList * socklist, SLPDSocket * sock)
                 * to be emptied, so make sure there is at least a minimal buffer
                 */
                sock->sendbuf = SLPBufferAlloc(1);
-            switch (SLPDProcessMessage(&sock->peeraddr,
-                  &sock->localaddr, sock->recvbuf, &sock->sendbuf, 0))
+            if (sock->islocal)
+               result = SLPDProcessLocalMessage(&sock->peeraddr,
+                     &sock->localaddr, sock->peerpid, sock->recvbuf,
+                     &sock->sendbuf);
+            else
+               result = SLPDProcessMessage(&sock->peeraddr,
+                     &sock->localaddr, sock->recvbuf, &sock->sendbuf, 0);
+            switch (result)
             {
                case SLP_ERROR_PARSE_ERROR:
                case SLP_ERROR_VER_NOT_SUPPORTED:
@@ -316,6 +335,26 @@ static void IncomingStreamRead(SLPList * socklist, SLPDSocket * sock)
    }
 }
 
+#ifdef SLP_HAVE_LOCAL_SOCKET
+/** Fill in the loopback address that stands in for a local socket peer.
+ *
+ * @param[out] addr - The address structure to be filled.
+ *
+ * @internal
+ */
+static void SetLocalPeerAddr(struct sockaddr_storage * addr)
+{
+   if (SLPNetIsIPV4())
+   {
+      int tmpaddr = INADDR_LOOPBACK;
+      SLPNetSetAddr(addr, AF_INET, G_SlpdProperty.port, &tmpaddr);
+   }
+   else
+      SLPNetSetAddr(addr, AF_INET6, G_SlpdProperty.port,
+            &slp_in6addr_loopback);
+}
+#endif
+
 /** Listen on an inbound socket.
  *
  * @param[in] socklist - The list of monitored sockets.
@@ -348,6 +387,20 @@ static void IncomingSocketListen(SLPList * socklist, SLPDSocket * sock)
             memcpy(&connsock->localaddr, &peeraddr,
                   sizeof(struct sockaddr_storage));
             connsock->state = STREAM_READ_FIRST;
+#ifdef SLP_HAVE_LOCAL_SOCKET
+            if (sock->localaddr.ss_family == AF_UNIX)
+            {
+               /* A local peer is by definition on this host: stand in the
+                * loopback address for it, so the usual locality checks
+                * hold, and remember who the kernel says it is.
+                */
+               connsock->islocal = 1;
+               SetLocalPeerAddr(&connsock->peeraddr);
+               SetLocalPeerAddr(&connsock->localaddr);
+               SLPDSocketGetPeerPid(fd, &connsock->peerpid);
+            }
+            else
+#endif
 #ifndef _WIN32
             {
                /* Set the receive and send buffer low water mark to 18 bytes
@@ -812,6 +865,35 @@ int SLPDIncomingReinit(void)
       }
    }
 
+#ifdef SLP_HAVE_LOCAL_SOCKET
+   /*--------------------------------------------------------------------*/
+   /* Create SOCKET_LISTEN socket on the local (AF_UNIX) path, which the */
+   /* library prefers over loopback TCP when it is present.              */
+   /*--------------------------------------------------------------------*/
+   if (G_SlpdProperty.localSocketPath && *G_SlpdProperty.localSocketPath)
+   {
+      struct sockaddr_un * unaddr = (struct sockaddr_un *)&myaddr;
+      memset(&myaddr, 0, sizeof(myaddr));
+      unaddr->sun_family = AF_UNIX;
+      strncpy(unaddr->sun_path, G_SlpdProperty.localSocketPath,
+            sizeof(unaddr->sun_path) - 1);
+      if (FindListeningSocket(&myaddr))
+         SLPDLog("Already listening on %s.\n", G_SlpdProperty.localSocketPath);
+      else
+      {
+         sock = SLPDSocketCreateLocalListen(G_SlpdProperty.localSocketPath);
+         if (sock)
+         {
+            SLPListLinkTail(&G_IncomingSocketList, (SLPListItem *) sock);
+            SLPDLog("Listening on %s...\n", G_SlpdProperty.localSocketPath);
+         }
+         else
+            SLPDLog("NETWORK_ERROR - Could not listen on %s (%s)\n",
+                  G_SlpdProperty.localSocketPath, strerror(errno));
+      }
+   }
+#endif
+
    /*---------------------------------------------------------------------*/
    /* Create sockets for all of the interfaces in the interfaces property */
    /*---------------------------------------------------------------------*/
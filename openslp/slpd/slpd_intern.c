@@ -0,0 +1,268 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Interned, normalised registration strings.
+ *
+ * Registrations carry a handful of strings - service types and scope
+ * names - that are shared by many entries and compared on every request.
+ * A pool stores each such string once, normalised with SLPNormalizeString
+ * (trimmed, white space folded, unescaped and case folded) and hashed, so
+ * that the database can match them by pointer rather than by repeating
+ * the normalisation on every comparison. Strings are reference counted
+ * and leave the pool when their last holder releases them.
+ *
+ * @file       slpd_intern.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    SlpdCode
+ */
+
+#include "slpd_intern.h"
+
+#include "slp_compare.h"
+#include "slp_hash.h"
+#include "slp_xmalloc.h"
+
+/** The initial number of buckets in a pool. */
+#define SLPD_INTERN_INITSIZE  64
+
+/** The size of the on-stack normalisation buffer. */
+#define SLPD_INTERN_STACKLEN  256
+
+/** Initialize an empty pool.
+ *
+ * @param[out] pool - The pool to initialize.
+ */
+void SLPDInternPoolInit(SLPDInternPool * pool)
+{
+   memset(pool, 0, sizeof(*pool));
+}
+
+/** Release all memory held by a pool.
+ *
+ * @param[in,out] pool - The pool to clean up.
+ *
+ * @remarks Any interned strings still held become invalid.
+ */
+void SLPDInternPoolDeinit(SLPDInternPool * pool)
+{
+   size_t i;
+
+   for (i = 0; i < pool->size; i++)
+   {
+      SLPDInternStr * istr = pool->buckets[i];
+      while (istr)
+      {
+         SLPDInternStr * next = istr->next;
+         xfree(istr);
+         istr = next;
+      }
+   }
+   xfree(pool->buckets);
+   memset(pool, 0, sizeof(*pool));
+}
+
+/** Double the number of buckets in a pool.
+ *
+ * @param[in,out] pool - The pool to grow.
+ *
+ * @return Zero on success, or non-zero on memory allocation failure.
+ *
+ * @internal
+ */
+static int SLPDInternPoolGrow(SLPDInternPool * pool)
+{
+   size_t size = pool->size? pool->size * 2: SLPD_INTERN_INITSIZE;
+   SLPDInternStr ** buckets;
+   size_t i;
+
+   buckets = xmalloc(size * sizeof(*buckets));
+   if (buckets == 0)
+      return -1;
+   memset(buckets, 0, size * sizeof(*buckets));
+
+   for (i = 0; i < pool->size; i++)
+   {
+      SLPDInternStr * istr = pool->buckets[i];
+      while (istr)
+      {
+         SLPDInternStr * next = istr->next;
+         istr->next = buckets[istr->hash & (size - 1)];
+         buckets[istr->hash & (size - 1)] = istr;
+         istr = next;
+      }
+   }
+   xfree(pool->buckets);
+   pool->buckets = buckets;
+   pool->size = size;
+   return 0;
+}
+
+/** Find or add a normalised string in a pool.
+ *
+ * @param[in,out] pool - The pool to search.
+ * @param[in] len - The length of @p str in bytes.
+ * @param[in] str - The normalised string to locate.
+ * @param[in] add - Non-zero to add @p str (with a reference) if it is
+ *    missing, and to add a reference if it is present.
+ *
+ * @return The interned string, or NULL if it is missing and @p add is
+ *    zero, or on memory allocation failure.
+ *
+ * @internal
+ */
+static SLPDInternStr * SLPDInternLookup(SLPDInternPool * pool, size_t len,
+      const char * str, int add)
+{
+   uint32_t hash = SLPHash(str, len);
+   SLPDInternStr * istr;
+
+   if (pool->size)
+      for (istr = pool->buckets[hash & (pool->size - 1)]; istr;
+            istr = istr->next)
+         if (istr->hash == hash && istr->len == len
+               && memcmp(istr->str, str, len) == 0)
+         {
+            if (add)
+               istr->refcount++;
+            return istr;
+         }
+
+   if (!add)
+      return 0;
+
+   /* Keep the load factor at or below one. */
+   if (pool->count + 1 > pool->size && SLPDInternPoolGrow(pool) != 0)
+      return 0;
+
+   istr = xmalloc(sizeof(SLPDInternStr) + len);
+   if (istr == 0)
+      return 0;
+   istr->hash = hash;
+   istr->refcount = 1;
+   istr->len = len;
+   memcpy(istr->str, str, len);
+   istr->str[len] = 0;
+   istr->next = pool->buckets[hash & (pool->size - 1)];
+   pool->buckets[hash & (pool->size - 1)] = istr;
+   pool->count++;
+   return istr;
+}
+
+/** Normalise a string and find or add it in a pool.
+ *
+ * @param[in,out] pool - The pool to search.
+ * @param[in] len - The length of @p str in bytes.
+ * @param[in] str - The string to normalise and locate.
+ * @param[in] add - As for SLPDInternLookup.
+ *
+ * @return As for SLPDInternLookup.
+ *
+ * @internal
+ */
+static SLPDInternStr * SLPDInternNormalised(SLPDInternPool * pool,
+      size_t len, const char * str, int add)
+{
+   char stackbuf[SLPD_INTERN_STACKLEN];
+   char * buf = stackbuf;
+   SLPDInternStr * istr;
+
+   /* A normalised string is never longer than its source. */
+   if (len > sizeof(stackbuf) && (buf = xmalloc(len)) == 0)
+      return 0;
+
+   len = SLPNormalizeString(len, str, buf, 1);
+   istr = SLPDInternLookup(pool, len, buf, add);
+
+   if (buf != stackbuf)
+      xfree(buf);
+   return istr;
+}
+
+/** Intern a string.
+ *
+ * Normalises @p str and returns the pool's copy of the result, adding
+ * it if necessary. Each successful call takes a reference that must be
+ * dropped with SLPDInternRelease.
+ *
+ * @param[in,out] pool - The pool to use.
+ * @param[in] len - The length of @p str in bytes.
+ * @param[in] str - The (not necessarily normalised) string to intern.
+ *
+ * @return The interned string, or NULL on memory allocation failure.
+ */
+SLPDInternStr * SLPDInternGet(SLPDInternPool * pool, size_t len,
+      const char * str)
+{
+   return SLPDInternNormalised(pool, len, str, 1);
+}
+
+/** Look up a string without interning it.
+ *
+ * Used on the request side: a string that is not in the pool can not
+ * match any registration, and no reference is taken.
+ *
+ * @param[in] pool - The pool to search.
+ * @param[in] len - The length of @p str in bytes.
+ * @param[in] str - The (not necessarily normalised) string to find.
+ *
+ * @return The interned string, or NULL if it is not in @p pool.
+ */
+SLPDInternStr * SLPDInternFind(SLPDInternPool * pool, size_t len,
+      const char * str)
+{
+   return SLPDInternNormalised(pool, len, str, 0);
+}
+
+/** Drop a reference to an interned string.
+ *
+ * @param[in,out] pool - The pool that owns @p istr.
+ * @param[in] istr - The interned string to release; may be NULL.
+ */
+void SLPDInternRelease(SLPDInternPool * pool, SLPDInternStr * istr)
+{
+   SLPDInternStr ** pp;
+
+   if (istr == 0 || --istr->refcount)
+      return;
+
+   for (pp = &pool->buckets[istr->hash & (pool->size - 1)]; *pp;
+         pp = &(*pp)->next)
+      if (*pp == istr)
+      {
+         *pp = istr->next;
+         pool->count--;
+         break;
+      }
+   xfree(istr);
+}
+
+/*=========================================================================*/
@@ -0,0 +1,88 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Interned, normalised registration strings.
+ *
+ * @file       slpd_intern.h
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    SlpdCode
+ */
+
+#ifndef SLPD_INTERN_H_INCLUDED
+#define SLPD_INTERN_H_INCLUDED
+
+/*!@defgroup SlpdCodeIntern Interned Strings */
+
+/*!@addtogroup SlpdCodeIntern
+ * @ingroup SlpdCode
+ * @{
+ */
+
+#include "slp_types.h"
+#include "slpd.h"
+
+/** An interned string.
+ *
+ * Every distinct normalised string in a pool is stored exactly once, so
+ * two interned strings from the same pool are equal if and only if their
+ * pointers are equal.
+ */
+typedef struct _SLPDInternStr
+{
+   struct _SLPDInternStr * next; /*!< The next string in the same bucket. */
+   uint32_t hash;                /*!< The hash value of @e str. */
+   unsigned int refcount;        /*!< The number of holders of this string. */
+   size_t len;                   /*!< The length of @e str in bytes. */
+   char str[1];                  /*!< The (null-terminated) normalised string. */
+} SLPDInternStr;
+
+/** A pool of interned strings. */
+typedef struct _SLPDInternPool
+{
+   SLPDInternStr ** buckets;     /*!< The bucket array. */
+   size_t size;                  /*!< The number of buckets (power of 2). */
+   size_t count;                 /*!< The number of strings in the pool. */
+} SLPDInternPool;
+
+void SLPDInternPoolInit(SLPDInternPool * pool);
+void SLPDInternPoolDeinit(SLPDInternPool * pool);
+SLPDInternStr * SLPDInternGet(SLPDInternPool * pool, size_t len,
+      const char * str);
+SLPDInternStr * SLPDInternFind(SLPDInternPool * pool, size_t len,
+      const char * str);
+void SLPDInternRelease(SLPDInternPool * pool, SLPDInternStr * istr);
+
+/*! @} */
+
+#endif   /* SLPD_INTERN_H_INCLUDED */
+
+/*=========================================================================*/
@@ -45,6 +45,8 @@
 #include "slpd_outgoing.h"
 #include "slpd_log.h"
 #include "slpd.h"
+#include "slpd_dasync.h"
+#include "slpd_dacache.h"
 #include "slpd_incoming.h"  /*For the global incoming socket map.  Instead of creating a new
                               socket for every multicast and broadcast, we'll simply send
                               on the existing sockets, using their network interfaces*/
@@ -76,12 +78,49 @@ SLPDatabase G_SlpdKnownDAs;
 int G_KnownDATimeSinceLastRefresh = 0;
 /*=========================================================================*/
 
+/*=========================================================================*/
+int G_KnownDATimeSinceLastSync = 0;
+/*=========================================================================*/
+
 /*=========================================================================*/
 char* G_ifaceurls = 0;
 size_t G_ifaceurlsLen = 0;
 /* Used to filter out our own DA urls */
 /*=========================================================================*/
 
+/*=========================================================================*/
+typedef struct _SLPDKnownDAResync
+/* How far a DA has been brought up to date with our registrations.        */
+/*                                                                         */
+/* Registrations go to a DA in database generation order, a window at a    */
+/* time, as SrvAcks free up its forwarding channel.  The acknowledged      */
+/* prefix is remembered against the DA's bootstamp and scopes, so a DA    */
+/* that comes back without having rebooted or taken on new scopes is only  */
+/* sent what changed since.                                                */
+/*=========================================================================*/
+{
+   SLPListItem listitem;
+   struct sockaddr_storage peer;    /* the DA */
+   uint32_t bootstamp;              /* the DA boot that synced refers to */
+   unsigned long synced;            /* registrations up to here are acked */
+   unsigned long scanned;           /* the pass has looked at these */
+   unsigned long target;            /* the pass stops at this generation */
+   SLPDDatabaseCursor cursor;       /* the pass's place in the database */
+   int active;                      /* the pass still has more to send */
+   int immortalonly;                /* the pass is an immortal refresh */
+   size_t scopelistlen;
+   char * scopelist;                /* the DA's scopes */
+   int head;                        /* ring of the pass's unacked messages */
+   int count;
+   uint16_t xids[SLPD_FORWARD_WINDOW];
+   unsigned long gens[SLPD_FORWARD_WINDOW];
+} SLPDKnownDAResync;
+
+/*=========================================================================*/
+SLPList G_KnownDAResyncs = {0, 0, 0};
+/* Resync state of every DA we have registered with                        */
+/*=========================================================================*/
+
 /*-------------------------------------------------------------------------*/
 int MakeActiveDiscoveryRqst(int ismcast, SLPBuffer * buffer)
 /* Pack a buffer with service:directory-agent SrvRqst                      *
@@ -229,77 +268,232 @@ FINISHED:
 
 
 /*-------------------------------------------------------------------------*/
-void SLPDKnownDARegisterAll(SLPMessage * daadvert, int immortalonly)
-/* registers all services with specified DA                                */
+static SLPDKnownDAResync * KnownDAResyncFind(struct sockaddr_storage * addr,
+                                             int create)
+/* Find (or create) the resync state of the DA at addr                     */
+/*-------------------------------------------------------------------------*/
+{
+   SLPDKnownDAResync * resync;
+
+   resync = (SLPDKnownDAResync *) G_KnownDAResyncs.head;
+   while (resync)
+   {
+      if (SLPNetCompareAddrs(&resync->peer, addr) == 0)
+         return resync;
+      resync = (SLPDKnownDAResync *) resync->listitem.next;
+   }
+
+   if (create)
+   {
+      resync = xmalloc(sizeof(SLPDKnownDAResync));
+      if (resync)
+      {
+         memset(resync, 0, sizeof(SLPDKnownDAResync));
+         memcpy(&resync->peer, addr, sizeof(struct sockaddr_storage));
+         SLPListLinkTail(&G_KnownDAResyncs, (SLPListItem *) resync);
+      }
+   }
+   return resync;
+}
+
+
+/*-------------------------------------------------------------------------*/
+static void KnownDAResyncAcked(SLPDKnownDAResync * resync)
+/* Retire acknowledged messages and move the synced generation up to just  */
+/* before the oldest message still unacknowledged                          */
+/*-------------------------------------------------------------------------*/
+{
+   while (resync->count
+          && !SLPDOutgoingForwardPending(&resync->peer,
+                                         resync->xids[resync->head]))
+   {
+      resync->head = (resync->head + 1) % SLPD_FORWARD_WINDOW;
+      resync->count--;
+   }
+
+   /* an immortal refresh skips most registrations, so proves nothing */
+   if (!resync->immortalonly)
+      resync->synced = resync->count ? resync->gens[resync->head] - 1
+                                     : resync->scanned;
+}
+
+
+/*-------------------------------------------------------------------------*/
+static void KnownDAResyncStop(struct sockaddr_storage * addr)
+/* Interrupt the pass to a DA; a later pass resumes from what was acked    */
+/*-------------------------------------------------------------------------*/
+{
+   SLPDKnownDAResync * resync = KnownDAResyncFind(addr, 0);
+
+   if (resync)
+   {
+      KnownDAResyncAcked(resync);
+      resync->active = 0;
+      resync->count = 0;
+
+      /* whatever was sent but not acked has to be sent again */
+      resync->scanned = resync->synced;
+   }
+}
+
+
+/*-------------------------------------------------------------------------*/
+static void KnownDAResyncPump(SLPDKnownDAResync * resync)
+/* Send as much of the pass as the DA's forwarding channel has room for    */
 /*-------------------------------------------------------------------------*/
 {
-   SLPBuffer buf;
    SLPMessage * msg;
+   SLPBuffer buf;
+   SLPBuffer sendbuf;
    SLPSrvReg * srvreg;
-   SLPDSocket * sock;
-   SLPBuffer sendbuf = 0;
-   void * handle = 0;
+   uint16_t xid;
+   int room;
 
-   /*---------------------------------------------------------------*/
-   /* Check to see if the database is empty and open an enumeration */
-   /* handle if it is not empty                                     */
-   /*---------------------------------------------------------------*/
+   KnownDAResyncAcked(resync);
+   if (!resync->active)
+      return;
+
+   room = SLPDOutgoingForwardRoom(&resync->peer);
+   while (room > 0 && resync->count < SLPD_FORWARD_WINDOW)
+   {
+      if (SLPDDatabaseCursorNext(&resync->cursor, resync->target,
+                                 &msg, &buf) == 0)
+      {
+         /* every registration the pass set out to send has been sent */
+         resync->active = 0;
+         resync->scanned = resync->target;
+         break;
+      }
+      srvreg = &(msg->body.srvreg);
+
+      /*-----------------------------------------------*/
+      /* If so instructed, skip mortal registrations   */
+      /*-----------------------------------------------*/
+      if (resync->immortalonly
+          && srvreg->urlentry.lifetime < SLP_LIFETIME_MAXIMUM)
+      {
+         resync->scanned = resync->cursor.generation;
+         continue;
+      }
+
+      /*---------------------------------------------------------*/
+      /* Only register local (or static) registrations of scopes */
+      /* supported by peer DA                                    */
+      /*---------------------------------------------------------*/
+      if ((srvreg->source == SLP_REG_SOURCE_LOCAL
+            || srvreg->source == SLP_REG_SOURCE_STATIC)
+            && SLPIntersectStringList(srvreg->scopelistlen,
+                                      srvreg->scopelist,
+                                      resync->scopelistlen,
+                                      resync->scopelist))
+      {
+         sendbuf = SLPBufferDup(buf);
+         if (sendbuf == 0
+             || SLPDOutgoingForward(&resync->peer, sendbuf, &xid) != 0)
+         {
+            /* leave this registration for the next pass */
+            resync->active = 0;
+            break;
+         }
+         resync->xids[(resync->head + resync->count) % SLPD_FORWARD_WINDOW] = xid;
+         resync->gens[(resync->head + resync->count) % SLPD_FORWARD_WINDOW]
+               = resync->cursor.generation;
+         resync->count++;
+         room--;
+      }
+      resync->scanned = resync->cursor.generation;
+   }
+
+   KnownDAResyncAcked(resync);
+}
+
+
+/*=========================================================================*/
+void SLPDKnownDAResyncPump(struct sockaddr_storage * addr)
+/* Continue the registration pass to a DA, if one is under way.  Called    */
+/* when the DA's forwarding channel gets an ack.                           */
+/*                                                                         */
+/* addr (IN) the address of the DA                                         */
+/*=========================================================================*/
+{
+   SLPDKnownDAResync * resync = KnownDAResyncFind(addr, 0);
+
+   if (resync && (resync->active || resync->count))
+      KnownDAResyncPump(resync);
+}
+
+
+/*-------------------------------------------------------------------------*/
+void SLPDKnownDARegisterAll(SLPMessage * daadvert, int immortalonly)
+/* registers all services with specified DA                                */
+/*                                                                         */
+/* The registrations are paced through the DA's forwarding channel by      */
+/* KnownDAResyncPump.  If the DA has the bootstamp we last synced it at,   */
+/* and no scopes it lacked then, it still holds what it acked then, so     */
+/* only newer registrations are sent (registrations dropped in the         */
+/* meantime simply expire at the DA).                                      */
+/*-------------------------------------------------------------------------*/
+{
+   SLPDKnownDAResync * resync;
+   SLPDAAdvert * entrydaadvert = &(daadvert->body.daadvert);
+   char * scopelist;
+
+   /*----------------------------------------*/
+   /* Nothing to do if the database is empty */
+   /*----------------------------------------*/
    if (SLPDDatabaseIsEmpty())
       return;
 
    /*--------------------------------------*/
    /* Never do a Register All to ourselves */
    /*--------------------------------------*/
-   if(SLPIntersectStringList(G_ifaceurlsLen, G_ifaceurls, daadvert->body.daadvert.urllen,
-                             daadvert->body.daadvert.url) > 0)
+   if(SLPIntersectStringList(G_ifaceurlsLen, G_ifaceurls, entrydaadvert->urllen,
+                             entrydaadvert->url) > 0)
       return;
 
-   handle = SLPDDatabaseEnumStart();
-   if (handle == 0)
+   resync = KnownDAResyncFind(&(daadvert->peer), 1);
+   if (resync == 0)
       return;
 
-   /*----------------------------------------------*/
-   /* Establish a new connection with the known DA */
-   /*----------------------------------------------*/
-   sock = SLPDOutgoingConnect(0, &(daadvert->peer));
-   if (sock)
-      while (1)
-      {
-         msg = SLPDDatabaseEnum(handle, &msg, &buf);
-         if (msg == NULL)
-            break;
-         srvreg = &(msg->body.srvreg);
-
-         /*-----------------------------------------------*/
-         /* If so instructed, skip mortal registrations   */
-         /*-----------------------------------------------*/
-         if (immortalonly && srvreg->urlentry.lifetime < SLP_LIFETIME_MAXIMUM)
-            continue;
-
-         /*---------------------------------------------------------*/
-         /* Only register local (or static) registrations of scopes */
-         /* supported by peer DA                                    */
-         /*---------------------------------------------------------*/
-         if ((srvreg->source == SLP_REG_SOURCE_LOCAL
-               || srvreg->source == SLP_REG_SOURCE_STATIC)
-               && SLPIntersectStringList(srvreg->scopelistlen,
-                                         srvreg->scopelist,
-                                         daadvert->body.daadvert.scopelistlen,
-                                         daadvert->body.daadvert.scopelist))
-         {
-            sendbuf = SLPBufferDup(buf);
-            if (sendbuf)
-            {
-               /*--------------------------------------------------------------*/
-               /* link newly constructed buffer to socket resendlist, and send */
-               /*--------------------------------------------------------------*/
-               SLPListLinkTail(&(sock->sendlist), (SLPListItem *) sendbuf);
-               SLPDOutgoingDatagramWrite(sock, sendbuf);
-            }
-         }
-      }
+   /* a full pass under way already covers an immortal refresh */
+   if (immortalonly && resync->active && !resync->immortalonly)
+      return;
 
-   SLPDDatabaseEnumEnd(handle);
+   scopelist = xmalloc(entrydaadvert->scopelistlen + 1);
+   if (scopelist == 0)
+      return;
+   memcpy(scopelist, entrydaadvert->scopelist, entrydaadvert->scopelistlen);
+
+   /*-----------------------------------------------------------*/
+   /* Settle what an earlier pass got acked, then forget it; a  */
+   /* DA that rebooted since has lost everything we sent it,    */
+   /* and one that took on new scopes never got what we hold in */
+   /* them, however old                                         */
+   /*-----------------------------------------------------------*/
+   KnownDAResyncAcked(resync);
+   if (resync->bootstamp != entrydaadvert->bootstamp
+         || !SLPSubsetStringList(resync->scopelistlen, resync->scopelist,
+                                 entrydaadvert->scopelistlen,
+                                 entrydaadvert->scopelist))
+   {
+      resync->bootstamp = entrydaadvert->bootstamp;
+      resync->synced = 0;
+   }
+
+   if (resync->scopelist)
+      xfree(resync->scopelist);
+   resync->scopelist = scopelist;
+   resync->scopelistlen = entrydaadvert->scopelistlen;
+
+   resync->immortalonly = immortalonly;
+   resync->scanned = immortalonly ? 0 : resync->synced;
+   resync->target = SLPDDatabaseGeneration();
+   SLPDDatabaseCursorInit(&resync->cursor, resync->scanned);
+   resync->head = 0;
+   resync->count = 0;
+   resync->active = 1;
+
+   KnownDAResyncPump(resync);
 }
 
 
@@ -418,7 +612,6 @@ void SLPDKnownDADeregisterAll(SLPMessage * daadvert)
    SLPBuffer buf;
    SLPMessage * msg;
    SLPSrvReg * srvreg;
-   SLPDSocket * sock;
    SLPBuffer sendbuf = 0;
    void * handle = 0;
 
@@ -432,37 +625,31 @@ void SLPDKnownDADeregisterAll(SLPMessage * daadvert)
    if (handle == 0)
       return;
 
-   /* Establish a new connection with the known DA */
-   sock = SLPDOutgoingConnect(0, &(daadvert->peer));
-   if (sock)
-      while (1)
+   while (1)
+   {
+      msg = SLPDDatabaseEnum(handle, &msg, &buf);
+      if (msg == NULL)
+         break;
+      srvreg = &(msg->body.srvreg);
+
+      /*-----------------------------------------------------------*/
+      /* Only Deregister local (or static) registrations of scopes */
+      /* supported by peer DA                                      */
+      /*-----------------------------------------------------------*/
+      if ( ( srvreg->source == SLP_REG_SOURCE_LOCAL ||
+             srvreg->source == SLP_REG_SOURCE_STATIC ) &&
+          SLPIntersectStringList(srvreg->scopelistlen,
+                                 srvreg->scopelist,
+                                 daadvert->body.daadvert.scopelistlen,
+                                 daadvert->body.daadvert.scopelist) )
       {
-         msg = SLPDDatabaseEnum(handle, &msg, &buf);
-         if (msg == NULL)
-            break;
-         srvreg = &(msg->body.srvreg);
-
-        /*-----------------------------------------------------------*/
-        /* Only Deregister local (or static) registrations of scopes */
-        /* supported by peer DA                                      */
-        /*-----------------------------------------------------------*/
-        if ( ( srvreg->source == SLP_REG_SOURCE_LOCAL ||
-               srvreg->source == SLP_REG_SOURCE_STATIC ) &&
-            SLPIntersectStringList(srvreg->scopelistlen,
-                                   srvreg->scopelist,
-                                   daadvert->body.daadvert.scopelistlen,
-                                   daadvert->body.daadvert.scopelist) )
-         {
-            if (MakeSrvderegFromSrvReg(msg, buf, &sendbuf) == 0)
-            {
-               /*--------------------------------------------------------------*/
-               /* link newly constructed buffer to socket resendlist, and send */
-               /*--------------------------------------------------------------*/
-               SLPListLinkTail(&(sock->sendlist), (SLPListItem *) sendbuf);
-               SLPDOutgoingDatagramWrite(sock, sendbuf);
-            }
-         }
+         /*-----------------------------------------------------*/
+         /* queue the new buffer on the DA's forwarding channel */
+         /*-----------------------------------------------------*/
+         if (MakeSrvderegFromSrvReg(msg, buf, &sendbuf) == 0)
+            SLPDOutgoingForward(&(daadvert->peer), sendbuf, 0);
       }
+   }
 
    SLPDDatabaseEnumEnd(handle);
 }
@@ -734,6 +921,15 @@ int SLPDKnownDADeinit()
 
    SLPDatabaseDeinit(&G_SlpdKnownDAs);
 
+   while (G_KnownDAResyncs.count)
+   {
+      SLPDKnownDAResync * resync = (SLPDKnownDAResync *)
+            SLPListUnlink(&G_KnownDAResyncs, G_KnownDAResyncs.head);
+      if (resync->scopelist)
+         xfree(resync->scopelist);
+      xfree(resync);
+   }
+
    if(G_ifaceurls)
       xfree(G_ifaceurls);
 
@@ -741,6 +937,25 @@ int SLPDKnownDADeinit()
 }
 
 
+/*-------------------------------------------------------------------------*/
+static void KnownDASync(SLPMessage * daadvert)
+/* Ask a peer DA for the registrations we lack, if we are a DA that syncs  */
+/*                                                                         */
+/* daadvert (IN) the DAAdvert message of the peer DA                       */
+/*-------------------------------------------------------------------------*/
+{
+   SLPDAAdvert * entrydaadvert = &(daadvert->body.daadvert);
+
+   if (!G_SlpdProperty.isDA || G_SlpdProperty.DASyncInterval <= 0)
+      return;
+
+   /* Skip ourself */
+   if (SLPIntersectStringList(G_ifaceurlsLen, G_ifaceurls,
+         entrydaadvert->urllen, entrydaadvert->url) == 0)
+      SLPDDASyncRequest(daadvert);
+}
+
+
 /*=========================================================================*/
 int SLPDKnownDAAdd(SLPMessage * msg, SLPBuffer buf)
 /* Adds a DA to the known DA list if it is new, removes it if DA is going  */
@@ -866,14 +1081,26 @@ int SLPDKnownDAAdd(SLPMessage * msg, SLPBuffer buf)
             /* Advertising DA must have went down then came back up */
             SLPDLogDAAdvertisement("Replacement", entry);
             SLPDKnownDARegisterAll(msg, 0);
+            KnownDASync(msg);
+         }
+         else if (daadvert->bootstamp != 0
+               && !SLPSubsetStringList(entrydaadvert->scopelistlen,
+                                       entrydaadvert->scopelist,
+                                       daadvert->scopelistlen,
+                                       daadvert->scopelist))
+         {
+            /* Same DA, but it now serves scopes it did not before */
+            SLPDLogDAAdvertisement("Scope change", entry);
+            SLPDKnownDARegisterAll(msg, 0);
          }
 
          if ( daadvert->bootstamp == 0 )
          {
             /* Dying DA was found in our KnownDA database. Log that it
-             * was removed.
+             * was removed, and stop registering with it.
              */
             SLPDLogDAAdvertisement("Removal", entry);
+            KnownDAResyncStop(&(msg->peer));
          }
 
          /* Remove the entry that is the same as the advertised entry */
@@ -900,6 +1127,9 @@ int SLPDKnownDAAdd(SLPMessage * msg, SLPBuffer buf)
             /* register all the services we know about with this new DA */
             SLPDKnownDARegisterAll(msg, 0);
 
+            /* and fetch whatever it knows that we do not */
+            KnownDASync(msg);
+
             /* log the addition of a new DA */
             SLPDLogDAAdvertisement("Addition", entry);
          }
@@ -944,6 +1174,9 @@ int SLPDKnownDAAdd(SLPMessage * msg, SLPBuffer buf)
    if (dh)
       SLPDatabaseClose(dh);
 
+   if (result == 0)
+      SLPDDACachePublish();
+
    return result;
 }
 
@@ -987,6 +1220,10 @@ void SLPDKnownDARemove(struct sockaddr_storage * addr)
 
       SLPDatabaseClose(dh);
    }
+   SLPDDACachePublish();
+
+   /* Stop registering with it; a later pass picks up from what was acked */
+   KnownDAResyncStop(addr);
 }
 
 
@@ -1411,7 +1648,6 @@ void SLPDKnownDAEcho(SLPMessage * msg, SLPBuffer buf)
    SLPDatabaseHandle dh;
    SLPDatabaseEntry * entry;
    SLPDAAdvert * entrydaadvert;
-   SLPDSocket * sock;
    const char * msgscope;
    size_t msgscopelen;
 
@@ -1467,21 +1703,12 @@ void SLPDKnownDAEcho(SLPMessage * msg, SLPBuffer buf)
             }
             else
             {
-               /*------------------------------------------*/
-               /* Load the socket with the message to send */
-               /*------------------------------------------*/
-               sock = SLPDOutgoingConnect(0, &(entry->msg->peer));
-               if (sock)
-               {
-                  dup = SLPBufferDup(buf);
-                  if (dup)
-                  {
-                     SLPListLinkTail(&(sock->sendlist), (SLPListItem *) dup);
-                     SLPDOutgoingDatagramWrite(sock, buf);
-                  }
-                  else
-                     sock->state = SOCKET_CLOSE;
-               }
+               /*-------------------------------------------------*/
+               /* Queue the message on the DA's forwarding channel */
+               /*-------------------------------------------------*/
+               dup = SLPBufferDup(buf);
+               if (dup)
+                  SLPDOutgoingForward(&(entry->msg->peer), dup, 0);
             }
          }
       }
@@ -1794,6 +2021,35 @@ void SLPDKnownDAImmortalRefresh(int seconds)
    }
 }
 
+/*=========================================================================*/
+void SLPDKnownDASync(int seconds)
+/* Ask every peer DA for the registrations we lack, once per               */
+/* net.slp.DASyncInterval                                                  */
+/*                                                                         */
+/* seconds (IN) time in seconds since last call                            */
+/*=========================================================================*/
+{
+   SLPDatabaseHandle dh;
+   SLPDatabaseEntry * entry;
+
+   if (!G_SlpdProperty.isDA || G_SlpdProperty.DASyncInterval <= 0)
+      return;
+
+   G_KnownDATimeSinceLastSync += seconds;
+   if (G_KnownDATimeSinceLastSync < G_SlpdProperty.DASyncInterval)
+      return;
+
+   dh = SLPDatabaseOpen(&G_SlpdKnownDAs);
+   if (dh)
+   {
+      while ((entry = SLPDatabaseEnum(dh)) != 0)
+         KnownDASync(entry->msg);
+      SLPDatabaseClose(dh);
+   }
+
+   G_KnownDATimeSinceLastSync = 0;
+}
+
 /*=========================================================================*/
 void SLPDKnownDADeRegisterWithAllDas(SLPMessage * msg, SLPBuffer buf)
 /* Deregister the registration described by the specified message          */
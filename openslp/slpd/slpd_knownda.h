@@ -57,6 +57,7 @@ int SLPDKnownDAInit(void);
 int SLPDKnownDADeinit(void);
 int SLPDKnownDAAdd(SLPMessage * msg, SLPBuffer buf);
 void SLPDKnownDARemove(struct sockaddr_storage * addr);
+void SLPDKnownDAResyncPump(struct sockaddr_storage * addr);
 void * SLPDKnownDAEnumStart(void);
 SLPMessage * SLPDKnownDAEnum(void * eh, SLPMessage ** msg, SLPBuffer * buf);
 void SLPDKnownDAEnumEnd(void * eh);
@@ -73,6 +74,7 @@ void SLPDKnownDAActiveDiscovery(int seconds);
 void SLPDKnownDAStaleDACheck(int seconds);
 void SLPDKnownDAPassiveDAAdvert(int seconds, int dadead);
 void SLPDKnownDAImmortalRefresh(int seconds);
+void SLPDKnownDASync(int seconds);
 void SLPDKnownDADeRegisterWithAllDas(SLPMessage * msg, SLPBuffer buf);
 void SLPDKnownDARegisterWithAllDas(SLPMessage * msg, SLPBuffer buf);
 
@@ -510,6 +510,12 @@ void SLPDLogRegistration(const char * prefix, SLPDatabaseEntry * entry)
          case SLP_REG_SOURCE_STATIC:
             SLPDLog("static (slp.reg)\n");
             break;
+
+         case SLP_REG_SOURCE_PEER_DA:
+            SLPDLog("peer DA (%s)\n",
+                  SLPNetSockAddrStorageToString(&entry->msg->peer,
+                        addr_str, sizeof(addr_str)));
+            break;
       }
       SLPDLogBuffer("    service-url = ",
             entry->msg->body.srvreg.urlentry.urllen,
@@ -45,8 +45,11 @@
 #include "slpd_incoming.h"
 #include "slpd_outgoing.h"
 #include "slpd_database.h"
+#include "slpd_dasync.h"
 #include "slpd_cmdline.h"
 #include "slpd_knownda.h"
+#include "slpd_snapshot.h"
+#include "slpd_dacache.h"
 #include "slpd_property.h"
 #include "slpd.h"
 
@@ -241,6 +244,12 @@ void HandleSigTerm(void)
 
    SLPDOutgoingDeinit(0);
 
+   /* write out the registrations to be restored on restart */
+   SLPDSnapshotDeinit();
+
+   /* abandon the DA cache, so local processes stop reading it */
+   SLPDDACacheDeinit();
+
    SLPDLog("****************************************\n");
    SLPDLogTime();
    SLPDLog("SLPD daemon shut down\n");
@@ -251,6 +260,7 @@ void HandleSigTerm(void)
    SLPDSpiDeinit();
 # endif
    SLPDDatabaseDeinit();
+   SLPDDASyncDeinit();
    SLPDPropertyDeinit();
    SLPDLogFileClose();
    xmalloc_deinit();
@@ -314,10 +324,13 @@ void HandleSigAlrm(void)
    SLPDIncomingAge(SLPD_AGE_INTERVAL);
    SLPDOutgoingAge(SLPD_AGE_INTERVAL);
    SLPDKnownDAImmortalRefresh(SLPD_AGE_INTERVAL);
+   SLPDKnownDASync(SLPD_AGE_INTERVAL);
    SLPDKnownDAPassiveDAAdvert(SLPD_AGE_INTERVAL, 0);
    SLPDKnownDAStaleDACheck(SLPD_AGE_INTERVAL);
    SLPDKnownDAActiveDiscovery(SLPD_AGE_INTERVAL);
+   SLPDDACachePublish();
    SLPDDatabaseAge(SLPD_AGE_INTERVAL, G_SlpdProperty.isDA);
+   SLPDSnapshotCheckpoint();
 }
 
 #ifdef DEBUG
@@ -647,8 +660,10 @@ int main(int argc, char * argv[])
          SLPDSpiInit(G_SlpdCommandLine.spifile) ||
 #endif
          SLPDDatabaseInit(G_SlpdCommandLine.regfile)
+         || SLPDSnapshotInit()
          || SLPDIncomingInit()
          || SLPDOutgoingInit()
+         || SLPDDACacheInit()
          || SLPDKnownDAInit())
       SLPDFatal("slpd initialization failed\n");
    SLPDLog("Agent Interfaces = %s\n", G_SlpdProperty.interfaces);
@@ -659,6 +674,9 @@ int main(int argc, char * argv[])
    if (DropPrivileges())
       SLPDFatal("Could not drop privileges\n");
 
+   /* write the snapshot as the user that keeps writing it */
+   SLPDSnapshotStart();
+
    /* Setup signal handlers */
    if (SetUpSignalHandlers())
       SLPDFatal("Error setting up signal handlers.\n");
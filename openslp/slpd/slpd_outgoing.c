@@ -49,9 +49,228 @@
 
 #include "slp_message.h"
 #include "slp_net.h"
+#include "slp_hash.h"
+#include "slp_xid.h"
+#include "slp_xmalloc.h"
 
 SLPList G_OutgoingSocketList = { 0, 0, 0 };
 
+/** Byte offset of the XID in both SLPv1 and SLPv2 message headers.
+ */
+#define OUTGOING_XID_OFFSET 10
+
+/** Stream sockets and forwarding channels, chained by peer address.
+ */
+static SLPDSocket * G_OutgoingPeers[SLPD_OUTGOING_BUCKETS];
+
+/** Unicast datagram sockets awaiting a reply, chained by the slot of
+ * their retry deadline.
+ */
+static SLPDSocket * G_OutgoingRetries[SLPD_RETRY_SLOTS];
+
+/** Seconds counted by SLPDOutgoingRetry; retry deadlines are in this time.
+ */
+static time_t G_OutgoingClock = 0;
+
+/** Find the peer index bucket of an address.
+ *
+ * @param[in] addr - The peer address; like SLPNetCompareAddrs, only the
+ *    family and host address are significant.
+ *
+ * @return The bucket that holds sockets connected to @p addr.
+ *
+ * @internal
+ */
+static SLPDSocket ** OutgoingPeerBucket(struct sockaddr_storage * addr)
+{
+   uint32_t hash;
+
+   if (addr->ss_family == AF_INET)
+      hash = SLPHash(&((struct sockaddr_in *)addr)->sin_addr,
+            sizeof(struct in_addr));
+   else if (addr->ss_family == AF_INET6)
+      hash = SLPHash(&((struct sockaddr_in6 *)addr)->sin6_addr,
+            sizeof(struct in6_addr));
+   else
+      hash = SLPHash(addr, sizeof(struct sockaddr_storage));
+   return &G_OutgoingPeers[hash & (SLPD_OUTGOING_BUCKETS - 1)];
+}
+
+/** Add an outgoing socket to the peer index and the outgoing list.
+ *
+ * @param[in] sock - The socket, whose peer address must be set.
+ *
+ * @internal
+ */
+static void OutgoingLink(SLPDSocket * sock)
+{
+   SLPDSocket ** bucket = OutgoingPeerBucket(&sock->peeraddr);
+
+   if ((sock->peernext = *bucket) != 0)
+      sock->peernext->peerprev = &sock->peernext;
+   sock->peerprev = bucket;
+   *bucket = sock;
+   SLPListLinkTail(&G_OutgoingSocketList, (SLPListItem *) sock);
+}
+
+/** Take a socket off the retry wheel.
+ *
+ * @param[in] sock - The socket; it need not be on the wheel.
+ *
+ * @internal
+ */
+static void OutgoingRetryCancel(SLPDSocket * sock)
+{
+   if (sock->retryprev)
+   {
+      if ((*sock->retryprev = sock->retrynext) != 0)
+         sock->retrynext->retryprev = sock->retryprev;
+      sock->retryprev = 0;
+   }
+}
+
+/** Put a socket on the retry wheel, in the slot of its deadline.
+ *
+ * @param[in] sock - The socket, which must not be on the wheel.
+ *
+ * @internal
+ */
+static void OutgoingRetryLink(SLPDSocket * sock)
+{
+   SLPDSocket ** slot = &G_OutgoingRetries[sock->deadline & (SLPD_RETRY_SLOTS - 1)];
+
+   if ((sock->retrynext = *slot) != 0)
+      sock->retrynext->retryprev = &sock->retrynext;
+   sock->retryprev = slot;
+   *slot = sock;
+}
+
+/** Schedule the next retry of a unicast datagram socket.
+ *
+ * @param[in] sock - The socket; its reconns selects the timeout from
+ *    net.slp.unicastTimeouts, counted from now.
+ *
+ * @remarks A retry is never due before the outgoing clock next ticks,
+ * since SLPDOutgoingRetry only looks for due retries when it does.
+ *
+ * @internal
+ */
+static void OutgoingRetrySchedule(SLPDSocket * sock)
+{
+   time_t timeout = G_SlpdProperty.unicastTimeouts[sock->reconns] / 1000;
+
+   OutgoingRetryCancel(sock);
+   sock->deadline = G_OutgoingClock + (timeout > 0? timeout: 1);
+   OutgoingRetryLink(sock);
+}
+
+/** Find the xid index slot of a forwarding channel for an xid.
+ *
+ * @param[in] sock - The forwarding channel to search.
+ * @param[in] xid - The transaction id to look for.
+ *
+ * @return The slot holding @p xid, or the empty slot that ends its
+ *    probe sequence if @p xid is not in flight.
+ *
+ * @internal
+ */
+static unsigned ChannelSlot(SLPDSocket * sock, uint16_t xid)
+{
+   unsigned slot = xid & (SLPD_FORWARD_SLOTS - 1);
+
+   while (sock->inflight[slot] && AS_UINT16(sock->inflight[slot]->start
+         + OUTGOING_XID_OFFSET) != xid)
+      slot = (slot + 1) & (SLPD_FORWARD_SLOTS - 1);
+   return slot;
+}
+
+/** Remove an acknowledged message from a forwarding channel.
+ *
+ * @param[in] sock - The forwarding channel.
+ * @param[in] xid - The transaction id of the acknowledgement.
+ *
+ * @return The unlinked message buffer, or null if @p xid is not in
+ *    flight on this channel.
+ *
+ * @internal
+ */
+static SLPBuffer ChannelTake(SLPDSocket * sock, uint16_t xid)
+{
+   unsigned hole = ChannelSlot(sock, xid);
+   unsigned next = hole;
+   unsigned home;
+   SLPBuffer buf = sock->inflight[hole];
+
+   if (buf == 0)
+      return 0;
+
+   /* close the hole by shifting back the rest of its probe sequence */
+   sock->inflight[hole] = 0;
+   while (1)
+   {
+      next = (next + 1) & (SLPD_FORWARD_SLOTS - 1);
+      if (sock->inflight[next] == 0)
+         break;
+      home = AS_UINT16(sock->inflight[next]->start + OUTGOING_XID_OFFSET)
+            & (SLPD_FORWARD_SLOTS - 1);
+      if (((next - home) & (SLPD_FORWARD_SLOTS - 1))
+            >= ((next - hole) & (SLPD_FORWARD_SLOTS - 1)))
+      {
+         sock->inflight[hole] = sock->inflight[next];
+         sock->inflight[next] = 0;
+         hole = next;
+      }
+   }
+   return (SLPBuffer) SLPListUnlink(&sock->sendlist, (SLPListItem *) buf);
+}
+
+/** Put a message in flight on a forwarding channel.
+ *
+ * @param[in] sock - The forwarding channel.
+ * @param[in] buf - The message to send; it is stamped with an xid that
+ *    is unique on the channel and linked to the resend list.
+ *
+ * @internal
+ */
+static void ChannelSend(SLPDSocket * sock, SLPBuffer buf)
+{
+   uint16_t xid;
+   unsigned slot;
+
+   if (sock->sendlist.count == 0)
+   {
+      /* an idle channel starts a fresh retransmission schedule */
+      sock->age = 0;
+      sock->reconns = 0;
+   }
+
+   do
+   {
+      xid = SLPXidGenerate();
+      slot = ChannelSlot(sock, xid);
+   } while (sock->inflight[slot]);
+
+   TO_UINT16(buf->start + OUTGOING_XID_OFFSET, xid);
+   sock->inflight[slot] = buf;
+   SLPListLinkTail(&sock->sendlist, (SLPListItem *) buf);
+   SLPDOutgoingDatagramWrite(sock, buf);
+   if (sock->retryprev == 0)
+      OutgoingRetrySchedule(sock);
+}
+
+/** Move backlogged messages into a forwarding channel's window.
+ *
+ * @param[in] sock - The forwarding channel.
+ *
+ * @internal
+ */
+static void ChannelFill(SLPDSocket * sock)
+{
+   while (sock->backlog.count && sock->sendlist.count < SLPD_FORWARD_WINDOW)
+      ChannelSend(sock, (SLPBuffer) SLPListUnlink(&sock->backlog,
+            sock->backlog.head));
+}
+
 /** Read a datagram from an outbound socket.
  *
  * @param[in] socklist - The list of sockets being monitored.
@@ -60,27 +279,58 @@ SLPList G_OutgoingSocketList = { 0, 0, 0 };
 void OutgoingDatagramRead(SLPList * socklist, SLPDSocket * sock)
 {
    int bytesread;
+   struct sockaddr_storage channelpeer;
+   struct sockaddr_storage * peeraddr;
    socklen_t peeraddrlen = sizeof(struct sockaddr_storage);
+   SLPBuffer acked = 0;
 
    (void)socklist;
 
+   /* a forwarding channel stays keyed on the DA address it was opened for */
+   peeraddr = sock->ischannel? &channelpeer: &sock->peeraddr;
+
    bytesread = recvfrom(sock->fd, (char*)sock->recvbuf->start, 
-         G_SlpdProperty.MTU, 0, (struct sockaddr *)&sock->peeraddr, 
+         G_SlpdProperty.MTU, 0, (struct sockaddr *)peeraddr, 
          &peeraddrlen);
    if (bytesread > 0)
    {
       sock->recvbuf->end = sock->recvbuf->start + bytesread;
 
+      if (sock->ischannel && bytesread >= OUTGOING_XID_OFFSET + 2)
+         acked = ChannelTake(sock, AS_UINT16(sock->recvbuf->start
+               + OUTGOING_XID_OFFSET));
+
       if (!sock->sendbuf)
          /* Some of the error handling code expects a sendbuf to be available
           * to be emptied, so make sure there is at least a minimal buffer
           */
          sock->sendbuf = SLPBufferAlloc(1);
-      SLPDProcessMessage(&sock->peeraddr, &sock->localaddr, 
-            sock->recvbuf, &sock->sendbuf, &sock->sendlist);
+      SLPDProcessMessage(peeraddr, &sock->localaddr, sock->recvbuf,
+            &sock->sendbuf, sock->ischannel? 0: &sock->sendlist);
 
       /* Completely ignore the message */
 
+      if (acked)
+      {
+         /* The DA is keeping up; restart the retransmission schedule
+          * for the rest of the window and let the backlog in.
+          */
+         SLPBufferFree(acked);
+         sock->age = 0;
+         sock->reconns = 0;
+         ChannelFill(sock);
+         if (sock->sendlist.count)
+            OutgoingRetrySchedule(sock);
+         else
+            OutgoingRetryCancel(sock);
+         SLPDKnownDAResyncPump(&sock->peeraddr);
+      }
+      else if (!sock->ischannel && sock->sendlist.count == 0)
+      {
+         /* every request was answered; the socket is not needed again */
+         OutgoingRetryCancel(sock);
+         sock->state = SOCKET_CLOSE;
+      }
    }
 }
 
@@ -448,7 +698,7 @@ SLPDSocket * SLPDOutgoingConnect(int is_TCP, struct sockaddr_storage * addr)
    
    if(is_TCP)
    {
-      sock = (SLPDSocket *) G_OutgoingSocketList.head;
+      sock = *OutgoingPeerBucket(addr);
       while (sock)
       {
         if (sock->state == STREAM_CONNECT_IDLE
@@ -457,30 +707,147 @@ SLPDSocket * SLPDOutgoingConnect(int is_TCP, struct sockaddr_storage * addr)
            if (SLPNetCompareAddrs(&(sock->peeraddr), addr) == 0)
               break;
         }
-        sock = (SLPDSocket *) sock->listitem.next;
+        sock = sock->peernext;
       }
 
       if (sock == 0)
       {
          sock = SLPDSocketCreateConnected(addr);
          if (sock)
-            SLPListLinkTail(&(G_OutgoingSocketList), (SLPListItem *) sock);
+            OutgoingLink(sock);
       }
    }
    else
    {
+      /* not indexed by peer: a reply may come from another address */
       sock = SLPDSocketCreateDatagram(addr, DATAGRAM_UNICAST);
       if (sock)
       {
          SLPListLinkTail(&(G_OutgoingSocketList), (SLPListItem *) sock);
          sock->reconns = 0;
          sock->age = 0;
+         OutgoingRetrySchedule(sock);
       }
    }
 
    return sock;
 }
 
+/** Find the forwarding channel for a DA.
+ *
+ * @param[in] addr - The address of the DA.
+ *
+ * @return The channel socket, or null if there is none.
+ *
+ * @internal
+ */
+static SLPDSocket * ChannelFind(struct sockaddr_storage * addr)
+{
+   SLPDSocket * sock = *OutgoingPeerBucket(addr);
+
+   while (sock)
+   {
+      if (sock->ischannel && SLPNetCompareAddrs(&sock->peeraddr, addr) == 0)
+         break;
+      sock = sock->peernext;
+   }
+   return sock;
+}
+
+/** Forward a message to a DA over its long-lived forwarding channel.
+ *
+ * @param[in] addr - The address of the DA.
+ * @param[in] buf - The SrvReg or SrvDeReg message to forward. The channel
+ *    takes ownership of the buffer and rewrites its xid.
+ * @param[out] xid - If not null, receives the xid the message was sent
+ *    with. Only meaningful when SLPDOutgoingForwardRoom said there was
+ *    room, since a backlogged message gets its xid when it is sent.
+ *
+ * @remarks There is one channel (a unicast datagram socket) per DA. At
+ * most SLPD_FORWARD_WINDOW messages are unacknowledged at a time; the
+ * rest wait on the channel's backlog in order and are sent as SrvAcks
+ * come back, so a registration storm costs one socket per DA rather
+ * than one per message. Acks are matched through an xid index.
+ *
+ * @return Zero on success, or a non-zero value if the message could not
+ *    be queued (@p buf is freed in that case).
+ */
+int SLPDOutgoingForward(struct sockaddr_storage * addr, SLPBuffer buf,
+      uint16_t * xid)
+{
+   SLPDSocket * sock;
+
+   if (buf->end - buf->start < OUTGOING_XID_OFFSET + 2)
+   {
+      SLPBufferFree(buf);
+      return -1;
+   }
+
+   sock = ChannelFind(addr);
+   if (sock == 0)
+   {
+      sock = SLPDSocketCreateDatagram(addr, DATAGRAM_UNICAST);
+      if (sock)
+      {
+         sock->inflight = xcalloc(SLPD_FORWARD_SLOTS, sizeof(SLPBuffer));
+         if (sock->inflight == 0)
+         {
+            SLPDSocketFree(sock);
+            sock = 0;
+         }
+      }
+      if (sock == 0)
+      {
+         SLPBufferFree(buf);
+         return -1;
+      }
+      sock->ischannel = 1;
+      OutgoingLink(sock);
+   }
+
+   if (sock->sendlist.count < SLPD_FORWARD_WINDOW)
+      ChannelSend(sock, buf);
+   else
+      SLPListLinkTail(&sock->backlog, (SLPListItem *) buf);
+
+   if (xid)
+      *xid = AS_UINT16(buf->start + OUTGOING_XID_OFFSET);
+
+   return 0;
+}
+
+/** Count the messages a DA's forwarding channel would send at once.
+ *
+ * @param[in] addr - The address of the DA.
+ *
+ * @return The number of free window slots, which is zero while messages
+ *    are waiting on the backlog.
+ */
+int SLPDOutgoingForwardRoom(struct sockaddr_storage * addr)
+{
+   SLPDSocket * sock = ChannelFind(addr);
+
+   if (sock == 0)
+      return SLPD_FORWARD_WINDOW;
+   if (sock->backlog.count)
+      return 0;
+   return SLPD_FORWARD_WINDOW - sock->sendlist.count;
+}
+
+/** Check whether a forwarded message still awaits its SrvAck.
+ *
+ * @param[in] addr - The address of the DA.
+ * @param[in] xid - The xid the message was sent with.
+ *
+ * @return A boolean value; true if the message is unacknowledged.
+ */
+int SLPDOutgoingForwardPending(struct sockaddr_storage * addr, uint16_t xid)
+{
+   SLPDSocket * sock = ChannelFind(addr);
+
+   return sock && sock->inflight[ChannelSlot(sock, xid)] != 0;
+}
+
 /** Check that there is an outgoing socket for the specified address
  *
  * @param[in] addr - The address of the peer to check.
@@ -489,13 +856,13 @@ SLPDSocket * SLPDOutgoingConnect(int is_TCP, struct sockaddr_storage * addr)
  */
 int SLPDHaveOutgoingConnectedSocket(struct sockaddr_storage* addr)
 {
-   SLPDSocket* sock = (SLPDSocket*)G_OutgoingSocketList.head;
+   SLPDSocket* sock = *OutgoingPeerBucket(addr);
    while (sock)
    {
       if (sock->state >= STREAM_CONNECT_IDLE &&
             SLPNetCompareAddrs(&sock->peeraddr, addr) == 0)
          return 1;
-      sock = (SLPDSocket*)sock->listitem.next;
+      sock = sock->peernext;
    }
    return 0;
 }
@@ -595,80 +962,80 @@ void SLPDOutgoingHandler(int * fdcount, SLPD_fdset * fdset)
 
 /** Resend messages on sockets whose timeout has expired
  *
- * @param[in] seconds - The number of seconds old a socket must be to have
- * its messages resent.
+ * @param[in] seconds - The number of seconds since the last call.
  *
  * @remarks - Ideally, this would be at a resolution lower than one second, 
  * but given the default timeout values, this isn't too far off the mark, and
  * should not add too much of a burden to the main loop.
+ *
+ * @remarks Only the retry wheel slots of the seconds that have passed are
+ * looked at, so the cost does not grow with the number of idle sockets.
  */
 void SLPDOutgoingRetry(time_t seconds)
 {
-   SLPDSocket * del = 0;
-   SLPDSocket * sock = (SLPDSocket *) G_OutgoingSocketList.head;
+   SLPDSocket * due;
+   SLPDSocket * sock;
+   time_t tick;
 
    if(seconds <= 0)
       return;
 
-   while (sock)
+   tick = G_OutgoingClock;
+   G_OutgoingClock += seconds;
+   if (seconds > SLPD_RETRY_SLOTS)
+      seconds = SLPD_RETRY_SLOTS;
+
+   while (seconds--)
    {
-      switch (sock->state)
+      /* take the slot's sockets off the wheel, so rescheduled ones are
+         not seen again here, and a socket freed meanwhile unlinks itself */
+      tick++;
+      due = G_OutgoingRetries[tick & (SLPD_RETRY_SLOTS - 1)];
+      G_OutgoingRetries[tick & (SLPD_RETRY_SLOTS - 1)] = 0;
+      if (due)
+         due->retryprev = &due;
+
+      while ((sock = due) != 0)
       {
-       case DATAGRAM_UNICAST:
-          if(0 == sock->sendlist.count)  /*Clean up as fast as we can, as all messages were sent*/
-             del = sock;
-          else
-          {
-             sock->age += seconds;
-             if(sock->age >= G_SlpdProperty.unicastTimeouts[sock->reconns] / 1000)
-             {
-               ++sock->reconns;
-               if(sock->reconns >= MAX_RETRANSMITS)  
-               {
-                  char addr_str[INET6_ADDRSTRLEN];
-                  SLPDLog("SLPD: Didn't receive response from DA at %s, removing it from list.\n",
-                  SLPNetSockAddrStorageToString(&sock->peeraddr, addr_str, sizeof(addr_str)));
-            
-                  SLPDKnownDARemove(&(sock->peeraddr));
-                  del = sock;
-               }
-               else
-               {
-                  SLPBuffer pbuf;
-                  sock->age = 0;
-                  for(pbuf = (SLPBuffer) sock->sendlist.head; pbuf; pbuf = (SLPBuffer) pbuf->listitem.next)
-                     SLPDOutgoingDatagramWrite(sock, pbuf);
-               }
-             }
-          }
-            break;
+         OutgoingRetryCancel(sock);
+         if (sock->deadline > G_OutgoingClock)
+         {
+            /* due on a later turn of the wheel */
+            OutgoingRetryLink(sock);
+            continue;
+         }
 
-         case DATAGRAM_MULTICAST:
-         case DATAGRAM_BROADCAST:
-         case STREAM_READ_FIRST:
-         case STREAM_WRITE_FIRST:
-         case STREAM_CONNECT_BLOCK:
-         case STREAM_READ:
-         case STREAM_WRITE:
-         case STREAM_CONNECT_IDLE:
-         case STREAM_WRITE_WAIT:
-         default:
-            break;
-      }
+         if(0 == sock->sendlist.count)  /*Clean up as fast as we can, as all messages were sent*/
+         {
+            if (!sock->ischannel)  /*Idle forwarding channels are aged out by SLPDOutgoingAge*/
+               SLPDSocketFree((SLPDSocket *)
+                     SLPListUnlink(&G_OutgoingSocketList, (SLPListItem *) sock));
+            continue;
+         }
 
-      sock = (SLPDSocket *) sock->listitem.next;
+         ++sock->reconns;
+         if(sock->reconns >= MAX_RETRANSMITS)  
+         {
+            char addr_str[INET6_ADDRSTRLEN];
+            SLPDLog("SLPD: Didn't receive response from DA at %s, removing it from list.\n",
+            SLPNetSockAddrStorageToString(&sock->peeraddr, addr_str, sizeof(addr_str)));
 
-      if (del)
-      {
-         SLPDSocketFree((SLPDSocket *)
-               SLPListUnlink(&G_OutgoingSocketList, (SLPListItem *) del));
-         del = 0;
+            SLPDKnownDARemove(&(sock->peeraddr));
+            SLPDSocketFree((SLPDSocket *)
+                  SLPListUnlink(&G_OutgoingSocketList, (SLPListItem *) sock));
+         }
+         else
+         {
+            SLPBuffer pbuf;
+            sock->age = 0;
+            for(pbuf = (SLPBuffer) sock->sendlist.head; pbuf; pbuf = (SLPBuffer) pbuf->listitem.next)
+               SLPDOutgoingDatagramWrite(sock, pbuf);
+            OutgoingRetrySchedule(sock);
+         }
       }
    }
 }
 
-
-
 /** Age the outgoing socket list.
  *
  * @param[in] seconds - The number of seconds old an entry must be to be 
@@ -691,7 +1058,22 @@ void SLPDOutgoingAge(time_t seconds)
             break;
 
        case DATAGRAM_UNICAST:
-          /*The Retry logic ages these out*/
+          /*The Retry logic ages these out, except idle forwarding channels*/
+          if (sock->ischannel && sock->sendlist.count == 0)
+          {
+             if (G_OutgoingSocketList.count > SLPD_COMFORT_SOCKETS)
+             {
+                /* Accelerate ageing cause we are low on sockets */
+                if (sock->age > SLPD_CONFIG_BUSY_CLOSE_CONN)
+                   del = sock;
+             }
+             else
+             {
+                if (sock->age > SLPD_CONFIG_CLOSE_CONN)
+                   del = sock;
+             }
+             sock->age = sock->age + seconds;
+          }
           break;
 
          case STREAM_READ_FIRST:
@@ -840,4 +1222,204 @@ void SLPDOutgoingSocketDump(void)
 }
 #endif
 
+#ifdef SLPD_OUTGOING_TEST
+
+/* ------------- Test main for the slpd_outgoing.c module -----------------
+ *
+ * Puts unconnected sockets on the peer index and the retry wheel, and
+ * checks that a retry due past a full turn of the wheel waits for it,
+ * that a cancelled retry is skipped while the rest of its slot is handled,
+ * and that a socket freed while linked leaves both indexes.
+ *
+ * Build and run with:
+ *    make slpd-outgoing-test && ./slpd-outgoing-test
+ */
+
+# define FAIL (printf("FAIL: %s at line %d.\n", __FILE__, __LINE__), (-1))
+# define PASS (printf("PASS: Success!\n"), (0))
+
+/* The retry wheel slot of an outgoing clock time. */
+#define TEST_SLOT(t) (&G_OutgoingRetries[(t) & (SLPD_RETRY_SLOTS - 1)])
+
+/* Make a unicast datagram socket to 10.0.0.n, without a descriptor, so
+ * that nothing is sent.
+ */
+static SLPDSocket * TestSocket(int n)
+{
+   SLPDSocket * sock = SLPDSocketAlloc();
+   int addr = 0x0a000000 + n;
+
+   if (sock)
+   {
+      SLPNetSetAddr(&sock->peeraddr, AF_INET, SLP_RESERVED_PORT, &addr);
+      sock->state = DATAGRAM_UNICAST;
+   }
+   return sock;
+}
+
+/* Count the sockets in a retry wheel slot, or -1 if a back link is wrong. */
+static int TestSlotCount(SLPDSocket ** slot)
+{
+   SLPDSocket ** prev = slot;
+   SLPDSocket * sock;
+   int count = 0;
+
+   for (sock = *slot; sock; sock = sock->retrynext, count++)
+   {
+      if (sock->retryprev != prev)
+         return -1;
+      prev = &sock->retrynext;
+   }
+   return count;
+}
+
+/* Count the sockets in a peer bucket, or -1 if a back link is wrong. */
+static int TestBucketCount(SLPDSocket ** bucket)
+{
+   SLPDSocket ** prev = bucket;
+   SLPDSocket * sock;
+   int count = 0;
+
+   for (sock = *bucket; sock; sock = sock->peernext, count++)
+   {
+      if (sock->peerprev != prev)
+         return -1;
+      prev = &sock->peernext;
+   }
+   return count;
+}
+
+int main(void)
+{
+   SLPDSocket * sock[5];
+   SLPDSocket ** bucket;
+   SLPDSocket ** slot;
+   SLPBuffer buf;
+   time_t due;
+   int i;
+
+   /* An empty configuration file name leaves every property at its
+    * default, so the results do not depend on the host's slp.conf.
+    */
+   if (SLPDPropertyInit("") != 0)
+      return FAIL;
+
+   /* A retry due past one full turn of the wheel is put back in its slot
+    * when the turn passes it, and handled on the next turn. One with
+    * nothing left to send is freed when due.
+    */
+   G_SlpdProperty.unicastTimeouts[0] = (SLPD_RETRY_SLOTS + 3) * 1000;
+   if ((sock[0] = TestSocket(1)) == 0)
+      return FAIL;
+   SLPListLinkTail(&G_OutgoingSocketList, (SLPListItem *) sock[0]);
+   OutgoingRetrySchedule(sock[0]);
+   due = sock[0]->deadline;
+   slot = TEST_SLOT(due);
+   if (due != G_OutgoingClock + SLPD_RETRY_SLOTS + 3
+         || *slot != sock[0] || TestSlotCount(slot) != 1)
+      return FAIL;
+   SLPDOutgoingRetry(SLPD_RETRY_SLOTS);
+   if (G_OutgoingSocketList.count != 1 || *slot != sock[0]
+         || TestSlotCount(slot) != 1)
+      return FAIL;
+   SLPDOutgoingRetry(2);
+   if (G_OutgoingSocketList.count != 1 || TestSlotCount(slot) != 1)
+      return FAIL;
+   SLPDOutgoingRetry(1);
+   if (G_OutgoingClock != due || G_OutgoingSocketList.count != 0
+         || TestSlotCount(slot) != 0)
+      return FAIL;
+
+   /* So is one passed by a jump of more than a turn. */
+   if ((sock[0] = TestSocket(1)) == 0)
+      return FAIL;
+   SLPListLinkTail(&G_OutgoingSocketList, (SLPListItem *) sock[0]);
+   OutgoingRetrySchedule(sock[0]);
+   slot = TEST_SLOT(sock[0]->deadline);
+   SLPDOutgoingRetry(10 * SLPD_RETRY_SLOTS);
+   if (G_OutgoingSocketList.count != 0 || TestSlotCount(slot) != 0)
+      return FAIL;
+
+   /* Of four retries due in the same slot, the one at its head and one in
+    * its middle are cancelled (a second cancel does nothing); the other
+    * two are handled, the one with a message to send by sending it again
+    * and scheduling its next retry.
+    */
+   G_SlpdProperty.unicastTimeouts[0] = 1000;
+   G_SlpdProperty.unicastTimeouts[1] = 2000;
+   for (i = 0; i < 4; i++)
+   {
+      if ((sock[i] = TestSocket(i + 2)) == 0)
+         return FAIL;
+      SLPListLinkTail(&G_OutgoingSocketList, (SLPListItem *) sock[i]);
+      OutgoingRetrySchedule(sock[i]);
+   }
+   if ((buf = SLPBufferAlloc(16)) == 0)
+      return FAIL;
+   SLPListLinkTail(&sock[2]->sendlist, (SLPListItem *) buf);
+   due = G_OutgoingClock + 1;
+   slot = TEST_SLOT(due);
+   if (*slot != sock[3] || TestSlotCount(slot) != 4)
+      return FAIL;
+   OutgoingRetryCancel(sock[3]);
+   OutgoingRetryCancel(sock[1]);
+   OutgoingRetryCancel(sock[1]);
+   if (sock[3]->retryprev != 0 || sock[1]->retryprev != 0
+         || *slot != sock[2] || sock[2]->retrynext != sock[0]
+         || TestSlotCount(slot) != 2)
+      return FAIL;
+   SLPDOutgoingRetry(1);
+   if (G_OutgoingSocketList.count != 3 || TestSlotCount(slot) != 0
+         || sock[1]->retryprev != 0 || sock[3]->retryprev != 0
+         || sock[2]->reconns != 1 || sock[2]->deadline != due + 2
+         || *TEST_SLOT(due + 2) != sock[2]
+         || TestSlotCount(TEST_SLOT(due + 2)) != 1)
+      return FAIL;
+   SLPDOutgoingDeinit(0);
+   if (G_OutgoingSocketList.count != 0
+         || TestSlotCount(TEST_SLOT(due + 2)) != 0)
+      return FAIL;
+
+   /* A socket freed while linked leaves its peer bucket and wheel slot,
+    * and the sockets after it in both are linked back to its place.
+    */
+   for (i = 0; i < 3; i++)
+   {
+      if ((sock[i] = TestSocket(5)) == 0)
+         return FAIL;
+      OutgoingLink(sock[i]);
+      OutgoingRetrySchedule(sock[i]);
+   }
+   bucket = OutgoingPeerBucket(&sock[0]->peeraddr);
+   slot = TEST_SLOT(sock[0]->deadline);
+   if (TestBucketCount(bucket) != 3 || TestSlotCount(slot) != 3)
+      return FAIL;
+   SLPDSocketFree((SLPDSocket *) SLPListUnlink(&G_OutgoingSocketList,
+         (SLPListItem *) sock[1]));
+   if (TestBucketCount(bucket) != 2 || TestSlotCount(slot) != 2
+         || sock[2]->peernext != sock[0] || sock[2]->retrynext != sock[0])
+      return FAIL;
+   SLPDSocketFree((SLPDSocket *) SLPListUnlink(&G_OutgoingSocketList,
+         (SLPListItem *) sock[2]));
+   if (*bucket != sock[0] || TestBucketCount(bucket) != 1
+         || *slot != sock[0] || TestSlotCount(slot) != 1)
+      return FAIL;
+   SLPDSocketFree((SLPDSocket *) SLPListUnlink(&G_OutgoingSocketList,
+         (SLPListItem *) sock[0]));
+   if (G_OutgoingSocketList.count != 0 || *bucket != 0 || *slot != 0)
+      return FAIL;
+
+   /* Nothing is left on either index. */
+   for (i = 0; i < SLPD_RETRY_SLOTS; i++)
+      if (G_OutgoingRetries[i] != 0)
+         return FAIL;
+   for (i = 0; i < SLPD_OUTGOING_BUCKETS; i++)
+      if (G_OutgoingPeers[i] != 0)
+         return FAIL;
+
+   return PASS;
+}
+
+#endif /* SLPD_OUTGOING_TEST */
+
 /*=========================================================================*/
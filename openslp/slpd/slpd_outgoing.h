@@ -61,6 +61,10 @@ int SLPDHaveOutgoingConnectedSocket(struct sockaddr_storage* addr);
 void SLPDOutgoingDatagramWrite(SLPDSocket * sock, SLPBuffer buffer);
 void SLPDOutgoingDatagramMcastWrite(SLPDSocket * sock, struct sockaddr_storage *maddr, SLPBuffer buffer);
 SLPDSocket * SLPDOutgoingConnect(int is_TCP, struct sockaddr_storage * addr);
+int SLPDOutgoingForward(struct sockaddr_storage * addr, SLPBuffer buf,
+      uint16_t * xid);
+int SLPDOutgoingForwardRoom(struct sockaddr_storage * addr);
+int SLPDOutgoingForwardPending(struct sockaddr_storage * addr, uint16_t xid);
 int SLPDOutgoingInit(void);
 int SLPDOutgoingDeinit(int graceful);
 
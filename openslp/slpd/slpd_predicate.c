@@ -381,7 +381,7 @@ static FilterResult wildcard_wc_str(char * pattern, size_t pattern_len,
       }
 
       /**** Find end of text. ****/
-      found = memchr(text_start, WILDCARD, pattern_len - text_len);
+      found = memchr(text_start, WILDCARD, (pattern + pattern_len) - text_start);
       if (found == NULL)
       {
          size_t unescaped_pattern_len;
@@ -2116,6 +2116,1100 @@ int SLPDPredicateTestTree(SLPDPredicateTreeNode *parseTree,
    return (err == FR_EVAL_TRUE);
 }
 
+/** Opcodes of a compiled predicate program.
+ *
+ * A program evaluates into a single result register. Leaf tests load it,
+ * and the jumps implement the short circuits of and/or chains, so no
+ * operand stack is needed.
+ */
+typedef enum
+{
+   PROG_TEST,        /*!< Evaluate leaf @c arg into the result. */
+   PROG_JUMP_FALSE,  /*!< Jump to @c arg if the result is false. */
+   PROG_JUMP_TRUE,   /*!< Jump to @c arg if the result is true. */
+   PROG_NOT,         /*!< Invert the result. */
+   PROG_END          /*!< Return the result. */
+} PredicateOpcode;
+
+/** Ends the chain of jumps still to be patched while compiling. */
+#define PROG_NO_JUMP ((unsigned)-1)
+
+/** A single predicate program instruction. */
+typedef struct
+{
+   PredicateOpcode opcode;
+   unsigned arg;
+} PredicateInstr;
+
+/** How a string equality leaf matches attribute values. */
+typedef enum
+{
+   MATCH_EXACT,      /*!< No wildcards: one segment, matched whole. */
+   MATCH_GLOB,       /*!< Segments separated by wildcards. */
+   MATCH_ESCAPED     /*!< Malformed escapes: defer to wildcard(). */
+} PredicateMatchKind;
+
+/** An unescaped, case-folded run of literal pattern text.
+ *
+ * Segments between two wildcards are searched for rather than compared in
+ * place, and carry what the search needs: the byte to scan for first, and
+ * the failure function that bounds the search on repetitive text.
+ */
+typedef struct
+{
+   const char * str;
+   size_t len;
+   size_t anchor;                /* offset of the byte scanned for */
+   int caseless;                 /* str[anchor] has one case; memchr it */
+   unsigned * fail;              /* middle segments only; else NULL */
+} PredicateSegment;
+
+/** A comparison leaf, with its value pre-converted for each type. */
+typedef struct
+{
+   Operation op;
+   const char * tag;
+   size_t tag_len;
+   const char * rhs;             /* As written, for ordering and fallback. */
+   size_t rhs_len;
+   int int_ok;                   /* rhs is an integer */
+   int int_val;
+   int bool_ok;                  /* op is EQUAL and rhs is a boolean */
+   SLPBoolean bool_val;
+   PredicateMatchKind match;
+   PredicateSegment * segs;      /* prefix, middles, tail (may be empty) */
+   unsigned nsegs;
+} PredicateLeaf;
+
+/** A compiled predicate, held in a single allocation. */
+struct _SLPDPredicateProgram
+{
+   PredicateInstr * code;
+   PredicateLeaf * leaves;
+   unsigned ninstrs;
+   unsigned long * arrivals;     /* batch scratch: two masks per instr */
+   SLPDTagFilter required;       /* tags any match must have */
+};
+
+/** Sizes gathered by the first compilation pass. */
+typedef struct
+{
+   unsigned ninstrs;
+   unsigned nleaves;
+   unsigned nsegs;
+   size_t nfail;
+   size_t nchars;
+} PredicateSizes;
+
+/** Allocation cursor for the second compilation pass. */
+typedef struct
+{
+   SLPDPredicateProgram * prog;
+   unsigned ninstrs;
+   unsigned nleaves;
+   PredicateSegment * segs;
+   unsigned * fail;
+   char * chars;
+} PredicateEmitter;
+
+/** ASCII letters folded to lower case, as unescape_cmp compares them. */
+static const unsigned char G_PredicateFold[256] =
+{
+   0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+   0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+   0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+   0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+   0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+   0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f,
+   0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+   0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f,
+   0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+   0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+   0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+   0x78, 0x79, 0x7a, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f,
+   0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+   0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+   0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+   0x78, 0x79, 0x7a, 0x7b, 0x7c, 0x7d, 0x7e, 0x7f,
+   0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+   0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+   0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+   0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f,
+   0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+   0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf,
+   0xb0, 0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7,
+   0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf,
+   0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+   0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf,
+   0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7,
+   0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf,
+   0xe0, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7,
+   0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef,
+   0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+   0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff,
+};
+
+#define PRED_FOLD(c) G_PredicateFold[(unsigned char)(c)]
+
+/** Add a tag to a tag filter.
+ *
+ * Tags compare case-insensitively, so the tag is hashed (FNV-1a) folded;
+ * two bits of the filter are taken from the hash.
+ *
+ * @internal
+ */
+static void predicateTagAdd(SLPDTagFilter * filter, const char * tag,
+      size_t tag_len)
+{
+   unsigned filter_bits = SLPD_TAG_FILTER_WORDS * 32;
+   uint32_t hash = 2166136261U;
+   unsigned bit;
+   size_t i;
+
+   for (i = 0; i < tag_len; i++)
+      hash = (hash ^ PRED_FOLD(tag[i])) * 16777619U;
+   bit = hash % filter_bits;
+   filter->bits[bit / 32] |= (uint32_t)1 << bit % 32;
+   bit = (hash >> 16) % filter_bits;
+   filter->bits[bit / 32] |= (uint32_t)1 << bit % 32;
+}
+
+/** Build the tag filter of an attribute list.
+ *
+ * The list is not parsed: tags are picked out as SLPAttrFreshen would
+ * find them, without trimming, as attribute lookups do not trim either.
+ * A list that is not well formed fills the filter, so that it rejects
+ * nothing.
+ *
+ * @param[out] filter - The filter to initialise.
+ * @param[in] attrlistlen - The length of @p attrlist in bytes.
+ * @param[in] attrlist - The attribute list of a registration.
+ */
+void SLPDTagFilterInit(SLPDTagFilter * filter, size_t attrlistlen,
+      const char * attrlist)
+{
+   const char * p = attrlist;
+   const char * end = attrlist + attrlistlen;
+   const char * itemend;
+   const char * tagend;
+
+   memset(filter, 0, sizeof(*filter));
+   while (p < end)
+   {
+      if (*p == '(')
+      {
+         /* Parentheses are reserved, so the item ends at the next one */
+         if ((itemend = memchr(p, ')', end - p)) == 0
+               || (tagend = memchr(p, '=', itemend - p)) == 0)
+            break;
+         predicateTagAdd(filter, p + 1, tagend - p - 1);
+         p = itemend + 1;
+      }
+      else
+      {
+         if ((itemend = memchr(p, ',', end - p)) == 0)
+            itemend = end;
+         predicateTagAdd(filter, p, itemend - p);
+         p = itemend;
+      }
+      if (p == end)
+         return;
+      if (*p++ != ',')
+         break;
+   }
+   if (p < end)
+      memset(filter, 0xff, sizeof(*filter));
+}
+
+/** Collect the tags a parse tree requires into a tag filter.
+ *
+ * Every comparison is false for a missing tag, so a leaf requires its
+ * tag. An and requires what any operand does; an or, the bits all its
+ * operands require (an entry satisfying one operand has all of that
+ * operand's bits); a not requires nothing.
+ *
+ * @internal
+ */
+static void predicateRequire(const SLPDPredicateTreeNode * node,
+      SLPDTagFilter * required)
+{
+   const SLPDPredicateTreeNode * child;
+   SLPDTagFilter sub;
+   unsigned i;
+
+   memset(required, 0, sizeof(*required));
+   switch (node->nodeType)
+   {
+      case NODE_AND:
+         for (child = node->nodeBody.logical.first; child;
+               child = child->next)
+         {
+            predicateRequire(child, &sub);
+            for (i = 0; i < SLPD_TAG_FILTER_WORDS; i++)
+               required->bits[i] |= sub.bits[i];
+         }
+         break;
+
+      case NODE_OR:
+         memset(required, 0xff, sizeof(*required));
+         for (child = node->nodeBody.logical.first; child;
+               child = child->next)
+         {
+            predicateRequire(child, &sub);
+            for (i = 0; i < SLPD_TAG_FILTER_WORDS; i++)
+               required->bits[i] &= sub.bits[i];
+         }
+         break;
+
+      case NODE_NOT:
+         break;
+
+      default:
+         predicateTagAdd(required, node->nodeBody.comparison.tag_str,
+               node->nodeBody.comparison.tag_len);
+         break;
+   }
+}
+
+/** Count the instructions, leaves and storage a parse tree compiles to.
+ *
+ * @param[in] node - The tree (or sub-tree) to measure.
+ * @param[in,out] sizes - The running totals.
+ *
+ * @internal
+ */
+static void predicateMeasure(const SLPDPredicateTreeNode * node,
+      PredicateSizes * sizes)
+{
+   const SLPDPredicateTreeNode * child;
+
+   switch (node->nodeType)
+   {
+      case NODE_AND:
+      case NODE_OR:
+         for (child = node->nodeBody.logical.first; child;
+               child = child->next)
+         {
+            predicateMeasure(child, sizes);
+            if (child->next)
+               sizes->ninstrs++;
+         }
+         break;
+
+      case NODE_NOT:
+         predicateMeasure(node->nodeBody.logical.first, sizes);
+         sizes->ninstrs++;
+         break;
+
+      default:
+      {
+         const char * rhs = node->nodeBody.comparison.value_str;
+         size_t rhs_len = node->nodeBody.comparison.value_len;
+         size_t i;
+
+         /* Two segments more than there are wildcards, at most */
+         sizes->nsegs += 2;
+         for (i = 0; i < rhs_len; i++)
+            if (rhs[i] == WILDCARD)
+               sizes->nsegs++;
+         sizes->nfail += rhs_len;
+         sizes->nchars += node->nodeBody.comparison.tag_len + 1
+               + 2 * rhs_len + 1;
+         sizes->nleaves++;
+         sizes->ninstrs++;
+         break;
+      }
+   }
+}
+
+/** Unescape one run of pattern text between wildcards.
+ *
+ * @param[in] raw - The escaped text.
+ * @param[in] raw_len - The length of @p raw in bytes.
+ * @param[out] out - Storage for the unescaped, case-folded text.
+ * @param[out] out_len - The length of @p out in bytes.
+ *
+ * @return A boolean value; false if an escape is malformed or truncated,
+ *    in which case wildcard() must decide what that means.
+ *
+ * @internal
+ */
+static int predicateUnescape(const char * raw, size_t raw_len, char * out,
+      size_t * out_len)
+{
+   size_t i;
+   size_t n = 0;
+
+   for (i = 0; i < raw_len; i++)
+   {
+      char c = raw[i];
+
+      if (c == '\\')
+      {
+         if (i + 2 >= raw_len)
+            return 0;
+         if (!unescape_check(raw[i + 1], raw[i + 2], &c))
+            return 0;
+         i += 2;
+      }
+      out[n++] = PRED_FOLD(c);
+   }
+   *out_len = n;
+   return 1;
+}
+
+/** Pre-compute the search data of a segment that lies between wildcards.
+ *
+ * The search scans for one byte of the segment before comparing the rest.
+ * A byte without a case (a digit, punctuation) can be found with memchr,
+ * and the one least repeated in the segment is likely the rarest in the
+ * text; a segment of letters only is filtered on its first and last bytes
+ * instead. The failure function is the Knuth-Morris-Pratt one, over the
+ * folded text.
+ *
+ * @param[in,out] seg - The segment, with @c str and @c len set.
+ * @param[in,out] e - The compilation cursor to take storage from.
+ *
+ * @internal
+ */
+static void predicateIndex(PredicateSegment * seg, PredicateEmitter * e)
+{
+   size_t counts[256];
+   size_t i;
+   size_t k = 0;
+
+   /* Scan for the caseless byte that repeats least within the segment
+    * (the text is folded, so a letter is a lower case one).
+    */
+   memset(counts, 0, sizeof(counts));
+   for (i = 0; i < seg->len; i++)
+      counts[(unsigned char)seg->str[i]]++;
+   seg->caseless = 0;
+   seg->anchor = 0;
+   for (i = 0; i < seg->len; i++)
+   {
+      unsigned char c = (unsigned char)seg->str[i];
+
+      if ((c < 'a' || c > 'z') && (!seg->caseless
+            || counts[c] <= counts[(unsigned char)seg->str[seg->anchor]]))
+      {
+         seg->caseless = 1;
+         seg->anchor = i;
+      }
+   }
+
+   seg->fail = e->fail;
+   e->fail += seg->len;
+   if (seg->len)
+      seg->fail[0] = 0;
+   for (i = 1; i < seg->len; i++)
+   {
+      while (k > 0 && seg->str[i] != seg->str[k])
+         k = seg->fail[k - 1];
+      if (seg->str[i] == seg->str[k])
+         k++;
+      seg->fail[i] = (unsigned)k;
+   }
+}
+
+/** Pre-compute the match plan of a string equality leaf.
+ *
+ * @param[in,out] leaf - The leaf, with @c rhs set.
+ * @param[in,out] e - The compilation cursor to take storage from.
+ *
+ * @internal
+ */
+static void predicatePlan(PredicateLeaf * leaf, PredicateEmitter * e)
+{
+   const char * rhs = leaf->rhs;
+   const char * end = rhs + leaf->rhs_len;
+   const char * seg = rhs;
+   PredicateSegment * segs = e->segs;
+   unsigned nsegs = 0;
+
+   leaf->match = memchr(rhs, WILDCARD, leaf->rhs_len)? MATCH_GLOB:
+         MATCH_EXACT;
+   while (1)
+   {
+      const char * wc = memchr(seg, WILDCARD, end - seg);
+      const char * segend = wc? wc: end;
+
+      if (!predicateUnescape(seg, segend - seg, e->chars,
+            &segs[nsegs].len))
+      {
+         leaf->match = MATCH_ESCAPED;
+         return;
+      }
+      segs[nsegs].str = e->chars;
+      segs[nsegs].anchor = 0;
+      segs[nsegs].caseless = 0;
+      segs[nsegs].fail = NULL;
+      e->chars += segs[nsegs].len;
+      nsegs++;
+      if (!wc)
+         break;
+
+      /* A run of wildcards is one wildcard */
+      for (seg = wc; seg < end && *seg == WILDCARD; seg++)
+         ;
+   }
+   leaf->segs = segs;
+   leaf->nsegs = nsegs;
+   e->segs += nsegs;
+
+   /* The prefix and the tail are anchored; only the middles are searched */
+   while (--nsegs > 1)
+      predicateIndex(&segs[nsegs - 1], e);
+}
+
+/** Emit the instructions for a parse tree.
+ *
+ * @param[in] node - The tree (or sub-tree) to compile.
+ * @param[in,out] e - The compilation cursor.
+ *
+ * @internal
+ */
+static void predicateEmit(const SLPDPredicateTreeNode * node,
+      PredicateEmitter * e)
+{
+   PredicateInstr * code = e->prog->code;
+   const SLPDPredicateTreeNode * child;
+
+   switch (node->nodeType)
+   {
+      case NODE_AND:
+      case NODE_OR:
+      {
+         /* Each operand but the last jumps to the end of the chain when
+          * it decides the outcome; the jumps are chained through their
+          * arguments until the end is known.
+          */
+         PredicateOpcode jump = node->nodeType == NODE_AND?
+               PROG_JUMP_FALSE: PROG_JUMP_TRUE;
+         unsigned pending = PROG_NO_JUMP;
+
+         for (child = node->nodeBody.logical.first; child;
+               child = child->next)
+         {
+            predicateEmit(child, e);
+            if (child->next)
+            {
+               code[e->ninstrs].opcode = jump;
+               code[e->ninstrs].arg = pending;
+               pending = e->ninstrs++;
+            }
+         }
+         while (pending != PROG_NO_JUMP)
+         {
+            unsigned next = code[pending].arg;
+            code[pending].arg = e->ninstrs;
+            pending = next;
+         }
+         break;
+      }
+
+      case NODE_NOT:
+         predicateEmit(node->nodeBody.logical.first, e);
+         code[e->ninstrs++].opcode = PROG_NOT;
+         break;
+
+      default:
+      {
+         PredicateLeaf * leaf = &e->prog->leaves[e->nleaves];
+         const char * rhs = node->nodeBody.comparison.value_str;
+         size_t rhs_len = node->nodeBody.comparison.value_len;
+         char * intend;
+
+         memset(leaf, 0, sizeof(*leaf));
+         leaf->op = node->nodeType;
+         leaf->tag = memcpy(e->chars, node->nodeBody.comparison.tag_str,
+               node->nodeBody.comparison.tag_len + 1);
+         leaf->tag_len = node->nodeBody.comparison.tag_len;
+         e->chars += leaf->tag_len + 1;
+         leaf->rhs = memcpy(e->chars, rhs, rhs_len + 1);
+         leaf->rhs_len = rhs_len;
+         e->chars += rhs_len + 1;
+
+         /* Convert the value once for each type it could be tested as */
+         leaf->int_val = strtol(rhs, &intend, 10);
+         leaf->int_ok = *intend == 0 || *intend == BRACKET_CLOSE;
+         leaf->bool_ok = leaf->op == EQUAL
+               && is_bool_string(rhs, rhs_len, &leaf->bool_val);
+         if (leaf->op == EQUAL)
+            predicatePlan(leaf, e);
+
+         code[e->ninstrs].opcode = PROG_TEST;
+         code[e->ninstrs++].arg = e->nleaves++;
+         break;
+      }
+   }
+}
+
+/** Compile a predicate parse tree into a flat program.
+ *
+ * The program gives the same results as SLPDPredicateTestTree on the tree,
+ * but evaluates in a loop over a linear instruction array. Each leaf's value
+ * is converted once for every type it may meet, and wildcard patterns are
+ * unescaped and split up front.
+ *
+ * @param[in] parseTree - The parsed predicate tree. It is not referenced
+ *    by the program and may be freed independently.
+ * @param[out] ppProgram - The address of storage for the program, to be
+ *    freed with SLPDPredicateFreeProgram.
+ *
+ * @return PREDICATE_PARSE_OK on success, or PREDICATE_PARSE_INTERNAL_ERROR
+ *    if out of memory.
+ */
+SLPDPredicateParseResult SLPDPredicateCompile(
+      const SLPDPredicateTreeNode * parseTree,
+      SLPDPredicateProgram ** ppProgram)
+{
+   PredicateSizes sizes;
+   PredicateEmitter e;
+   SLPDPredicateProgram * prog;
+   unsigned i;
+
+   memset(&sizes, 0, sizeof(sizes));
+   sizes.ninstrs = 1;   /* PROG_END */
+   predicateMeasure(parseTree, &sizes);
+
+   /* Leaves and segments hold pointers; keep them ahead of the rest */
+   prog = xmalloc(sizeof(*prog) + sizes.nleaves * sizeof(PredicateLeaf)
+         + sizes.nsegs * sizeof(PredicateSegment)
+         + 2 * sizes.ninstrs * sizeof(unsigned long)
+         + sizes.ninstrs * sizeof(PredicateInstr)
+         + sizes.nfail * sizeof(unsigned) + sizes.nchars);
+   *ppProgram = prog;
+   if (!prog)
+      return PREDICATE_PARSE_INTERNAL_ERROR;
+
+   prog->leaves = (PredicateLeaf *)(prog + 1);
+   e.segs = (PredicateSegment *)(prog->leaves + sizes.nleaves);
+   prog->arrivals = (unsigned long *)(e.segs + sizes.nsegs);
+   prog->code = (PredicateInstr *)(prog->arrivals + 2 * sizes.ninstrs);
+   prog->ninstrs = sizes.ninstrs;
+   e.fail = (unsigned *)(prog->code + sizes.ninstrs);
+   e.chars = (char *)(e.fail + sizes.nfail);
+   e.prog = prog;
+   e.ninstrs = 0;
+   e.nleaves = 0;
+
+   predicateEmit(parseTree, &e);
+   predicateRequire(parseTree, &prog->required);
+   prog->code[e.ninstrs].opcode = PROG_END;
+   prog->code[e.ninstrs].arg = 0;
+   SLP_ASSERT(e.ninstrs + 1 == sizes.ninstrs);
+
+   /* Thread jumps that land on a jump taken for the same reason */
+   for (i = 0; i < e.ninstrs; i++)
+   {
+      PredicateInstr * instr = &prog->code[i];
+
+      if (instr->opcode == PROG_JUMP_FALSE || instr->opcode == PROG_JUMP_TRUE)
+         while (prog->code[instr->arg].opcode == instr->opcode)
+            instr->arg = prog->code[instr->arg].arg;
+   }
+   return PREDICATE_PARSE_OK;
+}
+
+/** Free a program created by SLPDPredicateCompile.
+ *
+ * @param[in] program - The program to free; may be NULL.
+ */
+void SLPDPredicateFreeProgram(SLPDPredicateProgram * program)
+{
+   xfree(program);
+}
+
+/** Compare case-insensitively against a folded pattern segment.
+ *
+ * @internal
+ */
+static int predicateSegmentEq(const PredicateSegment * seg, const char * str)
+{
+   size_t i;
+
+   for (i = 0; i < seg->len; i++)
+      if (PRED_FOLD(str[i]) != (unsigned char)seg->str[i])
+         return 0;
+   return 1;
+}
+
+/** Find the leftmost occurrence of a middle segment.
+ *
+ * Candidates are found by scanning for the segment's anchor byte with
+ * memchr, or by its first and last bytes when it is all letters, and then
+ * compared in full. On repetitive text the comparisons can add up to far
+ * more than the text itself; once they outweigh it the rest of the search
+ * runs Knuth-Morris-Pratt, which reads each byte once.
+ *
+ * @param[in] seg - A segment prepared by predicateIndex.
+ * @param[in] str - The text to search (unescaped).
+ * @param[in] len - The length of @p str in bytes.
+ *
+ * @return The first match in @p str, or NULL.
+ *
+ * @internal
+ */
+static const char * predicateFind(const PredicateSegment * seg,
+      const char * str, size_t len)
+{
+   const unsigned char * text = (const unsigned char *)str;
+   const unsigned char * pat = (const unsigned char *)seg->str;
+   size_t m = seg->len;
+   size_t budget = len;
+   size_t i = 0;
+   size_t k;
+
+   if (m == 0)
+      return str;
+   if (m > len)
+      return NULL;
+
+   while (i <= len - m)
+   {
+      if (seg->caseless)
+      {
+         const unsigned char * hit = memchr(text + i + seg->anchor,
+               pat[seg->anchor], len - m + 1 - i);
+         if (hit == NULL)
+            return NULL;
+         i = hit - text - seg->anchor;
+      }
+      else
+      {
+         while (PRED_FOLD(text[i]) != pat[0]
+               || PRED_FOLD(text[i + m - 1]) != pat[m - 1])
+            if (++i > len - m)
+               return NULL;
+      }
+
+      for (k = 0; k < m && PRED_FOLD(text[i + k]) == pat[k]; k++)
+         ;
+      if (k == m)
+         return str + i;
+      if (k >= budget)
+         break;
+      budget -= k;
+      i++;
+   }
+   if (i > len - m)
+      return NULL;
+
+   /* Too much re-reading: finish in linear time */
+   for (k = 0; i < len; i++)
+   {
+      unsigned char c = PRED_FOLD(text[i]);
+
+      while (k > 0 && pat[k] != c)
+         k = seg->fail[k - 1];
+      if (pat[k] == c && ++k == m)
+         return str + i + 1 - m;
+   }
+   return NULL;
+}
+
+/** Match a string against a leaf's pre-computed pattern.
+ *
+ * @param[in] leaf - A string equality leaf.
+ * @param[in] str - The attribute value (unescaped).
+ * @param[in] len - The length of @p str in bytes.
+ *
+ * @return FR_EVAL_TRUE or FR_EVAL_FALSE, or the error wildcard() reports
+ *    for a pattern with malformed escapes.
+ *
+ * @internal
+ */
+static FilterResult predicateMatch(const PredicateLeaf * leaf,
+      const char * str, size_t len)
+{
+   const PredicateSegment * seg = leaf->segs;
+   const PredicateSegment * tail;
+
+   if (leaf->match == MATCH_ESCAPED)
+      return wildcard(leaf->rhs, leaf->rhs_len, str, len);
+
+   if (leaf->match == MATCH_EXACT)
+      return len == seg->len && predicateSegmentEq(seg, str)?
+            FR_EVAL_TRUE: FR_EVAL_FALSE;
+
+   /* The prefix is anchored at the start */
+   if (len < seg->len || !predicateSegmentEq(seg, str))
+      return FR_EVAL_FALSE;
+   str += seg->len;
+   len -= seg->len;
+
+   /* Each middle segment matches at its leftmost position */
+   tail = &leaf->segs[leaf->nsegs - 1];
+   for (seg++; seg < tail; seg++)
+   {
+      const char * found = predicateFind(seg, str, len);
+
+      if (found == NULL)
+         return FR_EVAL_FALSE;
+      len -= found + seg->len - str;
+      str = found + seg->len;
+   }
+
+   /* The tail is anchored at the end; an empty one is a trailing wildcard */
+   if (len < tail->len || !predicateSegmentEq(tail, str + len - tail->len))
+      return FR_EVAL_FALSE;
+   return FR_EVAL_TRUE;
+}
+
+/** Evaluate a compiled comparison leaf against the attribute it names.
+ *
+ * @param[in] leaf - The leaf to evaluate; not a PRESENT test.
+ * @param[in] var - The attribute the leaf's tag found.
+ *
+ * @return A filter result; as treeFilter gives for the same leaf.
+ *
+ * @internal
+ */
+static FilterResult predicateTestVar(const PredicateLeaf * leaf,
+      const var_t * var)
+{
+   value_t * value;
+
+   switch (var->type)
+   {
+      case SLP_BOOLEAN:
+         if (!leaf->bool_ok)
+            return FR_EVAL_FALSE;
+         return var->list->data.va_bool == leaf->bool_val?
+               FR_EVAL_TRUE: FR_EVAL_FALSE;
+
+      case SLP_INTEGER:
+         if (!leaf->int_ok)
+            return FR_EVAL_FALSE;
+         for (value = var->list; value; value = value->next)
+            if ((leaf->op == EQUAL && value->data.va_int == leaf->int_val)
+                  || (leaf->op == GREATER
+                        && value->data.va_int >= leaf->int_val)
+                  || (leaf->op == LESS
+                        && value->data.va_int <= leaf->int_val))
+               return FR_EVAL_TRUE;
+         return FR_EVAL_FALSE;
+
+      case SLP_KEYWORD:
+         return FR_EVAL_FALSE;
+
+      case SLP_STRING:
+         for (value = var->list; value; value = value->next)
+         {
+            if (leaf->op == EQUAL)
+            {
+               FilterResult result = predicateMatch(leaf, value->data.va_str,
+                     value->unescaped_len);
+               if (result != FR_EVAL_FALSE)
+                  return result;
+            }
+            else
+            {
+               int result = memcmp(value->data.va_str, leaf->rhs,
+                     MIN(leaf->rhs_len, value->unescaped_len));
+               if ((result <= 0 && leaf->op == LESS)
+                     || (result >= 0 && leaf->op == GREATER))
+                  return FR_EVAL_TRUE;
+            }
+         }
+         return FR_EVAL_FALSE;
+
+      default:
+         /* Opaque is not yet supported. */
+         return FR_INTERNAL_SYSTEM_ERROR;
+   }
+}
+
+/** Evaluate a compiled leaf against the attributes.
+ *
+ * @param[in] leaf - The leaf to evaluate.
+ * @param[in] slp_attr - The attributes handle to compare on.
+ *
+ * @return A filter result; as treeFilter gives for the same leaf.
+ *
+ * @internal
+ */
+static FilterResult predicateTest(const PredicateLeaf * leaf,
+      SLPAttributes slp_attr)
+{
+   var_t * var;
+
+   /* One lookup serves both the existence and the type check */
+   var = attr_val_find_str((struct xx_SLPAttributes *) slp_attr, leaf->tag,
+         leaf->tag_len);
+   if (var == NULL)
+      return FR_EVAL_FALSE;
+   if (leaf->op == PRESENT)
+      return FR_EVAL_TRUE;
+   return predicateTestVar(leaf, var);
+}
+
+/** Determine whether a set of attributes satisfies a compiled predicate.
+ *
+ * @param[in] program - The program from SLPDPredicateCompile; NULL is
+ *    always satisfied.
+ * @param[in] slp_attr - The set of attributes.
+ *
+ * @return A Boolean value; true if test succeeds. Zero if test fails
+ *    or some other error is detected.
+ */
+int SLPDPredicateTestProgram(const SLPDPredicateProgram * program,
+      SLPAttributes slp_attr)
+{
+   const PredicateInstr * ip;
+   FilterResult result = FR_EVAL_TRUE;
+
+   if (!program)
+      return 1;
+
+   for (ip = program->code; ; )
+   {
+      switch (ip->opcode)
+      {
+         case PROG_TEST:
+            result = predicateTest(&program->leaves[ip->arg], slp_attr);
+            if (result != FR_EVAL_TRUE && result != FR_EVAL_FALSE)
+               return 0;
+            ip++;
+            break;
+
+         case PROG_JUMP_FALSE:
+            ip = result == FR_EVAL_FALSE? program->code + ip->arg: ip + 1;
+            break;
+
+         case PROG_JUMP_TRUE:
+            ip = result == FR_EVAL_TRUE? program->code + ip->arg: ip + 1;
+            break;
+
+         case PROG_NOT:
+            result = result == FR_EVAL_TRUE? FR_EVAL_FALSE: FR_EVAL_TRUE;
+            ip++;
+            break;
+
+         default:
+            return result == FR_EVAL_TRUE;
+      }
+   }
+}
+
+/** Determine from its tag filter whether a registration may satisfy a
+ * compiled predicate, without parsing its attributes.
+ *
+ * @param[in] program - The program from SLPDPredicateCompile, or NULL.
+ * @param[in] filter - The tag filter of the registration's attributes.
+ *
+ * @return Zero if the registration lacks a tag the predicate requires;
+ *    non-zero if it may satisfy the predicate.
+ */
+int SLPDPredicateMayMatch(const SLPDPredicateProgram * program,
+      const SLPDTagFilter * filter)
+{
+   unsigned i;
+
+   if (program)
+      for (i = 0; i < SLPD_TAG_FILTER_WORDS; i++)
+         if ((filter->bits[i] & program->required.bits[i])
+               != program->required.bits[i])
+            return 0;
+   return 1;
+}
+
+/** The bit of a batch lane. */
+#define PRED_LANE(i) (1UL << (i))
+
+/** Every lane of a full batch. */
+#define PRED_ALL_LANES (PRED_LANE(SLPD_PREDICATE_BATCH - 1) * 2 - 1)
+
+/** Evaluate a compiled leaf for the selected lanes of a batch.
+ *
+ * The leaf's attribute is looked up once per lane and its values gathered
+ * into columns: single integers in one array, single strings in another.
+ * Each column is then compared in one loop, which the compiler can
+ * vectorise for the integers. Other lanes (booleans, lists of values) are
+ * tested one at a time.
+ *
+ * @param[in] leaf - The leaf to evaluate.
+ * @param[in] attrs - The attribute sets of the batch.
+ * @param[in] sel - The lanes to evaluate.
+ * @param[out] errors - Set to the lanes whose test failed with an error.
+ *
+ * @return The lanes of @p sel for which the leaf is true.
+ *
+ * @internal
+ */
+static unsigned long predicateTestBatch(const PredicateLeaf * leaf,
+      SLPAttributes const * attrs, unsigned long sel, unsigned long * errors)
+{
+   int ints[SLPD_PREDICATE_BATCH];
+   unsigned char hits[SLPD_PREDICATE_BATCH];
+   const value_t * strs[SLPD_PREDICATE_BATCH];
+   unsigned long int_lanes = 0;
+   unsigned long str_lanes = 0;
+   unsigned long result = 0;
+   unsigned i;
+
+   *errors = 0;
+
+   /* Gather */
+   for (i = 0; i < SLPD_PREDICATE_BATCH; i++)
+   {
+      const var_t * var;
+      FilterResult err;
+
+      ints[i] = 0;
+      if (!(sel & PRED_LANE(i)))
+         continue;
+      var = attrs[i]? attr_val_find_str((struct xx_SLPAttributes *)attrs[i],
+            leaf->tag, leaf->tag_len): NULL;
+      if (var == NULL)
+         continue;
+      if (leaf->op == PRESENT)
+         result |= PRED_LANE(i);
+      else if (var->type == SLP_INTEGER && var->list->next == NULL)
+      {
+         ints[i] = var->list->data.va_int;
+         int_lanes |= PRED_LANE(i);
+      }
+      else if (var->type == SLP_STRING && var->list->next == NULL
+            && leaf->op == EQUAL)
+      {
+         strs[i] = var->list;
+         str_lanes |= PRED_LANE(i);
+      }
+      else if ((err = predicateTestVar(leaf, var)) == FR_EVAL_TRUE)
+         result |= PRED_LANE(i);
+      else if (err != FR_EVAL_FALSE)
+         *errors |= PRED_LANE(i);
+   }
+
+   /* Compare the integer column across the whole batch */
+   if (int_lanes && leaf->int_ok)
+   {
+      int v = leaf->int_val;
+
+      switch (leaf->op)
+      {
+         case EQUAL:
+            for (i = 0; i < SLPD_PREDICATE_BATCH; i++)
+               hits[i] = ints[i] == v;
+            break;
+         case GREATER:
+            for (i = 0; i < SLPD_PREDICATE_BATCH; i++)
+               hits[i] = ints[i] >= v;
+            break;
+         case LESS:
+            for (i = 0; i < SLPD_PREDICATE_BATCH; i++)
+               hits[i] = ints[i] <= v;
+            break;
+         default:
+            memset(hits, 0, sizeof(hits));
+            break;
+      }
+      for (i = 0; i < SLPD_PREDICATE_BATCH; i++)
+         result |= (unsigned long)hits[i] << i & int_lanes;
+   }
+
+   /* Match the string column */
+   for (i = 0; str_lanes && i < SLPD_PREDICATE_BATCH; i++)
+   {
+      if (str_lanes & PRED_LANE(i))
+      {
+         FilterResult err = predicateMatch(leaf, strs[i]->data.va_str,
+               strs[i]->unescaped_len);
+         if (err == FR_EVAL_TRUE)
+            result |= PRED_LANE(i);
+         else if (err != FR_EVAL_FALSE)
+            *errors |= PRED_LANE(i);
+      }
+   }
+   return result;
+}
+
+/** Determine which of a batch of attribute sets satisfy a compiled
+ * predicate.
+ *
+ * Gives the same results as SLPDPredicateTestProgram on each set, but runs
+ * the program once for the whole batch. The result register holds one bit
+ * per set, and a selection mask the sets still being evaluated; a jump
+ * takes the sets it decides out of the selection, and they rejoin it at
+ * the jump's target. Each leaf is thus evaluated only for the sets that
+ * need it.
+ *
+ * @param[in] program - The program from SLPDPredicateCompile; NULL is
+ *    always satisfied. Its scratch space is used, so a program may not be
+ *    evaluated by two batches at once.
+ * @param[in] attrs - The attribute sets; a NULL set is never satisfied.
+ * @param[in] count - The number of sets, at most SLPD_PREDICATE_BATCH.
+ *
+ * @return A mask with bit @c i set if @p attrs[i] satisfies the predicate.
+ */
+unsigned long SLPDPredicateTestProgramBatch(SLPDPredicateProgram * program,
+      SLPAttributes const * attrs, unsigned count)
+{
+   unsigned long lanes;
+   unsigned long sel;
+   unsigned long result;
+   unsigned long * arrivals;
+   unsigned i;
+
+   SLP_ASSERT(count <= SLPD_PREDICATE_BATCH);
+   lanes = count < SLPD_PREDICATE_BATCH? PRED_LANE(count) - 1:
+         PRED_ALL_LANES;
+   for (i = 0; i < count; i++)
+      if (!attrs[i])
+         lanes &= ~PRED_LANE(i);
+   if (!program)
+      return lanes;
+
+   arrivals = program->arrivals;
+   memset(arrivals, 0, 2 * program->ninstrs * sizeof(*arrivals));
+   sel = result = lanes;
+   for (i = 0; ; i++)
+   {
+      const PredicateInstr * ip = &program->code[i];
+      unsigned long leaving;
+
+      /* Lanes that jumped here rejoin with the result they jumped on */
+      result = (result & sel) | arrivals[2 * i + 1];
+      sel |= arrivals[2 * i];
+
+      switch (ip->opcode)
+      {
+         case PROG_TEST:
+            if (sel)
+            {
+               unsigned long errors;
+
+               result = predicateTestBatch(&program->leaves[ip->arg], attrs,
+                     sel, &errors);
+               sel &= ~errors;
+            }
+            break;
+
+         case PROG_JUMP_FALSE:
+            leaving = sel & ~result;
+            arrivals[2 * ip->arg] |= leaving;
+            sel &= ~leaving;
+            break;
+
+         case PROG_JUMP_TRUE:
+            leaving = sel & result;
+            arrivals[2 * ip->arg] |= leaving;
+            arrivals[2 * ip->arg + 1] |= leaving;
+            sel &= ~leaving;
+            break;
+
+         case PROG_NOT:
+            result = ~result & sel;
+            break;
+
+         default:
+            return result & sel;
+      }
+   }
+}
+
 /** Copies attributes from a list to a string.
  *
  * Copies attributes from the specified attribute list to a result string
@@ -2238,4 +3332,498 @@ void print_parse_tree(SLPDPredicateTreeNode *tree)
 }
 #endif /* DEBUG */
 
+#ifdef SLPD_PREDICATE_BENCH
+
+/* ------------ Benchmark main for the slpd_predicate.c module -------------
+ *
+ * Times string equality predicates, through both the tree walker and the
+ * compiled program, on long attribute values. The typical cases are the
+ * patterns a browsing client sends; the pathological ones make a naive
+ * substring search re-read the value once per pattern byte.
+ *
+ * Build and run with:
+ *    make slpd-predicate-bench
+ *    ./slpd-predicate-bench [-n iterations]
+ */
+
+#include <time.h>
+
+/** A benchmark case: a predicate and the attribute value to test it on. */
+typedef struct BenchCase
+{
+   const char * name;
+   const char * predicate;
+   const char * unit;     /* the value is this text repeated ... */
+   int repeat;            /* ... this many times ... */
+   const char * suffix;   /* ... and then this */
+} BenchCase;
+
+static const BenchCase G_BenchCases[] =
+{
+   {"substring", "(v=*raid*)",
+         "Acme storage array, hot spare, dual controller; ", 16, "RAID 6"},
+   {"substring-miss", "(v=*zfs*)",
+         "Acme storage array, hot spare, dual controller; ", 16, "RAID 6"},
+   {"prefix", "(v=acme*)",
+         "Acme storage array, hot spare, dual controller; ", 16, "RAID 6"},
+   {"segments", "(v=*storage*spare*raid*)",
+         "Acme storage array, hot spare, dual controller; ", 16, "RAID 6"},
+   {"digits", "(v=*x-500*)",
+         "model x-400 rev 3, ", 40, "model x-500 rev 1"},
+   {"exact", "(v=acme storage array)", "Acme storage array", 1, ""},
+   {"repeat-letters", "(v=*aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab*)",
+         "a", 4096, "b"},
+   {"repeat-dashes", "(v=*-------------------------------1*)",
+         "-", 4096, "1"},
+   {"many-wildcards", "(v=*a*a*a*a*a*a*a*a*a*a*b)", "a", 4096, "b"},
+};
+
+static double BenchTime(SLPDPredicateTreeNode * tree,
+      const SLPDPredicateProgram * prog, SLPAttributes attr, long iters,
+      int * result)
+{
+   clock_t start = clock();
+   long n;
+
+   for (n = 0; n < iters; n++)
+      *result = prog? SLPDPredicateTestProgram(prog, attr):
+            SLPDPredicateTestTree(tree, attr);
+   return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char * argv[])
+{
+   long iters = 20000;
+   unsigned c;
+
+   if (argc == 3 && strcmp(argv[1], "-n") == 0)
+      iters = atol(argv[2]);
+   else if (argc != 1)
+   {
+      fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+      return 1;
+   }
+
+   printf("%-16s %6s %14s %14s %8s\n", "case", "bytes", "tree tests/s",
+         "prog tests/s", "speedup");
+   for (c = 0; c < sizeof(G_BenchCases) / sizeof(G_BenchCases[0]); c++)
+   {
+      const BenchCase * bc = &G_BenchCases[c];
+      size_t unit_len = strlen(bc->unit);
+      size_t len = unit_len * bc->repeat + strlen(bc->suffix);
+      SLPDPredicateTreeNode * tree;
+      SLPDPredicateProgram * prog;
+      SLPAttributes attr;
+      const char * end;
+      double tree_secs;
+      double prog_secs;
+      int tree_result = 0;
+      int prog_result = 0;
+      char * list;
+      char * cur;
+      int i;
+
+      /* (v=<value>) */
+      if ((list = xmalloc(len + 5)) == 0)
+         return 1;
+      cur = list + 3;
+      memcpy(list, "(v=", 3);
+      for (i = 0; i < bc->repeat; i++, cur += unit_len)
+         memcpy(cur, bc->unit, unit_len);
+      strcpy(cur, bc->suffix);
+      strcat(cur, ")");
+
+      if (SLPAttrAlloc("en", NULL, SLP_FALSE, &attr) != SLP_OK
+            || SLPAttrFreshen(attr, list) != SLP_OK
+            || createPredicateParseTree(bc->predicate, &end, &tree,
+                  SLPD_ATTR_RECURSION_DEPTH) != PREDICATE_PARSE_OK
+            || SLPDPredicateCompile(tree, &prog) != PREDICATE_PARSE_OK)
+      {
+         fprintf(stderr, "%s: case %s failed to set up\n", argv[0],
+               bc->name);
+         return 1;
+      }
+
+      /* Warm up, then time each */
+      BenchTime(tree, prog, attr, iters / 10 + 1, &prog_result);
+      tree_secs = BenchTime(tree, 0, attr, iters, &tree_result);
+      prog_secs = BenchTime(tree, prog, attr, iters, &prog_result);
+      printf("%-16s %6lu %14.0f %14.0f %7.1fx%s\n", bc->name,
+            (unsigned long)len, tree_secs > 0? iters / tree_secs: 0.0,
+            prog_secs > 0? iters / prog_secs: 0.0,
+            prog_secs > 0? tree_secs / prog_secs: 0.0,
+            tree_result == prog_result? "": " MISMATCH");
+
+      SLPDPredicateFreeProgram(prog);
+      freePredicateParseTree(tree);
+      SLPAttrFree(attr);
+      xfree(list);
+   }
+   return 0;
+}
+
+#endif /* SLPD_PREDICATE_BENCH */
+
+#ifdef SLPD_PREDICATE_TEST
+
+/* -------------- Test main for the slpd_predicate.c module ----------------
+ *
+ * Checks the tree walker against known results, then checks that the
+ * compiled program, its batch form and the tag filter agree with the tree
+ * walker on fixed and randomly generated predicates.
+ *
+ * Build and run with:
+ *    make slpd-predicate-test && ./slpd-predicate-test
+ */
+
+# define FAIL (printf("FAIL: %s at line %d.\n", __FILE__, __LINE__), (-1))
+# define PASS (printf("PASS: Success!\n"), (0))
+
+#define COUNTOF(a) (sizeof(a) / sizeof((a)[0]))
+
+/** A predicate, an attribute list, and the expected result: 1 if the
+ * list satisfies the predicate, 0 if not, and -1 for a parse error.
+ */
+typedef struct TestCase
+{
+   const char * attrs;
+   const char * predicate;
+   int expect;
+} TestCase;
+
+static const TestCase G_TestCases[] =
+{
+   /* Integers */
+   {"(int=23,25,27)", "(&(&(int=23)(int=25))(int=26))", 0},
+   {"(int=23,25,27)", "(&(&(int=24)(int=25))(int=26))", 0},
+   {"(int=23,25,27)", "(&(&(int=24)(int=28))(int=26))", 0},
+   {"(int=23,25,27)", "(&(&(int=23)(int=25))(int=27))", 1},
+   {"(int=23,25,27)", "(int>=29)", 0},
+   {"(int=23,25,27)", "(int>=26)", 1},
+   {"(int=23,25,27)", "(int>=24)", 1},
+   {"(int=23,25,27)", "(int>=22)", 1},
+   {"(int=23,25,27)", "(int<=22)", 0},
+   {"(int=23,25,27)", "(int<=23)", 1},
+   {"(a=1)", "(a=1)", 1},
+
+   /* Strings */
+   {"(str=string)", "(str<=a)", 0},
+   {"(str=string)", "(str<=string)", 1},
+   {"(str=string)", "(str<=strinx)", 1},
+   {"(str=string)", "(str>=a)", 1},
+   {"(str=string)", "(str>=string)", 1},
+   {"(str=string)", "(str>=strinx)", 0},
+   {"(str=string)", "(str=a)", 0},
+   {"(str=string)", "(str=*ing)", 1},
+   {"(str=string)", "(str=stri*)", 1},
+   {"(str=string)", "(str=*tri*)", 1},
+   {"(str=string)", "(str=\\73*)", 1},
+   {"(str=string)", "(str=\\73\\74\\72\\69*)", 1},
+   {"(str=string)", "(str=*\\73\\74\\72\\69*)", 1},
+   {"(str=string)", "(str=s*t*r*i*n*g)", 1},
+   {"(str=string)", "(str=s*t*r*i*ng)", 1},
+   {"(str=string)", "(str=\\73\\74\\72\\69ng)", 1},
+   {"(str=string)", "(str=s*tring)", 1},
+   {"(str=string)", "(str=\\73*\\74ring)", 1},
+
+   /* Wildcards */
+   {"(s=slug)", "(s=slug)", 1},
+   {"(s=slug)", "(s=slug*)", 1},
+   {"(s=slugx)", "(s=slug*)", 1},
+   {"(s=slugxy)", "(s=slug*)", 1},
+   {"(s=slugxy)", "(s=slug*y)", 1},
+   {"(s=slugxy)", "(s=slug*x)", 0},
+   {"(s=slugxy)", "(s=s*y)", 1},
+   {"(s=slugxy)", "(s=sl*xy)", 1},
+   {"(s=ababcdab)", "(s=ab*ab)", 1},
+   {"(s=ababcdab)", "(s=ab*ab*)", 1},
+   {"(s=ababcdab)", "(s=*)", 1},
+   {"(s=ababcdab)", "(s=*cd)", 0},
+   {"(s=ababcdab)", "(s=*cdab)", 1},
+   {"(s=ababcdab)", "(s=*cd*)", 1},
+   {"(s=ababcdab)", "(s=*c*d*)", 1},
+   {"(s=ababcdab)", "(s=*****c****d****)", 1},
+   {"(s=ab*cd)", "(s=ab\\2Acd)", 1},
+   {"(s=ab**)", "(s=ab\\2A\\2A)", 1},
+   {"(s=ab**lnas)", "(s=ab\\2A\\2Aln*)", 1},
+   {"(s=ab**lnas)", "(s=ab\\2A\\2Aln)", 0},
+   {"(s=ab*x*l*ln)", "(s=ab\\2A*\\2Aln)", 1},
+
+   /* Booleans */
+   {"(bool=true)", "(bool=true)", 1},
+   {"(bool=true)", "(bool=false)", 0},
+   {"(bool=true)", "(bool=falsew)", 0},
+   {"(bool=true)", "(bool=*false)", 0},
+   {"(bool=true)", "(bool=truee)", 0},
+   {"(bool=true)", "(bool= true)", 0},
+
+   /* Keywords */
+   {"keyw", "(keyw=*)", 1},
+   {"keyw", "(keyw=sd)", 0},
+   {"keyw", "(keyw<=adf)", 0},
+
+   /* Logical operators */
+   {"keyw", "(!(keyw=*))", 0},
+   {"keyw", "(!(!(keyw=*)))", 1},
+   {"keyw", "(!(!(!(keyw=*))))", 0},
+   {"keyw", "(!(!(!(!(keyw=*)))))", 1},
+   {"keyw,(bool=true)", "(&(keyw=*)(bool=true))", 1},
+   {"keyw,(bool=true)", "(&(keyw=*)(bool=false))", 0},
+   {"keyw,(bool=true)", "(&(keyw=*)(!(bool=false)))", 1},
+   {"keyw,(bool=true)", "(&(keywx=*)(bool=true))", 0},
+   {"keyw,(bool=true)", "(&(!(keywx=*))(bool=true))", 1},
+   {"keyw,(bool=true)", "(&(lkeyw=*)(bool=false))", 0},
+   {"keyw,(bool=true)", "(&(!(lkeyw=*))(!(bool=false)))", 1},
+   {"keyw,(bool=true)",
+         "(&(&(keyw=*)(bool=true))(&(keyw=*)(bool=true)))", 1},
+   {"keyw,(bool=true)",
+         "(&(&(!(keyw=*))(bool=true))(&(keyw=*)(bool=true)))", 0},
+   {"keyw,(bool=true)",
+         "(!(&(&(!(keyw=*))(bool=true))(&(keyw=*)(bool=true))))", 1},
+   {"(x=1)", "(&(x=1)(!(x=1)))", 0},
+   {"(x=1)", "(&(x=1))", 1},
+   {"(x=1)", "(&(x=1)(x=1)(x=1))", 1},
+
+   /* Syntax */
+   {"keyw", "asdf=log", -1},
+   {"keyw", "(asdf=log", -1},
+   {"keyw", "(asdf=log))", -1},
+   {"keyw", "((asdf=log)", -1},
+   {"keyw", "(asdflog)", -1},
+   {"keyw", "(asdflog=q)", 0},
+   {"keyw", "((asdflog=q))", -1},
+   {"keyw", "((asdflog=q)(asdflog=q))", -1},
+   {"keyw", "()", -1},
+   {"keyw", "(!)", -1},
+   {"keyw", "(&)", -1},
+   {"keyw", "(=)", -1},
+   {"keyw", "(thingy=)", 0},
+   {"keyw", "(&(a=b)(c=d))", 0},
+   {"keyw", "(|(a=b)(c=d)w)", -1},
+};
+
+/* Attribute lists to evaluate every predicate against. */
+static const char * const G_TestAttrs[] =
+{
+   "(int=23,25,27),(str=string,Strong),(bool=true),keyw",
+   "(x=1),(y=abc),(z=false),(str=ababcdab),(int=-5)",
+   "(name=Laser\\2A1),(str=ab**lnas,ab*x*l*ln,S),(op=\\FF\\00\\01)",
+   "(str=),(int=0),(bool=false),(STR=CaSe)",
+   "(str=aabaabaaab,xA1-2a1-2B,abcabcabd),(name=-----1--1)",
+};
+
+/* Tags, operators and values the random predicates are made of. */
+static const char * const G_TestTags[] =
+{
+   "int", "str", "bool", "keyw", "name", "op", "x", "y", "missing", "STR",
+};
+static const char * const G_TestOps[] = { "=", ">=", "<=", "~=", };
+static const char * const G_TestValues[] =
+{
+   "23", "25", "-5", "0", "2*", "*", "string", "s*g", "S*T*R*", "*ing",
+   "stri*", "\\73*", "ab*ab", "*cd*", "*c*d*", "true", "false", "abc",
+   "\\2A", "bad\\G1", "tr\\", "\\4", "Laser\\2A1", "*\\41*", "",
+   "ab\\2A*\\2Aln", "case", "**a**", "1x", "*aab*", "*aaab*b", "*a1-2b*",
+   "*1-2*1-2*", "*ABCABD*", "*bca*c*", "*a*a*b*", "*--1*", "*-1-*", "*--*",
+};
+
+static unsigned long G_TestSeed = 1;
+
+static unsigned TestRand(unsigned n)
+{
+   G_TestSeed = G_TestSeed * 1103515245 + 12345;
+   return (unsigned)((G_TestSeed >> 16) % n);
+}
+
+/* Appends a random predicate of at most the given depth. */
+static void TestBuild(char * buf, size_t size, int depth)
+{
+   size_t len = strlen(buf);
+   unsigned kind = depth > 0? TestRand(6): 5;
+
+   if (kind < 3)
+   {
+      unsigned n = kind == 2? 1: 1 + TestRand(3);
+
+      snprintf(buf + len, size - len, "(%c", "&|!"[kind]);
+      while (n--)
+         TestBuild(buf, size, depth - 1);
+   }
+   else if (TestRand(8) == 0)
+      snprintf(buf + len, size - len, "(%s=*",
+            G_TestTags[TestRand(COUNTOF(G_TestTags))]);
+   else
+      snprintf(buf + len, size - len, "(%s%s%s",
+            G_TestTags[TestRand(COUNTOF(G_TestTags))],
+            G_TestOps[TestRand(COUNTOF(G_TestOps))],
+            G_TestValues[TestRand(COUNTOF(G_TestValues))]);
+   len = strlen(buf);
+   snprintf(buf + len, size - len, ")");
+}
+
+/* Parses a whole predicate; returns 0 if it is not valid. */
+static SLPDPredicateTreeNode * TestParse(const char * str)
+{
+   SLPDPredicateTreeNode * tree;
+   const char * end;
+
+   if (createPredicateParseTree(str, &end, &tree,
+         SLPD_ATTR_RECURSION_DEPTH) != PREDICATE_PARSE_OK)
+      return 0;
+   if (*end != 0)
+   {
+      freePredicateParseTree(tree);
+      return 0;
+   }
+   return tree;
+}
+
+/* Checks that the compiled program agrees with the tree walker, both one
+ * list at a time and in a full batch of them (with gaps), and that the tag
+ * filter of a list never rejects a predicate the list satisfies. Returns
+ * -1 on a mismatch, 0 if the predicate does not parse and 1 otherwise;
+ * @p rejected counts the lists the tag filter ruled out.
+ */
+static int TestCompiled(const char * str, SLPAttributes * attrs,
+      size_t nattrs, unsigned long * rejected)
+{
+   SLPDPredicateTreeNode * tree;
+   SLPDPredicateProgram * prog;
+   SLPAttributes batch[SLPD_PREDICATE_BATCH];
+   unsigned long expect_mask = 0;
+   unsigned long mask;
+   int result = 1;
+   size_t i;
+
+   if ((tree = TestParse(str)) == 0)
+      return 0;
+   if (SLPDPredicateCompile(tree, &prog) != PREDICATE_PARSE_OK)
+   {
+      printf("%s: does not compile\n", str);
+      freePredicateParseTree(tree);
+      return -1;
+   }
+   for (i = 0; i < nattrs; i++)
+   {
+      int expect = SLPDPredicateTestTree(tree, attrs[i]);
+      int got = SLPDPredicateTestProgram(prog, attrs[i]);
+      SLPDTagFilter filter;
+
+      SLPDTagFilterInit(&filter, strlen(G_TestAttrs[i / 2]),
+            G_TestAttrs[i / 2]);
+      if (!SLPDPredicateMayMatch(prog, &filter))
+      {
+         if (expect)
+         {
+            printf("%s on %s: rejected by the tag filter\n", str,
+                  G_TestAttrs[i / 2]);
+            result = -1;
+         }
+         (*rejected)++;
+      }
+      if (expect != got)
+      {
+         printf("%s on %s: tree %d, program %d\n", str,
+               G_TestAttrs[i / 2], expect, got);
+         result = -1;
+      }
+   }
+   for (i = 0; i < SLPD_PREDICATE_BATCH; i++)
+   {
+      batch[i] = i % 7 == 6? NULL: attrs[i % nattrs];
+      if (batch[i] && SLPDPredicateTestTree(tree, batch[i]))
+         expect_mask |= 1UL << i;
+   }
+   mask = SLPDPredicateTestProgramBatch(prog, batch, SLPD_PREDICATE_BATCH);
+   if (mask != expect_mask)
+   {
+      printf("%s: batch %#lx, expected %#lx\n", str, mask, expect_mask);
+      result = -1;
+   }
+   mask = SLPDPredicateTestProgramBatch(prog, batch, 5);
+   if (mask != (expect_mask & 0x1f))
+   {
+      printf("%s: short batch %#lx, expected %#lx\n", str, mask,
+            expect_mask & 0x1f);
+      result = -1;
+   }
+   SLPDPredicateFreeProgram(prog);
+   freePredicateParseTree(tree);
+   return result;
+}
+
+int main(int argc, char * argv[])
+{
+   SLPAttributes attrs[2 * COUNTOF(G_TestAttrs)];
+   unsigned long rejected = 0;
+   int checked = 0;
+   char buf[1024];
+   size_t i;
+
+   (void)argc;
+   (void)argv;
+
+   /* The tree walker, against known results. */
+   for (i = 0; i < COUNTOF(G_TestCases); i++)
+   {
+      const TestCase * tc = &G_TestCases[i];
+      SLPDPredicateTreeNode * tree = TestParse(tc->predicate);
+      SLPAttributes attr;
+      int got = -1;
+
+      if (SLPAttrAllocStr("en", NULL, SLP_FALSE, &attr, tc->attrs)
+            != SLP_OK)
+         return FAIL;
+      if (tree)
+      {
+         got = SLPDPredicateTestTree(tree, attr) != 0;
+         freePredicateParseTree(tree);
+      }
+      SLPAttrFree(attr);
+      if (got != tc->expect)
+      {
+         printf("%s on %s: got %d, expected %d\n", tc->predicate,
+               tc->attrs, got, tc->expect);
+         return FAIL;
+      }
+   }
+
+   /* Each list is tested both as parsed and compacted. */
+   for (i = 0; i < COUNTOF(G_TestAttrs); i++)
+   {
+      if (SLPAttrAllocStr("en", NULL, SLP_FALSE, &attrs[2 * i],
+               G_TestAttrs[i]) != SLP_OK
+            || SLPAttrAllocStr("en", NULL, SLP_FALSE, &attrs[2 * i + 1],
+               G_TestAttrs[i]) != SLP_OK
+            || SLPAttrCompact(attrs[2 * i + 1]) != SLP_OK)
+         return FAIL;
+   }
+
+   /* The compiled program, on the known cases and random predicates. */
+   for (i = 0; i < COUNTOF(G_TestCases); i++)
+      if (TestCompiled(G_TestCases[i].predicate, attrs, COUNTOF(attrs),
+            &rejected) < 0)
+         return FAIL;
+   for (i = 0; i < 20000; i++)
+   {
+      int result;
+
+      buf[0] = 0;
+      TestBuild(buf, sizeof(buf), 1 + TestRand(4));
+      if ((result = TestCompiled(buf, attrs, COUNTOF(attrs),
+            &rejected)) < 0)
+         return FAIL;
+      checked += result;
+   }
+   if (checked < 10000 || rejected == 0)
+      return FAIL;
+
+   for (i = 0; i < COUNTOF(attrs); i++)
+      SLPAttrFree(attrs[i]);
+
+   return PASS;
+}
+
+#endif /* SLPD_PREDICATE_TEST */
+
 /*=========================================================================*/
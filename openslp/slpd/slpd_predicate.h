@@ -123,6 +123,45 @@ void freePredicateParseTree(SLPDPredicateTreeNode *pNode);
 int SLPDPredicateTestTree(SLPDPredicateTreeNode *parseTree, 
       SLPAttributes slp_attr);
 
+/** The number of 32-bit words in an SLPDTagFilter. */
+#define SLPD_TAG_FILTER_WORDS 4
+
+/** A Bloom filter over the tags of an attribute list.
+ *
+ * A tag that is in the list always tests as present; one that is not
+ * occasionally does too.
+ */
+typedef struct
+{
+   uint32_t bits[SLPD_TAG_FILTER_WORDS];
+} SLPDTagFilter;
+
+void SLPDTagFilterInit(SLPDTagFilter * filter, size_t attrlistlen,
+      const char * attrlist);
+
+/** A predicate parse tree compiled for repeated evaluation. */
+typedef struct _SLPDPredicateProgram SLPDPredicateProgram;
+
+SLPDPredicateParseResult SLPDPredicateCompile(
+      const SLPDPredicateTreeNode * parseTree,
+      SLPDPredicateProgram ** ppProgram);
+
+void SLPDPredicateFreeProgram(SLPDPredicateProgram * program);
+
+int SLPDPredicateTestProgram(const SLPDPredicateProgram * program,
+      SLPAttributes slp_attr);
+
+/** The most attribute sets SLPDPredicateTestProgramBatch takes at once;
+ * one bit each in its result.
+ */
+#define SLPD_PREDICATE_BATCH 32
+
+unsigned long SLPDPredicateTestProgramBatch(SLPDPredicateProgram * program,
+      SLPAttributes const * attrs, unsigned count);
+
+int SLPDPredicateMayMatch(const SLPDPredicateProgram * program,
+      const SLPDTagFilter * filter);
+
 /*! @} */
 
 #endif   /* SLPD_PREDICATE_H_INCLUDED */
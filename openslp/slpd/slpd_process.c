@@ -42,6 +42,7 @@
 #include "slpd_outgoing.h"
 #include "slpd_property.h"
 #include "slpd_database.h"
+#include "slpd_dasync.h"
 #include "slpd_knownda.h"
 #include "slpd_log.h"
 
@@ -493,6 +494,17 @@ static int ProcessSrvRqst(SLPMessage * message, SLPBuffer * sendbuf,
       }
       goto RESPOND;
    }
+   if (SLPCompareString(message->body.srvrqst.srvtypelen,
+         message->body.srvrqst.srvtype,
+         sizeof(SLPD_DASYNC_SERVICE_TYPE) - 1,
+         SLPD_DASYNC_SERVICE_TYPE) == 0)
+   {
+      /* A peer DA asking for the registrations it lacks; they are sent
+         separately, and the request itself gets an empty reply.
+       */
+      SLPDDASyncRespond(message);
+      goto RESPOND;
+   }
 
    /* make sure that we handle the scope */
    if (SLPIntersectStringList(message->body.srvrqst.scopelistlen,
@@ -656,6 +668,7 @@ FINISHED:
  *
  * @param[in] message - The message to process.
  * @param[in] recvbuf - The buffer associated with @p message.
+ * @param[in] peerpid - The kernel-reported pid of a local peer, or 0.
  * @param[out] sendbuf - The response buffer to fill.
  * @param[in] errorcode - The error code from the client request.
  *
@@ -664,7 +677,7 @@ FINISHED:
  * @internal
  */
 static int ProcessSrvReg(SLPMessage * message, SLPBuffer recvbuf,
-      SLPBuffer * sendbuf, int errorcode)
+      uint32_t peerpid, SLPBuffer * sendbuf, int errorcode)
 {
    SLPBuffer result = *sendbuf;
 
@@ -705,10 +718,22 @@ static int ProcessSrvReg(SLPMessage * message, SLPBuffer recvbuf,
           */
          if (SLPNetIsLoopback(&(message->peer)))
             message->body.srvreg.source= SLP_REG_SOURCE_LOCAL;
+         else if (SLPDDASyncIsPeer(&(message->peer)))
+            message->body.srvreg.source = SLP_REG_SOURCE_PEER_DA;
          else
             message->body.srvreg.source = SLP_REG_SOURCE_REMOTE;
 
-         errorcode = SLPDDatabaseReg(message, recvbuf);
+         /* If the registrant asked for pid watching, watch the pid the
+          * kernel vouches for rather than the one it claimed.
+          */
+         if (peerpid != 0 && message->body.srvreg.pid != 0)
+            message->body.srvreg.pid = peerpid;
+
+         /* Don't let a peer DA give back what was deregistered here. */
+         if (!SLPDDASyncAccepts(message))
+            errorcode = SLP_ERROR_AUTHENTICATION_FAILED;
+         else
+            errorcode = SLPDDatabaseReg(message, recvbuf);
       }
    }
    else
@@ -889,6 +914,32 @@ static int ProcessSrvAck(SLPMessage * message, SLPBuffer * sendbuf,
    return 0;
 }
 
+/** Process a SrvRply message.
+ *
+ * The only SrvRply slpd asks for is the answer to a DA sync request,
+ * which carries nothing; accepting it keeps the connection it came over
+ * open for the next sync.
+ *
+ * @param[in] message - The message to process.
+ * @param[out] sendbuf - The response buffer to fill.
+ * @param[in] errorcode - The error code from the client request.
+ *
+ * @return Zero - always.
+ *
+ * @internal
+ */
+static int ProcessSrvRply(SLPMessage * message, SLPBuffer * sendbuf,
+      int errorcode)
+{
+   SLPBuffer result = *sendbuf;
+
+   (void)message;
+   (void)errorcode;
+
+   result->end = result->start;
+   return 0;
+}
+
 /** Process a general attribute request message.
  *
  * @param[in] message - The message to process.
@@ -1338,6 +1389,7 @@ static int ProcessSAAdvert(SLPMessage * message, SLPBuffer * sendbuf,
  *
  * @param[in] peerinfo - The remote address the message was received from.
  * @param[in] localaddr - The local address the message was received on.
+ * @param[in] peerpid - The kernel-reported pid of a local peer, or 0.
  * @param[in] recvbuf - The message to process.
  * @param[out] sendbuf - The address of storage for the results of the
  *    processed message.
@@ -1347,13 +1399,16 @@ static int ProcessSAAdvert(SLPMessage * message, SLPBuffer * sendbuf,
  * @return Zero on success if @p sendbuf contains a response to send,
  *    or a non-zero value if @p sendbuf does not contain a response
  *    to send.
+ *
+ * @internal
  */
-int SLPDProcessMessage(struct sockaddr_storage * peerinfo,
-      struct sockaddr_storage * localaddr, SLPBuffer recvbuf,
-      SLPBuffer * sendbuf, SLPList * psendlist)
+static int ProcessMessage(struct sockaddr_storage * peerinfo,
+      struct sockaddr_storage * localaddr, uint32_t peerpid,
+      SLPBuffer recvbuf, SLPBuffer * sendbuf, SLPList * psendlist)
 {
    SLPHeader header;
    SLPMessage * message = 0;
+   size_t bodyoffset;
    int errorcode = 0;
 
 #ifdef DEBUG
@@ -1372,6 +1427,7 @@ int SLPDProcessMessage(struct sockaddr_storage * peerinfo,
    /* Parse just the message header */
    recvbuf->curpos = recvbuf->start;
    errorcode = SLPMessageParseHeader(recvbuf, &header);
+   bodyoffset = recvbuf->curpos - recvbuf->start;
 
    /* Reset the buffer "curpos" pointer so that full message can be
       parsed later
@@ -1402,9 +1458,12 @@ int SLPDProcessMessage(struct sockaddr_storage * peerinfo,
       message = SLPMessageAlloc();
       if (message)
       {
-         /* Parse the message and fill out the message descriptor */
-         errorcode = SLPMessageParseBuffer(peerinfo, localaddr,
-               recvbuf, message);
+         /* Parse the rest of the message and fill out the message
+          * descriptor - the header has been parsed already.
+          */
+         recvbuf->curpos = recvbuf->start + bodyoffset;
+         errorcode = SLPMessageParseBody(peerinfo, localaddr,
+               recvbuf, &header, message);
          if (errorcode == 0)
          {
             /* Process messages based on type */
@@ -1415,7 +1474,7 @@ int SLPDProcessMessage(struct sockaddr_storage * peerinfo,
                   break;
 
                case SLP_FUNCT_SRVREG:
-                  errorcode = ProcessSrvReg(message, recvbuf,
+                  errorcode = ProcessSrvReg(message, recvbuf, peerpid,
                         sendbuf, errorcode);
                   if (errorcode == 0)
                      SLPDKnownDAEcho(message, recvbuf);
@@ -1431,6 +1490,10 @@ int SLPDProcessMessage(struct sockaddr_storage * peerinfo,
                   errorcode = ProcessSrvAck(message, sendbuf, errorcode);
                   break;
 
+               case SLP_FUNCT_SRVRPLY:
+                  errorcode = ProcessSrvRply(message, sendbuf, errorcode);
+                  break;
+
                case SLP_FUNCT_ATTRRQST:
                   errorcode = ProcessAttrRqst(message, sendbuf, errorcode);
                   break;
@@ -1522,4 +1585,385 @@ FINISHED:
    return errorcode;
 }
 
+/** Processes the recvbuf and places the results in sendbuf
+ *
+ * @param[in] peerinfo - The remote address the message was received from.
+ * @param[in] localaddr - The local address the message was received on.
+ * @param[in] recvbuf - The message to process.
+ * @param[out] sendbuf - The address of storage for the results of the
+ *    processed message.
+ * @param[out] sendlist - if non-0, this function will prune the message
+ *    with the processed xid from the sendlist.
+ *
+ * @return Zero on success if @p sendbuf contains a response to send,
+ *    or a non-zero value if @p sendbuf does not contain a response
+ *    to send.
+ */
+int SLPDProcessMessage(struct sockaddr_storage * peerinfo,
+      struct sockaddr_storage * localaddr, SLPBuffer recvbuf,
+      SLPBuffer * sendbuf, SLPList * psendlist)
+{
+   return ProcessMessage(peerinfo, localaddr, 0, recvbuf, sendbuf,
+         psendlist);
+}
+
+/** Processes a message received on slpd's local (AF_UNIX) socket.
+ *
+ * @param[in] peerinfo - The loopback address standing in for the peer.
+ * @param[in] localaddr - The loopback address standing in for slpd.
+ * @param[in] peerpid - The peer's pid from its kernel credentials, or 0
+ *    if the platform does not report it.
+ * @param[in] recvbuf - The message to process.
+ * @param[out] sendbuf - The address of storage for the results of the
+ *    processed message.
+ *
+ * @return Zero on success if @p sendbuf contains a response to send,
+ *    or a non-zero value if @p sendbuf does not contain a response
+ *    to send.
+ */
+int SLPDProcessLocalMessage(struct sockaddr_storage * peerinfo,
+      struct sockaddr_storage * localaddr, uint32_t peerpid,
+      SLPBuffer recvbuf, SLPBuffer * sendbuf)
+{
+   return ProcessMessage(peerinfo, localaddr, peerpid, recvbuf, sendbuf, 0);
+}
+
+#ifdef SLPD_PROCESS_BENCH
+
+/* ------------- Benchmark main for the slpd_process.c module --------------
+ *
+ * Replays a corpus of wire messages (one raw packet per file, see
+ * test/corpus/README) through the codec and the slpd request handlers
+ * in-process, and reports the throughput and heap allocations of each.
+ * Every message is first timed through SLPMessageParseBuffer alone, then
+ * requests are timed through SLPDProcessMessage, which parses them again
+ * and builds the reply. Files are replayed in the order given, so the
+ * registrations in the corpus are in the database before the requests
+ * that find them. A SrvDeReg is preceded, untimed, by the SrvReg of the
+ * same URL in every iteration, so that each one removes a registration.
+ * Only a DA answers SLPv1 requests; without -d they are not replayed
+ * through slpd, and are counted apart.
+ *
+ * Allocations are counted by wrapping the allocator at link time, which
+ * needs GNU ld; where configure finds it, the Makefile defines
+ * SLPD_PROCESS_BENCH_WRAP together with the --wrap options. Without it,
+ * allocation counts are not reported.
+ *
+ * Build and run with:
+ *    make slpd-process-bench
+ *    ./slpd-process-bench [-d] [-n iterations] [-c conffile] \
+ *          ../test/corpus/[0-9]*.bin
+ */
+
+static unsigned long G_BenchAllocs = 0;
+
+#ifdef SLPD_PROCESS_BENCH_WRAP
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t count, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+char * __real_strdup(const char * str);
+
+void * __wrap_malloc(size_t size)
+{
+   G_BenchAllocs++;
+   return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t count, size_t size)
+{
+   G_BenchAllocs++;
+   return __real_calloc(count, size);
+}
+
+void * __wrap_realloc(void * ptr, size_t size)
+{
+   G_BenchAllocs++;
+   return __real_realloc(ptr, size);
+}
+
+char * __wrap_strdup(const char * str)
+{
+   G_BenchAllocs++;
+   return __real_strdup(str);
+}
+#endif
+
+/** One corpus message, kept pristine as parsing terminates in place. */
+typedef struct BenchPacket
+{
+   const char * name;
+   unsigned char * data;
+   size_t len;
+   int request;      /* slpd answers it, so it is replayed via Process */
+   int reg;          /* for a SrvDeReg, the SrvReg it undoes, or -1 */
+} BenchPacket;
+
+static int BenchLoad(const char * path, BenchPacket * pkt)
+{
+   FILE * fp;
+   long len;
+   const char * slash = strrchr(path, '/');
+
+   if ((fp = fopen(path, "rb")) == 0)
+      return -1;
+   if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) <= 0
+         || fseek(fp, 0, SEEK_SET) != 0
+         || (pkt->data = xmalloc(len)) == 0)
+   {
+      fclose(fp);
+      return -1;
+   }
+   pkt->len = fread(pkt->data, 1, len, fp);
+   fclose(fp);
+   pkt->name = slash? slash + 1: path;
+   pkt->reg = -1;
+
+   /* Replies and adverts are parsed only: replaying a DAAdvert would
+    * have slpd register with a DA that does not exist.
+    */
+   switch (pkt->len > 1? pkt->data[1]: 0)
+   {
+      case SLP_FUNCT_SRVRQST:
+      case SLP_FUNCT_SRVREG:
+      case SLP_FUNCT_SRVDEREG:
+      case SLP_FUNCT_ATTRRQST:
+      case SLP_FUNCT_SRVTYPERQST:
+         pkt->request = 1;
+         break;
+      default:
+         pkt->request = 0;
+   }
+   return pkt->len == (size_t)len? 0: -1;
+}
+
+static void BenchCopy(SLPBuffer buffer, const BenchPacket * pkt)
+{
+   memcpy(buffer->start, pkt->data, pkt->len);
+   buffer->curpos = buffer->start;
+   buffer->end = buffer->start + pkt->len;
+}
+
+/* Find the SrvReg before a SrvDeReg in the corpus that registers the
+ * URL it deregisters; returns its index, or -1.
+ */
+static int BenchFindReg(const BenchPacket * pkts, int dereg, void * peer,
+      void * local, SLPBuffer buffer, SLPMessage * msg)
+{
+   size_t urllen;
+   char * url;
+   int i;
+
+   BenchCopy(buffer, &pkts[dereg]);
+   if (SLPMessageParseBuffer(peer, local, buffer, msg) != 0
+         || msg->header.functionid != SLP_FUNCT_SRVDEREG)
+      return -1;
+   urllen = msg->body.srvdereg.urlentry.urllen;
+   if ((url = xmemdup(msg->body.srvdereg.urlentry.url, urllen)) == 0)
+      return -1;
+   for (i = dereg - 1; i >= 0; i--)
+   {
+      BenchCopy(buffer, &pkts[i]);
+      if (SLPMessageParseBuffer(peer, local, buffer, msg) == 0
+            && msg->header.functionid == SLP_FUNCT_SRVREG
+            && msg->body.srvreg.urlentry.urllen == urllen
+            && memcmp(msg->body.srvreg.urlentry.url, url, urllen) == 0)
+         break;
+   }
+   xfree(url);
+   return i;
+}
+
+static void BenchReport(const char * phase, const char * name, long msgs,
+      double secs, unsigned long allocs)
+{
+   printf("%-8s %-30s %9.0f msgs/sec", phase, name,
+         secs > 0? msgs / secs: 0.0);
+#ifdef SLPD_PROCESS_BENCH_WRAP
+   printf(" %7.2f allocs/msg", (double)allocs / msgs);
+#else
+   (void)allocs;
+#endif
+   printf("\n");
+}
+
+int main(int argc, char * argv[])
+{
+   struct sockaddr_storage peer;
+   struct sockaddr_storage local;
+   const char * conffile = "";
+   int loopback = INADDR_LOOPBACK;
+   BenchPacket * pkts;
+   SLPBuffer recvbuf;
+   SLPBuffer sendbuf;
+   SLPMessage * msg;
+   long iters = 20000;
+   int isda = 0;
+   int dropped = 0;
+   int npkts = 0;
+   int phase;
+   int i;
+
+   for (i = 1; i < argc && argv[i][0] == '-'; i++)
+   {
+      if (strcmp(argv[i], "-d") == 0)
+         isda = 1;
+      else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         iters = atol(argv[++i]);
+      else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+         conffile = argv[++i];
+      else
+         break;
+   }
+   if (i >= argc || argv[i][0] == '-' || iters <= 0)
+   {
+      fprintf(stderr, "usage: %s [-d] [-n iterations] [-c conffile] "
+            "packet-file ...\n", argv[0]);
+      return 1;
+   }
+
+   /* An empty configuration file name leaves every property at its
+    * default, so the results do not depend on the host's slp.conf.
+    * Only a DA answers SLPv1 requests, hence -d.
+    */
+   if (SLPDPropertyInit(conffile) != 0 || SLPDDatabaseInit(0) != 0)
+      return 1;
+   if (isda)
+      G_SlpdProperty.isDA = 1;
+
+   if ((pkts = xmalloc((argc - i) * sizeof(*pkts))) == 0)
+      return 1;
+   for (; i < argc; i++)
+   {
+      if (BenchLoad(argv[i], &pkts[npkts]) != 0)
+      {
+         fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[i]);
+         return 1;
+      }
+      npkts++;
+   }
+
+   /* Requests from the loopback address are handled as local API calls,
+    * which is how slpd sees most of its registrations.
+    */
+   memset(&peer, 0, sizeof(peer));
+   SLPNetSetAddr(&peer, AF_INET, G_SlpdProperty.port, &loopback);
+   memcpy(&local, &peer, sizeof(local));
+
+   recvbuf = SLPBufferAlloc(G_SlpdProperty.MTU);
+   sendbuf = SLPBufferAlloc(G_SlpdProperty.MTU);
+   msg = SLPMessageAlloc();
+   if (recvbuf == 0 || sendbuf == 0 || msg == 0)
+      return 1;
+
+   for (i = 0; i < npkts; i++)
+   {
+      if (pkts[i].len > recvbuf->allocated)
+      {
+         fprintf(stderr, "%s: %s is too large\n", argv[0], pkts[i].name);
+         return 1;
+      }
+      if (pkts[i].data[1] == SLP_FUNCT_SRVDEREG)
+      {
+         pkts[i].reg = BenchFindReg(pkts, i, &peer, &local, recvbuf, msg);
+         if (pkts[i].reg < 0)
+            fprintf(stderr, "%s: no SrvReg for %s; it only deregisters "
+                  "on the warm-up pass\n", argv[0], pkts[i].name);
+      }
+
+      /* slpd drops SLPv1 requests unless it is a DA */
+      if (pkts[i].request && pkts[i].data[0] == 1 && !isda)
+      {
+         pkts[i].request = 0;
+         dropped++;
+      }
+   }
+
+   printf("%ld iterations of %d messages\n", iters, npkts);
+   for (phase = 0; phase < 2; phase++)
+   {
+      const char * name = phase? "process": "parse";
+      unsigned long totalallocs = 0;
+      double totalsecs = 0;
+      long totalmsgs = 0;
+
+      /* Untimed warm-up pass, so registrations are in place and the
+       * allocation counts reflect the steady state.
+       */
+      for (i = 0; i < npkts; i++)
+      {
+         if (phase && !pkts[i].request)
+            continue;
+         BenchCopy(recvbuf, &pkts[i]);
+         if (phase == 0
+               && SLPMessageParseBuffer(&peer, &local, recvbuf, msg) != 0)
+         {
+            fprintf(stderr, "%s: %s does not parse\n", argv[0],
+                  pkts[i].name);
+            return 1;
+         }
+         if (phase)
+            SLPDProcessMessage(&peer, &local, recvbuf, &sendbuf, 0);
+      }
+
+      for (i = 0; i < npkts; i++)
+      {
+         unsigned long allocs;
+         clock_t start;
+         double secs;
+         long n;
+
+         if (phase && !pkts[i].request)
+            continue;
+
+         allocs = G_BenchAllocs;
+         start = clock();
+         for (n = 0; n < iters; n++)
+         {
+            if (phase && pkts[i].reg >= 0)
+            {
+               /* Put back what the last pass removed, untimed */
+               clock_t paused = clock();
+               unsigned long pausedallocs = G_BenchAllocs;
+
+               BenchCopy(recvbuf, &pkts[pkts[i].reg]);
+               SLPDProcessMessage(&peer, &local, recvbuf, &sendbuf, 0);
+               allocs += G_BenchAllocs - pausedallocs;
+               start += clock() - paused;
+            }
+            BenchCopy(recvbuf, &pkts[i]);
+            if (phase == 0)
+               SLPMessageParseBuffer(&peer, &local, recvbuf, msg);
+            else
+               SLPDProcessMessage(&peer, &local, recvbuf, &sendbuf, 0);
+         }
+         secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+         allocs = G_BenchAllocs - allocs;
+
+         BenchReport(name, pkts[i].name, iters, secs, allocs);
+         totalallocs += allocs;
+         totalsecs += secs;
+         totalmsgs += iters;
+      }
+      if (totalmsgs)
+         BenchReport(name, "(all)", totalmsgs, totalsecs, totalallocs);
+   }
+   if (dropped)
+      printf("%d SLPv1 request(s) not processed: only a DA answers them "
+            "(use -d)\n", dropped);
+
+   SLPMessageFree(msg);
+   SLPBufferFree(sendbuf);
+   SLPBufferFree(recvbuf);
+   for (i = 0; i < npkts; i++)
+      xfree(pkts[i].data);
+   xfree(pkts);
+#ifdef DEBUG
+   SLPDDatabaseDeinit();
+#endif
+   SLPDPropertyDeinit();
+   return 0;
+}
+
+#endif /* SLPD_PROCESS_BENCH */
+
 /*=========================================================================*/
@@ -56,6 +56,9 @@ int CheckAndResizeBuffer(SLPBuffer * sendbuf, SLPBuffer tmp, size_t grow_size);
 int SLPDProcessMessage(struct sockaddr_storage * peerinfo,
       struct sockaddr_storage * localaddr, SLPBuffer recvbuf, 
       SLPBuffer * sendbuf, SLPList * psendlist);
+int SLPDProcessLocalMessage(struct sockaddr_storage * peerinfo,
+      struct sockaddr_storage * localaddr, uint32_t peerpid,
+      SLPBuffer recvbuf, SLPBuffer * sendbuf);
 
 #if defined(ENABLE_SLPv1)
 int SLPDv1ProcessMessage(struct sockaddr_storage * peeraddr, 
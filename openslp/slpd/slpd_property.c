@@ -66,6 +66,9 @@ void SLPDPropertyReinit(void)
    xfree(G_SlpdProperty.DAAddresses);
    xfree(G_SlpdProperty.interfaces);
    xfree(G_SlpdProperty.locale);
+   xfree(G_SlpdProperty.localSocketPath);
+   xfree(G_SlpdProperty.snapshotFile);
+   xfree(G_SlpdProperty.DACacheFile);
    xfree(G_SlpdProperty.ifaceInfo.iface_addr);
    xfree(G_SlpdProperty.ifaceInfo.bcast_addr);
 
@@ -120,6 +123,13 @@ void SLPDPropertyReinit(void)
    if ((G_SlpdProperty.locale = SLPPropertyXDup("net.slp.locale")) != 0)
       G_SlpdProperty.localeLen = strlen(G_SlpdProperty.locale);
 
+   G_SlpdProperty.localSocketPath = SLPPropertyXDup("net.slp.localSocketPath");
+   G_SlpdProperty.snapshotFile = SLPPropertyXDup("net.slp.snapshotFile");
+   G_SlpdProperty.DACacheFile = SLPPropertyXDup("net.slp.DACacheFile");
+#ifdef ENABLE_PREDICATES
+   G_SlpdProperty.lazyAttributes = SLPPropertyAsBoolean("net.slp.lazyAttributes");
+#endif
+
    G_SlpdProperty.securityEnabled = SLPPropertyAsBoolean("net.slp.securityEnabled");
    G_SlpdProperty.checkSourceAddr = SLPPropertyAsBoolean("net.slp.checkSourceAddr");
    G_SlpdProperty.DAHeartBeat = SLPPropertyAsInteger("net.slp.DAHeartBeat");
@@ -140,6 +150,11 @@ void SLPDPropertyReinit(void)
    if (G_SlpdProperty.DAHeartBeat < SLPD_AGE_INTERVAL)
       G_SlpdProperty.DAHeartBeat = SLPD_AGE_INTERVAL;
 
+   G_SlpdProperty.DASyncInterval = SLPPropertyAsInteger("net.slp.DASyncInterval");
+   if (G_SlpdProperty.DASyncInterval > 0
+         && G_SlpdProperty.DASyncInterval < SLPD_AGE_INTERVAL)
+      G_SlpdProperty.DASyncInterval = SLPD_AGE_INTERVAL;
+
    G_SlpdProperty.port = (uint16_t)SLPPropertyAsInteger("net.slp.port");
    G_SlpdProperty.useDHCP = SLPPropertyAsBoolean("net.slp.useDHCP");
 
@@ -263,6 +278,9 @@ void SLPDPropertyDeinit(void)
    xfree(G_SlpdProperty.indexedAttributes);
 #endif
    xfree(G_SlpdProperty.locale);
+   xfree(G_SlpdProperty.localSocketPath);
+   xfree(G_SlpdProperty.snapshotFile);
+   xfree(G_SlpdProperty.DACacheFile);
    xfree(G_SlpdProperty.ifaceInfo.iface_addr);
    xfree(G_SlpdProperty.ifaceInfo.bcast_addr);
 
@@ -73,6 +73,9 @@ typedef struct _SLPDProperty
    uint16_t port;
    size_t localeLen;
    char * locale;
+   char * localSocketPath;
+   char * snapshotFile;
+   char * DACacheFile;
 
    int indexingPropertiesSet;           /** Indexes are only maintained from startup,
                                          *  and may not be switched on and off without
@@ -83,6 +86,10 @@ typedef struct _SLPDProperty
 #ifdef ENABLE_PREDICATES
    size_t indexedAttributesLen;
    char * indexedAttributes;
+   int lazyAttributes;                  /** Parse the full attribute list of
+                                         *  a registration only when a
+                                         *  predicate first needs it.
+                                         */
 #endif
    int srvtypeIsIndexed;
 
@@ -111,6 +118,9 @@ typedef struct _SLPDProperty
    int securityEnabled;
    int checkSourceAddr;
    int DAHeartBeat;
+   int DASyncInterval;                  /** Seconds between syncs with peer
+                                         *  DAs, or zero for none.
+                                         */
    int appendLog;
    int MTU;
    int useDHCP;
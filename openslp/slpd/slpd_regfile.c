@@ -48,71 +48,105 @@
 
 #include "slp_xmalloc.h"
 #include "slp_compare.h"
+#include "slp_regfile.h"
 
 #if defined(ENABLE_SLPv2_SECURITY)
 # include "slp_auth.h"
 #endif
 
-/** Trim leading and trailing whitespace from a string.
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+# include <sys/mman.h>
+# define REGFILE_MMAP 1
+#endif
+
+/** A compiled registration file loaded into memory. */
+struct _SLPDRegFileImage
+{
+   uint8_t * data;         /*!< The contents of the file. */
+   size_t len;             /*!< The size of the file. */
+   uint32_t hash;          /*!< The hash over the entries of the file. */
+   char * scopes;          /*!< The scopes of default-scope entries. */
+   int sign;               /*!< Non-zero if the entries were signed. */
+};
+
+/** Build and parse the SrvReg message of a registration.
  *
- * @param[in,out] str - The address of the string to be trimmed.
+ * @param[in] entry - The registration; an entry without a scope list is
+ *    given the scopes slpd is configured with.
+ * @param[out] msg - A message describing the SrvReg in buf.
+ * @param[out] buf - The buffer used to hold @p message data.
  *
- * @return A pointer to the first non-whitespace character in @p str.
+ * @return Zero on success, or an SLP_ERROR_xxx code on error.
  *
  * @internal
  */
-static char * TrimWhitespace(char * str)
+static int RegFileBuildSrvReg(const SLPRegFileEntry * entry,
+      SLPMessage ** msg, SLPBuffer * buf)
 {
-   char * end;
+   struct sockaddr_storage peer;
+   SLPRegFileEntry reg = *entry;
+   int result;
 
-   end = str+strlen(str)-1;
-   while (*str && *str <= 0x20)
-      str++;
+#ifdef ENABLE_SLPv2_SECURITY
+   unsigned char * urlauth = 0;
+   int urlauthlen = 0;
+   unsigned char * attrauth = 0;
+   int attrauthlen = 0;
+#endif
 
-   while (end >= str)
+   /* Set the scope set in properties if not is set */
+   if (reg.scopelist == 0)
    {
-      if (*end > 0x20)
-         break;
-      *end = 0;
-      end--;
+      reg.scopelist = G_SlpdProperty.useScopes;
+      reg.scopelistlen = G_SlpdProperty.useScopesLen;
    }
-   return str;
-}
 
-/** Read a line from a file into a buffer.
- *
- * @param[in] fd - The file to read from.
- * @param[out] line - The address of storage for the read line.
- * @param[in] linesize - The size of the buffer pointed to by @p line.
- *
- * @return A pointer to @p line for convenience.
- *
- * @internal
- */
-static char * RegFileReadLine(FILE * fd, char * line, int linesize)
-{
-   while (1)
+#ifdef ENABLE_SLPv2_SECURITY
+   /* generate authentication blocks */
+   if (G_SlpdProperty.securityEnabled)
    {
-      if (fgets(line,linesize,fd) == 0)
-         return 0;
-
-      while(*line && *line <= 0x20 && *line != 0x0d && *line != 0x0a)
-         line++;
+      SLPAuthSignUrl(G_SlpdSpiHandle, 0, 0, reg.urllen, reg.url,
+            &urlauthlen, &urlauth);
+      SLPAuthSignString(G_SlpdSpiHandle, 0, 0, reg.attrlistlen,
+            reg.attrlist, &attrauthlen, &attrauth);
+   }
 
-      if (*line == 0x0d || *line == 0x0a)
-         break;
+   *buf = SLPBufferAlloc(SLPRegFileSrvRegSize(&reg, urlauthlen,
+         attrauthlen));
+   if (*buf)
+      SLPRegFilePutSrvReg((*buf)->start, &reg, urlauth, urlauthlen,
+            attrauth, attrauthlen);
+   xfree(urlauth);
+   xfree(attrauth);
+#else
+   *buf = SLPBufferAlloc(SLPRegFileSrvRegSize(&reg, 0, 0));
+   if (*buf)
+      SLPRegFilePutSrvReg((*buf)->start, &reg, 0, 0, 0, 0);
+#endif
 
-      if (*line != 0 && *line != '#' && *line != ';')
-         break;
+   /* okay, now comes the really stupid (and lazy part) */
+   *msg = SLPMessageAlloc();
+   if (*buf == 0 || *msg == 0)
+   {
+      SLPMessageFree(*msg);
+      SLPBufferFree(*buf);
+      *msg = 0;
+      *buf = 0;
+      return SLP_ERROR_INTERNAL_ERROR;
    }
-   return line;
+
+   /* this should be ok even if we are not supporting IPv4,
+    * since it's a static service
+    */
+   memset(&peer, 0, sizeof(struct sockaddr_in));
+   peer.ss_family = AF_UNSPEC;
+   ((struct sockaddr_in *)&peer)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   result = SLPMessageParseBuffer(&peer, &peer, *buf, *msg);
+   (*msg)->body.srvreg.source = SLP_REG_SOURCE_STATIC;
+   return result;
 }
 
 /** Read service registrations from a text file.
- *
- * A really big and nasty function that reads service registrations from
- * from a file. Don't look at this too hard or you'll be sick. This is by
- * far the most horrible code in OpenSLP. Please volunteer to rewrite it!
  *
  * "THANK GOODNESS this function is only called at startup" -- Matt
  *
@@ -128,430 +162,258 @@ static char * RegFileReadLine(FILE * fd, char * line, int linesize)
  */
 int SLPDRegFileReadSrvReg(FILE * fd, SLPMessage ** msg, SLPBuffer * buf)
 {
-   char * slider1;
-   char * slider2;
+   SLPRegFileEntry entry;
    char line[4096];
-
-   struct sockaddr_storage peer;
-   int result = 0;
-   size_t bufsize = 0;
-   size_t langtaglen = 0;
-   char * langtag = 0;
-   size_t scopelistlen = 0;
-   char * scopelist = 0;
-   size_t urllen = 0;
-   char * url = 0;
-   int lifetime = 0;
-   size_t srvtypelen = 0;
-   char * srvtype = 0;
-   size_t attrlistlen = 0;
-   char * attrlist = 0;
-   SLPBuffer tmp;
-
-#ifdef ENABLE_SLPv2_SECURITY
-   unsigned char * urlauth = 0;
-   int urlauthlen = 0;
-   unsigned char * attrauth = 0;
-   int attrauthlen = 0;
-#endif
+   int result;
 
    /* give the out params an initial NULL value */
    *buf = 0;
    *msg = 0;
 
-   /* read the next non-white non-comment line from the stream */
-   do
-   {
-      slider1 = RegFileReadLine(fd, line, 4096);
-      if (slider1 == 0)
-         return -1;
+   result = SLPRegFileReadEntry(fd, &entry, line, sizeof(line));
+   if (result == 0)
+      result = RegFileBuildSrvReg(&entry, msg, buf);
 
-   } while (*slider1 == 0x0d ||  *slider1 == 0x0a);
-
-   /* Parse the url-props */
-   slider2 = strchr(slider1, ',');
-   if (slider2)
+   /* check for errors and free memory */
+   switch(result)
    {
-      /* srvurl */
-      *slider2 = 0; /* squash comma to null terminate srvurl */
-      url = xstrdup(TrimWhitespace(slider1));
-      if (url == 0)
-      {
-         result = SLP_ERROR_INTERNAL_ERROR;
-         goto CLEANUP;
-      }
-      urllen = strlen(url);
-
-      /* derive srvtype from srvurl */
-      srvtype = strstr(slider1, "://");
-      if (srvtype == 0)
-      {
-         result = SLP_ERROR_INVALID_REGISTRATION;
-         goto CLEANUP;
-      }
-      *srvtype = 0;
-      srvtype=xstrdup(TrimWhitespace(slider1));
-      if (srvtype == 0)
-      {
-         result = SLP_ERROR_INTERNAL_ERROR;
-         goto CLEANUP;
-      }
-      srvtypelen = strlen(srvtype);
-      slider1 = slider2 + 1;
+      case SLP_ERROR_INTERNAL_ERROR:
+         SLPDLog("\nERROR: Out of memory one reg file line:\n   %s\n", line);
+         break;
 
-      /*lang*/
-      slider2 = strchr(slider1, ',');
-      if (slider2)
-      {
-         *slider2 = 0; /* squash comma to null terminate lang */
-         langtag = xstrdup(TrimWhitespace(slider1));
-         if (langtag == 0)
-         {
-            result = SLP_ERROR_INVALID_REGISTRATION;
-            goto CLEANUP;
-         }
-         langtaglen = strlen(langtag);
-         slider1 = slider2 + 1;
-      }
-      else
-      {
-         result = SLP_ERROR_INVALID_REGISTRATION;
-         goto CLEANUP;
-      }
+      case SLP_ERROR_INVALID_REGISTRATION:
+         SLPDLog("\nERROR: Invalid reg file format near:\n   %s\n", line);
+         break;
 
-      /* ltime */
-      slider2 = strchr(slider1,',');
-      if (slider2)
-      {
-         *slider2 = 0; /* squash comma to null terminate ltime */
-         lifetime = atoi(slider1);
-         slider1 = slider2 + 1;
-      }
-      else
-      {
-         lifetime = atoi(slider1);
-         slider1 = slider2;
-      }
-      if (lifetime < 1 || lifetime > SLP_LIFETIME_MAXIMUM)
-      {
-         result = SLP_ERROR_INVALID_REGISTRATION;
-         goto CLEANUP;
-      }
+      case SLP_ERROR_SCOPE_NOT_SUPPORTED:
+         SLPDLog("\nERROR: Duplicate scopes or scope list with "
+               "embedded spaces near:\n   %s\n", line);
+         break;
 
-      /* get the srvtype if one was not derived by the srvurl */
-      if (srvtype == 0)
-      {
-         srvtype = xstrdup(TrimWhitespace(slider1));
-         if (srvtype == 0)
-         {
-            result = SLP_ERROR_INTERNAL_ERROR;
-            goto CLEANUP;
-         }
-         srvtypelen = strlen(srvtype);
-         if (srvtypelen == 0)
-         {
-            result = SLP_ERROR_INVALID_REGISTRATION;
-            goto CLEANUP;
-         }
-      }
-   }
-   else
-   {
-      result = SLP_ERROR_INVALID_REGISTRATION;
-      goto CLEANUP;
+      default:
+         break;
    }
 
-   /* read all the attributes including the scopelist */
-   *line=0;
-   while (1)
-   {
-      slider1 = RegFileReadLine(fd,line,4096);
-      if (slider1 == 0)
-      {
-         result = -1;
-         break;
-      }
-      if (*slider1 == 0x0d || *slider1 == 0x0a)
-         break;
+   SLPRegFileFreeEntry(&entry);
+   return result;
+}
 
-      /* Check to see if it is the scopes line */
-      /* FIXME We can collapse the scope stuff into the value getting and
-         just make it a special case (do strcmp on the tag as opposed to the
-         line) of attribute getting. */
-      if (strncasecmp(slider1,"scopes", 6) == 0)
-      {
-         /* found scopes line */
-         slider2 = strchr(slider1,'=');
-         if (slider2)
-         {
-            slider2++;
-            if (*slider2)
-            {
-               /* just in case some idiot puts multiple scopes lines */
-               if (scopelist)
-               {
-                  result = SLP_ERROR_SCOPE_NOT_SUPPORTED;
-                  goto CLEANUP;
-               }
-
-               /* make sure there are no spaces in the scope list
-      NOTE: There's nothing in the spec that indicates that
-      scopes can't contain spaces. Commenting out for now. --jmc
-               if (strchr(slider2, ' '))
-               {
-                  result = SLP_ERROR_SCOPE_NOT_SUPPORTED;
-                  goto CLEANUP;
-               } */
-
-               scopelist = xstrdup(TrimWhitespace(slider2));
-               if (scopelist == 0)
-               {
-                  result = SLP_ERROR_INTERNAL_ERROR;
-                  goto CLEANUP;
-               }
-               scopelistlen = strlen(scopelist);
-            }
-         }
-      }
-      else
-      {
-         /* line contains an attribute (slow but it works)*/
-         /* TODO Fix this so we do not have to realloc memory each time! */
-         TrimWhitespace(slider1);
-
-         if (attrlist == 0)
-         {
-            attrlistlen += strlen(slider1) + 2;
-            attrlist = xmalloc(attrlistlen + 1);
-            if (attrlist == 0)
-            {
-               result = SLP_ERROR_INTERNAL_ERROR;
-               goto CLEANUP;
-            }
-            *attrlist = 0;
-         }
-         else
-         {
-            char * tmp_attrlist;
-            attrlistlen += strlen(slider1) + 3;
-            if ((tmp_attrlist = xrealloc(attrlist, attrlistlen + 1)) == 0)
-            {
-               xfree(attrlist);
-               result = SLP_ERROR_INTERNAL_ERROR;
-               goto CLEANUP;
-            }
-            attrlist = tmp_attrlist;
-            strcat(attrlist, ",");
-         }
-
-         if (attrlist == 0)
-         {
-            result = SLP_ERROR_INTERNAL_ERROR;
-            goto CLEANUP;
-         }
-
-         /* we need special case for keywords (why do we need these)
-            they seem like a waste of code.  Why not just use booleans */
-         if (strchr(slider1, '='))
-         {
-            /* normal attribute (with '=') */
-            strcat(attrlist, "(");
-            strcat(attrlist, slider1);
-            strcat(attrlist, ")");
-         }
-         else
-         {
-            /* keyword (no '=') */
-            attrlistlen -= 2; /* subtract 2 bytes for no '(' or ')' */
-            strcat(attrlist, slider1);
-         }
-      }
+/** Load a compiled registration file.
+ *
+ * The file is mapped into memory where possible, privately and
+ * writable, since parsing a message terminates its strings in place.
+ *
+ * @param[in] regfile - The name of the registration file.
+ *
+ * @return The loaded file, to be released with SLPDRegFileImageClose
+ *    once no registration read from it is in use, or NULL if the file
+ *    is not a compiled registration file.
+ */
+SLPDRegFileImage SLPDRegFileImageOpen(const char * regfile)
+{
+   SLPDRegFileImage image;
+   uint8_t * data = 0;
+   size_t len = 0;
+#ifdef REGFILE_MMAP
+   struct stat st;
+   int fd;
+
+   if ((fd = open(regfile, O_RDONLY)) < 0)
+      return 0;
+   if (fstat(fd, &st) == 0 && st.st_size >= SLP_REGFILE_HDRLEN)
+   {
+      len = (size_t)st.st_size;
+      data = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+         data = 0;
    }
-
-   /* Set the scope set in properties if not is set */
-   if (scopelist == 0)
+   close(fd);
+#else
+   FILE * fp;
+   long size;
+
+   if ((fp = fopen(regfile, "rb")) == 0)
+      return 0;
+   if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= SLP_REGFILE_HDRLEN
+         && fseek(fp, 0, SEEK_SET) == 0
+         && (data = xmalloc((size_t)size)) != 0)
    {
-      scopelist = xstrdup(G_SlpdProperty.useScopes);
-      if (scopelist == 0)
+      len = (size_t)size;
+      if (fread(data, 1, len, fp) != len)
       {
-         result = SLP_ERROR_INTERNAL_ERROR;
-         goto CLEANUP;
+         xfree(data);
+         data = 0;
       }
-      scopelistlen = G_SlpdProperty.useScopesLen;
-   }
-
-#ifdef ENABLE_SLPv2_SECURITY
-   /* generate authentication blocks */
-   if (G_SlpdProperty.securityEnabled)
-   {
-      SLPAuthSignUrl(G_SlpdSpiHandle, 0, 0, urllen, url,
-            &urlauthlen, &urlauth);
-      SLPAuthSignString(G_SlpdSpiHandle, 0, 0, attrlistlen, attrlist,
-            &attrauthlen, &attrauth);
    }
+   fclose(fp);
 #endif
 
-   /* allocate buffer for the SrvReg Message */
-   bufsize = 14 + langtaglen;    /* 14 bytes for header    */
-   bufsize += urllen + 6;        /*  1 byte for reserved   */
-                                 /*  2 bytes for lifetime  */
-                                 /*  2 bytes for urllen    */
-                                 /*  1 byte for authcount  */
-   bufsize += srvtypelen + 2;    /*  2 bytes for len field */
-   bufsize += scopelistlen + 2;  /*  2 bytes for len field */
-   bufsize += attrlistlen + 2;   /*  2 bytes for len field */
-   bufsize += 1;                 /*  1 byte for authcount  */
+   if (data == 0)
+      return 0;
 
+   image = 0;
+   if (memcmp(data, SLP_REGFILE_MAGIC, 8) == 0
+         && (image = xmalloc(sizeof(*image))) != 0)
+   {
+      image->data = data;
+      image->len = len;
+      image->hash = AS_UINT32(data + 12);
+      image->scopes = xstrdup(G_SlpdProperty.useScopes);
 #ifdef ENABLE_SLPv2_SECURITY
-   bufsize += urlauthlen;
-   bufsize += attrauthlen;
+      image->sign = G_SlpdProperty.securityEnabled;
+#else
+      image->sign = 0;
 #endif
-
-   tmp = *buf = SLPBufferAlloc(bufsize);
-   if (tmp == 0)
-   {
-      result = SLP_ERROR_INTERNAL_ERROR;
-      goto CLEANUP;
+      if (image->scopes == 0)
+      {
+         xfree(image);
+         image = 0;
+      }
    }
-
-   /* now build the SrvReg Message */
-
-   /* version */
-   *tmp->curpos++ = 2;
-
-   /* function id */
-   *tmp->curpos++ = SLP_FUNCT_SRVREG;
-
-   /* length */
-   PutUINT24(&tmp->curpos, bufsize);
-
-   /* flags */
-   PutUINT16(&tmp->curpos, 0);
-
-   /* ext offset */
-   PutUINT24(&tmp->curpos, 0);
-
-   /* xid */
-   PutUINT16(&tmp->curpos, 0);
-
-   /* lang tag len */
-   PutUINT16(&tmp->curpos, langtaglen);
-
-   /* lang tag */
-   memcpy(tmp->curpos, langtag, langtaglen);
-   tmp->curpos += langtaglen;
-
-   /* url-entry reserved */
-   *tmp->curpos++ = 0;
-
-   /* url-entry lifetime */
-   PutUINT16(&tmp->curpos, lifetime);
-
-   /* url-entry urllen */
-   PutUINT16(&tmp->curpos, urllen);
-
-   /* url-entry url */
-   memcpy(tmp->curpos, url, urllen);
-   tmp->curpos += urllen;
-
-   /* url-entry authblock */
-#ifdef ENABLE_SLPv2_SECURITY
-   if (urlauth)
+   if (image == 0)
    {
-      /* authcount */
-      *tmp->curpos++ = 1;
-
-      /* authblock */
-      memcpy(tmp->curpos, urlauth, urlauthlen);
-      tmp->curpos += urlauthlen;
-   }
-   else
+#ifdef REGFILE_MMAP
+      munmap(data, len);
+#else
+      xfree(data);
 #endif
-      *tmp->curpos++ = 0;
+   }
+   return image;
+}
 
-   /* service type */
-   PutUINT16(&tmp->curpos, srvtypelen);
-   memcpy(tmp->curpos, srvtype, srvtypelen);
-   tmp->curpos += srvtypelen;
+/** Test whether two compiled registration files register the same.
+ *
+ * @param[in] image1 - A loaded registration file.
+ * @param[in] image2 - Another loaded registration file.
+ *
+ * @return Non-zero if the files hold the same entries, and these were
+ *    loaded with the same configured scopes and signing.
+ */
+int SLPDRegFileImageSame(SLPDRegFileImage image1, SLPDRegFileImage image2)
+{
+   return image1->len == image2->len
+         && image1->hash == image2->hash
+         && image1->sign == image2->sign
+         && strcmp(image1->scopes, image2->scopes) == 0
+         && memcmp(image1->data, image2->data, SLP_REGFILE_HDRLEN) == 0;
+}
 
-   /* scope list */
-   PutUINT16(&tmp->curpos, scopelistlen);
-   memcpy(tmp->curpos, scopelist, scopelistlen);
-   tmp->curpos += scopelistlen;
+/** Read a service registration from a compiled registration file.
+ *
+ * The message is used where it lies in the file, unless it has to be
+ * rebuilt to add the configured scopes or authentication blocks.
+ *
+ * @param[in] image - The loaded registration file.
+ * @param[in,out] pos - The offset of the next entry; start with zero.
+ * @param[out] msg - A message describing the SrvReg in buf.
+ * @param[out] buf - The buffer used to hold @p message data.
+ *
+ * @return Zero on success. A value greater than zero on error. A value
+ *    less than zero at the end of the file.
+ *
+ * @note Eventually the caller needs to call SLPBufferFree and
+ *    SLPMessageFree to free memory.
+ */
+int SLPDRegFileImageReadSrvReg(SLPDRegFileImage image, size_t * pos,
+      SLPMessage ** msg, SLPBuffer * buf)
+{
+   struct sockaddr_storage peer;
+   uint8_t * rec;
+   size_t reclen;
+   size_t msglen;
+   int result;
 
-   /* attr list */
-   PutUINT16(&tmp->curpos, attrlistlen);
-   memcpy(tmp->curpos, attrlist, attrlistlen);
-   tmp->curpos += attrlistlen;
+   *buf = 0;
+   *msg = 0;
 
-   /* attribute auth block */
-#ifdef ENABLE_SLPv2_SECURITY
-   if (attrauth)
+   if (*pos < SLP_REGFILE_HDRLEN)
+      *pos = SLP_REGFILE_HDRLEN;
+   if (image->len - *pos < SLP_REGFILE_ENTRYHDRLEN + 14)
+      return -1;
+
+   /* every message is followed by at least one zero byte */
+   rec = image->data + *pos;
+   reclen = AS_UINT32(rec);
+   msglen = AS_UINT24(rec + SLP_REGFILE_ENTRYHDRLEN + 2);
+   if (reclen > image->len - *pos
+         || SLP_REGFILE_ENTRYHDRLEN + msglen >= reclen)
    {
-      /* authcount */
-      *tmp->curpos++ = 1;
-
-      /* authblock */
-      memcpy(tmp->curpos, attrauth, attrauthlen);
-      tmp->curpos += attrauthlen;
+      SLPDLog("\nERROR: Invalid compiled reg file entry at offset %lu\n",
+            (unsigned long)*pos);
+      return -1;
    }
-   else
-#endif
-      *tmp->curpos++ = 0;
+   *pos += reclen;
 
-   /* okay, now comes the really stupid (and lazy part) */
+   *buf = SLPBufferAlloc(0);
    *msg = SLPMessageAlloc();
-   if (*msg == 0)
+   if (*buf == 0 || *msg == 0)
    {
-      SLPBufferFree(*buf);
-      *buf = 0;
       result = SLP_ERROR_INTERNAL_ERROR;
-      goto CLEANUP;
+      goto FINISHED;
    }
+   (*buf)->start = rec + SLP_REGFILE_ENTRYHDRLEN;
+   (*buf)->curpos = (*buf)->start;
+   (*buf)->end = (*buf)->start + msglen;
 
-   /* this should be ok even if we are not supporting IPv4,
-    * since it's a static service
-    */
    memset(&peer, 0, sizeof(struct sockaddr_in));
    peer.ss_family = AF_UNSPEC;
    ((struct sockaddr_in *)&peer)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
    result = SLPMessageParseBuffer(&peer, &peer, *buf, *msg);
+   if (result != 0 || (*msg)->header.functionid != SLP_FUNCT_SRVREG)
+   {
+      result = SLP_ERROR_INVALID_REGISTRATION;
+      goto FINISHED;
+   }
    (*msg)->body.srvreg.source = SLP_REG_SOURCE_STATIC;
 
-CLEANUP:
-
-   /* check for errors and free memory */
-   switch(result)
+   if ((rec[4] & SLP_REGFILE_DEFAULT_SCOPES) || image->sign)
    {
-      case SLP_ERROR_INTERNAL_ERROR:
-         SLPDLog("\nERROR: Out of memory one reg file line:\n   %s\n", line);
-         break;
-
-      case SLP_ERROR_INVALID_REGISTRATION:
-         SLPDLog("\nERROR: Invalid reg file format near:\n   %s\n", line);
-         break;
-
-      case SLP_ERROR_SCOPE_NOT_SUPPORTED:
-         SLPDLog("\nERROR: Duplicate scopes or scope list with "
-               "embedded spaces near:\n   %s\n", line);
-         break;
-
-      default:
-         break;
+      /* rebuild the message from the one in the file */
+      SLPMessage * filemsg = *msg;
+      SLPBuffer filebuf = *buf;
+      SLPRegFileEntry entry;
+
+      entry.url = (char *)filemsg->body.srvreg.urlentry.url;
+      entry.urllen = filemsg->body.srvreg.urlentry.urllen;
+      entry.srvtype = (char *)filemsg->body.srvreg.srvtype;
+      entry.srvtypelen = filemsg->body.srvreg.srvtypelen;
+      entry.langtag = (char *)filemsg->header.langtag;
+      entry.langtaglen = filemsg->header.langtaglen;
+      entry.lifetime = filemsg->body.srvreg.urlentry.lifetime;
+      entry.scopelist = (rec[4] & SLP_REGFILE_DEFAULT_SCOPES)? 0:
+            (char *)filemsg->body.srvreg.scopelist;
+      entry.scopelistlen = filemsg->body.srvreg.scopelistlen;
+      entry.attrlist = (char *)filemsg->body.srvreg.attrlist;
+      entry.attrlistlen = filemsg->body.srvreg.attrlistlen;
+
+      result = RegFileBuildSrvReg(&entry, msg, buf);
+      SLPMessageFree(filemsg);
+      SLPBufferFree(filebuf);
+      return result;
    }
+   return 0;
 
-   xfree(langtag);
-   xfree(scopelist);
-   xfree(url);
-   xfree(srvtype);
-   xfree(attrlist);
+FINISHED:
+   SLPMessageFree(*msg);
+   SLPBufferFree(*buf);
+   *msg = 0;
+   *buf = 0;
+   return result;
+}
 
-#ifdef ENABLE_SLPv2_SECURITY
-   xfree(urlauth);
-   xfree(attrauth);
+/** Release a loaded compiled registration file.
+ *
+ * @param[in] image - The loaded registration file.
+ */
+void SLPDRegFileImageClose(SLPDRegFileImage image)
+{
+#ifdef REGFILE_MMAP
+   munmap(image->data, image->len);
+#else
+   xfree(image->data);
 #endif
-
-   return result;
+   xfree(image->scopes);
+   xfree(image);
 }
 
 /*=========================================================================*/
@@ -53,7 +53,15 @@
 #include "slp_message.h"
 #include "slpd.h"
 
+/** A compiled registration file loaded into memory. */
+typedef struct _SLPDRegFileImage * SLPDRegFileImage;
+
 int SLPDRegFileReadSrvReg(FILE * fd, SLPMessage ** msg, SLPBuffer * buf);
+SLPDRegFileImage SLPDRegFileImageOpen(const char * regfile);
+int SLPDRegFileImageSame(SLPDRegFileImage image1, SLPDRegFileImage image2);
+int SLPDRegFileImageReadSrvReg(SLPDRegFileImage image, size_t * pos,
+      SLPMessage ** msg, SLPBuffer * buf);
+void SLPDRegFileImageClose(SLPDRegFileImage image);
 
 /*! @} */
 
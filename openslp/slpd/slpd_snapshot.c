@@ -0,0 +1,934 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Persistent snapshot and log of the registration database.
+ *
+ * When net.slp.snapshotFile is set, slpd keeps the registrations it was
+ * sent over the network on disk, so that a restart does not leave it
+ * waiting for every SA to register again. Registrations from slp.reg
+ * are read from there anyway, and those of local processes are tied to
+ * processes that may not survive the restart, so neither is kept.
+ *
+ * The snapshot holds the raw SrvReg buffer of every kept registration,
+ * with the absolute time at which it expires. Each registration and
+ * removal since the snapshot was written is appended to a log next to
+ * it. On startup, before any socket is opened, slpd maps the snapshot,
+ * replays the log over it and drops whatever expired in the meantime;
+ * then it writes a fresh snapshot and starts a new, empty log. The log
+ * is compacted the same way once it outgrows the snapshot.
+ *
+ * The snapshot is read before slpd drops its privileges, but written only
+ * after, so that the files belong to the user slpd runs as, and a
+ * directory that user cannot write is noticed at startup rather than
+ * when the log has grown.
+ *
+ * Both files start with a magic string and an epoch. A snapshot of epoch
+ * N contains every log up to epoch N-1, so a log that was not replaced
+ * because slpd stopped in between is recognised and skipped. Records
+ * carry a hash of their payload, so replay stops at a record that was
+ * only partly written.
+ *
+ * @file       slpd_snapshot.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    SlpdCode
+ */
+
+#include "slpd_snapshot.h"
+#include "slpd_database.h"
+#include "slpd_log.h"
+#include "slpd_property.h"
+
+#include "slp_hash.h"
+#include "slp_xmalloc.h"
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+# include <sys/mman.h>
+# define SNAPSHOT_MMAP 1
+#endif
+
+#define SNAPSHOT_MAGIC     "SLPDSNP1"  /*!< The snapshot file magic. */
+#define SNAPSHOT_LOG_MAGIC "SLPDLOG1"  /*!< The log file magic. */
+#define SNAPSHOT_HDRLEN    12          /*!< Magic and epoch. */
+
+/* A record is a fixed header followed by its payload:
+ *
+ *     0  type          SNAPSHOT_REG or SNAPSHOT_REMOVE
+ *     1  source        SLP_REG_SOURCE_xxx of the registration
+ *     2  family        4, 6, or 0 if the peer address is unknown
+ *     4  address       the peer address (16 bytes)
+ *    20  port          the peer port (network byte order)
+ *    24  expiry        seconds since the epoch; 0 for never
+ *    28  length        the length of the payload
+ *    32  check         SLPHash of the payload
+ *
+ * A SNAPSHOT_REG payload is the SrvReg message buffer; a SNAPSHOT_REMOVE
+ * payload is the 16-bit length and bytes of the URL, then those of the
+ * scope list, of the registration removed.
+ */
+#define SNAPSHOT_RECLEN    36
+#define SNAPSHOT_REG       'R'
+#define SNAPSHOT_REMOVE    'U'
+
+static char * G_SnapshotPath = 0;      /*!< The snapshot file name. */
+static char * G_SnapshotLogPath = 0;   /*!< The log file name. */
+static FILE * G_SnapshotLog = 0;       /*!< The open log, if any. */
+static uint32_t G_SnapshotEpoch = 0;   /*!< The epoch of the snapshot. */
+static long G_SnapshotSize = 0;        /*!< The size of the snapshot. */
+static long G_SnapshotLogSize = 0;     /*!< The size of the log. */
+static int G_SnapshotFailed = 0;       /*!< The last compaction failed. */
+
+/** Test whether a registration is kept on disk.
+ *
+ * @param[in] msg - The SrvReg message of the registration.
+ *
+ * @return Non-zero if the registration came over the network.
+ *
+ * @internal
+ */
+static int SnapshotKeeps(SLPMessage * msg)
+{
+   return msg->header.version == 2
+         && (msg->body.srvreg.source == SLP_REG_SOURCE_REMOTE
+               || msg->body.srvreg.source == SLP_REG_SOURCE_PEER_DA);
+}
+
+/** Write a record.
+ *
+ * @param[in] fp - The file to write to.
+ * @param[in] type - The record type.
+ * @param[in] msg - The SrvReg message of the registration.
+ * @param[in] payload - The record payload.
+ * @param[in] len - The length of @p payload in bytes.
+ *
+ * @return The number of bytes written, or -1 on error.
+ *
+ * @internal
+ */
+static long SnapshotPutRecord(FILE * fp, int type, SLPMessage * msg,
+      const void * payload, size_t len)
+{
+   uint8_t hdr[SNAPSHOT_RECLEN];
+   int lifetime = msg->body.srvreg.urlentry.lifetime;
+   uint32_t expiry = 0;
+
+   if (lifetime < SLP_LIFETIME_MAXIMUM)
+      expiry = (uint32_t)(time(0) + lifetime);
+
+   memset(hdr, 0, sizeof(hdr));
+   hdr[0] = (uint8_t)type;
+   hdr[1] = (uint8_t)msg->body.srvreg.source;
+   if (msg->peer.ss_family == AF_INET)
+   {
+      struct sockaddr_in * v4 = (struct sockaddr_in *)&msg->peer;
+      hdr[2] = 4;
+      memcpy(hdr + 4, &v4->sin_addr, sizeof(v4->sin_addr));
+      memcpy(hdr + 20, &v4->sin_port, 2);
+   }
+   else if (msg->peer.ss_family == AF_INET6)
+   {
+      struct sockaddr_in6 * v6 = (struct sockaddr_in6 *)&msg->peer;
+      hdr[2] = 6;
+      memcpy(hdr + 4, &v6->sin6_addr, sizeof(v6->sin6_addr));
+      memcpy(hdr + 20, &v6->sin6_port, 2);
+   }
+   TO_UINT32(hdr + 24, expiry);
+   TO_UINT32(hdr + 28, len);
+   TO_UINT32(hdr + 32, SLPHash(payload, len));
+
+   if (fwrite(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)
+         || fwrite(payload, 1, len, fp) != len)
+      return -1;
+   return (long)(sizeof(hdr) + len);
+}
+
+/** Write a registration record.
+ *
+ * @param[in] fp - The file to write to.
+ * @param[in] msg - The SrvReg message of the registration.
+ * @param[in] buf - The SrvReg message buffer of the registration.
+ *
+ * @return The number of bytes written, or -1 on error.
+ *
+ * @internal
+ */
+static long SnapshotPutReg(FILE * fp, SLPMessage * msg, SLPBuffer buf)
+{
+   return SnapshotPutRecord(fp, SNAPSHOT_REG, msg, buf->start,
+         buf->end - buf->start);
+}
+
+/** Write a file header.
+ *
+ * @param[in] fp - The file to write to.
+ * @param[in] magic - The file magic.
+ * @param[in] epoch - The file epoch.
+ *
+ * @return Zero on success, or non-zero on error.
+ *
+ * @internal
+ */
+static int SnapshotPutHeader(FILE * fp, const char * magic, uint32_t epoch)
+{
+   uint8_t hdr[SNAPSHOT_HDRLEN];
+
+   memcpy(hdr, magic, 8);
+   TO_UINT32(hdr + 8, epoch);
+   return fwrite(hdr, 1, sizeof(hdr), fp) != sizeof(hdr);
+}
+
+/** Map a file into memory for reading.
+ *
+ * @param[in] path - The name of the file.
+ * @param[out] len - The size of the file.
+ *
+ * @return The contents of the file, to be released with SnapshotUnmap,
+ *    or NULL if the file is missing, empty or unreadable.
+ *
+ * @internal
+ */
+static uint8_t * SnapshotMap(const char * path, size_t * len)
+{
+   uint8_t * data = 0;
+#ifdef SNAPSHOT_MMAP
+   struct stat st;
+   int fd;
+
+   *len = 0;
+   if ((fd = open(path, O_RDONLY)) < 0)
+      return 0;
+   if (fstat(fd, &st) == 0 && st.st_size > 0)
+   {
+      data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+         data = 0;
+      else
+         *len = (size_t)st.st_size;
+   }
+   close(fd);
+#else
+   FILE * fp;
+   long size;
+
+   *len = 0;
+   if ((fp = fopen(path, "rb")) == 0)
+      return 0;
+   if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0
+         && fseek(fp, 0, SEEK_SET) == 0
+         && (data = xmalloc((size_t)size)) != 0)
+   {
+      if (fread(data, 1, (size_t)size, fp) == (size_t)size)
+         *len = (size_t)size;
+      else
+      {
+         xfree(data);
+         data = 0;
+      }
+   }
+   fclose(fp);
+#endif
+   return data;
+}
+
+/** Release a file mapped by SnapshotMap.
+ *
+ * @param[in] data - The contents of the file.
+ * @param[in] len - The size of the file.
+ *
+ * @internal
+ */
+static void SnapshotUnmap(uint8_t * data, size_t len)
+{
+#ifdef SNAPSHOT_MMAP
+   munmap(data, len);
+#else
+   (void)len;
+   xfree(data);
+#endif
+}
+
+/** Put a registration record back into the database.
+ *
+ * @param[in] rec - The record header.
+ * @param[in] payload - The SrvReg message buffer of the registration.
+ * @param[in] len - The length of @p payload in bytes.
+ * @param[in] now - The current time.
+ *
+ * @return Non-zero if the registration was added.
+ *
+ * @internal
+ */
+static int SnapshotReplayReg(const uint8_t * rec, const uint8_t * payload,
+      size_t len, uint32_t now)
+{
+   struct sockaddr_storage peer;
+   uint32_t expiry = AS_UINT32(rec + 24);
+   SLPMessage * msg;
+   SLPBuffer buf;
+
+   /* drop registrations that expired while we were down */
+   if (expiry != 0 && expiry <= now)
+      return 0;
+
+   memset(&peer, 0, sizeof(peer));
+   if (rec[2] == 4)
+   {
+      struct sockaddr_in * v4 = (struct sockaddr_in *)&peer;
+      v4->sin_family = AF_INET;
+      memcpy(&v4->sin_addr, rec + 4, sizeof(v4->sin_addr));
+      memcpy(&v4->sin_port, rec + 20, 2);
+   }
+   else if (rec[2] == 6)
+   {
+      struct sockaddr_in6 * v6 = (struct sockaddr_in6 *)&peer;
+      v6->sin6_family = AF_INET6;
+      memcpy(&v6->sin6_addr, rec + 4, sizeof(v6->sin6_addr));
+      memcpy(&v6->sin6_port, rec + 20, 2);
+   }
+
+   buf = SLPBufferAlloc(len);
+   msg = SLPMessageAlloc();
+   if (buf && msg)
+   {
+      memcpy(buf->start, payload, len);
+      if (SLPMessageParseBuffer(&peer, 0, buf, msg) == 0
+            && msg->header.functionid == SLP_FUNCT_SRVREG)
+      {
+         msg->body.srvreg.source = rec[1];
+         if (expiry == 0)
+            msg->body.srvreg.urlentry.lifetime = SLP_LIFETIME_MAXIMUM;
+         else if (expiry - now < SLP_LIFETIME_MAXIMUM)
+            msg->body.srvreg.urlentry.lifetime = (int)(expiry - now);
+         else
+            msg->body.srvreg.urlentry.lifetime = SLP_LIFETIME_MAXIMUM - 1;
+
+         if (SLPDDatabaseReg(msg, buf) == SLP_ERROR_OK)
+            return 1;
+      }
+   }
+   SLPMessageFree(msg);
+   SLPBufferFree(buf);
+   return 0;
+}
+
+/** Replay the records of a snapshot or log file.
+ *
+ * @param[in] data - The contents of the file.
+ * @param[in] len - The size of the file.
+ * @param[in] magic - The magic the file should start with.
+ * @param[in] epoch - The epoch the file should have, or NULL to accept
+ *    any epoch.
+ * @param[out] fileepoch - The epoch of the file.
+ *
+ * @return The number of records replayed, or -1 if the file is not of
+ *    the expected kind.
+ *
+ * @internal
+ */
+static int SnapshotReplay(const uint8_t * data, size_t len,
+      const char * magic, const uint32_t * epoch, uint32_t * fileepoch)
+{
+   const uint8_t * cur = data + SNAPSHOT_HDRLEN;
+   const uint8_t * end = data + len;
+   uint32_t now = (uint32_t)time(0);
+   int count = 0;
+
+   if (len < SNAPSHOT_HDRLEN || memcmp(data, magic, 8) != 0)
+      return -1;
+   *fileepoch = AS_UINT32(data + 8);
+   if (epoch && *epoch != *fileepoch)
+      return -1;
+
+   while (end - cur >= SNAPSHOT_RECLEN)
+   {
+      const uint8_t * payload = cur + SNAPSHOT_RECLEN;
+      uint32_t payloadlen = AS_UINT32(cur + 28);
+
+      /* stop at a record that was not completely written */
+      if (payloadlen > (size_t)(end - payload)
+            || SLPHash(payload, payloadlen) != AS_UINT32(cur + 32))
+         break;
+
+      if (cur[0] == SNAPSHOT_REG)
+         SnapshotReplayReg(cur, payload, payloadlen, now);
+      else if (cur[0] == SNAPSHOT_REMOVE && payloadlen >= 4)
+      {
+         size_t urllen = AS_UINT16(payload);
+         size_t scopelistlen;
+
+         if (urllen + 4 <= payloadlen)
+         {
+            scopelistlen = AS_UINT16(payload + 2 + urllen);
+            if (urllen + 4 + scopelistlen <= payloadlen)
+               SLPDDatabaseForget(urllen, (const char *)payload + 2,
+                     scopelistlen, (const char *)payload + 4 + urllen);
+         }
+      }
+      count++;
+      cur = payload + payloadlen;
+   }
+   return count;
+}
+
+/** Write a fresh snapshot and start a new log.
+ *
+ * @return Zero on success, or non-zero if the snapshot could not be
+ *    written, in which case the current log is kept.
+ *
+ * @internal
+ */
+static int SnapshotCompact(void)
+{
+   size_t pathlen = strlen(G_SnapshotPath);
+   uint32_t epoch = G_SnapshotEpoch + 1;
+   SLPMessage * msg;
+   SLPBuffer buf;
+   char * tmppath;
+   FILE * fp;
+   FILE * log;
+   void * eh;
+   long size = SNAPSHOT_HDRLEN;
+   long written;
+   int result = -1;
+
+   tmppath = xmalloc(pathlen + sizeof(".tmp"));
+   if (tmppath == 0)
+      return -1;
+   memcpy(tmppath, G_SnapshotPath, pathlen);
+   memcpy(tmppath + pathlen, ".tmp", sizeof(".tmp"));
+
+   fp = fopen(tmppath, "wb");
+   if (fp == 0)
+      goto FINISHED;
+
+   if (SnapshotPutHeader(fp, SNAPSHOT_MAGIC, epoch) == 0
+         && (eh = SLPDDatabaseEnumStart()) != 0)
+   {
+      while (size >= 0 && SLPDDatabaseEnum(eh, &msg, &buf))
+      {
+         if (SnapshotKeeps(msg))
+         {
+            written = SnapshotPutReg(fp, msg, buf);
+            size = written < 0? -1: size + written;
+         }
+      }
+      SLPDDatabaseEnumEnd(eh);
+   }
+   else
+      size = -1;
+
+   if (fflush(fp) != 0 || ferror(fp))
+      size = -1;
+#ifndef _WIN32
+   if (size >= 0 && fsync(fileno(fp)) != 0)
+      size = -1;
+#endif
+   if (fclose(fp) != 0 || size < 0)
+   {
+      remove(tmppath);
+      goto FINISHED;
+   }
+
+#ifdef _WIN32
+   remove(G_SnapshotPath);
+#endif
+   if (rename(tmppath, G_SnapshotPath) != 0)
+   {
+      remove(tmppath);
+      goto FINISHED;
+   }
+   G_SnapshotEpoch = epoch;
+   G_SnapshotSize = size;
+   result = 0;
+
+   /* The snapshot holds everything the old log did; start a new one.
+    * Should that fail, the stale log is ignored on the next startup.
+    * The old log is removed first, as it may belong to another user.
+    */
+   if (G_SnapshotLog)
+      fclose(G_SnapshotLog);
+   G_SnapshotLog = 0;
+   remove(G_SnapshotLogPath);
+   log = fopen(G_SnapshotLogPath, "wb");
+   if (log && SnapshotPutHeader(log, SNAPSHOT_LOG_MAGIC, epoch) == 0
+         && fflush(log) == 0)
+   {
+      G_SnapshotLog = log;
+      G_SnapshotLogSize = SNAPSHOT_HDRLEN;
+   }
+   else
+   {
+      if (log)
+         fclose(log);
+      SLPDLog("Could not start database log %s\n", G_SnapshotLogPath);
+   }
+
+FINISHED:
+   xfree(tmppath);
+   return result;
+}
+
+/** Release the snapshot file names and stop logging, without writing.
+ *
+ * @internal
+ */
+static void SnapshotClose(void)
+{
+   if (G_SnapshotLog)
+      fclose(G_SnapshotLog);
+   G_SnapshotLog = 0;
+   xfree(G_SnapshotPath);
+   xfree(G_SnapshotLogPath);
+   G_SnapshotPath = 0;
+   G_SnapshotLogPath = 0;
+}
+
+/** Write a fresh snapshot and start a new log, logging a failure.
+ *
+ * @return Zero on success, or non-zero on error.
+ *
+ * @internal
+ */
+static int SnapshotWrite(void)
+{
+   if (SnapshotCompact() == 0)
+   {
+      G_SnapshotFailed = 0;
+      return 0;
+   }
+   if (!G_SnapshotFailed)
+      SLPDLog("Could not write database snapshot %s\n", G_SnapshotPath);
+   G_SnapshotFailed = 1;
+   return -1;
+}
+
+/** Load the database snapshot.
+ *
+ * Restores the registrations kept by a previous run of slpd; must be
+ * called after the database has been initialised and before any
+ * registration is accepted from the network. Nothing is written until
+ * SLPDSnapshotStart is called.
+ *
+ * @return Zero - always; a snapshot that cannot be read is logged and
+ *    otherwise ignored.
+ */
+int SLPDSnapshotInit(void)
+{
+   size_t pathlen;
+   uint8_t * data;
+   size_t len;
+   uint32_t epoch = 0;
+   uint32_t logepoch;
+   int regs = 0;
+   int logged = 0;
+
+   if (G_SlpdProperty.snapshotFile == 0 || *G_SlpdProperty.snapshotFile == 0)
+      return 0;
+
+   pathlen = strlen(G_SlpdProperty.snapshotFile);
+   G_SnapshotPath = xstrdup(G_SlpdProperty.snapshotFile);
+   G_SnapshotLogPath = xmalloc(pathlen + sizeof(".log"));
+   if (G_SnapshotPath == 0 || G_SnapshotLogPath == 0)
+   {
+      SnapshotClose();
+      return 0;
+   }
+   memcpy(G_SnapshotLogPath, G_SnapshotPath, pathlen);
+   memcpy(G_SnapshotLogPath + pathlen, ".log", sizeof(".log"));
+
+   if ((data = SnapshotMap(G_SnapshotPath, &len)) != 0)
+   {
+      regs = SnapshotReplay(data, len, SNAPSHOT_MAGIC, 0, &epoch);
+      SnapshotUnmap(data, len);
+      if (regs < 0)
+      {
+         SLPDLog("Ignoring invalid database snapshot %s\n", G_SnapshotPath);
+         regs = 0;
+         epoch = 0;
+      }
+   }
+   G_SnapshotEpoch = epoch;
+
+   if ((data = SnapshotMap(G_SnapshotLogPath, &len)) != 0)
+   {
+      /* a log of an older epoch is already part of the snapshot */
+      logged = SnapshotReplay(data, len, SNAPSHOT_LOG_MAGIC, &epoch,
+            &logepoch);
+      SnapshotUnmap(data, len);
+      if (logged < 0)
+         logged = 0;
+   }
+
+   SLPDLog("Restored database snapshot %s (%d registrations, "
+         "%d log records)\n", G_SnapshotPath, regs, logged);
+   return 0;
+}
+
+/** Write the loaded snapshot afresh and start logging.
+ *
+ * Must be called once slpd runs as the user it keeps running as, so that
+ * this user owns the files and can replace them later. If they cannot be
+ * written now, no snapshot is kept by this run of slpd.
+ */
+void SLPDSnapshotStart(void)
+{
+   if (G_SnapshotPath && SnapshotWrite() != 0)
+   {
+      SLPDLog("Not keeping registrations across restarts\n");
+      SnapshotClose();
+   }
+}
+
+/** Write a final snapshot and stop logging. */
+void SLPDSnapshotDeinit(void)
+{
+   /* even if logging stopped, the database itself is complete */
+   if (G_SnapshotPath)
+      SnapshotWrite();
+   SnapshotClose();
+}
+
+/** Log a registration that was added to the database.
+ *
+ * @param[in] msg - The SrvReg message of the registration.
+ * @param[in] buf - The SrvReg message buffer of the registration.
+ */
+void SLPDSnapshotLogReg(SLPMessage * msg, SLPBuffer buf)
+{
+   long written;
+
+   if (G_SnapshotLog == 0 || !SnapshotKeeps(msg))
+      return;
+
+   written = SnapshotPutReg(G_SnapshotLog, msg, buf);
+   if (written > 0 && fflush(G_SnapshotLog) == 0)
+      G_SnapshotLogSize += written;
+}
+
+/** Log a registration that was removed from the database.
+ *
+ * @param[in] msg - The SrvReg message of the registration.
+ */
+void SLPDSnapshotLogRemove(SLPMessage * msg)
+{
+   SLPSrvReg * srvreg = &msg->body.srvreg;
+   uint8_t * payload;
+   uint8_t * cur;
+   size_t len;
+   long written;
+
+   if (G_SnapshotLog == 0 || !SnapshotKeeps(msg))
+      return;
+
+   len = 4 + srvreg->urlentry.urllen + srvreg->scopelistlen;
+   if ((payload = xmalloc(len)) == 0)
+      return;
+   cur = payload;
+   PutUINT16(&cur, srvreg->urlentry.urllen);
+   memcpy(cur, srvreg->urlentry.url, srvreg->urlentry.urllen);
+   cur += srvreg->urlentry.urllen;
+   PutUINT16(&cur, srvreg->scopelistlen);
+   memcpy(cur, srvreg->scopelist, srvreg->scopelistlen);
+
+   written = SnapshotPutRecord(G_SnapshotLog, SNAPSHOT_REMOVE, msg,
+         payload, len);
+   if (written > 0 && fflush(G_SnapshotLog) == 0)
+      G_SnapshotLogSize += written;
+   xfree(payload);
+}
+
+/** Compact the log into a fresh snapshot once it outgrows the snapshot.
+ *
+ * Also retries a snapshot or log that could not be written last time.
+ */
+void SLPDSnapshotCheckpoint(void)
+{
+   if (G_SnapshotPath == 0)
+      return;
+
+   /* Compact once the log outgrows the snapshot; or, if no log could be
+    * started last time, as soon as possible, as nothing is being logged.
+    */
+   if (G_SnapshotLog == 0 || (G_SnapshotLogSize > SLPD_SNAPSHOT_LOG_MIN
+         && G_SnapshotLogSize > G_SnapshotSize))
+      SnapshotWrite();
+}
+
+#ifdef SLPD_SNAPSHOT_TEST
+
+/* ------------- Test main for the slpd_snapshot.c module -----------------
+ *
+ * Registers a few services as if over the network and removes one, then
+ * restarts the database without a final snapshot, as after a crash, and
+ * checks that the snapshot and log bring back what was there. Then checks
+ * that replay stops at a torn record, and skips a log of an older epoch
+ * and files of the wrong kind.
+ *
+ * Build and run with:
+ *    make slpd-snapshot-test && ./slpd-snapshot-test
+ */
+
+# define FAIL (printf("FAIL: %s at line %d.\n", __FILE__, __LINE__), (-1))
+# define PASS (printf("PASS: Success!\n"), (0))
+
+#define TEST_SNAPSHOT   "slpd-snapshot-test.snp"
+#define TEST_LOG        TEST_SNAPSHOT ".log"
+
+/* Register a URL in a scope, as a SrvReg from a remote SA would. */
+static int TestReg(const char * url, const char * scope, int lifetime)
+{
+   struct sockaddr_storage peer;
+   int remote = 0x0a000001;
+   size_t urllen = strlen(url);
+   size_t scopelen = strlen(scope);
+   size_t len = 14 + 2 + 6 + urllen + 1 + 2 + 17 + 2 + scopelen + 2 + 1;
+   SLPMessage * msg = SLPMessageAlloc();
+   SLPBuffer buf = SLPBufferAlloc(len);
+   uint8_t * cur;
+
+   if (msg == 0 || buf == 0)
+      return -1;
+
+   cur = buf->start;
+   *cur++ = 2;
+   *cur++ = SLP_FUNCT_SRVREG;
+   PutUINT24(&cur, len);
+   PutUINT16(&cur, SLP_FLAG_FRESH);
+   PutUINT24(&cur, 0);
+   PutUINT16(&cur, 1);
+   PutUINT16(&cur, 2);
+   memcpy(cur, "en", 2), cur += 2;
+   *cur++ = 0;
+   PutUINT16(&cur, lifetime);
+   PutUINT16(&cur, urllen);
+   memcpy(cur, url, urllen), cur += urllen;
+   *cur++ = 0;
+   PutUINT16(&cur, 17);
+   memcpy(cur, "service:snapshot", 17), cur += 17;
+   PutUINT16(&cur, scopelen);
+   memcpy(cur, scope, scopelen), cur += scopelen;
+   PutUINT16(&cur, 0);
+   *cur++ = 0;
+
+   memset(&peer, 0, sizeof(peer));
+   SLPNetSetAddr(&peer, AF_INET, SLP_RESERVED_PORT, &remote);
+   if (SLPMessageParseBuffer(&peer, 0, buf, msg) != 0)
+      return -1;
+   msg->body.srvreg.source = SLP_REG_SOURCE_REMOTE;
+   if (SLPDDatabaseReg(msg, buf) != SLP_ERROR_OK)
+      return -1;
+   return 0;
+}
+
+/* Return a bit mask of the test URLs "service:snapshot://N" in the
+ * database, or -1 if there is anything else.
+ */
+static int TestContents(void)
+{
+   SLPMessage * msg;
+   SLPBuffer buf;
+   void * eh;
+   int mask = 0;
+
+   if ((eh = SLPDDatabaseEnumStart()) == 0)
+      return -1;
+   while (SLPDDatabaseEnum(eh, &msg, &buf))
+   {
+      SLPUrlEntry * urlentry = &msg->body.srvreg.urlentry;
+
+      if (urlentry->urllen != 20
+            || memcmp(urlentry->url, "service:snapshot://", 19) != 0)
+         mask = -1;
+      else if (mask >= 0)
+         mask |= 1 << atoi(urlentry->url + 19);
+   }
+   SLPDDatabaseEnumEnd(eh);
+   return mask;
+}
+
+/* Restart the database from the snapshot; after a crash, the log is just
+ * closed, and no final snapshot is written.
+ */
+static int TestRestart(int crash)
+{
+   if (crash)
+      SnapshotClose();
+   else
+      SLPDSnapshotDeinit();
+   SLPDDatabaseDeinit();
+   if (SLPDDatabaseInit(0) != 0 || SLPDSnapshotInit() != 0)
+      return -1;
+   SLPDSnapshotStart();
+   return G_SnapshotLog? 0: -1;
+}
+
+/* Append bytes to the end of a file. */
+static int TestAppend(const char * path, const void * data, size_t len)
+{
+   FILE * fp = fopen(path, "ab");
+   int result = -1;
+
+   if (fp)
+   {
+      if (fwrite(data, 1, len, fp) == len)
+         result = 0;
+      if (fclose(fp) != 0)
+         result = -1;
+   }
+   return result;
+}
+
+/* Change the epoch of a file. */
+static int TestSetEpoch(const char * path, uint32_t epoch)
+{
+   FILE * fp = fopen(path, "r+b");
+   uint8_t buf[4];
+   int result = -1;
+
+   TO_UINT32(buf, epoch);
+   if (fp)
+   {
+      if (fseek(fp, 8, SEEK_SET) == 0 && fwrite(buf, 1, 4, fp) == 4)
+         result = 0;
+      if (fclose(fp) != 0)
+         result = -1;
+   }
+   return result;
+}
+
+int main(void)
+{
+   uint8_t torn[SNAPSHOT_RECLEN + 4];
+   SLPMessage * msg;
+   SLPBuffer buf;
+   uint8_t * data;
+   void * eh;
+   size_t len;
+   uint32_t epoch;
+   uint32_t wrong;
+
+   remove(TEST_SNAPSHOT);
+   remove(TEST_LOG);
+
+   /* An empty configuration file name leaves every property at its
+    * default, so the results do not depend on the host's slp.conf.
+    */
+   if (SLPDPropertyInit("") != 0)
+      return FAIL;
+   G_SlpdProperty.snapshotFile = xstrdup(TEST_SNAPSHOT);
+   if (SLPDDatabaseInit(0) != 0 || SLPDSnapshotInit() != 0)
+      return FAIL;
+   SLPDSnapshotStart();
+   if (G_SnapshotLog == 0 || TestContents() != 0)
+      return FAIL;
+
+   /* Registrations and removals are logged and replayed. */
+   if (TestReg("service:snapshot://1", "default", 300) != 0
+         || TestReg("service:snapshot://2", "default", 300) != 0
+         || TestReg("service:snapshot://3", "default", 300) != 0)
+      return FAIL;
+   SLPDDatabaseForget(20, "service:snapshot://2", 7, "default");
+   if (TestContents() != 0x0a || TestRestart(1) != 0
+         || TestContents() != 0x0a)
+      return FAIL;
+
+   /* A registration that expired while slpd was down is dropped. */
+   if (TestReg("service:snapshot://4", "default", 300) != 0
+         || (eh = SLPDDatabaseEnumStart()) == 0)
+      return FAIL;
+   while (SLPDDatabaseEnum(eh, &msg, &buf))
+      if (msg->body.srvreg.urlentry.url[19] == '4')
+         msg->body.srvreg.urlentry.lifetime = 1;
+   SLPDDatabaseEnumEnd(eh);
+   SLPDSnapshotDeinit();
+   sleep(2);
+   if (TestRestart(1) != 0 || TestContents() != 0x0a)
+      return FAIL;
+
+   /* Replay stops at a record that was only partly written, or whose
+    * payload does not match its hash.
+    */
+   if (TestReg("service:snapshot://5", "default", 300) != 0)
+      return FAIL;
+   memset(torn, 0, sizeof(torn));
+   torn[0] = SNAPSHOT_REMOVE;
+   TO_UINT32(torn + 28, 100);
+   if (TestAppend(TEST_LOG, torn, sizeof(torn)) != 0
+         || TestRestart(1) != 0 || TestContents() != 0x2a)
+      return FAIL;
+
+   if (TestReg("service:snapshot://6", "default", 300) != 0)
+      return FAIL;
+   TO_UINT32(torn + 28, 4);
+   if (TestAppend(TEST_LOG, torn, sizeof(torn)) != 0
+         || fseek(G_SnapshotLog, 0, SEEK_END) != 0
+         || TestReg("service:snapshot://7", "default", 300) != 0
+         || TestRestart(1) != 0 || TestContents() != 0x6a)
+      return FAIL;
+
+   /* Replay checks the kind and epoch of a file. */
+   if ((data = SnapshotMap(TEST_LOG, &len)) == 0)
+      return FAIL;
+   wrong = G_SnapshotEpoch - 1;
+   if (SnapshotReplay(data, len, SNAPSHOT_LOG_MAGIC, 0, &epoch) != 0
+         || epoch != G_SnapshotEpoch
+         || SnapshotReplay(data, len, SNAPSHOT_LOG_MAGIC, &wrong, &epoch) != -1
+         || SnapshotReplay(data, len, SNAPSHOT_MAGIC, 0, &epoch) != -1
+         || SnapshotReplay(data, SNAPSHOT_HDRLEN - 1, SNAPSHOT_LOG_MAGIC,
+               0, &epoch) != -1)
+      return FAIL;
+   SnapshotUnmap(data, len);
+
+   /* A log of an older epoch, as left when slpd stopped between writing
+    * the snapshot and starting a new log, is skipped.
+    */
+   if (TestReg("service:snapshot://8", "default", 300) != 0
+         || TestSetEpoch(TEST_LOG, G_SnapshotEpoch - 1) != 0
+         || TestRestart(1) != 0 || TestContents() != 0x6a)
+      return FAIL;
+
+   /* A final snapshot is written even if the log could not be. */
+   fclose(G_SnapshotLog);
+   G_SnapshotLog = 0;
+   if (TestReg("service:snapshot://8", "default", 300) != 0
+         || TestRestart(0) != 0 || TestContents() != 0x16a)
+      return FAIL;
+
+   SnapshotClose();
+   SLPDDatabaseDeinit();
+   remove(TEST_SNAPSHOT);
+   remove(TEST_LOG);
+   return PASS;
+}
+
+#endif /* SLPD_SNAPSHOT_TEST */
+
+/*=========================================================================*/
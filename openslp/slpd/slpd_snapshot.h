@@ -0,0 +1,69 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Persistent snapshot and log of the registration database.
+ *
+ * @file       slpd_snapshot.h
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    SlpdCode
+ */
+
+#ifndef SLPD_SNAPSHOT_H_INCLUDED
+#define SLPD_SNAPSHOT_H_INCLUDED
+
+/*!@defgroup SlpdCodeSnapshot Database Snapshot */
+
+/*!@addtogroup SlpdCodeSnapshot
+ * @ingroup SlpdCode
+ * @{
+ */
+
+#include "slp_types.h"
+#include "slp_buffer.h"
+#include "slp_message.h"
+#include "slpd.h"
+
+/** The log may grow to this many bytes before it is always compacted. */
+#define SLPD_SNAPSHOT_LOG_MIN    (64 * 1024)
+
+int SLPDSnapshotInit(void);
+void SLPDSnapshotStart(void);
+void SLPDSnapshotDeinit(void);
+void SLPDSnapshotLogReg(SLPMessage * msg, SLPBuffer buf);
+void SLPDSnapshotLogRemove(SLPMessage * msg);
+void SLPDSnapshotCheckpoint(void);
+
+/*! @} */
+
+#endif   /* SLPD_SNAPSHOT_H_INCLUDED */
+
+/*=========================================================================*/
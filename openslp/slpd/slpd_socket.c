@@ -375,6 +375,12 @@ void SLPDSocketFree(SLPDSocket * sock)
    if (sock->fd != SLP_INVALID_SOCKET)
       closesocket(sock->fd);
 
+#ifdef SLP_HAVE_LOCAL_SOCKET
+   /* remove the file system entry of a local listening socket */
+   if (sock->state == SOCKET_LISTEN && sock->localaddr.ss_family == AF_UNIX)
+      unlink(((struct sockaddr_un *)&sock->localaddr)->sun_path);
+#endif
+
    /* free receive buffer */
    if (sock->recvbuf)
       SLPBufferFree(sock->recvbuf);
@@ -391,6 +397,24 @@ void SLPDSocketFree(SLPDSocket * sock)
    if (sock->sendbuf)
       SLPBufferFree(sock->sendbuf);
 
+   /* free forwarding channel backlog and xid index */
+   while (sock->backlog.count)
+      SLPBufferFree((SLPBuffer)SLPListUnlink(&sock->backlog, sock->backlog.head));
+   if (sock->inflight)
+      xfree(sock->inflight);
+
+   /* unlink from the outgoing peer index and retry wheel */
+   if (sock->peerprev)
+   {
+      if ((*sock->peerprev = sock->peernext) != 0)
+         sock->peernext->peerprev = sock->peerprev;
+   }
+   if (sock->retryprev)
+   {
+      if ((*sock->retryprev = sock->retrynext) != 0)
+         sock->retrynext->retryprev = sock->retryprev;
+   }
+
    /* free the actual socket structure */
    xfree(sock);
 }
@@ -651,6 +675,96 @@ SLPDSocket * SLPDSocketCreateListen(struct sockaddr_storage * peeraddr)
    return 0;
 }
 
+/** Create a listening socket on a local (AF_UNIX) path.
+ *
+ * The socket is of type SOCK_SEQPACKET, so each SLP message arrives as
+ * one record, and is non-blocking, so accept never blocks. Any socket
+ * already at @p path is unlinked and replaced, whether or not another
+ * process is still listening on it; any other kind of file there is left
+ * alone and no socket is created. The path is made writable by all local
+ * users, so any of them can connect, as to the loopback TCP port.
+ *
+ * @param[in] path - The file system path to listen on.
+ *
+ * @return A valid socket or NULL if the path is empty or unusable, or the
+ *    platform has no such sockets.
+ */
+SLPDSocket * SLPDSocketCreateLocalListen(const char * path)
+{
+#ifdef SLP_HAVE_LOCAL_SOCKET
+   SLPDSocket * sock;
+   struct sockaddr_un * addr;
+   struct stat st;
+
+   if (!path || !*path || strlen(path) >= sizeof(addr->sun_path))
+      return 0;
+
+   if (lstat(path, &st) == 0 && !S_ISSOCK(st.st_mode))
+      return 0;
+
+   sock = SLPDSocketAlloc();
+   if (sock)
+   {
+      addr = (struct sockaddr_un *)&sock->localaddr;
+      addr->sun_family = AF_UNIX;
+      strcpy(addr->sun_path, path);
+
+      sock->fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+      if (sock->fd != SLP_INVALID_SOCKET)
+      {
+         unlink(path);
+         if (bind(sock->fd, (struct sockaddr *)addr, sizeof(*addr)) == 0)
+         {
+            chmod(path, 0666);
+            if (listen(sock->fd, 5) == 0)
+            {
+               /* Set socket to non-blocking so subsequent calls to
+                  accept will *never* block */
+               int fdflags = fcntl(sock->fd, F_GETFL, 0);
+               fcntl(sock->fd, F_SETFL, fdflags | O_NONBLOCK);
+               sock->state = SOCKET_LISTEN;
+               return sock;
+            }
+         }
+      }
+      SLPDSocketFree(sock);   /* also removes the path again */
+   }
+#else
+   (void)path;
+#endif
+   return 0;
+}
+
+/** Retrieve the process id of the peer of a local (AF_UNIX) socket.
+ *
+ * The value comes from the kernel's record of the connecting process,
+ * so unlike the pid extension of a SrvReg it cannot be forged.
+ *
+ * @param[in] fd - A connected AF_UNIX socket.
+ * @param[out] pid - The address of storage for the peer's process id.
+ *
+ * @return Zero on success, or a non-zero value if the platform does not
+ *    report peer process ids.
+ */
+int SLPDSocketGetPeerPid(sockfd_t fd, uint32_t * pid)
+{
+#if defined(SLP_HAVE_LOCAL_SOCKET) && defined(SO_PEERCRED)
+   struct ucred cred;
+   socklen_t credlen = sizeof(cred);
+
+   if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) == 0
+         && cred.pid > 0)
+   {
+      *pid = (uint32_t)cred.pid;
+      return 0;
+   }
+#else
+   (void)fd;
+   (void)pid;
+#endif
+   return -1;
+}
+
 /** Determines if a socket is listening on an address.
  *
  * @param[in] sock - The socket to check.
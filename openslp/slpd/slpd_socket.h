@@ -95,9 +95,25 @@ typedef struct _SLPDSocket
    SLPBuffer recvbuf;
    SLPBuffer sendbuf;
 
+   /* Local (AF_UNIX) socket stuff */
+   int islocal;       /* accepted on slpd's local socket; peeraddr is loopback */
+   uint32_t peerpid;  /* pid from the peer's kernel credentials, or 0 */
+
    /* Outgoing socket stuff */
    int reconns; /*For stream sockets, this drives reconnect.  For unicast dgram sockets, this drives resend*/
    SLPList sendlist;
+
+   /* Forwarding channel stuff (see SLPDOutgoingForward) */
+   int ischannel;         /* long-lived per-DA channel; sendlist is the in-flight window */
+   SLPList backlog;       /* messages waiting for a free window slot */
+   SLPBuffer * inflight;  /* sendlist entries indexed by xid, SLPD_FORWARD_SLOTS long */
+
+   /* Outgoing indexes (see slpd_outgoing.c); a freed socket unlinks itself */
+   struct _SLPDSocket * peernext;    /* next socket in the same peer bucket */
+   struct _SLPDSocket ** peerprev;   /* link to this socket, or null if not indexed */
+   struct _SLPDSocket * retrynext;   /* next socket in the same retry slot */
+   struct _SLPDSocket ** retryprev;  /* link to this socket, or null if no retry is due */
+   time_t deadline;                  /* outgoing clock time of the next retry */
 #if HAVE_POLL
    int fdsetnr;
 #endif
@@ -139,6 +155,8 @@ typedef struct _SLPD_fdset
 
 SLPDSocket * SLPDSocketCreateConnected(struct sockaddr_storage * addr);
 SLPDSocket * SLPDSocketCreateListen(struct sockaddr_storage * peeraddr);
+SLPDSocket * SLPDSocketCreateLocalListen(const char * path);
+int SLPDSocketGetPeerPid(sockfd_t fd, uint32_t * pid);
 int SLPDSocketIsMcastOn(SLPDSocket * sock, struct sockaddr_storage * addr);
 SLPDSocket * SLPDSocketCreateDatagram(struct sockaddr_storage * peeraddr, 
       int type); 
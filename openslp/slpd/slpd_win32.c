@@ -48,6 +48,8 @@
 #include "slpd_incoming.h"
 #include "slpd_outgoing.h"
 #include "slpd_knownda.h"
+#include "slpd_snapshot.h"
+#include "slpd_dacache.h"
 #include "slpd.h"
 
 #include "slp_linkedlist.h"
@@ -387,14 +389,17 @@ static void ServiceStart(int argc, char ** argv)
    /* initialize for the first time */
    SLPDPropertyReinit();  /*So we get any property-related log messages*/
    if (SLPDDatabaseInit(G_SlpdCommandLine.regfile)
+         || SLPDSnapshotInit()
          || SLPDIncomingInit()
          || SLPDOutgoingInit()
+         || SLPDDACacheInit()
          || SLPDKnownDAInit())
    {
       SLPDLog("slpd initialization failed\n");
       goto cleanup_winsock;
    }
    SLPDLog("Agent Interfaces = %s\n", G_SlpdProperty.interfaces);
+   SLPDSnapshotStart();
 
    /* service is now running, perform work until shutdown    */
    if (!ReportStatusToSCMgr(SERVICE_RUNNING, NO_ERROR, 0))
@@ -42,6 +42,7 @@
  */
 
 #include "slptool.h"
+#include "slp_regfile.h"
 
 #ifndef _WIN32
 # ifndef HAVE_STRCASECMP
@@ -313,6 +314,97 @@ void Deregister(SLPToolCommandLine * cmdline)
    }
 }
 
+void CompileRegFile(SLPToolCommandLine * cmdline)
+{
+   SLPRegFileEntry entry;
+   char line[4096];
+   char * tmpname;
+   uint32_t count = 0;
+   uint32_t hash = 0;
+   FILE * in;
+   FILE * out;
+   int result;
+
+   in = fopen(cmdline->cmdparam1, "rb");
+   if (in == 0)
+   {
+      printf("Can't open %s\n", cmdline->cmdparam1);
+      return;
+   }
+
+   /* slpd may have the output file mapped, so replace it rather than
+    * writing over it
+    */
+   tmpname = malloc(strlen(cmdline->cmdparam2) + sizeof(".tmp"));
+   if (tmpname == 0)
+   {
+      fclose(in);
+      return;
+   }
+   strcpy(tmpname, cmdline->cmdparam2);
+   strcat(tmpname, ".tmp");
+
+   out = fopen(tmpname, "wb");
+   if (out == 0)
+   {
+      printf("Can't create %s\n", tmpname);
+      free(tmpname);
+      fclose(in);
+      return;
+   }
+
+   /* leave room for the header until the entries are known */
+   result = SLPRegFileWriteHeader(out, 0, 0);
+   while (result == 0)
+   {
+      result = SLPRegFileReadEntry(in, &entry, line, sizeof(line));
+      if (result == 0)
+      {
+         if (SLPRegFileWriteEntry(out, &entry, &hash) != 0)
+         {
+            printf("Can't write %s\n", tmpname);
+            result = 1;
+         }
+         count++;
+      }
+      else if (result > 0)
+      {
+         /* report the bad entry and carry on with the rest */
+         printf("Skipping invalid registration near:\n   %s\n", line);
+         result = 0;
+      }
+      SLPRegFileFreeEntry(&entry);
+   }
+
+   if (result < 0 && (fseek(out, 0, SEEK_SET) != 0
+         || SLPRegFileWriteHeader(out, count, hash) != 0))
+   {
+      printf("Can't write %s\n", tmpname);
+      result = 1;
+   }
+   if (fclose(out) != 0 && result < 0)
+   {
+      printf("Can't write %s\n", tmpname);
+      result = 1;
+   }
+   fclose(in);
+
+   if (result < 0)
+   {
+#ifdef _WIN32
+      remove(cmdline->cmdparam2);
+#endif
+      if (rename(tmpname, cmdline->cmdparam2) == 0)
+         printf("%lu registrations compiled into %s\n",
+               (unsigned long)count, cmdline->cmdparam2);
+      else
+         printf("Can't rename %s to %s\n", tmpname, cmdline->cmdparam2);
+   }
+   else
+      remove(tmpname);
+   free(tmpname);
+}
+
 void PrintVersion(SLPToolCommandLine * cmdline)
 {
    (void)cmdline;
@@ -490,6 +582,24 @@ int ParseCommandLine(int argc, char * argv[], SLPToolCommandLine * cmdline)
          else
             return 1;
       }
+      else if (strcasecmp(argv[i], "compileregfile") == 0)
+      {
+         cmdline->cmd = COMPILEREGFILE;
+
+         /* text registration file */
+         i++;
+         if (i < argc)
+            cmdline->cmdparam1 = argv[i];
+         else
+            return 1;
+
+         /* compiled registration file */
+         i++;
+         if (i < argc)
+            cmdline->cmdparam2 = argv[i];
+         else
+            return 1;
+      }
       else if (strcasecmp(argv[i], "getproperty") == 0)
       {
          cmdline->cmd = GETPROPERTY;
@@ -527,6 +637,7 @@ void DisplayUsage()
    printf("      findscopes\n");
    printf("      register url [attrs]\n");
    printf("      deregister url\n");
+   printf("      compileregfile regfile compiled-regfile\n");
    printf("      getproperty propertyname\n");
    printf("\n");
    printf("Examples:\n");
@@ -549,6 +660,7 @@ void DisplayUsage()
 #endif
    printf("   slptool deregister service:myserv.x://myhost.com\n");
    printf("   slptool getproperty net.slp.useScopes\n");
+   printf("   slptool compileregfile /etc/slp.reg /etc/slp.reg.bin\n");
 }
 
 int main(int argc, char * argv[])
@@ -591,6 +703,10 @@ int main(int argc, char * argv[])
             Deregister(&cmdline);
             break;
 
+         case COMPILEREGFILE:
+            CompileRegFile(&cmdline);
+            break;
+
          case PRINT_VERSION:
             PrintVersion(&cmdline);
 	    break;
@@ -92,6 +92,7 @@ typedef enum _SLPToolCommand
    GETPROPERTY,
    REGISTER,
    DEREGISTER,
+   COMPILEREGFILE,
    PRINT_VERSION,
    DUMMY
 } SLPToolCommand;
@@ -115,6 +116,7 @@ void FindSrvTypes(SLPToolCommandLine * cmdline);
 void GetProperty(SLPToolCommandLine * cmdline);
 void Register(SLPToolCommandLine * cmdline);
 void Deregister(SLPToolCommandLine * cmdline);
+void CompileRegFile(SLPToolCommandLine * cmdline);
 
 /*! @} */
 
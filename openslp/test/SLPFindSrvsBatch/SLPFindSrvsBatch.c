@@ -0,0 +1,104 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Test for SLPFindSrvsBatch.
+ *
+ * @file       SLPFindSrvsBatch.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    TestCode
+ */
+
+#include <slp.h>
+#include <slp_debug.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+SLPBoolean MySLPSrvURLBatchCallback(SLPHandle hslp, unsigned int query,
+      const char * srvurl, unsigned short lifetime, SLPError errcode, 
+      void * cookie)
+{
+   (void)hslp;
+   switch (errcode)
+   {
+      case SLP_OK:
+         printf("Query %u Service URL     = %s\n", query, srvurl);
+         printf("Query %u Service Timeout = %i\n", query, lifetime);
+         break;
+
+      case SLP_LAST_CALL:
+         printf("Query %u Done\n", query);
+         break;
+
+      default:
+         ((SLPError *)cookie)[query] = errcode;
+         break;
+   }
+   return SLP_TRUE;
+}
+
+int main(int argc, char * argv[])
+{
+   int i;
+   SLPError err;
+   SLPError * callbackerr;
+   SLPSrvQuery * queries;
+   SLPHandle hslp;
+
+   if (argc < 2)
+   {
+      printf("SLPFindSrvsBatch\n  Finds SLP services in one batch.\n"
+            " Usage:\n   SLPFindSrvsBatch\n     <service type> ...\n");
+      return 0;
+   }
+   queries = calloc(argc - 1, sizeof(SLPSrvQuery));
+   callbackerr = calloc(argc - 1, sizeof(SLPError));
+   if (queries == 0 || callbackerr == 0)
+      return 1;
+   for (i = 1; i < argc; i++)
+      queries[i - 1].s_pcSrvType = argv[i];
+
+   err = SLPOpen("en", SLP_FALSE, &hslp);
+   check_error_state(err, "Error opening slp handle.");
+
+   err = SLPFindSrvsBatch(hslp, queries, argc - 1, 
+         MySLPSrvURLBatchCallback, callbackerr);
+   check_error_state(err, "Error finding services with slp.");
+
+   /* Now that we're done using slp, close the slp handle */
+   SLPClose(hslp);
+
+   free(callbackerr);
+   free(queries);
+   return 0;
+}
+
+/*=========================================================================*/ 
@@ -0,0 +1,114 @@
+/*-------------------------------------------------------------------------
+ * Copyright (C) 2000 Caldera Systems, Inc
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ *    Neither the name of Caldera Systems nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * `AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE CALDERA
+ * SYSTEMS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-------------------------------------------------------------------------*/
+
+/** Test for SLPFindSrvsStart, SLPFindSrvsNext and SLPFindSrvsCancel.
+ *
+ * @file       SLPFindSrvsStream.c
+ * @attention  Please submit patches to http://www.openslp.org
+ * @ingroup    TestCode
+ */
+
+#include <slp.h>
+#include <slp_debug.h>
+#include <stdio.h>
+
+SLPBoolean MySLPSrvURLCallback(SLPHandle hslp, const char * srvurl,
+      unsigned short lifetime, SLPError errcode, void * cookie)
+{
+   (void)hslp;
+   switch (errcode)
+   {
+      case SLP_OK:
+         printf("Service URL     = %s\n", srvurl);
+         printf("Service Timeout = %i\n", lifetime);
+         break;
+
+      case SLP_LAST_CALL:
+         printf("Last call\n");
+         break;
+
+      default:
+         break;
+   }
+   *(SLPError *)cookie = errcode;
+   return SLP_TRUE;
+}
+
+int main(int argc, char * argv[])
+{
+   SLPError err;
+   SLPError callbackerr;
+   SLPHandle hslp;
+   SLPSrvURLStream hstream;
+   char * srvurl;
+   unsigned short lifetime;
+
+   if (argc != 2)
+   {
+      printf("SLPFindSrvsStream\n  Finds a SLP service as a stream.\n"
+            " Usage:\n   SLPFindSrvsStream\n     <service type>\n");
+      return 0;
+   }
+   err = SLPOpen("en", SLP_FALSE, &hslp);
+   check_error_state(err, "Error opening slp handle.");
+
+   err = SLPFindSrvsStart(hslp, argv[1], 0, 0, &hstream);
+   check_error_state(err, "Error starting service stream.");
+
+   while ((err = SLPFindSrvsNext(hstream, &srvurl, &lifetime)) == SLP_OK)
+   {
+      printf("Service URL     = %s\n", srvurl);
+      printf("Service Timeout = %i\n", lifetime);
+      SLPFree(srvurl);
+   }
+   if (err != SLP_LAST_CALL)
+      check_error_state(err, "Error reading service stream.");
+
+   /* Release the stream before reusing the handle */
+   SLPFindSrvsCancel(hstream);
+
+   /* Cancelling a stream must not stop later requests on the handle */
+   err = SLPFindSrvsStart(hslp, argv[1], 0, 0, &hstream);
+   check_error_state(err, "Error starting service stream.");
+   SLPFindSrvsCancel(hstream);
+
+   err = SLPFindSrvs(hslp, argv[1], 0, 0, MySLPSrvURLCallback, &callbackerr);
+   check_error_state(err, "Error finding services after a cancel.");
+   if (callbackerr != SLP_LAST_CALL)
+      printf("No last call after a cancel\n");
+
+   SLPClose(hslp);
+
+   return 0;
+}
+
+/*=========================================================================*/ 